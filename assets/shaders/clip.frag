@@ -0,0 +1,60 @@
+#version 450
+
+// only the stencil is written, pixels outside the shape are discarded
+
+// enum ClipKind in clip.h
+#define KIND_ROUNDED_RECT 1
+#define KIND_PATH 2
+
+// matches struct ClipParams in clip.h
+layout(push_constant) uniform Clip {
+	vec4 view; // x0, y0, 2 / width, 2 / height
+	vec4 rect; // x, y, width, height
+	float radius;
+	uint kind;
+	uint first_point;
+	uint point_count;
+} clip;
+
+layout(std430, set = 0, binding = 0) readonly buffer Points {
+	vec2 points[];
+};
+
+layout(location = 0) in vec2 fragPosition;
+
+float rounded_rect_distance(vec2 position)
+{
+	vec2 half_size = 0.5 * clip.rect.zw;
+	float radius = min(clip.radius, min(half_size.x, half_size.y));
+	vec2 q = abs(position - clip.rect.xy - half_size) - half_size + radius;
+
+	return length(max(q, 0.0)) + min(max(q.x, q.y), 0.0) - radius;
+}
+
+// winding number of the closed polygon around position
+int winding(vec2 position)
+{
+	int count = 0;
+
+	for (uint i = 0; i < clip.point_count; i++)
+	{
+		vec2 a = points[clip.first_point + i];
+		vec2 b = points[clip.first_point + (i + 1) % clip.point_count];
+		float side = (b.x - a.x) * (position.y - a.y) - (position.x - a.x) * (b.y - a.y);
+
+		if (a.y <= position.y) {
+			if (b.y > position.y && side > 0.0) count++;
+		}
+		else if (b.y <= position.y && side < 0.0) {
+			count--;
+		}
+	}
+
+	return count;
+}
+
+void main()
+{
+	if (clip.kind == KIND_ROUNDED_RECT && rounded_rect_distance(fragPosition) > 0.0) discard;
+	if (clip.kind == KIND_PATH && winding(fragPosition) == 0) discard;
+}
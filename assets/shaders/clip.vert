@@ -0,0 +1,28 @@
+#version 450
+
+// matches struct ClipParams in clip.h
+layout(push_constant) uniform Clip {
+	vec4 view; // x0, y0, 2 / width, 2 / height
+	vec4 rect; // x, y, width, height
+	float radius;
+	uint kind;
+	uint first_point;
+	uint point_count;
+} clip;
+
+layout(location = 0) out vec2 fragPosition;
+
+// triangle strip
+vec2 corners[4] = vec2[](
+	vec2(0.0, 0.0),
+	vec2(1.0, 0.0),
+	vec2(0.0, 1.0),
+	vec2(1.0, 1.0)
+);
+
+void main() {
+	vec2 position = clip.rect.xy + corners[gl_VertexIndex] * clip.rect.zw;
+
+	gl_Position = vec4((position - clip.view.xy) * clip.view.zw - 1.0, 0.0, 1.0);
+	fragPosition = position;
+}
@@ -0,0 +1,17 @@
+#version 450
+
+layout(set = 0, binding = 0) uniform sampler2D layer;
+
+layout(push_constant) uniform Composite {
+	vec4 rect;
+	vec4 color;  // premultiplied
+} composite;
+
+layout(location = 0) in vec2 fragUv;
+
+layout(location = 0) out vec4 outColor;
+
+void main()
+{
+	outColor = texture(layer, fragUv) * composite.color;
+}
@@ -0,0 +1,24 @@
+#version 450
+
+layout(push_constant) uniform Composite {
+	vec4 rect;  // x0, y0, x1, y1 in clip space
+	vec4 color;
+} composite;
+
+layout(location = 0) out vec2 fragUv;
+
+vec2 corners[6] = vec2[](
+	vec2(0.0, 0.0),
+	vec2(1.0, 0.0),
+	vec2(1.0, 1.0),
+	vec2(1.0, 1.0),
+	vec2(0.0, 1.0),
+	vec2(0.0, 0.0)
+);
+
+void main() {
+	vec2 corner = corners[gl_VertexIndex];
+
+	gl_Position = vec4(mix(composite.rect.xy, composite.rect.zw, corner), 0.0, 1.0);
+	fragUv = corner;
+}
@@ -0,0 +1,20 @@
+#version 450
+
+layout(set = 0, binding = 0) uniform sampler2D texture_image;
+
+layout(push_constant) uniform Image {
+	vec4 rect;
+	vec4 color;
+} image;
+
+layout(location = 0) in vec2 fragUv;
+
+layout(location = 0) out vec4 outColor;
+
+void main()
+{
+	// decoded images have straight alpha, blending expects it premultiplied
+	vec4 texel = texture(texture_image, fragUv);
+
+	outColor = vec4(texel.rgb * texel.a, texel.a) * image.color;
+}
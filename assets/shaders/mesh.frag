@@ -0,0 +1,12 @@
+#version 450
+
+layout(location = 0) in vec4 fragColor;
+layout(location = 1) in vec2 fragUV;
+
+layout(location = 0) out vec4 outColor;
+
+void main()
+{
+	// v runs across the mesh, a little darker on the inside
+	outColor = vec4(fragColor.rgb * (0.6 + 0.4 * fragUV.y), fragColor.a);
+}
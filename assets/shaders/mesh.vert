@@ -0,0 +1,28 @@
+#version 450
+
+// per frame, from the uniform ring
+layout(set = 0, binding = 0) uniform Frame {
+	vec4 view;  // x0, y0, 2 / width, 2 / height
+	float time;
+} frame;
+
+// per draw
+layout(push_constant) uniform Draw {
+	vec4 tile;  // origin x, y, half extent x, y
+} draw;
+
+// float or compact vertices, the input formats expand both to the same values
+layout(location = 0) in vec2 inPosition;
+layout(location = 1) in vec2 inUV;
+layout(location = 2) in vec4 inColor;
+
+layout(location = 0) out vec4 fragColor;
+layout(location = 1) out vec2 fragUV;
+
+void main() {
+	vec2 position = draw.tile.xy + inPosition * draw.tile.zw;
+
+	gl_Position = vec4((position - frame.view.xy) * frame.view.zw - 1.0, 0.0, 1.0);
+	fragColor = inColor;
+	fragUV = inUV;
+}
@@ -0,0 +1,73 @@
+#version 450
+
+// enum PaintKind, enum PaintExtend and the ramp texture size in paint.h
+#define KIND_LINEAR 1
+#define KIND_RADIAL 2
+#define KIND_CONIC 3
+#define KIND_PATTERN 4
+#define EXTEND_REPEAT 1
+#define EXTEND_REFLECT 2
+#define RAMP_WIDTH 256.0
+#define RAMP_COUNT 256.0
+
+layout(set = 0, binding = 0) uniform sampler2D ramps;
+layout(set = 1, binding = 0) uniform sampler2D pattern;
+
+layout(location = 0) in vec2 fragPosition;
+layout(location = 1) flat in vec4 fragParams;
+layout(location = 2) flat in vec4 fragColor;
+layout(location = 3) flat in uvec3 fragPaint;
+
+layout(location = 0) out vec4 outColor;
+
+vec2 extend(vec2 t, uint mode)
+{
+	if (mode == EXTEND_REPEAT) return fract(t);
+	if (mode == EXTEND_REFLECT) return 1.0 - abs(mod(t, 2.0) - 1.0);
+
+	return clamp(t, 0.0, 1.0);
+}
+
+// texel centres only, so the ends of a ramp are its end stops and rows never blend
+vec4 ramp(float t, uint mode)
+{
+	float u = (extend(vec2(t), mode).x * (RAMP_WIDTH - 1.0) + 0.5) / RAMP_WIDTH;
+	float v = (float(fragPaint.z) + 0.5) / RAMP_COUNT;
+
+	return textureLod(ramps, vec2(u, v), 0.0);
+}
+
+void main()
+{
+	vec2 p = fragPosition;
+	vec4 params = fragParams;
+	uint kind = fragPaint.x;
+	uint mode = fragPaint.y;
+
+	// pattern coordinates and their gradients, taken before any branch; unwrapped so
+	// the wrap does not pick the smallest mip
+	vec2 uv = (p - params.xy) / params.zw;
+	vec2 uv_dx = dFdx(uv);
+	vec2 uv_dy = dFdy(uv);
+
+	vec4 color = vec4(1.0);
+
+	if (kind == KIND_LINEAR) {
+		vec2 d = params.zw - params.xy;
+		color = ramp(dot(p - params.xy, d) / max(dot(d, d), 1e-6), mode);
+	}
+	else if (kind == KIND_RADIAL) {
+		color = ramp(length(p - params.xy) / max(params.z, 1e-6), mode);
+	}
+	else if (kind == KIND_CONIC) {
+		vec2 d = p - params.xy;
+		color = ramp(fract((atan(d.y, d.x) - params.z) / 6.2831853), EXTEND_REPEAT);
+	}
+	else if (kind == KIND_PATTERN) {
+		color = textureGrad(pattern, extend(uv, mode), uv_dx, uv_dy);
+	}
+
+	// straight alpha throughout, blending expects it premultiplied
+	color *= fragColor;
+	outColor = vec4(color.rgb * color.a, color.a);
+}
@@ -0,0 +1,45 @@
+#version 450
+
+// matches struct PaintInstance in paint.h
+struct Instance {
+	vec4 rect;   // x, y, width, height
+	vec4 params;
+	vec4 color;
+	uint kind;
+	uint extend;
+	uint ramp;
+	uint pad;
+};
+
+layout(std430, set = 0, binding = 1) readonly buffer Instances {
+	Instance instances[];
+};
+
+layout(push_constant) uniform View {
+	vec4 transform;  // x0, y0, 2 / width, 2 / height
+} view;
+
+layout(location = 0) out vec2 fragPosition;
+layout(location = 1) flat out vec4 fragParams;
+layout(location = 2) flat out vec4 fragColor;
+layout(location = 3) flat out uvec3 fragPaint; // kind, extend, ramp
+
+// triangle strip
+vec2 corners[4] = vec2[](
+	vec2(0.0, 0.0),
+	vec2(1.0, 0.0),
+	vec2(0.0, 1.0),
+	vec2(1.0, 1.0)
+);
+
+void main() {
+	Instance instance = instances[gl_InstanceIndex];
+
+	vec2 position = instance.rect.xy + corners[gl_VertexIndex] * instance.rect.zw;
+
+	gl_Position = vec4((position - view.transform.xy) * view.transform.zw - 1.0, 0.0, 1.0);
+	fragPosition = position;
+	fragParams = instance.params;
+	fragColor = instance.color;
+	fragPaint = uvec3(instance.kind, instance.extend, instance.ramp);
+}
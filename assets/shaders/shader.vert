@@ -1,5 +1,16 @@
 #version 450
 
+// per frame, from the uniform ring
+layout(set = 0, binding = 0) uniform Frame {
+	vec4 view;  // x0, y0, 2 / width, 2 / height
+	float time;
+} frame;
+
+// per draw
+layout(push_constant) uniform Draw {
+	vec4 transform;  // center x, center y, size, spin in radians per second
+} draw;
+
 layout(location = 0) out vec3 fragColor;
 
 vec2 positions[3] = vec2[](
@@ -15,6 +26,11 @@ vec3 colors[3] = vec3[](
 );
 
 void main() {
-	gl_Position = vec4(positions[gl_VertexIndex], 0.0, 1.0);
+	float angle = frame.time * draw.transform.w;
+	mat2 rotation = mat2(cos(angle), sin(angle), -sin(angle), cos(angle));
+
+	vec2 position = draw.transform.xy + rotation * positions[gl_VertexIndex] * draw.transform.z;
+
+	gl_Position = vec4((position - frame.view.xy) * frame.view.zw - 1.0, 0.0, 1.0);
 	fragColor = colors[gl_VertexIndex];
 }
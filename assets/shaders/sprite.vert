@@ -0,0 +1,40 @@
+#version 450
+
+struct Instance {
+	vec4 rect;  // x, y, width, height
+	vec4 color;
+	uint clip;
+	uint layer;
+	uint pad0;
+	uint pad1;
+};
+
+layout(std430, set = 0, binding = 0) readonly buffer Instances {
+	Instance instances[];
+};
+
+layout(std430, set = 0, binding = 2) readonly buffer Visible {
+	uint visible[];
+};
+
+layout(push_constant) uniform View {
+	vec4 transform;  // x0, y0, 2 / width, 2 / height
+} view;
+
+layout(location = 0) out vec4 fragColor;
+
+vec2 corners[4] = vec2[](
+	vec2(0.0, 0.0),
+	vec2(1.0, 0.0),
+	vec2(1.0, 1.0),
+	vec2(0.0, 1.0)
+);
+
+void main() {
+	Instance instance = instances[visible[gl_InstanceIndex]];
+
+	vec2 position = instance.rect.xy + corners[gl_VertexIndex] * instance.rect.zw;
+
+	gl_Position = vec4((position - view.transform.xy) * view.transform.zw - 1.0, 0.0, 1.0);
+	fragColor = instance.color;
+}
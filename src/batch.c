@@ -0,0 +1,570 @@
+// vg_batch: renders the frames of a scene trace as a batch of jobs on every
+// usable device at once, the way thumbnails and charts are rendered on a
+// render server, and reports images per second per device and in total.
+//
+//   vg_batch trace.vgt [--jobs n] [--devices n] [--scaling] [--output thumb_%06u.ppm] [--render-pass] [--cpu-cull] [--no-cpu]
+//
+// Every device gets its own context and a worker thread that renders one job
+// at a time, job n being frame n of the trace (wrapping around). Workers take
+// jobs from a shared queue, in batches sized by the throughput they measured
+// so far: a share of what is left in proportion to their rate, halved so the
+// batches shrink towards the end and the devices finish together. Jobs of a
+// worker whose device fails go back to the queue for the others.
+//
+// --scaling runs the same jobs on the best device alone, then the best two,
+// and so on, and prints the speedup over the first.
+
+#define _POSIX_C_SOURCE 200809L // clock_gettime
+
+#include <vulkan/vulkan.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "render.h"
+#include "scene.h"
+#include "trace.h"
+#include "capture.h"
+#include "track.h"
+#include "context.h"
+
+#define BATCH_FORMAT VK_FORMAT_R8G8B8A8_UNORM
+#define BATCH_MAX_TAKE 256    // jobs in one batch, so a rate measured early cannot claim everything
+#define BATCH_RATE_WEIGHT 0.3 // of a new measurement against the running rate
+
+struct BatchQueue {
+	pthread_mutex_t lock;
+	uint32_t next;
+	uint32_t count;
+
+	// jobs handed back by workers that failed, taken before new ones
+	uint32_t *returned;
+	uint32_t returned_count;
+
+	uint32_t worker_count;
+	bool active[RENDER_MAX_DEVICES];
+	double rates[RENDER_MAX_DEVICES]; // jobs per ms, 0 until measured
+};
+
+struct BatchWorker {
+	uint32_t index; // of its device
+	uint32_t slot;  // in the worker list and the queue, devices that failed leave no gap
+	char name[VK_MAX_PHYSICAL_DEVICE_NAME_SIZE];
+	struct RenderContext context;
+
+	VkCommandPool command_pool;
+	VkCommandBuffer command_buffer;
+	VkFence fence;
+	struct Image target;
+	bool capturing;
+	struct FrameCapture capture;
+	struct SceneRenderer *scene;
+	VkFramebuffer *framebuffer; // only without dynamic rendering
+	struct SceneFrame *frame;
+	uint64_t frame_index;
+
+	const struct TraceReader *reader;
+	struct BatchQueue *queue;
+	pthread_t thread;
+
+	// of the last run
+	uint32_t rendered;
+	uint32_t failed;
+	double busy_ms;
+	VkResult result;
+};
+
+static double now_ms(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static void reset_batch_queue(struct BatchQueue *queue, uint32_t job_count, uint32_t worker_count)
+{
+	queue->next = 0;
+	queue->count = job_count;
+	queue->returned_count = 0;
+	queue->worker_count = worker_count;
+
+	for (uint32_t i = 0; i < RENDER_MAX_DEVICES; i++)
+	{
+		queue->active[i] = i < worker_count;
+		queue->rates[i] = 0.0;
+	}
+}
+
+// jobs first to first + count - 1 for the worker, count 0 when the queue is empty
+static uint32_t take_jobs(struct BatchQueue *queue, uint32_t worker, uint32_t *first)
+{
+	pthread_mutex_lock(&queue->lock);
+
+	if (queue->returned_count > 0) {
+		*first = queue->returned[--queue->returned_count];
+		pthread_mutex_unlock(&queue->lock);
+		return 1;
+	}
+
+	uint32_t remaining = queue->count - queue->next;
+	uint32_t take = remaining > 0 ? 1 : 0;
+
+	// one at a time until every active worker has a rate, nobody knows its share before
+	double total = 0.0;
+	bool measured = true;
+
+	for (uint32_t i = 0; i < queue->worker_count; i++)
+	{
+		if (!queue->active[i]) continue;
+
+		total += queue->rates[i];
+		measured = measured && queue->rates[i] > 0.0;
+	}
+
+	if (measured && total > 0.0) {
+		uint32_t share = (uint32_t) (0.5 * remaining * queue->rates[worker] / total);
+		if (share > take) take = share;
+	}
+
+	if (take > BATCH_MAX_TAKE) take = BATCH_MAX_TAKE;
+
+	*first = queue->next;
+	queue->next += take;
+
+	pthread_mutex_unlock(&queue->lock);
+
+	return take;
+}
+
+static void report_rate(struct BatchQueue *queue, uint32_t worker, uint32_t jobs, double ms)
+{
+	if (jobs == 0 || ms <= 0.0) return;
+
+	double rate = jobs / ms;
+
+	pthread_mutex_lock(&queue->lock);
+
+	double *current = &queue->rates[worker];
+	*current = *current > 0.0 ? (1.0 - BATCH_RATE_WEIGHT) * *current + BATCH_RATE_WEIGHT * rate : rate;
+
+	pthread_mutex_unlock(&queue->lock);
+}
+
+// the worker is out, what it had not rendered goes back and its rate stops counting
+static void return_jobs(struct BatchQueue *queue, uint32_t worker, uint32_t first, uint32_t count)
+{
+	pthread_mutex_lock(&queue->lock);
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		queue->returned[queue->returned_count++] = first + i;
+	}
+
+	queue->active[worker] = false;
+	queue->rates[worker] = 0.0;
+
+	pthread_mutex_unlock(&queue->lock);
+}
+
+// records and submits one frame, then waits for it; the scene's rings assume one frame in flight.
+// A frame that is not kept is never confirmed to the capture, so it writes no file
+static VkResult render_job(struct BatchWorker *worker, uint32_t job, bool kept)
+{
+	VkDevice device = worker->context.device;
+
+	vkResetFences(device, 1, &worker->fence);
+	vkResetCommandBuffer(worker->command_buffer, 0);
+
+	VkCommandBufferBeginInfo begin_info = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+		.pNext = NULL,
+		.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+		.pInheritanceInfo = NULL,
+	};
+
+	VkResult result = vkBeginCommandBuffer(worker->command_buffer, &begin_info);
+	if (result != VK_SUCCESS) return result;
+
+	// the file is named after the job, not after the worker's count
+	if (worker->capturing) worker->capture.frame_number = job;
+
+	// jobs are unrelated frames, each one's live feed is only what its trace frame holds
+	reset_scene_stream(worker->scene);
+
+	VkFramebuffer framebuffer = worker->framebuffer != NULL ? worker->framebuffer[0] : VK_NULL_HANDLE;
+	record_scene_frame(worker->command_buffer, worker->scene, worker->frame, worker->frame_index++, worker->target.image, worker->target.view, framebuffer);
+
+	result = vkEndCommandBuffer(worker->command_buffer);
+	if (result != VK_SUCCESS) return result;
+
+	VkSubmitInfo submit_info = {
+		.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+		.pNext = NULL,
+		.waitSemaphoreCount = 0,
+		.pWaitSemaphores = NULL,
+		.pWaitDstStageMask = NULL,
+		.commandBufferCount = 1,
+		.pCommandBuffers = &worker->command_buffer,
+		.signalSemaphoreCount = 0,
+		.pSignalSemaphores = NULL,
+	};
+
+	result = vkQueueSubmit(worker->context.graphics_queue, 1, &submit_info, worker->fence);
+	if (result != VK_SUCCESS) return result;
+
+	if (worker->capturing && kept) confirm_frame_capture(&worker->capture);
+
+	result = vkWaitForFences(device, 1, &worker->fence, VK_TRUE, UINT64_MAX);
+	if (result != VK_SUCCESS) return result;
+
+	if (worker->capturing) poll_frame_capture(device, &worker->capture);
+
+	return VK_SUCCESS;
+}
+
+static void *batch_worker(void *user_data)
+{
+	struct BatchWorker *worker = user_data;
+	struct BatchQueue *queue = worker->queue;
+	uint32_t frame_count = worker->reader->header->frame_count;
+
+	worker->rendered = 0;
+	worker->failed = 0;
+	worker->busy_ms = 0.0;
+
+	uint32_t first = 0;
+	uint32_t count = 0;
+
+	while ((count = take_jobs(queue, worker->slot, &first)) > 0)
+	{
+		double start = now_ms();
+		uint32_t done = 0;
+		uint32_t unreadable = 0;
+
+		for (; done < count; done++)
+		{
+			// a frame that cannot be read fails on every device, it is not handed back
+			if (!read_trace_frame(worker->reader, (first + done) % frame_count, worker->frame)) {
+				unreadable++;
+				continue;
+			}
+
+			worker->result = render_job(worker, first + done, true);
+			if (worker->result != VK_SUCCESS) break;
+		}
+
+		double elapsed = now_ms() - start;
+
+		worker->busy_ms += elapsed;
+		worker->rendered += done - unreadable;
+		worker->failed += unreadable;
+
+		if (worker->result != VK_SUCCESS) {
+			printf("device %u (%s) gave up after %u jobs: %s\n", worker->index, worker->name, worker->rendered, get_result_string(worker->result));
+			return_jobs(queue, worker->slot, first + done, count - done);
+			break;
+		}
+
+		report_rate(queue, worker->slot, done - unreadable, elapsed);
+	}
+
+	return NULL;
+}
+
+static void destroy_batch_worker(struct BatchWorker *worker)
+{
+	VkDevice device = worker->context.device;
+
+	if (worker->result != VK_ERROR_DEVICE_LOST) vkDeviceWaitIdle(device);
+
+	// the readbacks of a lost device never finish
+	if (worker->capturing) {
+		if (worker->result != VK_ERROR_DEVICE_LOST) finish_frame_capture(device, &worker->capture);
+		destroy_frame_capture(device, &worker->capture);
+	}
+
+	free(worker->frame);
+
+	if (worker->framebuffer != NULL) {
+		untrack_resource(RESOURCE_FRAMEBUFFER, worker->framebuffer[0]);
+		vkDestroyFramebuffer(device, worker->framebuffer[0], NULL);
+		free(worker->framebuffer);
+	}
+
+	destroy_scene_renderer(worker->scene);
+	destroy_image(device, &worker->target);
+
+	untrack_resource(RESOURCE_FENCE, worker->fence);
+	vkDestroyFence(device, worker->fence, NULL);
+	untrack_resource(RESOURCE_COMMAND_POOL, worker->command_pool);
+	vkDestroyCommandPool(device, worker->command_pool, NULL);
+
+	destroy_render_context(&worker->context);
+}
+
+// device_count is set to the usable devices whenever the device's context came up, even if the worker fails later
+static bool create_batch_worker(struct BatchWorker *worker, uint32_t slot, uint32_t index, const struct RenderContextInfo *info, const struct TraceReader *reader, bool gpu_driven_enabled, const char *output_path, uint32_t *device_count)
+{
+	struct RenderContextInfo device_info = *info;
+	device_info.device_pinned = true;
+	device_info.device_index = index;
+
+	*worker = (struct BatchWorker) {
+		.index = index,
+		.slot = slot,
+		.reader = reader,
+	};
+
+	if (create_render_context(&worker->context, &device_info) != VK_SUCCESS) {
+		print_render_error(&worker->context.error);
+		return false;
+	}
+
+	*device_count = render_device_count(&worker->context);
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(worker->context.physical_device, &properties);
+	snprintf(worker->name, sizeof(worker->name), "%s", properties.deviceName);
+
+	VkDevice device = worker->context.device;
+	VkExtent2D extent = {reader->header->width, reader->header->height};
+
+	// the helpers below report their failures here, the worker is given up on the first one
+	struct RenderError error = {0};
+	struct RenderError *watched = watch_render_errors(&error);
+
+	worker->command_pool = create_command_pool(device, worker->context.indices);
+	worker->command_buffer = create_command_buffer(device, worker->command_pool);
+	worker->fence = create_fence(device);
+
+	worker->target = create_image(worker->context.physical_device, device, extent, BATCH_FORMAT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+
+	worker->capturing = output_path != NULL;
+
+	if (worker->capturing) {
+		worker->capture = create_frame_capture(worker->context.physical_device, device, extent, BATCH_FORMAT, CAPTURE_FORMAT_PPM, output_path, 60, 3);
+	}
+
+	struct SceneSetup setup = trace_setup(reader);
+	worker->scene = create_scene_renderer(worker->context.physical_device, device, worker->command_pool, worker->context.graphics_queue, worker->context.pipeline_cache, &worker->context.features, extent, BATCH_FORMAT, GRAPH_ACCESS_NONE, GRAPH_ACCESS_COLOR_ATTACHMENT, gpu_driven_enabled, &setup, worker->capturing ? &worker->capture : NULL);
+
+	if (worker->scene->render_pass != VK_NULL_HANDLE) worker->framebuffer = create_swapchain_framebuffer(device, &worker->target.view, 1, worker->scene->stencil_view, worker->scene->render_pass, extent);
+
+	worker->frame = malloc(sizeof(struct SceneFrame));
+
+	watch_render_errors(watched);
+	worker->result = error.result;
+
+	// the first frame pays for first use of the pipelines and buffers, it would skew the first rate;
+	// every device renders it, only the job that really gets frame 0 writes its thumbnail
+	if (worker->result == VK_SUCCESS && read_trace_frame(reader, 0, worker->frame)) worker->result = render_job(worker, 0, false);
+
+	if (worker->result != VK_SUCCESS) {
+		printf("failed to render on device %u (%s): %s\n", index, worker->name, get_result_string(worker->result));
+		destroy_batch_worker(worker);
+		return false;
+	}
+
+	return true;
+}
+
+// the jobs on the first worker_count workers; returns images per second over all of them
+static double run_batch(struct BatchWorker *workers, uint32_t worker_count, struct BatchQueue *queue, uint32_t job_count)
+{
+	reset_batch_queue(queue, job_count, worker_count);
+
+	double start = now_ms();
+	bool started[RENDER_MAX_DEVICES] = {false};
+
+	for (uint32_t i = 0; i < worker_count; i++)
+	{
+		workers[i].queue = queue;
+
+		// a worker whose device failed in an earlier run sits this one out
+		started[i] = workers[i].result == VK_SUCCESS && pthread_create(&workers[i].thread, NULL, batch_worker, &workers[i]) == 0;
+
+		if (!started[i]) {
+			if (workers[i].result == VK_SUCCESS) printf("failed to start the worker for device %u\n", workers[i].index);
+			return_jobs(queue, i, 0, 0);
+		}
+	}
+
+	for (uint32_t i = 0; i < worker_count; i++)
+	{
+		if (started[i]) pthread_join(workers[i].thread, NULL);
+	}
+
+	double elapsed = now_ms() - start;
+
+	uint32_t rendered = 0;
+	uint32_t failed = 0;
+
+	for (uint32_t i = 0; i < worker_count; i++)
+	{
+		if (!started[i]) continue;
+
+		const struct BatchWorker *worker = &workers[i];
+
+		rendered += worker->rendered;
+		failed += worker->failed;
+
+		printf("\tdevice %u (%s): %u images, %.1f%%, %.1f images/s while busy\n", worker->index, worker->name, worker->rendered, job_count > 0 ? 100.0 * worker->rendered / job_count : 0.0, worker->busy_ms > 0.0 ? worker->rendered * 1000.0 / worker->busy_ms : 0.0);
+	}
+
+	// nobody left to take them
+	uint32_t unrendered = queue->returned_count + (queue->count - queue->next);
+	double rate = elapsed > 0.0 ? rendered * 1000.0 / elapsed : 0.0;
+
+	printf("batch: %u images on %u devices in %.1f ms, %.1f images/s", rendered, worker_count, elapsed, rate);
+	if (failed > 0 || unrendered > 0) printf(", %u unreadable, %u not rendered", failed, unrendered);
+	printf("\n");
+
+	return rate;
+}
+
+int main(int argc, char **argv)
+{
+	const char *trace_path = NULL;
+	const char *output_path = NULL;
+	uint32_t job_count = 0;
+	uint32_t max_devices = RENDER_MAX_DEVICES;
+	bool scaling = false;
+	bool dynamic_rendering_enabled = true;
+	bool gpu_driven_enabled = true;
+	bool cpu_devices_enabled = true; // lavapipe and the like, slow but they add up on many cores
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc) job_count = (uint32_t) atoi(argv[++i]);
+		else if (strcmp(argv[i], "--devices") == 0 && i + 1 < argc) max_devices = (uint32_t) atoi(argv[++i]);
+		else if (strcmp(argv[i], "--scaling") == 0) scaling = true;
+		else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) output_path = argv[++i];
+		else if (strcmp(argv[i], "--render-pass") == 0) dynamic_rendering_enabled = false;
+		else if (strcmp(argv[i], "--cpu-cull") == 0) gpu_driven_enabled = false;
+		else if (strcmp(argv[i], "--no-cpu") == 0) cpu_devices_enabled = false;
+		else trace_path = argv[i];
+	}
+
+	if (trace_path == NULL) {
+		printf("usage: vg_batch trace.vgt [--jobs n] [--devices n] [--scaling] [--output thumb_%%06u.ppm] [--render-pass] [--cpu-cull] [--no-cpu]\n");
+		return EXIT_FAILURE;
+	}
+
+	// every worker writes its own files, one stream would interleave them
+	if (output_path != NULL && strchr(output_path, '%') == NULL) {
+		printf("failed to use %s for output, it needs a pattern for the job number like thumb_%%06u.ppm\n", output_path);
+		return EXIT_FAILURE;
+	}
+
+	struct TraceReader reader;
+	if (!open_trace_reader(trace_path, &reader)) return EXIT_FAILURE;
+
+	if (reader.header->frame_count == 0) {
+		printf("failed to find frames in %s\n", trace_path);
+		close_trace_reader(&reader);
+		return EXIT_FAILURE;
+	}
+
+	if (job_count == 0) job_count = reader.header->frame_count;
+	if (max_devices > RENDER_MAX_DEVICES) max_devices = RENDER_MAX_DEVICES;
+
+	// headless, every device has its own instance so nothing is shared between the worker threads
+
+	struct RenderContextInfo contextInfo = {
+		.presentable = false,
+		.validation_layers_enabled = false,
+		.dynamic_rendering_enabled = dynamic_rendering_enabled,
+		.cpu_fallback_enabled = cpu_devices_enabled,
+		.device_pinned = true,
+		.device_index = 0,
+		.validation_layer_count = 0,
+		.validation_layers = NULL,
+		.device_extension_count = 0,
+		.device_extensions = NULL,
+	};
+
+	struct BatchWorker *workers = calloc(RENDER_MAX_DEVICES, sizeof(struct BatchWorker));
+	uint32_t worker_count = 0;
+
+	// a device that cannot be used is skipped, the ones after it still get workers; the first
+	// context that comes up says how many devices there are, until then every index is tried
+	uint32_t device_count = max_devices;
+
+	for (uint32_t i = 0; i < device_count; i++)
+	{
+		uint32_t found = device_count;
+		bool created = create_batch_worker(&workers[worker_count], worker_count, i, &contextInfo, &reader, gpu_driven_enabled, output_path, &found);
+
+		if (found < device_count) device_count = found;
+		if (created) worker_count++;
+	}
+
+	if (worker_count == 0) {
+		printf("failed to render on any device\n");
+		free(workers);
+		close_trace_reader(&reader);
+		return EXIT_FAILURE;
+	}
+
+	struct BatchQueue queue = {
+		.lock = PTHREAD_MUTEX_INITIALIZER,
+		.next = 0,
+		.count = 0,
+		.returned = malloc((job_count > 0 ? job_count : 1) * sizeof(uint32_t)),
+		.returned_count = 0,
+		.worker_count = 0,
+		.active = {false},
+		.rates = {0.0},
+	};
+
+	printf("%u jobs of %ux%u on %u devices\n", job_count, reader.header->width, reader.header->height, worker_count);
+
+	if (scaling) {
+		double rates[RENDER_MAX_DEVICES];
+
+		for (uint32_t n = 1; n <= worker_count; n++)
+		{
+			rates[n - 1] = run_batch(workers, n, &queue, job_count);
+		}
+
+		printf("devices,images_per_s,speedup\n");
+
+		for (uint32_t n = 1; n <= worker_count; n++)
+		{
+			printf("%u,%.1f,%.2f\n", n, rates[n - 1], rates[0] > 0.0 ? rates[n - 1] / rates[0] : 0.0);
+		}
+	}
+	else {
+		run_batch(workers, worker_count, &queue, job_count);
+	}
+
+	for (uint32_t i = 0; i < worker_count; i++)
+	{
+		if (workers[i].context.fallbacks > 0) printf("device %u: %u fallbacks\n", workers[i].index, workers[i].context.fallbacks);
+	}
+
+	// cleanup
+
+	bool lost = false;
+
+	for (uint32_t i = 0; i < worker_count; i++)
+	{
+		lost = lost || workers[i].result != VK_SUCCESS;
+		destroy_batch_worker(&workers[i]);
+	}
+
+	free(queue.returned);
+	free(workers);
+
+	report_resource_leaks();
+
+	close_trace_reader(&reader);
+
+	return lost ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,673 @@
+// vg_bench: micro benchmarks for the renderer, printed as csv.
+//
+//   vg_bench [spatial|geometry|filter|mesh]
+//
+// spatial: builds the dynamic AABB tree over 10^5 and 10^6 random 10x10 boxes,
+// moves 1% of them, and times 1920x1080 viewport queries and point picks at
+// random spots. Times are per operation, averaged over many.
+//
+// geometry: runs the transform, bounds and clip kernels over 10^4 to 10^7
+// random points and boxes, the scalar ones and the ones picked for this cpu.
+// Times are per call, averaged over about 10^8 elements worth of calls.
+//
+// filter: blurs freshly drawn filter layers at several radii and resolutions
+// on a headless device, timed with gpu timestamps around the blur alone. The
+// median of BENCH_BLURS blurs is printed, with the path the radius took.
+//
+// mesh: draws one 256x256 vertex grid BENCH_MESH_DRAWS times into a 1024x1024
+// target on a headless device, once with float vertices and 32 bit indices and
+// once with compact vertices and 16 bit indices. Each draw references the whole
+// vertex and index buffers, their sizes times the draws are printed with the
+// median gpu time of BENCH_MESH_RUNS submissions, the clear included.
+
+#define _POSIX_C_SOURCE 200809L // clock_gettime
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+#include <math.h>
+#include <time.h>
+
+#include "spatial.h"
+#include "geometry.h"
+#include "render.h"
+#include "filter.h"
+#include "timer.h"
+#include "context.h"
+#include "track.h"
+#include "mesh.h"
+#include "ring.h"
+
+#define BENCH_QUERIES 1000
+#define BENCH_PICKS 100000
+#define BENCH_BLURS 50
+#define BENCH_GEOMETRY_ELEMENTS 100000000
+#define BENCH_MESH_SIDE 256 // vertices along each side of the grid, 65536 still fit 16 bit indices
+#define BENCH_MESH_DRAWS 64
+#define BENCH_MESH_RUNS 50
+#define BENCH_MESH_FORMAT VK_FORMAT_R8G8B8A8_UNORM
+
+static double now_ms(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+// xorshift, the same numbers on every run
+static float random_float(uint32_t *state, float max)
+{
+	*state ^= *state << 13;
+	*state ^= *state >> 17;
+	*state ^= *state << 5;
+
+	return max * (float) (*state >> 8) / (1 << 24);
+}
+
+// about one box per 20x20 cell whatever the count, so a viewport sees the same density
+static void bench_spatial(uint32_t count)
+{
+	float world = 20.0f * sqrtf((float) count);
+	uint32_t seed = 12345;
+
+	struct SpatialTree tree = create_spatial_tree(4.0f);
+	int32_t *proxies = malloc(count * sizeof(int32_t));
+	uint32_t *items = malloc(count * sizeof(uint32_t));
+	float *positions = malloc(2 * count * sizeof(float));
+
+	double start = now_ms();
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		float x = positions[2 * i] = random_float(&seed, world);
+		float y = positions[2 * i + 1] = random_float(&seed, world);
+
+		proxies[i] = spatial_insert(&tree, (struct Aabb) {x, y, x + 10.0f, y + 10.0f}, i);
+	}
+
+	double insert_ms = now_ms() - start;
+
+	// drifting a few pixels, most moves stay inside the fattened boxes and never touch the tree
+	uint32_t moved = count / 100;
+	uint32_t reinserted = 0;
+
+	start = now_ms();
+
+	for (uint32_t i = 0; i < moved; i++)
+	{
+		uint32_t item = (uint32_t) random_float(&seed, (float) count) % count;
+		float x = positions[2 * item] += random_float(&seed, 12.0f) - 6.0f;
+		float y = positions[2 * item + 1] += random_float(&seed, 12.0f) - 6.0f;
+
+		reinserted += spatial_update(&tree, proxies[item], (struct Aabb) {x, y, x + 10.0f, y + 10.0f});
+	}
+
+	double update_ms = now_ms() - start;
+
+	uint64_t found = 0;
+
+	start = now_ms();
+
+	for (uint32_t i = 0; i < BENCH_QUERIES; i++)
+	{
+		float x = random_float(&seed, world - 1920.0f);
+		float y = random_float(&seed, world - 1080.0f);
+
+		found += spatial_query_rect(&tree, (struct Aabb) {x, y, x + 1920.0f, y + 1080.0f}, items, count);
+	}
+
+	double query_ms = now_ms() - start;
+	uint64_t query_hits = found / BENCH_QUERIES;
+
+	start = now_ms();
+
+	for (uint32_t i = 0; i < BENCH_PICKS; i++)
+	{
+		spatial_pick(&tree, random_float(&seed, world), random_float(&seed, world));
+	}
+
+	double pick_ms = now_ms() - start;
+
+	printf("spatial,%u,%d,%.1f,%.4f,%.4f,%llu,%.5f,%u\n", count, spatial_height(&tree), insert_ms, moved > 0 ? update_ms / moved : 0.0, query_ms / BENCH_QUERIES, (unsigned long long) query_hits, pick_ms / BENCH_PICKS, reinserted);
+
+	free(positions);
+	free(items);
+	free(proxies);
+	destroy_spatial_tree(&tree);
+}
+
+// half the boxes overlap the clip rect, so the clip kernel's output is not predictable
+static void bench_geometry(const struct GeometryKernels *kernels, uint32_t count)
+{
+	uint32_t seed = 12345;
+	uint32_t calls = BENCH_GEOMETRY_ELEMENTS / count;
+
+	float *x = malloc(count * sizeof(float));
+	float *y = malloc(count * sizeof(float));
+	float *x1 = malloc(count * sizeof(float));
+	float *y1 = malloc(count * sizeof(float));
+	float *points = malloc(2 * count * sizeof(float));
+	uint32_t *visible = malloc(count * sizeof(uint32_t));
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		x[i] = random_float(&seed, 4000.0f);
+		y[i] = random_float(&seed, 2000.0f);
+		x1[i] = x[i] + 10.0f;
+		y1[i] = y[i] + 10.0f;
+	}
+
+	float matrix[6] = {0.8f, 0.6f, -0.6f, 0.8f, 100.0f, 50.0f};
+	struct Aabb clip = {0.0f, 0.0f, 1920.0f, 2000.0f};
+
+	double start = now_ms();
+
+	for (uint32_t i = 0; i < calls; i++)
+	{
+		kernels->transform(x, y, count, matrix, points, 2 * sizeof(float));
+	}
+
+	double transform_ms = now_ms() - start;
+
+	// summed so the calls are not optimized away
+	float extent = 0.0f;
+
+	start = now_ms();
+
+	for (uint32_t i = 0; i < calls; i++)
+	{
+		struct Aabb box = kernels->bounds(x, y, count);
+		extent += box.x1 - box.x0;
+	}
+
+	double bounds_ms = now_ms() - start;
+	uint64_t kept = 0;
+
+	start = now_ms();
+
+	for (uint32_t i = 0; i < calls; i++)
+	{
+		kept += kernels->clip(x, y, x1, y1, count, clip, visible);
+	}
+
+	double clip_ms = now_ms() - start;
+
+	printf("geometry,%u,%s,%.4f,%.4f,%.4f,%u\n", count, kernels->name, transform_ms / calls, bounds_ms / calls, clip_ms / calls, (uint32_t) (kept / calls));
+
+	if (extent < 0.0f || points[0] != points[0]) printf("geometry: unexpected output\n");
+
+	free(visible);
+	free(points);
+	free(y1);
+	free(x1);
+	free(y);
+	free(x);
+}
+
+static int compare_double(const void *a, const void *b)
+{
+	double x = *(const double *) a;
+	double y = *(const double *) b;
+
+	return (x > y) - (x < y);
+}
+
+// one layer blurred BENCH_BLURS times, each in its own submission after the layer was drawn again
+static double bench_blur(struct RenderContext *context, struct FilterSystem *system, VkCommandBuffer command_buffer, VkFence fence, struct GpuTimer *timer, VkExtent2D extent, float radius)
+{
+	VkDevice device = context->device;
+
+	struct FilterLayer layer;
+	VkResult result = create_filter_layer(context->physical_device, device, system, extent, radius, &layer);
+
+	if (result != VK_SUCCESS) {
+		printf("failed to create filter layer: %s\n", get_result_string(result));
+		return -1.0;
+	}
+
+	double times[BENCH_BLURS];
+	uint32_t count = 0;
+
+	for (uint32_t i = 0; i < BENCH_BLURS; i++)
+	{
+		vkResetCommandBuffer(command_buffer, 0);
+
+		VkCommandBufferBeginInfo begin_info = {
+			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+			.pNext = NULL,
+			.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+			.pInheritanceInfo = NULL,
+		};
+
+		vkBeginCommandBuffer(command_buffer, &begin_info);
+
+		// an empty layer costs as much to blur as a full one, drawing it again only makes it dirty
+		begin_filter_layer(command_buffer, system, &layer);
+		end_filter_layer(command_buffer, system, &layer);
+
+		reset_gpu_timer(command_buffer, timer, 0, 2);
+		write_gpu_timestamp(command_buffer, timer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0);
+		record_filter_layer(command_buffer, system, &layer);
+		write_gpu_timestamp(command_buffer, timer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 1);
+
+		vkEndCommandBuffer(command_buffer);
+
+		VkSubmitInfo submit_info = {
+			.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+			.pNext = NULL,
+			.waitSemaphoreCount = 0,
+			.pWaitSemaphores = NULL,
+			.pWaitDstStageMask = NULL,
+			.commandBufferCount = 1,
+			.pCommandBuffers = &command_buffer,
+			.signalSemaphoreCount = 0,
+			.pSignalSemaphores = NULL,
+		};
+
+		result = vkQueueSubmit(context->graphics_queue, 1, &submit_info, fence);
+		if (result == VK_SUCCESS) result = vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
+
+		if (result != VK_SUCCESS) {
+			printf("failed to submit blur: %s\n", get_result_string(result));
+			break;
+		}
+
+		vkResetFences(device, 1, &fence);
+		times[count++] = read_gpu_elapsed(device, timer, 0);
+	}
+
+	destroy_filter_layer(device, system, &layer);
+
+	if (count == 0) return -1.0;
+
+	qsort(times, count, sizeof(double), compare_double);
+
+	return times[count / 2];
+}
+
+static void bench_filter(void)
+{
+	struct RenderContextInfo info = {
+		.presentable = false,
+		.validation_layers_enabled = false,
+		.dynamic_rendering_enabled = true,
+		.cpu_fallback_enabled = false, // a software device would time the wrong thing
+		.device_pinned = false,
+		.device_index = 0,
+		.validation_layer_count = 0,
+		.validation_layers = NULL,
+		.device_extension_count = 0,
+		.device_extensions = NULL,
+	};
+
+	struct RenderContext context;
+
+	if (create_render_context(&context, &info) != VK_SUCCESS) {
+		print_render_error(&context.error);
+		return;
+	}
+
+	VkDevice device = context.device;
+	VkExtent2D max_extent = {1920, 1080};
+
+	VkCommandPool command_pool = create_command_pool(device, context.indices);
+	VkCommandBuffer command_buffer = create_command_buffer(device, command_pool);
+	VkFence fence = create_fence(device);
+	vkResetFences(device, 1, &fence);
+
+	struct GpuTimer timer = create_gpu_timer(context.physical_device, device, 2);
+
+	// the composite pipeline needs a target to be made against, it is never drawn with here
+	VkRenderPass render_pass = context.features.dynamic_rendering ? VK_NULL_HANDLE : create_render_pass(device, FILTER_FORMAT, VK_FORMAT_UNDEFINED);
+	struct FilterSystem system = create_filter_system(device, &context.features, max_extent, render_pass, FILTER_FORMAT, VK_FORMAT_UNDEFINED);
+
+	VkExtent2D extents[] = {{256, 256}, {1024, 1024}, {1920, 1080}};
+	float radii[] = {2.0f, 8.0f, 16.0f, 32.0f, 64.0f};
+
+	printf("suite,width,height,radius,path,blur_ms\n");
+
+	for (uint32_t i = 0; i < sizeof(extents) / sizeof(extents[0]) && timer.supported && system.result == VK_SUCCESS; i++)
+	{
+		for (uint32_t j = 0; j < sizeof(radii) / sizeof(radii[0]); j++)
+		{
+			double blur_ms = bench_blur(&context, &system, command_buffer, fence, &timer, extents[i], radii[j]);
+			if (blur_ms < 0.0) break;
+
+			const char *path = radii[j] <= FILTER_GAUSSIAN_MAX_RADIUS ? "gaussian" : "kawase";
+			printf("filter,%u,%u,%.0f,%s,%.4f\n", extents[i].width, extents[i].height, radii[j], path, blur_ms);
+		}
+	}
+
+	if (!timer.supported) printf("filter: the device has no timestamps on its graphics queue\n");
+
+	destroy_filter_system(device, &system);
+	untrack_resource(RESOURCE_RENDER_PASS, render_pass);
+	vkDestroyRenderPass(device, render_pass, NULL);
+	destroy_gpu_timer(device, &timer);
+	untrack_resource(RESOURCE_FENCE, fence);
+	vkDestroyFence(device, fence, NULL);
+	untrack_resource(RESOURCE_COMMAND_POOL, command_pool);
+	vkDestroyCommandPool(device, command_pool, NULL);
+
+	destroy_render_context(&context);
+}
+
+// a BENCH_MESH_SIDE square grid over the whole extent, two triangles a cell
+static struct Mesh create_grid_mesh(struct RenderContext *context, VkCommandPool command_pool, enum VertexLayout layout, VkIndexType index_type, VkExtent2D extent)
+{
+	uint32_t side = BENCH_MESH_SIDE;
+	uint32_t vertex_count = side * side;
+	uint32_t index_count = 6 * (side - 1) * (side - 1);
+
+	struct Vertex *vertices = malloc(vertex_count * sizeof(struct Vertex));
+	uint32_t *indices = malloc(index_count * sizeof(uint32_t));
+
+	for (uint32_t y = 0; y < side; y++)
+	{
+		for (uint32_t x = 0; x < side; x++)
+		{
+			float u = (float) x / (side - 1);
+			float v = (float) y / (side - 1);
+
+			vertices[y * side + x] = (struct Vertex) {
+				.position = {u * extent.width, v * extent.height},
+				.uv = {u, v},
+				.color = {u, v, 1.0f - u, 1.0f},
+			};
+		}
+	}
+
+	uint32_t count = 0;
+
+	for (uint32_t y = 0; y + 1 < side; y++)
+	{
+		for (uint32_t x = 0; x + 1 < side; x++)
+		{
+			uint32_t i = y * side + x;
+			uint32_t quad[6] = {i, i + side, i + 1, i + 1, i + side, i + side + 1};
+
+			memcpy(&indices[count], quad, sizeof(quad));
+			count += 6;
+		}
+	}
+
+	struct Mesh mesh = create_mesh_indexed(context->physical_device, context->device, command_pool, context->graphics_queue, layout, index_type, vertices, vertex_count, indices, index_count);
+
+	free(indices);
+	free(vertices);
+
+	return mesh;
+}
+
+// BENCH_MESH_DRAWS draws of the mesh in one pass, BENCH_MESH_RUNS times, each in its own submission
+static double bench_mesh_draws(struct RenderContext *context, VkCommandBuffer command_buffer, VkFence fence, struct GpuTimer *timer, const struct Image *target, VkRenderPass render_pass, VkFramebuffer framebuffer, VkPipeline pipeline, VkPipelineLayout layout, const struct UniformRing *ring, uint32_t uniforms_offset, const struct Mesh *mesh)
+{
+	VkDevice device = context->device;
+	VkClearColorValue clear_color = {{0.0f, 0.0f, 0.0f, 1.0f}};
+
+	double times[BENCH_MESH_RUNS];
+	uint32_t count = 0;
+
+	for (uint32_t i = 0; i < BENCH_MESH_RUNS; i++)
+	{
+		vkResetCommandBuffer(command_buffer, 0);
+
+		VkCommandBufferBeginInfo begin_info = {
+			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+			.pNext = NULL,
+			.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+			.pInheritanceInfo = NULL,
+		};
+
+		vkBeginCommandBuffer(command_buffer, &begin_info);
+
+		// the target is cleared anyway, what it held can go
+		VkImageMemoryBarrier barrier = {
+			.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+			.pNext = NULL,
+			.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+			.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+			.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+			.newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+			.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.image = target->image,
+			.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1},
+		};
+
+		vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0, 0, NULL, 0, NULL, 1, &barrier);
+
+		reset_gpu_timer(command_buffer, timer, 0, 2);
+		write_gpu_timestamp(command_buffer, timer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0);
+
+		if (context->features.dynamic_rendering) {
+			begin_dynamic_rendering(&context->features, command_buffer, target->view, VK_NULL_HANDLE, target->extent, clear_color);
+		} else {
+			VkRenderPassBeginInfo render_pass_info = {
+				.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+				.pNext = NULL,
+				.renderPass = render_pass,
+				.framebuffer = framebuffer,
+				.renderArea = {
+					.offset = {0, 0},
+					.extent = target->extent,
+				},
+				.clearValueCount = 1,
+				.pClearValues = &(VkClearValue) {.color = clear_color},
+			};
+
+			vkCmdBeginRenderPass(command_buffer, &render_pass_info, VK_SUBPASS_CONTENTS_INLINE);
+		}
+
+		VkDeviceSize vertex_offset = 0;
+
+		vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+		vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 0, 1, &ring->descriptor_set, 1, &uniforms_offset);
+		vkCmdBindVertexBuffers(command_buffer, 0, 1, &mesh->vertex_buffer.buffer, &vertex_offset);
+		vkCmdBindIndexBuffer(command_buffer, mesh->index_buffer.buffer, 0, mesh->index_type);
+		vkCmdPushConstants(command_buffer, layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(mesh->tile), mesh->tile);
+
+		for (uint32_t j = 0; j < BENCH_MESH_DRAWS; j++)
+		{
+			vkCmdDrawIndexed(command_buffer, mesh->index_count, 1, 0, 0, 0);
+		}
+
+		if (context->features.dynamic_rendering) {
+			end_dynamic_rendering(&context->features, command_buffer);
+		} else {
+			vkCmdEndRenderPass(command_buffer);
+		}
+
+		write_gpu_timestamp(command_buffer, timer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 1);
+
+		vkEndCommandBuffer(command_buffer);
+
+		VkSubmitInfo submit_info = {
+			.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+			.pNext = NULL,
+			.waitSemaphoreCount = 0,
+			.pWaitSemaphores = NULL,
+			.pWaitDstStageMask = NULL,
+			.commandBufferCount = 1,
+			.pCommandBuffers = &command_buffer,
+			.signalSemaphoreCount = 0,
+			.pSignalSemaphores = NULL,
+		};
+
+		VkResult result = vkQueueSubmit(context->graphics_queue, 1, &submit_info, fence);
+		if (result == VK_SUCCESS) result = vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
+
+		if (result != VK_SUCCESS) {
+			printf("failed to submit mesh draws: %s\n", get_result_string(result));
+			break;
+		}
+
+		vkResetFences(device, 1, &fence);
+		times[count++] = read_gpu_elapsed(device, timer, 0);
+	}
+
+	if (count == 0) return -1.0;
+
+	qsort(times, count, sizeof(double), compare_double);
+
+	return times[count / 2];
+}
+
+static void bench_mesh(void)
+{
+	struct RenderContextInfo info = {
+		.presentable = false,
+		.validation_layers_enabled = false,
+		.dynamic_rendering_enabled = true,
+		.cpu_fallback_enabled = false, // a software device would time the wrong thing
+		.device_pinned = false,
+		.device_index = 0,
+		.validation_layer_count = 0,
+		.validation_layers = NULL,
+		.device_extension_count = 0,
+		.device_extensions = NULL,
+	};
+
+	struct RenderContext context;
+
+	if (create_render_context(&context, &info) != VK_SUCCESS) {
+		print_render_error(&context.error);
+		return;
+	}
+
+	VkDevice device = context.device;
+	VkExtent2D extent = {1024, 1024};
+
+	// the helpers below print and report their failures here, nothing is drawn after the first
+	struct RenderError error = {0};
+	struct RenderError *watched = watch_render_errors(&error);
+
+	VkCommandPool command_pool = create_command_pool(device, context.indices);
+	VkCommandBuffer command_buffer = create_command_buffer(device, command_pool);
+	VkFence fence = create_fence(device);
+	vkResetFences(device, 1, &fence);
+
+	struct GpuTimer timer = create_gpu_timer(context.physical_device, device, 2);
+
+	struct Image target = create_image(context.physical_device, device, extent, BENCH_MESH_FORMAT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT);
+
+	VkRenderPass render_pass = VK_NULL_HANDLE;
+	VkFramebuffer *framebuffer = NULL;
+
+	if (!context.features.dynamic_rendering) {
+		render_pass = create_render_pass(device, BENCH_MESH_FORMAT, VK_FORMAT_UNDEFINED);
+		framebuffer = create_swapchain_framebuffer(device, &target.view, 1, VK_NULL_HANDLE, render_pass, extent);
+	}
+
+	// the view maps the grid's pixels onto the target, the same for every draw
+	float uniforms[8] = {0.0f, 0.0f, 2.0f / extent.width, 2.0f / extent.height, 0.0f, 0.0f, 0.0f, 0.0f};
+
+	struct UniformRing ring = create_uniform_ring(context.physical_device, device, 256, sizeof(uniforms), VK_SHADER_STAGE_VERTEX_BIT);
+	begin_uniform_ring_frame(&ring, 0);
+	uint32_t uniforms_offset = push_uniforms(&ring, uniforms, sizeof(uniforms));
+
+	VkPipelineLayout layout = create_pipeline_layout(device, 1, &ring.set_layout, VK_SHADER_STAGE_VERTEX_BIT, 4 * sizeof(float));
+
+	enum VertexLayout layouts[] = {VERTEX_LAYOUT_FLOAT, VERTEX_LAYOUT_COMPACT};
+	VkIndexType index_types[] = {VK_INDEX_TYPE_UINT32, VK_INDEX_TYPE_UINT16};
+
+	printf("suite,layout,index_bits,vertices,indices,draws,vertex_bytes,index_bytes,gpu_ms\n");
+
+	for (uint32_t i = 0; i < sizeof(layouts) / sizeof(layouts[0]) && timer.supported && error.result == VK_SUCCESS; i++)
+	{
+		struct PipelineState state = {
+			.render_pass = render_pass,
+			.color_format = BENCH_MESH_FORMAT,
+			.stencil_format = VK_FORMAT_UNDEFINED,
+			.stencil = STENCIL_MODE_NONE,
+			.blend = BLEND_MODE_NONE,
+			.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+			.samples = VK_SAMPLE_COUNT_1_BIT,
+			.vertex_layout = layouts[i],
+		};
+
+		VkPipeline pipeline = create_graphics_pipeline_state(device, VK_NULL_HANDLE, extent, layout, "../assets/shaders/mesh_vert.spv", "../assets/shaders/mesh_frag.spv", &state);
+		struct Mesh mesh = create_grid_mesh(&context, command_pool, layouts[i], index_types[i], extent);
+
+		// a mesh the layout or index type was refused for has no buffers
+		if (error.result == VK_SUCCESS && mesh.vertex_buffer.buffer != VK_NULL_HANDLE) {
+			double gpu_ms = bench_mesh_draws(&context, command_buffer, fence, &timer, &target, render_pass, framebuffer != NULL ? framebuffer[0] : VK_NULL_HANDLE, pipeline, layout, &ring, uniforms_offset, &mesh);
+
+			if (gpu_ms >= 0.0) {
+				printf("mesh,%s,%u,%u,%u,%u,%llu,%llu,%.4f\n",
+					layouts[i] == VERTEX_LAYOUT_COMPACT ? "compact" : "float",
+					mesh.index_type == VK_INDEX_TYPE_UINT16 ? 16 : 32,
+					mesh.vertex_count,
+					mesh.index_count,
+					BENCH_MESH_DRAWS,
+					(unsigned long long) (mesh.vertex_buffer.size * BENCH_MESH_DRAWS),
+					(unsigned long long) (mesh.index_buffer.size * BENCH_MESH_DRAWS),
+					gpu_ms);
+			}
+		}
+
+		destroy_mesh(device, &mesh);
+		untrack_resource(RESOURCE_PIPELINE, pipeline);
+		vkDestroyPipeline(device, pipeline, NULL);
+	}
+
+	if (!timer.supported) printf("mesh: the device has no timestamps on its graphics queue\n");
+
+	watch_render_errors(watched);
+
+	untrack_resource(RESOURCE_PIPELINE_LAYOUT, layout);
+	vkDestroyPipelineLayout(device, layout, NULL);
+	destroy_uniform_ring(device, &ring);
+
+	if (framebuffer != NULL) {
+		untrack_resource(RESOURCE_FRAMEBUFFER, framebuffer[0]);
+		vkDestroyFramebuffer(device, framebuffer[0], NULL);
+		free(framebuffer);
+	}
+
+	untrack_resource(RESOURCE_RENDER_PASS, render_pass);
+	vkDestroyRenderPass(device, render_pass, NULL);
+	destroy_image(device, &target);
+	destroy_gpu_timer(device, &timer);
+	untrack_resource(RESOURCE_FENCE, fence);
+	vkDestroyFence(device, fence, NULL);
+	untrack_resource(RESOURCE_COMMAND_POOL, command_pool);
+	vkDestroyCommandPool(device, command_pool, NULL);
+
+	destroy_render_context(&context);
+}
+
+int main(int argc, char **argv)
+{
+	const char *suite = argc > 1 ? argv[1] : NULL;
+	bool all = suite == NULL;
+
+	if (!all && strcmp(suite, "spatial") != 0 && strcmp(suite, "geometry") != 0 && strcmp(suite, "filter") != 0 && strcmp(suite, "mesh") != 0) {
+		printf("usage: vg_bench [spatial|geometry|filter|mesh]\n");
+		return EXIT_FAILURE;
+	}
+
+	if (all || strcmp(suite, "spatial") == 0) {
+		printf("suite,items,height,build_ms,update_ms,query_ms,query_hits,pick_ms,reinserted\n");
+		bench_spatial(100000);
+		bench_spatial(1000000);
+	}
+
+	if (all || strcmp(suite, "geometry") == 0) {
+		printf("suite,count,kernels,transform_ms,bounds_ms,clip_ms,visible\n");
+
+		for (uint32_t count = 10000; count <= 10000000; count *= 10)
+		{
+			bench_geometry(get_scalar_geometry_kernels(), count);
+			if (get_geometry_kernels() != get_scalar_geometry_kernels()) bench_geometry(get_geometry_kernels(), count);
+		}
+	}
+
+	if (all || strcmp(suite, "filter") == 0) bench_filter();
+	if (all || strcmp(suite, "mesh") == 0) bench_mesh();
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,596 @@
+#include <vulkan/vulkan.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "render.h"
+#include "blocks.h"
+
+static uint8_t clamp_byte(int value)
+{
+	return value < 0 ? 0 : value > 255 ? 255 : (uint8_t) value;
+}
+
+static uint64_t read_le64(const uint8_t *bytes)
+{
+	uint64_t value = 0;
+	for (int i = 7; i >= 0; i--) value = value << 8 | bytes[i];
+
+	return value;
+}
+
+static uint64_t read_be64(const uint8_t *bytes)
+{
+	uint64_t value = 0;
+	for (int i = 0; i < 8; i++) value = value << 8 | bytes[i];
+
+	return value;
+}
+
+// BC1 and BC3
+
+static void expand_565(uint16_t color, uint8_t rgb[3])
+{
+	uint32_t r = color >> 11 & 31;
+	uint32_t g = color >> 5 & 63;
+	uint32_t b = color & 31;
+
+	rgb[0] = (uint8_t) (r << 3 | r >> 2);
+	rgb[1] = (uint8_t) (g << 2 | g >> 4);
+	rgb[2] = (uint8_t) (b << 3 | b >> 2);
+}
+
+// four colors when c0 > c1 or inside BC3; otherwise three and either black or transparent black
+static void bc1_palette(const uint8_t *block, uint8_t palette[4][4], bool always_four, bool punch_through)
+{
+	uint16_t c0 = (uint16_t) (block[0] | block[1] << 8);
+	uint16_t c1 = (uint16_t) (block[2] | block[3] << 8);
+
+	expand_565(c0, palette[0]);
+	expand_565(c1, palette[1]);
+	palette[0][3] = palette[1][3] = 255;
+
+	bool four = always_four || c0 > c1;
+
+	for (int c = 0; c < 3; c++)
+	{
+		if (four) {
+			palette[2][c] = (uint8_t) ((2 * palette[0][c] + palette[1][c] + 1) / 3);
+			palette[3][c] = (uint8_t) ((palette[0][c] + 2 * palette[1][c] + 1) / 3);
+		}
+		else {
+			palette[2][c] = (uint8_t) ((palette[0][c] + palette[1][c] + 1) / 2);
+			palette[3][c] = 0;
+		}
+	}
+
+	palette[2][3] = 255;
+	palette[3][3] = four || !punch_through ? 255 : 0;
+}
+
+static void decode_bc1_colors(const uint8_t *block, uint8_t *texels, bool always_four, bool punch_through)
+{
+	uint8_t palette[4][4];
+	bc1_palette(block, palette, always_four, punch_through);
+
+	uint32_t indices = (uint32_t) block[4] | (uint32_t) block[5] << 8 | (uint32_t) block[6] << 16 | (uint32_t) block[7] << 24;
+
+	for (int i = 0; i < 16; i++)
+	{
+		memcpy(&texels[4 * i], palette[indices >> (2 * i) & 3], 4);
+	}
+}
+
+static void decode_bc1_rgb(const uint8_t *block, uint8_t *texels)
+{
+	decode_bc1_colors(block, texels, false, false);
+}
+
+static void decode_bc1_rgba(const uint8_t *block, uint8_t *texels)
+{
+	decode_bc1_colors(block, texels, false, true);
+}
+
+static void decode_bc3(const uint8_t *block, uint8_t *texels)
+{
+	decode_bc1_colors(block + 8, texels, true, false);
+
+	uint64_t bits = read_le64(block);
+	uint32_t a0 = block[0];
+	uint32_t a1 = block[1];
+
+	uint8_t alphas[8] = {(uint8_t) a0, (uint8_t) a1};
+
+	for (uint32_t i = 1; i < 7; i++)
+	{
+		if (a0 > a1) alphas[i + 1] = (uint8_t) (((7 - i) * a0 + i * a1 + 3) / 7);
+		else if (i < 5) alphas[i + 1] = (uint8_t) (((5 - i) * a0 + i * a1 + 2) / 5);
+	}
+
+	if (a0 <= a1) {
+		alphas[6] = 0;
+		alphas[7] = 255;
+	}
+
+	for (int i = 0; i < 16; i++)
+	{
+		texels[4 * i + 3] = alphas[bits >> (16 + 3 * i) & 7];
+	}
+}
+
+// ETC2; texel indices run down the columns
+
+static const int etc_modifiers[8][4] = {
+	{2, 8, -2, -8},
+	{5, 17, -5, -17},
+	{9, 29, -9, -29},
+	{13, 42, -13, -42},
+	{18, 60, -18, -60},
+	{24, 80, -24, -80},
+	{33, 106, -33, -106},
+	{47, 183, -47, -183},
+};
+
+static const int etc_distances[8] = {3, 6, 11, 16, 23, 32, 41, 64};
+
+static const int eac_modifiers[16][8] = {
+	{-3, -6, -9, -15, 2, 5, 8, 14},
+	{-3, -7, -10, -13, 2, 6, 9, 12},
+	{-2, -5, -8, -13, 1, 4, 7, 12},
+	{-2, -4, -6, -13, 1, 3, 5, 12},
+	{-3, -6, -8, -12, 2, 5, 7, 11},
+	{-3, -7, -9, -11, 2, 6, 8, 10},
+	{-4, -7, -8, -11, 3, 6, 7, 10},
+	{-3, -5, -8, -11, 2, 4, 7, 10},
+	{-2, -6, -8, -10, 1, 5, 7, 9},
+	{-2, -5, -8, -10, 1, 4, 7, 9},
+	{-2, -4, -8, -10, 1, 3, 7, 9},
+	{-2, -5, -7, -10, 1, 4, 6, 9},
+	{-3, -4, -7, -10, 2, 3, 6, 9},
+	{-1, -2, -3, -10, 0, 1, 2, 9},
+	{-4, -6, -8, -9, 3, 5, 7, 8},
+	{-3, -5, -7, -9, 2, 4, 6, 8},
+};
+
+static uint32_t bit_field(uint64_t bits, int high, int low)
+{
+	return (uint32_t) (bits >> low) & ((1u << (high - low + 1)) - 1);
+}
+
+static int sign_extend3(uint32_t value)
+{
+	return value >= 4 ? (int) value - 8 : (int) value;
+}
+
+static uint32_t etc_index(uint64_t bits, int x, int y)
+{
+	int i = 4 * x + y;
+
+	return (uint32_t) ((bits >> (16 + i) & 1) << 1 | (bits >> i & 1));
+}
+
+static void write_texel(uint8_t *texels, int x, int y, const int rgb[3])
+{
+	uint8_t *texel = &texels[4 * (4 * y + x)];
+
+	texel[0] = clamp_byte(rgb[0]);
+	texel[1] = clamp_byte(rgb[1]);
+	texel[2] = clamp_byte(rgb[2]);
+	texel[3] = 255;
+}
+
+// individual and differential modes, two sub blocks with a base color and modifier table each
+static void decode_etc_subblocks(uint64_t bits, uint8_t *texels, const int base[2][3])
+{
+	uint32_t tables[2] = {bit_field(bits, 39, 37), bit_field(bits, 36, 34)};
+	bool flip = bits >> 32 & 1;
+
+	for (int y = 0; y < 4; y++)
+	{
+		for (int x = 0; x < 4; x++)
+		{
+			int sub = flip ? y >= 2 : x >= 2;
+			int modifier = etc_modifiers[tables[sub]][etc_index(bits, x, y)];
+			int rgb[3] = {base[sub][0] + modifier, base[sub][1] + modifier, base[sub][2] + modifier};
+
+			write_texel(texels, x, y, rgb);
+		}
+	}
+}
+
+// T and H modes, four paint colors picked directly by the texel indices
+static void decode_etc_paints(uint64_t bits, uint8_t *texels, const int paints[4][3])
+{
+	for (int y = 0; y < 4; y++)
+	{
+		for (int x = 0; x < 4; x++)
+		{
+			write_texel(texels, x, y, paints[etc_index(bits, x, y)]);
+		}
+	}
+}
+
+static int extend4(uint32_t value)
+{
+	return (int) (value << 4 | value);
+}
+
+static int extend5(uint32_t value)
+{
+	return (int) (value << 3 | value >> 2);
+}
+
+static int extend6(uint32_t value)
+{
+	return (int) (value << 2 | value >> 4);
+}
+
+static int extend7(uint32_t value)
+{
+	return (int) (value << 1 | value >> 6);
+}
+
+static void decode_etc2_color(const uint8_t *block, uint8_t *texels)
+{
+	uint64_t bits = read_be64(block);
+
+	if (!(bits >> 33 & 1)) {
+		int base[2][3] = {
+			{extend4(bit_field(bits, 63, 60)), extend4(bit_field(bits, 55, 52)), extend4(bit_field(bits, 47, 44))},
+			{extend4(bit_field(bits, 59, 56)), extend4(bit_field(bits, 51, 48)), extend4(bit_field(bits, 43, 40))},
+		};
+
+		decode_etc_subblocks(bits, texels, base);
+		return;
+	}
+
+	// an overflowing differential color selects one of the etc2 modes instead
+	int r = (int) bit_field(bits, 63, 59) + sign_extend3(bit_field(bits, 58, 56));
+	int g = (int) bit_field(bits, 55, 51) + sign_extend3(bit_field(bits, 50, 48));
+	int b = (int) bit_field(bits, 47, 43) + sign_extend3(bit_field(bits, 42, 40));
+
+	if (r < 0 || r > 31) {
+		int c1[3] = {extend4(bit_field(bits, 60, 59) << 2 | bit_field(bits, 57, 56)), extend4(bit_field(bits, 55, 52)), extend4(bit_field(bits, 51, 48))};
+		int c2[3] = {extend4(bit_field(bits, 47, 44)), extend4(bit_field(bits, 43, 40)), extend4(bit_field(bits, 39, 36))};
+		int d = etc_distances[bit_field(bits, 35, 34) << 1 | bit_field(bits, 32, 32)];
+
+		int paints[4][3] = {
+			{c1[0], c1[1], c1[2]},
+			{c2[0] + d, c2[1] + d, c2[2] + d},
+			{c2[0], c2[1], c2[2]},
+			{c2[0] - d, c2[1] - d, c2[2] - d},
+		};
+
+		decode_etc_paints(bits, texels, paints);
+	}
+	else if (g < 0 || g > 31) {
+		uint32_t r1 = bit_field(bits, 62, 59);
+		uint32_t g1 = bit_field(bits, 58, 56) << 1 | bit_field(bits, 52, 52);
+		uint32_t b1 = bit_field(bits, 51, 51) << 3 | bit_field(bits, 49, 47);
+		uint32_t r2 = bit_field(bits, 46, 43);
+		uint32_t g2 = bit_field(bits, 42, 39);
+		uint32_t b2 = bit_field(bits, 38, 35);
+
+		// the order of the two colors holds the distance index's lowest bit
+		uint32_t order = (r1 << 8 | g1 << 4 | b1) >= (r2 << 8 | g2 << 4 | b2);
+		int d = etc_distances[bit_field(bits, 34, 34) << 2 | bit_field(bits, 32, 32) << 1 | order];
+
+		int c1[3] = {extend4(r1), extend4(g1), extend4(b1)};
+		int c2[3] = {extend4(r2), extend4(g2), extend4(b2)};
+
+		int paints[4][3] = {
+			{c1[0] + d, c1[1] + d, c1[2] + d},
+			{c1[0] - d, c1[1] - d, c1[2] - d},
+			{c2[0] + d, c2[1] + d, c2[2] + d},
+			{c2[0] - d, c2[1] - d, c2[2] - d},
+		};
+
+		decode_etc_paints(bits, texels, paints);
+	}
+	else if (b < 0 || b > 31) {
+		// planar, three corner colors and a gradient between them
+		int o[3] = {
+			extend6(bit_field(bits, 62, 57)),
+			extend7(bit_field(bits, 56, 56) << 6 | bit_field(bits, 54, 49)),
+			extend6(bit_field(bits, 48, 48) << 5 | bit_field(bits, 44, 43) << 3 | bit_field(bits, 41, 39)),
+		};
+		int h[3] = {
+			extend6(bit_field(bits, 38, 34) << 1 | bit_field(bits, 32, 32)),
+			extend7(bit_field(bits, 31, 25)),
+			extend6(bit_field(bits, 24, 19)),
+		};
+		int v[3] = {
+			extend6(bit_field(bits, 18, 13)),
+			extend7(bit_field(bits, 12, 6)),
+			extend6(bit_field(bits, 5, 0)),
+		};
+
+		for (int y = 0; y < 4; y++)
+		{
+			for (int x = 0; x < 4; x++)
+			{
+				int rgb[3];
+				for (int c = 0; c < 3; c++) rgb[c] = (x * (h[c] - o[c]) + y * (v[c] - o[c]) + 4 * o[c] + 2) >> 2;
+
+				write_texel(texels, x, y, rgb);
+			}
+		}
+	}
+	else {
+		int base[2][3] = {
+			{extend5(bit_field(bits, 63, 59)), extend5(bit_field(bits, 55, 51)), extend5(bit_field(bits, 47, 43))},
+			{extend5((uint32_t) r), extend5((uint32_t) g), extend5((uint32_t) b)},
+		};
+
+		decode_etc_subblocks(bits, texels, base);
+	}
+}
+
+static void decode_etc2_rgba(const uint8_t *block, uint8_t *texels)
+{
+	decode_etc2_color(block + 8, texels);
+
+	uint64_t bits = read_be64(block);
+	int base = (int) bit_field(bits, 63, 56);
+	int multiplier = (int) bit_field(bits, 55, 52);
+	const int *modifiers = eac_modifiers[bit_field(bits, 51, 48)];
+
+	for (int x = 0; x < 4; x++)
+	{
+		for (int y = 0; y < 4; y++)
+		{
+			int i = 4 * x + y;
+			texels[4 * (4 * y + x) + 3] = clamp_byte(base + modifiers[bits >> (45 - 3 * i) & 7] * multiplier);
+		}
+	}
+}
+
+static void decode_rgba8(const uint8_t *block, uint8_t *texels)
+{
+	memcpy(texels, block, 4);
+}
+
+static const struct BlockFormat block_formats[] = {
+	{VK_FORMAT_R8G8B8A8_UNORM, VK_FORMAT_R8G8B8A8_UNORM, 1, 1, 4, "rgba8", decode_rgba8},
+	{VK_FORMAT_R8G8B8A8_SRGB, VK_FORMAT_R8G8B8A8_SRGB, 1, 1, 4, "rgba8 srgb", decode_rgba8},
+	{VK_FORMAT_BC1_RGB_UNORM_BLOCK, VK_FORMAT_R8G8B8A8_UNORM, 4, 4, 8, "bc1 rgb", decode_bc1_rgb},
+	{VK_FORMAT_BC1_RGB_SRGB_BLOCK, VK_FORMAT_R8G8B8A8_SRGB, 4, 4, 8, "bc1 rgb srgb", decode_bc1_rgb},
+	{VK_FORMAT_BC1_RGBA_UNORM_BLOCK, VK_FORMAT_R8G8B8A8_UNORM, 4, 4, 8, "bc1", decode_bc1_rgba},
+	{VK_FORMAT_BC1_RGBA_SRGB_BLOCK, VK_FORMAT_R8G8B8A8_SRGB, 4, 4, 8, "bc1 srgb", decode_bc1_rgba},
+	{VK_FORMAT_BC3_UNORM_BLOCK, VK_FORMAT_R8G8B8A8_UNORM, 4, 4, 16, "bc3", decode_bc3},
+	{VK_FORMAT_BC3_SRGB_BLOCK, VK_FORMAT_R8G8B8A8_SRGB, 4, 4, 16, "bc3 srgb", decode_bc3},
+	{VK_FORMAT_BC7_UNORM_BLOCK, VK_FORMAT_R8G8B8A8_UNORM, 4, 4, 16, "bc7", NULL},
+	{VK_FORMAT_BC7_SRGB_BLOCK, VK_FORMAT_R8G8B8A8_SRGB, 4, 4, 16, "bc7 srgb", NULL},
+	{VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK, VK_FORMAT_R8G8B8A8_UNORM, 4, 4, 8, "etc2 rgb", decode_etc2_color},
+	{VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK, VK_FORMAT_R8G8B8A8_SRGB, 4, 4, 8, "etc2 rgb srgb", decode_etc2_color},
+	{VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK, VK_FORMAT_R8G8B8A8_UNORM, 4, 4, 16, "etc2", decode_etc2_rgba},
+	{VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK, VK_FORMAT_R8G8B8A8_SRGB, 4, 4, 16, "etc2 srgb", decode_etc2_rgba},
+	{VK_FORMAT_ASTC_4x4_UNORM_BLOCK, VK_FORMAT_R8G8B8A8_UNORM, 4, 4, 16, "astc 4x4", NULL},
+	{VK_FORMAT_ASTC_4x4_SRGB_BLOCK, VK_FORMAT_R8G8B8A8_SRGB, 4, 4, 16, "astc 4x4 srgb", NULL},
+	{VK_FORMAT_ASTC_6x6_UNORM_BLOCK, VK_FORMAT_R8G8B8A8_UNORM, 6, 6, 16, "astc 6x6", NULL},
+	{VK_FORMAT_ASTC_6x6_SRGB_BLOCK, VK_FORMAT_R8G8B8A8_SRGB, 6, 6, 16, "astc 6x6 srgb", NULL},
+	{VK_FORMAT_ASTC_8x8_UNORM_BLOCK, VK_FORMAT_R8G8B8A8_UNORM, 8, 8, 16, "astc 8x8", NULL},
+	{VK_FORMAT_ASTC_8x8_SRGB_BLOCK, VK_FORMAT_R8G8B8A8_SRGB, 8, 8, 16, "astc 8x8 srgb", NULL},
+};
+
+const struct BlockFormat *find_block_format(VkFormat format)
+{
+	for (uint32_t i = 0; i < sizeof(block_formats) / sizeof(block_formats[0]); i++)
+	{
+		if (block_formats[i].format == format) return &block_formats[i];
+	}
+
+	return NULL;
+}
+
+VkDeviceSize block_level_size(const struct BlockFormat *format, uint32_t width, uint32_t height)
+{
+	VkDeviceSize blocks_x = (width + format->block_width - 1) / format->block_width;
+	VkDeviceSize blocks_y = (height + format->block_height - 1) / format->block_height;
+
+	return blocks_x * blocks_y * format->block_size;
+}
+
+bool decode_blocks(const struct BlockFormat *format, const uint8_t *blocks, uint32_t width, uint32_t height, uint8_t *pixels)
+{
+	if (format->decode == NULL) return false;
+
+	uint32_t block_width = format->block_width;
+	uint32_t block_height = format->block_height;
+	uint8_t texels[8 * 8 * 4];
+
+	for (uint32_t y = 0; y < height; y += block_height)
+	{
+		for (uint32_t x = 0; x < width; x += block_width)
+		{
+			format->decode(blocks, texels);
+			blocks += format->block_size;
+
+			// blocks hanging over the edge keep only the texels inside
+			uint32_t columns = width - x < block_width ? width - x : block_width;
+			uint32_t rows = height - y < block_height ? height - y : block_height;
+
+			for (uint32_t row = 0; row < rows; row++)
+			{
+				memcpy(&pixels[4 * ((size_t) (y + row) * width + x)], &texels[4 * row * block_width], 4 * columns);
+			}
+		}
+	}
+
+	return true;
+}
+
+// encoders, bounding box endpoints and nearest palette entry; quick rather than good
+
+static uint16_t pack_565(const uint8_t rgb[3])
+{
+	return (uint16_t) ((rgb[0] * 31 + 127) / 255 << 11 | (rgb[1] * 63 + 127) / 255 << 5 | (rgb[2] * 31 + 127) / 255);
+}
+
+static void encode_bc1_colors(const uint8_t *texels, uint8_t *block, bool punch_through)
+{
+	uint8_t low[3] = {255, 255, 255};
+	uint8_t high[3] = {0, 0, 0};
+	bool transparent = false;
+
+	for (int i = 0; i < 16; i++)
+	{
+		const uint8_t *texel = &texels[4 * i];
+
+		if (punch_through && texel[3] < 128) {
+			transparent = true;
+			continue;
+		}
+
+		for (int c = 0; c < 3; c++)
+		{
+			if (texel[c] < low[c]) low[c] = texel[c];
+			if (texel[c] > high[c]) high[c] = texel[c];
+		}
+	}
+
+	uint16_t c0 = pack_565(high);
+	uint16_t c1 = pack_565(low);
+
+	// three color mode wants c0 <= c1, four color mode c0 > c1
+	if (transparent ? c0 > c1 : c0 < c1) {
+		uint16_t swap = c0;
+		c0 = c1;
+		c1 = swap;
+	}
+
+	block[0] = (uint8_t) c0;
+	block[1] = (uint8_t) (c0 >> 8);
+	block[2] = (uint8_t) c1;
+	block[3] = (uint8_t) (c1 >> 8);
+
+	uint8_t palette[4][4];
+	bc1_palette(block, palette, !punch_through, punch_through);
+
+	// with equal endpoints the four color palette is the one color four times
+	uint32_t entries = transparent || (c0 == c1 && punch_through) ? 3 : 4;
+	uint32_t indices = 0;
+
+	for (int i = 0; i < 16; i++)
+	{
+		const uint8_t *texel = &texels[4 * i];
+		uint32_t best = 3;
+
+		if (!transparent || texel[3] >= 128) {
+			int best_error = INT32_MAX;
+
+			for (uint32_t p = 0; p < entries; p++)
+			{
+				int error = 0;
+				for (int c = 0; c < 3; c++) error += (texel[c] - palette[p][c]) * (texel[c] - palette[p][c]);
+
+				if (error < best_error) {
+					best_error = error;
+					best = p;
+				}
+			}
+		}
+
+		indices |= best << (2 * i);
+	}
+
+	block[4] = (uint8_t) indices;
+	block[5] = (uint8_t) (indices >> 8);
+	block[6] = (uint8_t) (indices >> 16);
+	block[7] = (uint8_t) (indices >> 24);
+}
+
+static void encode_bc1(const uint8_t *texels, uint8_t *block)
+{
+	encode_bc1_colors(texels, block, true);
+}
+
+static void encode_bc3(const uint8_t *texels, uint8_t *block)
+{
+	uint8_t a0 = 0;
+	uint8_t a1 = 255;
+
+	for (int i = 0; i < 16; i++)
+	{
+		uint8_t alpha = texels[4 * i + 3];
+		if (alpha > a0) a0 = alpha;
+		if (alpha < a1) a1 = alpha;
+	}
+
+	// eight value mode, a0 > a1; a flat block only uses index 0
+	uint8_t alphas[8] = {a0, a1};
+	for (uint32_t i = 1; i < 7; i++) alphas[i + 1] = (uint8_t) (((7 - i) * a0 + i * a1 + 3) / 7);
+
+	uint64_t indices = 0;
+
+	for (int i = 0; i < 16 && a0 > a1; i++)
+	{
+		int alpha = texels[4 * i + 3];
+		uint64_t best = 0;
+		int best_error = 256;
+
+		for (int p = 0; p < 8; p++)
+		{
+			int error = abs(alpha - alphas[p]);
+
+			if (error < best_error) {
+				best_error = error;
+				best = (uint64_t) p;
+			}
+		}
+
+		indices |= best << (3 * i);
+	}
+
+	block[0] = a0;
+	block[1] = a1;
+	for (int i = 0; i < 6; i++) block[2 + i] = (uint8_t) (indices >> (8 * i));
+
+	encode_bc1_colors(texels, block + 8, false);
+}
+
+bool encode_blocks(const struct BlockFormat *format, const uint8_t *pixels, uint32_t width, uint32_t height, uint8_t *blocks)
+{
+	void (*encode)(const uint8_t *texels, uint8_t *block) = NULL;
+
+	switch (format->format)
+	{
+		case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+		case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+			encode = encode_bc1;
+			break;
+		case VK_FORMAT_BC3_UNORM_BLOCK:
+		case VK_FORMAT_BC3_SRGB_BLOCK:
+			encode = encode_bc3;
+			break;
+		default:
+			return false;
+	}
+
+	uint8_t texels[4 * 4 * 4];
+
+	for (uint32_t y = 0; y < height; y += 4)
+	{
+		for (uint32_t x = 0; x < width; x += 4)
+		{
+			for (uint32_t row = 0; row < 4; row++)
+			{
+				for (uint32_t column = 0; column < 4; column++)
+				{
+					uint32_t source_x = x + column < width ? x + column : width - 1;
+					uint32_t source_y = y + row < height ? y + row : height - 1;
+
+					memcpy(&texels[4 * (4 * row + column)], &pixels[4 * ((size_t) source_y * width + source_x)], 4);
+				}
+			}
+
+			encode(texels, blocks);
+			blocks += format->block_size;
+		}
+	}
+
+	return true;
+}
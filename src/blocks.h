@@ -0,0 +1,33 @@
+#pragma once
+
+#include "render.h"
+
+// Block compressed texture formats. Sizes for the formats textures can be
+// stored in, software decoders to RGBA8 for devices without support for
+// one, and the quick BC1 and BC3 encoders the pack tool uses.
+//
+// BC7 and ASTC have no software decoder; on devices without them those
+// textures fail to load rather than being transcoded.
+
+struct BlockFormat {
+	VkFormat format;
+	VkFormat fallback; // R8G8B8A8 with the same transfer function
+	uint32_t block_width;
+	uint32_t block_height;
+	uint32_t block_size; // bytes
+	const char *name;
+
+	// one block to block_width * block_height RGBA8 texels, row by row; NULL when not decodable
+	void (*decode)(const uint8_t *block, uint8_t *texels);
+};
+
+// NULL for formats textures can not be stored in
+const struct BlockFormat *find_block_format(VkFormat format);
+
+VkDeviceSize block_level_size(const struct BlockFormat *format, uint32_t width, uint32_t height);
+
+// a whole level to tightly packed RGBA8 rows, false when the format has no decoder
+bool decode_blocks(const struct BlockFormat *format, const uint8_t *blocks, uint32_t width, uint32_t height, uint8_t *pixels);
+
+// tightly packed RGBA8 rows to BC1 or BC3 blocks, edge blocks repeat the last row and column
+bool encode_blocks(const struct BlockFormat *format, const uint8_t *pixels, uint32_t width, uint32_t height, uint8_t *blocks);
@@ -0,0 +1,469 @@
+#define _POSIX_C_SOURCE 200809L // popen, pclose, sched_yield, clock_gettime
+
+#include <vulkan/vulkan.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+#include <sched.h>
+#include <time.h>
+
+#include "render.h"
+#include "capture.h"
+#include "track.h"
+
+#define CAPTURE_GROUP_SIZE 8
+
+struct CaptureParams {
+	uint32_t size[2];
+	uint32_t mode;
+	uint32_t srgb;
+	uint32_t row_words;
+	uint32_t chroma_words;
+	uint32_t chroma_offset;
+	uint32_t chroma_plane;
+};
+
+static bool is_srgb_format(VkFormat format)
+{
+	return format == VK_FORMAT_B8G8R8A8_SRGB ||
+		format == VK_FORMAT_R8G8B8A8_SRGB ||
+		format == VK_FORMAT_A8B8G8R8_SRGB_PACK32;
+}
+
+static uint32_t div_up(uint32_t value, uint32_t divisor)
+{
+	return (value + divisor - 1) / divisor;
+}
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+}
+
+// readback buffers are read by the cpu, cached memory makes that a lot faster where it exists
+static VkMemoryPropertyFlags readback_memory_properties(VkPhysicalDevice physical_device)
+{
+	VkMemoryPropertyFlags cached = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+
+	VkPhysicalDeviceMemoryProperties memory_properties;
+	vkGetPhysicalDeviceMemoryProperties(physical_device, &memory_properties);
+
+	for (uint32_t i = 0; i < memory_properties.memoryTypeCount; i++)
+	{
+		if ((memory_properties.memoryTypes[i].propertyFlags & cached) == cached) return cached;
+	}
+
+	return VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+}
+
+static FILE *open_capture_stream(const char *path, bool *piped)
+{
+	*piped = false;
+
+	if (path[0] == '|') {
+		*piped = true;
+		return popen(path + 1, "w");
+	}
+
+	return fopen(path, "wb");
+}
+
+static VkDescriptorSetLayout create_capture_set_layout(VkDevice device)
+{
+	VkDescriptorSetLayoutBinding bindings[2] = {
+		{
+			.binding = 0,
+			.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+			.descriptorCount = 1,
+			.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+			.pImmutableSamplers = NULL,
+		},
+		{
+			.binding = 1,
+			.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			.descriptorCount = 1,
+			.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+			.pImmutableSamplers = NULL,
+		},
+	};
+
+	VkDescriptorSetLayoutCreateInfo set_layout_info = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+		.pNext = NULL,
+		.flags = 0,
+		.bindingCount = 2,
+		.pBindings = bindings,
+	};
+
+	VkDescriptorSetLayout set_layout;
+	VkResult result = vkCreateDescriptorSetLayout(device, &set_layout_info, NULL, &set_layout);
+	if (result != VK_SUCCESS) printf("failed to create capture descriptor set layout\n");
+	if (result == VK_SUCCESS) track_resource(RESOURCE_DESCRIPTOR_SET_LAYOUT, set_layout, 0);
+
+	return set_layout;
+}
+
+static VkDescriptorPool create_capture_descriptor_pool(VkDevice device)
+{
+	VkDescriptorPoolSize pool_sizes[2] = {
+		{
+			.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+			.descriptorCount = CAPTURE_MAX_SLOTS,
+		},
+		{
+			.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			.descriptorCount = CAPTURE_MAX_SLOTS,
+		},
+	};
+
+	VkDescriptorPoolCreateInfo pool_info = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+		.pNext = NULL,
+		.flags = 0,
+		.maxSets = CAPTURE_MAX_SLOTS,
+		.poolSizeCount = 2,
+		.pPoolSizes = pool_sizes,
+	};
+
+	VkDescriptorPool descriptor_pool;
+	VkResult result = vkCreateDescriptorPool(device, &pool_info, NULL, &descriptor_pool);
+	if (result != VK_SUCCESS) printf("failed to create capture descriptor pool\n");
+	if (result == VK_SUCCESS) track_resource(RESOURCE_DESCRIPTOR_POOL, descriptor_pool, 0);
+
+	return descriptor_pool;
+}
+
+struct FrameCapture create_frame_capture(VkPhysicalDevice physical_device, VkDevice device, VkExtent2D extent, VkFormat source_format, enum CaptureFormat format, const char *path, uint32_t frame_rate, uint32_t slot_count)
+{
+	struct FrameCapture capture = {0};
+
+	capture.format = format;
+	capture.extent = extent;
+	capture.srgb = is_srgb_format(source_format);
+	capture.frame_rate = frame_rate;
+	capture.path = path;
+	capture.slot_count = slot_count < 2 ? 2 : slot_count > CAPTURE_MAX_SLOTS ? CAPTURE_MAX_SLOTS : slot_count;
+
+	// packed layout, see capture.comp
+
+	uint32_t groups = div_up(extent.width, 4);
+
+	switch (format)
+	{
+		case CAPTURE_FORMAT_RGBA:
+			capture.row_words = extent.width;
+			capture.frame_size = (VkDeviceSize) extent.width * extent.height * 4;
+			break;
+		case CAPTURE_FORMAT_PPM:
+			capture.row_words = groups * 3;
+			capture.frame_size = (VkDeviceSize) capture.row_words * extent.height * 4;
+			break;
+		case CAPTURE_FORMAT_Y4M:
+			capture.row_words = groups;
+			capture.chroma_words = div_up(extent.width, 8);
+			capture.chroma_offset = capture.row_words * extent.height;
+			capture.chroma_plane = capture.chroma_words * div_up(extent.height, 2);
+			capture.frame_size = (VkDeviceSize) (capture.chroma_offset + 2 * capture.chroma_plane) * 4;
+			break;
+	}
+
+	// a pattern means a file per frame, anything else is one stream
+
+	bool per_frame = format == CAPTURE_FORMAT_PPM && strchr(path, '%') != NULL;
+
+	if (!per_frame) {
+		capture.stream = open_capture_stream(path, &capture.piped);
+		if (capture.stream == NULL) printf("failed to open capture output %s\n", path);
+	}
+
+	if (capture.stream != NULL && format == CAPTURE_FORMAT_Y4M) {
+		fprintf(capture.stream, "YUV4MPEG2 W%u H%u F%u:1 Ip A1:1 C420jpeg\n", extent.width, extent.height, frame_rate);
+	}
+
+	capture.sampler = create_sampler(device, VK_FILTER_NEAREST, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE);
+	capture.set_layout = create_capture_set_layout(device);
+	capture.descriptor_pool = create_capture_descriptor_pool(device);
+	capture.pipeline_layout = create_pipeline_layout(device, 1, &capture.set_layout, VK_SHADER_STAGE_COMPUTE_BIT, sizeof(struct CaptureParams));
+	capture.pipeline = create_compute_pipeline(device, capture.pipeline_layout, "../assets/shaders/capture_comp.spv");
+
+	VkMemoryPropertyFlags memory_properties = readback_memory_properties(physical_device);
+
+	VkDescriptorSetLayout set_layouts[CAPTURE_MAX_SLOTS];
+	VkDescriptorSet sets[CAPTURE_MAX_SLOTS];
+
+	for (uint32_t i = 0; i < capture.slot_count; i++)
+	{
+		set_layouts[i] = capture.set_layout;
+	}
+
+	VkDescriptorSetAllocateInfo allocate_info = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+		.pNext = NULL,
+		.descriptorPool = capture.descriptor_pool,
+		.descriptorSetCount = capture.slot_count,
+		.pSetLayouts = set_layouts,
+	};
+
+	VkResult result = vkAllocateDescriptorSets(device, &allocate_info, sets);
+	if (result != VK_SUCCESS) printf("failed to allocate capture descriptor sets\n");
+
+	VkEventCreateInfo event_info = {
+		.sType = VK_STRUCTURE_TYPE_EVENT_CREATE_INFO,
+		.pNext = NULL,
+		.flags = 0,
+	};
+
+	for (uint32_t i = 0; i < capture.slot_count; i++)
+	{
+		struct CaptureSlot *slot = &capture.slots[i];
+
+		slot->buffer = create_buffer(physical_device, device, capture.frame_size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, memory_properties);
+		slot->set = sets[i];
+		slot->pending = false;
+
+		result = vkCreateEvent(device, &event_info, NULL, &slot->event);
+		if (result != VK_SUCCESS) printf("failed to create capture event\n");
+		if (result == VK_SUCCESS) track_resource(RESOURCE_EVENT, slot->event, 0);
+
+		VkDescriptorBufferInfo buffer_info = {
+			.buffer = slot->buffer.buffer,
+			.offset = 0,
+			.range = capture.frame_size,
+		};
+
+		VkWriteDescriptorSet write = {
+			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			.pNext = NULL,
+			.dstSet = slot->set,
+			.dstBinding = 1,
+			.dstArrayElement = 0,
+			.descriptorCount = 1,
+			.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			.pImageInfo = NULL,
+			.pBufferInfo = &buffer_info,
+			.pTexelBufferView = NULL,
+		};
+
+		vkUpdateDescriptorSets(device, 1, &write, 0, NULL);
+	}
+
+	return capture;
+}
+
+void destroy_frame_capture(VkDevice device, struct FrameCapture *capture)
+{
+	for (uint32_t i = 0; i < capture->slot_count; i++)
+	{
+		untrack_resource(RESOURCE_EVENT, capture->slots[i].event);
+		vkDestroyEvent(device, capture->slots[i].event, NULL);
+		destroy_buffer(device, &capture->slots[i].buffer);
+	}
+
+	untrack_resource(RESOURCE_PIPELINE, capture->pipeline);
+	vkDestroyPipeline(device, capture->pipeline, NULL);
+	untrack_resource(RESOURCE_PIPELINE_LAYOUT, capture->pipeline_layout);
+	vkDestroyPipelineLayout(device, capture->pipeline_layout, NULL);
+	untrack_resource(RESOURCE_DESCRIPTOR_POOL, capture->descriptor_pool);
+	vkDestroyDescriptorPool(device, capture->descriptor_pool, NULL);
+	untrack_resource(RESOURCE_DESCRIPTOR_SET_LAYOUT, capture->set_layout);
+	vkDestroyDescriptorSetLayout(device, capture->set_layout, NULL);
+	untrack_resource(RESOURCE_SAMPLER, capture->sampler);
+	vkDestroySampler(device, capture->sampler, NULL);
+
+	if (capture->stream != NULL) {
+		if (capture->piped) pclose(capture->stream);
+		else fclose(capture->stream);
+	}
+
+	printf("capture: %llu frames, %.1f MB written, %llu stalls, %llu dropped\n", (unsigned long long) (capture->written - capture->dropped), capture->bytes_written / (1024.0 * 1024.0), (unsigned long long) capture->stalls, (unsigned long long) capture->dropped);
+}
+
+// copies rows out of the padded layout
+static size_t write_rows(FILE *stream, const uint8_t *data, uint32_t row_bytes, uint32_t row_stride, uint32_t rows)
+{
+	size_t written = 0;
+
+	for (uint32_t y = 0; y < rows; y++)
+	{
+		written += fwrite(data + (size_t) y * row_stride, 1, row_bytes, stream);
+	}
+
+	return written;
+}
+
+static void write_slot(struct FrameCapture *capture, struct CaptureSlot *slot)
+{
+	const uint8_t *data = slot->buffer.mapped;
+	uint32_t width = capture->extent.width;
+	uint32_t height = capture->extent.height;
+
+	FILE *stream = capture->stream;
+
+	if (stream == NULL) {
+		char name[1024];
+		snprintf(name, sizeof(name), capture->path, (unsigned) slot->frame);
+
+		stream = fopen(name, "wb");
+		if (stream == NULL) {
+			printf("failed to open capture file %s\n", name);
+			return;
+		}
+	}
+
+	size_t written = 0;
+
+	switch (capture->format)
+	{
+		case CAPTURE_FORMAT_RGBA:
+			written += fwrite(data, 1, capture->frame_size, stream);
+			break;
+		case CAPTURE_FORMAT_PPM:
+			written += fprintf(stream, "P6\n%u %u\n255\n", width, height);
+			written += write_rows(stream, data, width * 3, capture->row_words * 4, height);
+			break;
+		case CAPTURE_FORMAT_Y4M:
+			written += fprintf(stream, "FRAME\n");
+			written += write_rows(stream, data, width, capture->row_words * 4, height);
+			written += write_rows(stream, data + capture->chroma_offset * 4, div_up(width, 2), capture->chroma_words * 4, div_up(height, 2));
+			written += write_rows(stream, data + (capture->chroma_offset + capture->chroma_plane) * 4, div_up(width, 2), capture->chroma_words * 4, div_up(height, 2));
+			break;
+	}
+
+	if (stream != capture->stream) fclose(stream);
+
+	capture->bytes_written += written;
+	capture->written++;
+	slot->pending = false;
+}
+
+void poll_frame_capture(VkDevice device, struct FrameCapture *capture)
+{
+	// frames finish in order, stop at the first one that has not
+	while (capture->written < capture->recorded)
+	{
+		struct CaptureSlot *slot = &capture->slots[capture->written % capture->slot_count];
+
+		if (vkGetEventStatus(device, slot->event) != VK_EVENT_SET) break;
+
+		write_slot(capture, slot);
+	}
+}
+
+// past the deadline the oldest frames are dropped unwritten, in order, until slot is free
+static void drain_slot(VkDevice device, struct FrameCapture *capture, struct CaptureSlot *slot)
+{
+	uint64_t deadline = now_ns() + CAPTURE_DRAIN_TIMEOUT_NS;
+
+	while (slot->pending)
+	{
+		poll_frame_capture(device, capture);
+		if (!slot->pending) break;
+
+		if (now_ns() < deadline) {
+			sched_yield();
+			continue;
+		}
+
+		struct CaptureSlot *oldest = &capture->slots[capture->written % capture->slot_count];
+		printf("failed to read back captured frame %llu, dropping it\n", (unsigned long long) oldest->frame);
+
+		oldest->pending = false;
+		capture->written++;
+		capture->dropped++;
+	}
+}
+
+void finish_frame_capture(VkDevice device, struct FrameCapture *capture)
+{
+	for (uint32_t i = 0; i < capture->slot_count; i++)
+	{
+		drain_slot(device, capture, &capture->slots[i]);
+	}
+
+	if (capture->stream != NULL) fflush(capture->stream);
+}
+
+void record_frame_capture(VkCommandBuffer command_buffer, VkDevice device, struct FrameCapture *capture, VkImageView source)
+{
+	struct CaptureSlot *slot = &capture->slots[capture->recorded % capture->slot_count];
+
+	// only when the host falls behind by a whole ring
+	if (slot->pending) {
+		capture->stalls++;
+		drain_slot(device, capture, slot);
+	}
+
+	vkResetEvent(device, slot->event);
+
+	VkDescriptorImageInfo image_info = {
+		.sampler = capture->sampler,
+		.imageView = source,
+		.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+	};
+
+	VkWriteDescriptorSet write = {
+		.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+		.pNext = NULL,
+		.dstSet = slot->set,
+		.dstBinding = 0,
+		.dstArrayElement = 0,
+		.descriptorCount = 1,
+		.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+		.pImageInfo = &image_info,
+		.pBufferInfo = NULL,
+		.pTexelBufferView = NULL,
+	};
+
+	vkUpdateDescriptorSets(device, 1, &write, 0, NULL);
+
+	struct CaptureParams params = {
+		.size = {capture->extent.width, capture->extent.height},
+		.mode = capture->format == CAPTURE_FORMAT_RGBA ? 0 : capture->format == CAPTURE_FORMAT_PPM ? 1 : 2,
+		.srgb = capture->srgb ? 1 : 0,
+		.row_words = capture->row_words,
+		.chroma_words = capture->chroma_words,
+		.chroma_offset = capture->chroma_offset,
+		.chroma_plane = capture->chroma_plane,
+	};
+
+	vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, capture->pipeline);
+	vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, capture->pipeline_layout, 0, 1, &slot->set, 0, NULL);
+	vkCmdPushConstants(command_buffer, capture->pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(params), &params);
+	vkCmdDispatch(command_buffer, div_up(div_up(capture->extent.width, 4), CAPTURE_GROUP_SIZE), div_up(capture->extent.height, CAPTURE_GROUP_SIZE), 1);
+
+	// make the packed frame visible to the host, then tell it so
+	VkBufferMemoryBarrier barrier = {
+		.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+		.pNext = NULL,
+		.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+		.dstAccessMask = VK_ACCESS_HOST_READ_BIT,
+		.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.buffer = slot->buffer.buffer,
+		.offset = 0,
+		.size = VK_WHOLE_SIZE,
+	};
+
+	vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, NULL, 1, &barrier, 0, NULL);
+	vkCmdSetEvent(command_buffer, slot->event, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+	capture->staged = true;
+}
+
+void confirm_frame_capture(struct FrameCapture *capture)
+{
+	if (!capture->staged) return;
+
+	struct CaptureSlot *slot = &capture->slots[capture->recorded % capture->slot_count];
+
+	slot->frame = capture->frame_number++;
+	slot->pending = true;
+	capture->recorded++;
+	capture->staged = false;
+}
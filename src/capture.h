@@ -0,0 +1,88 @@
+#pragma once
+
+#include "render.h"
+
+// Frame capture. A compute pass packs the rendered image into a host
+// readable buffer (rgb, rgba or yuv 4:2:0, so the readback is as small as
+// the output format allows) and sets an event when the copy is done. The
+// buffers rotate through slots, and finished frames are written out in
+// order whenever the host notices their event, so the gpu never waits for
+// the file or pipe.
+//
+// Outputs:
+//   - ppm: one file per frame when the path contains a printf pattern
+//     ("frame_%06u.ppm"), otherwise concatenated ppm images in one stream
+//   - y4m: a single yuv4mpeg2 stream
+//   - rgba: raw rgba8 frames, one after the other
+//
+// A path of "|command" pipes into command, "|ffmpeg -i - out.mp4" for example;
+// stdout is left alone since the renderer logs there.
+
+#define CAPTURE_MAX_SLOTS 4
+#define CAPTURE_DRAIN_TIMEOUT_NS 2000000000ull // waiting for a slot longer than this gives up on its frame
+
+enum CaptureFormat {
+	CAPTURE_FORMAT_PPM,
+	CAPTURE_FORMAT_Y4M,
+	CAPTURE_FORMAT_RGBA,
+};
+
+struct CaptureSlot {
+	struct Buffer buffer;
+	VkEvent event; // set by the gpu once buffer holds the frame
+	VkDescriptorSet set;
+	bool pending; // submitted, not written out yet
+	uint64_t frame;
+};
+
+struct FrameCapture {
+	enum CaptureFormat format;
+	VkExtent2D extent;
+	bool srgb;
+	uint32_t frame_rate;
+
+	const char *path;
+	FILE *stream; // NULL for a file per frame
+	bool piped;
+
+	// packed layout, in 32 bit words
+	uint32_t row_words;
+	uint32_t chroma_words;
+	uint32_t chroma_offset;
+	uint32_t chroma_plane;
+	VkDeviceSize frame_size;
+
+	VkSampler sampler;
+	VkDescriptorSetLayout set_layout;
+	VkDescriptorPool descriptor_pool;
+	VkPipelineLayout pipeline_layout;
+	VkPipeline pipeline;
+
+	struct CaptureSlot slots[CAPTURE_MAX_SLOTS];
+	uint32_t slot_count;
+	bool staged; // the next slot was recorded into, its submit is not confirmed yet
+
+	uint64_t recorded;
+	uint64_t written;
+	uint64_t frame_number; // in the next per frame file name, counts submitted frames unless the caller sets it
+	uint64_t stalls; // times recording had to wait for a slot to drain
+	uint64_t dropped; // frames the gpu never finished within CAPTURE_DRAIN_TIMEOUT_NS
+	uint64_t bytes_written;
+};
+
+// slot_count has to exceed the frames in flight, a slot's descriptor set is rewritten when it comes round again
+struct FrameCapture create_frame_capture(VkPhysicalDevice physical_device, VkDevice device, VkExtent2D extent, VkFormat source_format, enum CaptureFormat format, const char *path, uint32_t frame_rate, uint32_t slot_count);
+void destroy_frame_capture(VkDevice device, struct FrameCapture *capture);
+
+// packs source, which has to be in SHADER_READ_ONLY_OPTIMAL and sampled from compute, into the next slot
+void record_frame_capture(VkCommandBuffer command_buffer, VkDevice device, struct FrameCapture *capture, VkImageView source);
+
+// call once the command buffer holding the last record_frame_capture was submitted; a frame whose
+// submit failed is never confirmed, and the next record reuses its slot
+void confirm_frame_capture(struct FrameCapture *capture);
+
+// writes out every finished frame without blocking
+void poll_frame_capture(VkDevice device, struct FrameCapture *capture);
+
+// waits for and writes out every recorded frame, after the last submit
+void finish_frame_capture(VkDevice device, struct FrameCapture *capture);
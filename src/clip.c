@@ -0,0 +1,435 @@
+#include <vulkan/vulkan.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+#include <math.h>
+
+#include "render.h"
+#include "clip.h"
+#include "track.h"
+
+static VkDescriptorSetLayout create_clip_set_layout(VkDevice device)
+{
+	VkDescriptorSetLayoutBinding binding = {
+		.binding = 0,
+		.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+		.descriptorCount = 1,
+		.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+		.pImmutableSamplers = NULL,
+	};
+
+	VkDescriptorSetLayoutCreateInfo set_layout_info = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+		.pNext = NULL,
+		.flags = 0,
+		.bindingCount = 1,
+		.pBindings = &binding,
+	};
+
+	VkDescriptorSetLayout set_layout;
+	VkResult result = vkCreateDescriptorSetLayout(device, &set_layout_info, NULL, &set_layout);
+	if (result != VK_SUCCESS) printf("failed to create clip descriptor set layout\n");
+	if (result == VK_SUCCESS) track_resource(RESOURCE_DESCRIPTOR_SET_LAYOUT, set_layout, 0);
+
+	return set_layout;
+}
+
+static VkDescriptorSet create_clip_descriptor_set(VkDevice device, struct ClipStack *stack)
+{
+	VkDescriptorPoolSize pool_size = {
+		.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+		.descriptorCount = 1,
+	};
+
+	VkDescriptorPoolCreateInfo pool_info = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+		.pNext = NULL,
+		.flags = 0,
+		.maxSets = 1,
+		.poolSizeCount = 1,
+		.pPoolSizes = &pool_size,
+	};
+
+	VkResult result = vkCreateDescriptorPool(device, &pool_info, NULL, &stack->descriptor_pool);
+	if (result != VK_SUCCESS) printf("failed to create clip descriptor pool\n");
+	if (result == VK_SUCCESS) track_resource(RESOURCE_DESCRIPTOR_POOL, stack->descriptor_pool, 0);
+
+	VkDescriptorSetAllocateInfo allocate_info = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+		.pNext = NULL,
+		.descriptorPool = stack->descriptor_pool,
+		.descriptorSetCount = 1,
+		.pSetLayouts = &stack->set_layout,
+	};
+
+	VkDescriptorSet descriptor_set;
+	result = vkAllocateDescriptorSets(device, &allocate_info, &descriptor_set);
+	if (result != VK_SUCCESS) printf("failed to allocate clip descriptor set\n");
+
+	VkDescriptorBufferInfo buffer_info = {
+		.buffer = stack->point_buffer.buffer,
+		.offset = 0,
+		.range = VK_WHOLE_SIZE,
+	};
+
+	VkWriteDescriptorSet write = {
+		.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+		.pNext = NULL,
+		.dstSet = descriptor_set,
+		.dstBinding = 0,
+		.dstArrayElement = 0,
+		.descriptorCount = 1,
+		.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+		.pImageInfo = NULL,
+		.pBufferInfo = &buffer_info,
+		.pTexelBufferView = NULL,
+	};
+
+	vkUpdateDescriptorSets(device, 1, &write, 0, NULL);
+
+	return descriptor_set;
+}
+
+struct ClipStack *create_clip_stack(VkPhysicalDevice physical_device, VkDevice device, struct PipelineRegistry *registry, uint32_t frames_in_flight)
+{
+	struct ClipStack *stack = calloc(1, sizeof(struct ClipStack));
+
+	stack->device = device;
+	stack->frames_in_flight = frames_in_flight > 0 ? frames_in_flight : 1;
+	stack->registry = registry;
+
+	VkDeviceSize point_size = (VkDeviceSize) stack->frames_in_flight * CLIP_MAX_POINTS * 2 * sizeof(float);
+	stack->point_buffer = create_buffer(physical_device, device, point_size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+	stack->set_layout = create_clip_set_layout(device);
+	stack->set = create_clip_descriptor_set(device, stack);
+	stack->layout = create_pipeline_layout(device, 1, &stack->set_layout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(struct ClipParams));
+
+	// the shapes only ever write the stencil, the registry builds a push and a pop pipeline per target
+	stack->program = register_pipeline_program(registry, "../assets/shaders/clip_vert.spv", "../assets/shaders/clip_frag.spv", stack->layout);
+
+	return stack;
+}
+
+void destroy_clip_stack(struct ClipStack *stack)
+{
+	VkDevice device = stack->device;
+
+	untrack_resource(RESOURCE_PIPELINE_LAYOUT, stack->layout);
+	vkDestroyPipelineLayout(device, stack->layout, NULL);
+	untrack_resource(RESOURCE_DESCRIPTOR_POOL, stack->descriptor_pool);
+	vkDestroyDescriptorPool(device, stack->descriptor_pool, NULL);
+	untrack_resource(RESOURCE_DESCRIPTOR_SET_LAYOUT, stack->set_layout);
+	vkDestroyDescriptorSetLayout(device, stack->set_layout, NULL);
+	destroy_buffer(device, &stack->point_buffer);
+
+	free(stack);
+}
+
+static bool scissor_equal(VkRect2D a, VkRect2D b)
+{
+	return a.offset.x == b.offset.x && a.offset.y == b.offset.y && a.extent.width == b.extent.width && a.extent.height == b.extent.height;
+}
+
+static bool scissor_empty(VkRect2D rect)
+{
+	return rect.extent.width == 0 || rect.extent.height == 0;
+}
+
+static VkRect2D intersect_scissor(VkRect2D a, VkRect2D b)
+{
+	int32_t x0 = a.offset.x > b.offset.x ? a.offset.x : b.offset.x;
+	int32_t y0 = a.offset.y > b.offset.y ? a.offset.y : b.offset.y;
+	int64_t ax1 = (int64_t) a.offset.x + a.extent.width;
+	int64_t ay1 = (int64_t) a.offset.y + a.extent.height;
+	int64_t bx1 = (int64_t) b.offset.x + b.extent.width;
+	int64_t by1 = (int64_t) b.offset.y + b.extent.height;
+	int64_t x1 = ax1 < bx1 ? ax1 : bx1;
+	int64_t y1 = ay1 < by1 ? ay1 : by1;
+
+	VkRect2D rect = {
+		.offset = {x0, y0},
+		.extent = {x1 > x0 ? (uint32_t) (x1 - x0) : 0, y1 > y0 ? (uint32_t) (y1 - y0) : 0},
+	};
+
+	return rect;
+}
+
+// the pixels whose centres are inside rect, clamped to the target
+static VkRect2D rect_to_scissor(const struct ClipStack *stack, const float rect[4])
+{
+	float scale_x = 0.5f * stack->view[2] * stack->extent.width;
+	float scale_y = 0.5f * stack->view[3] * stack->extent.height;
+
+	float x0 = floorf((rect[0] - stack->view[0]) * scale_x + 0.5f);
+	float y0 = floorf((rect[1] - stack->view[1]) * scale_y + 0.5f);
+	float x1 = floorf((rect[0] + rect[2] - stack->view[0]) * scale_x + 0.5f);
+	float y1 = floorf((rect[1] + rect[3] - stack->view[1]) * scale_y + 0.5f);
+
+	x0 = x0 < 0.0f ? 0.0f : x0;
+	y0 = y0 < 0.0f ? 0.0f : y0;
+	x1 = x1 > stack->extent.width ? stack->extent.width : x1;
+	y1 = y1 > stack->extent.height ? stack->extent.height : y1;
+
+	VkRect2D scissor = {
+		.offset = {(int32_t) x0, (int32_t) y0},
+		.extent = {x1 > x0 ? (uint32_t) (x1 - x0) : 0, y1 > y0 ? (uint32_t) (y1 - y0) : 0},
+	};
+
+	return scissor;
+}
+
+static void set_clip_state(VkCommandBuffer command_buffer, struct ClipStack *stack, VkRect2D scissor, uint32_t reference)
+{
+	if (!scissor_equal(scissor, stack->bound_scissor)) {
+		vkCmdSetScissor(command_buffer, 0, 1, &scissor);
+		stack->bound_scissor = scissor;
+		stack->stats.scissor_sets++;
+	}
+
+	if (reference != stack->bound_reference) {
+		vkCmdSetStencilReference(command_buffer, VK_STENCIL_FACE_FRONT_AND_BACK, reference);
+		stack->bound_reference = reference;
+		stack->stats.reference_sets++;
+	}
+}
+
+void begin_clip_pass(VkCommandBuffer command_buffer, struct ClipStack *stack, uint64_t frame_index, const struct PipelineState *target, VkExtent2D extent, const float view[4])
+{
+	stack->target = *target;
+	stack->extent = extent;
+	memcpy(stack->view, view, sizeof(stack->view));
+
+	stack->point_base = (uint32_t) (frame_index % stack->frames_in_flight) * CLIP_MAX_POINTS;
+	stack->point_count = 0;
+
+	stack->depth = 0;
+	stack->overflow = 0;
+	stack->entries[0] = (struct ClipEntry) {
+		.scissor = {
+			.offset = {0, 0},
+			.extent = extent,
+		},
+		.reference = 0,
+		.bounds = {0.0f, 0.0f, 0.0f, 0.0f},
+		.stenciled = false,
+	};
+
+	stack->stats.rect_clips = 0;
+	stack->stats.stencil_clips = 0;
+	stack->stats.empty_clips = 0;
+	stack->stats.scissor_sets = 1;
+	stack->stats.reference_sets = 1;
+
+	// nothing is known about the command buffer yet
+	vkCmdSetScissor(command_buffer, 0, 1, &stack->entries[0].scissor);
+	vkCmdSetStencilReference(command_buffer, VK_STENCIL_FACE_FRONT_AND_BACK, 0);
+	stack->bound_scissor = stack->entries[0].scissor;
+	stack->bound_reference = 0;
+}
+
+// NULL past CLIP_MAX_DEPTH, the clip is then ignored and only its pop is counted
+static struct ClipEntry *push_entry(struct ClipStack *stack)
+{
+	if (stack->depth == CLIP_MAX_DEPTH || stack->overflow > 0) {
+		if (stack->overflow++ == 0) printf("failed to push clip, more than %d deep\n", CLIP_MAX_DEPTH);
+		return NULL;
+	}
+
+	stack->entries[stack->depth + 1] = stack->entries[stack->depth];
+	stack->entries[stack->depth + 1].stenciled = false;
+	stack->depth++;
+
+	if (stack->depth > stack->stats.max_depth) stack->stats.max_depth = stack->depth;
+
+	return &stack->entries[stack->depth];
+}
+
+bool push_clip_rect(struct ClipStack *stack, const float rect[4])
+{
+	struct ClipEntry *entry = push_entry(stack);
+	if (entry == NULL) return true;
+
+	entry->scissor = intersect_scissor(entry->scissor, rect_to_scissor(stack, rect));
+	stack->stats.rect_clips++;
+
+	if (scissor_empty(entry->scissor)) {
+		stack->stats.empty_clips++;
+		return false;
+	}
+
+	return true;
+}
+
+// draws the shape where the stencil is at the parent's depth and raises it by one; the scissor is
+// already cut down to the shape's bounds, which keeps the draw and the one that undoes it small
+static bool push_stencil_clip(VkCommandBuffer command_buffer, struct ClipStack *stack, const struct ClipParams *params)
+{
+	struct ClipEntry *entry = push_entry(stack);
+	if (entry == NULL) return true;
+
+	entry->scissor = intersect_scissor(entry->scissor, rect_to_scissor(stack, params->rect));
+
+	if (scissor_empty(entry->scissor)) {
+		stack->stats.empty_clips++;
+		return false;
+	}
+
+	// without a stencil, or with all of it in use, the shape clips to its bounds
+	if (stack->target.stencil_format == VK_FORMAT_UNDEFINED || entry->reference == CLIP_MAX_STENCIL) {
+		stack->stats.rect_clips++;
+		return true;
+	}
+
+	struct PipelineState state = stack->target;
+	state.stencil = STENCIL_MODE_CLIP_PUSH;
+	state.blend = BLEND_MODE_NONE;
+	state.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP;
+	state.vertex_layout = VERTEX_LAYOUT_NONE;
+	struct PipelineKey key = make_pipeline_key(stack->program, &state);
+	VkPipeline pipeline = get_pipeline(stack->registry, &key);
+
+	// so does one whose pipeline could not be made
+	if (pipeline == VK_NULL_HANDLE) {
+		stack->stats.rect_clips++;
+		return true;
+	}
+
+	set_clip_state(command_buffer, stack, entry->scissor, entry->reference);
+
+	vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+	vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, stack->layout, 0, 1, &stack->set, 0, NULL);
+	vkCmdPushConstants(command_buffer, stack->layout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(struct ClipParams), params);
+	vkCmdDraw(command_buffer, 4, 1, 0, 0);
+
+	memcpy(entry->bounds, params->rect, sizeof(entry->bounds));
+	entry->reference++;
+	entry->stenciled = true;
+	stack->stats.stencil_clips++;
+
+	return true;
+}
+
+bool push_clip_rounded_rect(VkCommandBuffer command_buffer, struct ClipStack *stack, const float rect[4], float radius)
+{
+	if (radius <= 0.0f) return push_clip_rect(stack, rect);
+
+	struct ClipParams params = {
+		.view = {stack->view[0], stack->view[1], stack->view[2], stack->view[3]},
+		.rect = {rect[0], rect[1], rect[2], rect[3]},
+		.radius = radius,
+		.kind = CLIP_KIND_ROUNDED_RECT,
+		.first_point = 0,
+		.point_count = 0,
+	};
+
+	return push_stencil_clip(command_buffer, stack, &params);
+}
+
+bool push_clip_path(VkCommandBuffer command_buffer, struct ClipStack *stack, const float *points, uint32_t point_count)
+{
+	float x0 = INFINITY, y0 = INFINITY, x1 = -INFINITY, y1 = -INFINITY;
+
+	for (uint32_t i = 0; i < point_count; i++)
+	{
+		x0 = fminf(x0, points[2 * i]);
+		y0 = fminf(y0, points[2 * i + 1]);
+		x1 = fmaxf(x1, points[2 * i]);
+		y1 = fmaxf(y1, points[2 * i + 1]);
+	}
+
+	float bounds[4] = {x0, y0, point_count > 0 ? x1 - x0 : 0.0f, point_count > 0 ? y1 - y0 : 0.0f};
+
+	// a path that does not fit this frame's points is clipped to its bounds
+	if (point_count < 3 || stack->point_count + point_count > CLIP_MAX_POINTS) {
+		if (point_count >= 3) printf("failed to push clip path, out of points\n");
+		return push_clip_rect(stack, bounds);
+	}
+
+	uint32_t first = stack->point_base + stack->point_count;
+	memcpy((float *) stack->point_buffer.mapped + 2 * first, points, point_count * 2 * sizeof(float));
+	stack->point_count += point_count;
+
+	struct ClipParams params = {
+		.view = {stack->view[0], stack->view[1], stack->view[2], stack->view[3]},
+		.rect = {bounds[0], bounds[1], bounds[2], bounds[3]},
+		.radius = 0.0f,
+		.kind = CLIP_KIND_PATH,
+		.first_point = first,
+		.point_count = point_count,
+	};
+
+	return push_stencil_clip(command_buffer, stack, &params);
+}
+
+void pop_clip(VkCommandBuffer command_buffer, struct ClipStack *stack)
+{
+	if (stack->overflow > 0) {
+		stack->overflow--;
+		return;
+	}
+
+	if (stack->depth == 0) return;
+
+	const struct ClipEntry *entry = &stack->entries[stack->depth];
+	stack->depth--;
+
+	if (!entry->stenciled) return;
+
+	// everything the push raised is inside its bounds and scissor, lower it back to the parent's depth
+	struct PipelineState state = stack->target;
+	state.stencil = STENCIL_MODE_CLIP_POP;
+	state.blend = BLEND_MODE_NONE;
+	state.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP;
+	state.vertex_layout = VERTEX_LAYOUT_NONE;
+	struct PipelineKey key = make_pipeline_key(stack->program, &state);
+
+	struct ClipParams params = {
+		.view = {stack->view[0], stack->view[1], stack->view[2], stack->view[3]},
+		.rect = {entry->bounds[0], entry->bounds[1], entry->bounds[2], entry->bounds[3]},
+		.radius = 0.0f,
+		.kind = CLIP_KIND_RECT,
+		.first_point = 0,
+		.point_count = 0,
+	};
+
+	VkPipeline pipeline = get_pipeline(stack->registry, &key);
+	if (pipeline == VK_NULL_HANDLE) return;
+
+	set_clip_state(command_buffer, stack, entry->scissor, stack->entries[stack->depth].reference);
+
+	vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+	vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, stack->layout, 0, 1, &stack->set, 0, NULL);
+	vkCmdPushConstants(command_buffer, stack->layout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(struct ClipParams), &params);
+	vkCmdDraw(command_buffer, 4, 1, 0, 0);
+}
+
+void pop_clips_to(VkCommandBuffer command_buffer, struct ClipStack *stack, uint32_t depth)
+{
+	while (clip_depth(stack) > depth)
+	{
+		pop_clip(command_buffer, stack);
+	}
+}
+
+uint32_t clip_depth(const struct ClipStack *stack)
+{
+	return stack->depth + stack->overflow;
+}
+
+void apply_clip(VkCommandBuffer command_buffer, struct ClipStack *stack)
+{
+	const struct ClipEntry *entry = &stack->entries[stack->depth];
+
+	set_clip_state(command_buffer, stack, entry->scissor, entry->reference);
+}
+
+void print_clip_stats(const struct ClipStack *stack)
+{
+	const struct ClipStats *stats = &stack->stats;
+
+	printf("clip: %u rect clips, %u stencil clips, %u empty, %u scissor and %u reference changes, %u deep at most\n", stats->rect_clips, stats->stencil_clips, stats->empty_clips, stats->scissor_sets, stats->reference_sets, stats->max_depth);
+}
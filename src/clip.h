@@ -0,0 +1,113 @@
+#pragma once
+
+#include "render.h"
+#include "pipeline.h"
+
+// Nested clips for one render pass. Axis aligned rects only intersect the
+// dynamic scissor, so they cost nothing beyond a vkCmdSetScissor. Rounded
+// rects and paths go through the stencil, which holds how many of them a
+// pixel is inside: entering one draws its shape where the stencil equals
+// the current depth and increments it, leaving one draws its bounds and
+// lowers everything above the parent depth back down. The stencil is only
+// cleared by the render pass load, never in between, and pipelines drawn
+// under clips test for equality with the depth as the stencil reference.
+//
+// Scissor and reference are set lazily by apply_clip and only when they
+// differ from what the command buffer already has, so clips that change
+// nothing cost nothing. Without a stencil format the stack still works but
+// rounded rects and paths clip to their bounds.
+
+#define CLIP_MAX_DEPTH 32
+#define CLIP_MAX_POINTS 4096 // path points per frame
+#define CLIP_MAX_STENCIL 255 // stencil clips nested at once, an 8 bit stencil
+
+enum ClipKind {
+	CLIP_KIND_RECT,
+	CLIP_KIND_ROUNDED_RECT,
+	CLIP_KIND_PATH,
+	CLIP_KIND_COUNT,
+};
+
+struct ClipEntry {
+	VkRect2D scissor;   // in effect inside this clip
+	uint32_t reference; // stencil depth inside this clip
+	float bounds[4];    // of the stencil shape, redrawn to leave it
+	bool stenciled;
+};
+
+struct ClipStats {
+	uint32_t rect_clips;    // last recorded pass
+	uint32_t stencil_clips; // last recorded pass
+	uint32_t empty_clips;   // last recorded pass, nothing left visible
+	uint32_t scissor_sets;  // last recorded pass
+	uint32_t reference_sets;
+	uint32_t max_depth;
+};
+
+// push constants of clip.vert and clip.frag
+struct ClipParams {
+	float view[4];   // x0, y0, 2 / width, 2 / height
+	float rect[4];   // x, y, width, height of the shape
+	float radius;    // rounded rects
+	uint32_t kind;   // enum ClipKind
+	uint32_t first_point;
+	uint32_t point_count;
+};
+
+struct ClipStack {
+	VkDevice device;
+	uint32_t frames_in_flight;
+
+	struct PipelineRegistry *registry;
+	uint32_t program;
+
+	// path points, a slice of CLIP_MAX_POINTS per frame in flight
+	struct Buffer point_buffer;
+	uint32_t point_base;
+	uint32_t point_count;
+
+	VkDescriptorSetLayout set_layout;
+	VkDescriptorPool descriptor_pool;
+	VkDescriptorSet set;
+	VkPipelineLayout layout;
+
+	// the pass being recorded
+	struct PipelineState target; // stencil mode ignored
+	VkExtent2D extent;
+	float view[4];
+	struct ClipEntry entries[CLIP_MAX_DEPTH + 1]; // [0] is the whole target
+	uint32_t depth;
+	uint32_t overflow; // pushes past CLIP_MAX_DEPTH, popped before anything else
+
+	// dynamic state the command buffer has, what apply_clip compares against
+	VkRect2D bound_scissor;
+	uint32_t bound_reference;
+
+	struct ClipStats stats;
+};
+
+// registers the clip shaders with registry, which has to outlive the stack
+struct ClipStack *create_clip_stack(VkPhysicalDevice physical_device, VkDevice device, struct PipelineRegistry *registry, uint32_t frames_in_flight);
+void destroy_clip_stack(struct ClipStack *stack);
+
+// right after the render pass begins, with the stencil cleared to 0; target describes the pass's
+// attachments and view maps clip coordinates to it, x0, y0, 2 / width, 2 / height.
+// Sets the whole target as scissor and 0 as reference
+void begin_clip_pass(VkCommandBuffer command_buffer, struct ClipStack *stack, uint64_t frame_index, const struct PipelineState *target, VkExtent2D extent, const float view[4]);
+
+// rects are x, y, width, height in view space; every push returns false when nothing is left
+// visible, it still has to be popped; a rect only cuts the scissor, which apply_clip sets later
+bool push_clip_rect(struct ClipStack *stack, const float rect[4]);
+bool push_clip_rounded_rect(VkCommandBuffer command_buffer, struct ClipStack *stack, const float rect[4], float radius);
+
+// a closed polygon, filled with the nonzero rule; points are x, y pairs
+bool push_clip_path(VkCommandBuffer command_buffer, struct ClipStack *stack, const float *points, uint32_t point_count);
+
+void pop_clip(VkCommandBuffer command_buffer, struct ClipStack *stack);
+void pop_clips_to(VkCommandBuffer command_buffer, struct ClipStack *stack, uint32_t depth);
+uint32_t clip_depth(const struct ClipStack *stack);
+
+// sets scissor and stencil reference for the innermost clip, before drawing clipped content
+void apply_clip(VkCommandBuffer command_buffer, struct ClipStack *stack);
+
+void print_clip_stats(const struct ClipStack *stack);
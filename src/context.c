@@ -0,0 +1,368 @@
+#include <vulkan/vulkan.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "render.h"
+#include "context.h"
+#include "track.h"
+
+#define fail_context(context, result, call) fail_render(&(context)->error, (result), (call))
+
+static bool out_of_memory(VkResult result)
+{
+	return result == VK_ERROR_OUT_OF_HOST_MEMORY || result == VK_ERROR_OUT_OF_DEVICE_MEMORY;
+}
+
+enum RenderRecovery render_recovery(VkResult result)
+{
+	if (out_of_memory(result)) return RENDER_RECOVERY_MEMORY;
+	if (result == VK_ERROR_DEVICE_LOST || result == VK_ERROR_SURFACE_LOST_KHR) return RENDER_RECOVERY_DEVICE;
+
+	// suboptimal and out of date swapchains need a resize, which a fixed size window never has
+	return RENDER_RECOVERY_NONE;
+}
+
+// instance and debug messenger
+
+static VkResult create_instance_objects(struct RenderContext *context)
+{
+	struct RenderContextInfo *info = &context->info;
+
+	// glfw adds what surfaces need, headless needs nothing
+	uint32_t extension_count = 0;
+	char **extensions = NULL;
+
+	if (info->presentable) {
+		extensions = get_required_instance_extensions(info->validation_layers_enabled, &extension_count);
+	}
+	else if (info->validation_layers_enabled) {
+		extensions = malloc(sizeof(char *));
+		extensions[0] = VK_EXT_DEBUG_UTILS_EXTENSION_NAME;
+		extension_count = 1;
+	}
+
+	VkResult result = try_create_instance(info->validation_layers_enabled, info->validation_layer_count, info->validation_layers, extension_count, extensions, &context->instance);
+
+	// validation is a development aid, not worth failing over
+	if ((result == VK_ERROR_LAYER_NOT_PRESENT || result == VK_ERROR_EXTENSION_NOT_PRESENT) && info->validation_layers_enabled) {
+		printf("instance without validation layers: %s\n", get_result_string(result));
+
+		info->validation_layers_enabled = false;
+		context->fallbacks++;
+
+		// the debug utils extension is last, when it is there
+		if (extension_count > 0) extension_count--;
+		result = try_create_instance(false, 0, NULL, extension_count, extensions, &context->instance);
+	}
+
+	free(extensions);
+
+	if (result != VK_SUCCESS) return fail_context(context, result, "create instance");
+
+	context->debug_messenger = create_debug_messenger(info->validation_layers_enabled, context->instance);
+
+	return VK_SUCCESS;
+}
+
+static void destroy_instance_objects(struct RenderContext *context)
+{
+	if (context->debug_messenger != VK_NULL_HANDLE) {
+		PFN_vkDestroyDebugUtilsMessengerEXT func = (PFN_vkDestroyDebugUtilsMessengerEXT) vkGetInstanceProcAddr(context->instance, "vkDestroyDebugUtilsMessengerEXT");
+		if (func != NULL) func(context->instance, context->debug_messenger, NULL);
+	}
+
+	if (context->instance != VK_NULL_HANDLE) vkDestroyInstance(context->instance, NULL);
+
+	context->debug_messenger = VK_NULL_HANDLE;
+	context->instance = VK_NULL_HANDLE;
+}
+
+// physical devices and the logical device
+
+// windows are not known yet, glfw says which families can present on this platform at all
+static bool find_queue_families(VkInstance instance, VkPhysicalDevice physical_device, bool presentable, struct QueueFamilyIndices *indices)
+{
+	uint32_t family_count = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &family_count, NULL);
+
+	VkQueueFamilyProperties *families = malloc(family_count * sizeof(VkQueueFamilyProperties));
+	vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &family_count, families);
+
+	bool graphics_found = false;
+	bool present_found = false;
+
+	for (uint32_t i = 0; i < family_count && !(graphics_found && present_found); i++)
+	{
+		bool graphics = (families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0;
+
+		// headless there is nothing to present, the graphics queue stands in
+		bool present = presentable ? glfwGetPhysicalDevicePresentationSupport(instance, physical_device, i) == GLFW_TRUE : graphics;
+
+		// one family for both where there is one
+		if (graphics && present) {
+			indices->graphicsFamily = i;
+			indices->presentFamily = i;
+			graphics_found = present_found = true;
+			break;
+		}
+
+		if (graphics && !graphics_found) {
+			indices->graphicsFamily = i;
+			graphics_found = true;
+		}
+
+		if (present && !present_found) {
+			indices->presentFamily = i;
+			present_found = true;
+		}
+	}
+
+	free(families);
+
+	return graphics_found && present_found;
+}
+
+static bool device_extensions_supported(VkPhysicalDevice physical_device, const struct RenderContextInfo *info)
+{
+	uint32_t available_count = 0;
+	vkEnumerateDeviceExtensionProperties(physical_device, NULL, &available_count, NULL);
+
+	VkExtensionProperties *available = malloc(available_count * sizeof(VkExtensionProperties));
+	vkEnumerateDeviceExtensionProperties(physical_device, NULL, &available_count, available);
+
+	bool supported = check_extension_support(info->device_extensions, info->device_extension_count, available, available_count);
+
+	free(available);
+
+	return supported;
+}
+
+struct DeviceCandidate {
+	VkPhysicalDevice physical_device;
+	struct QueueFamilyIndices indices;
+	uint32_t rank;      // higher first
+	VkDeviceSize vram;  // breaks ties
+};
+
+// usable physical devices best first: discrete, integrated, virtual, then cpu when allowed
+static uint32_t rank_devices(const struct RenderContext *context, struct DeviceCandidate *candidates)
+{
+	uint32_t device_count = 0;
+	vkEnumeratePhysicalDevices(context->instance, &device_count, NULL);
+
+	VkPhysicalDevice *devices = malloc((device_count > 0 ? device_count : 1) * sizeof(VkPhysicalDevice));
+	vkEnumeratePhysicalDevices(context->instance, &device_count, devices);
+
+	uint32_t candidate_count = 0;
+
+	for (uint32_t i = 0; i < device_count && candidate_count < RENDER_MAX_DEVICES; i++)
+	{
+		VkPhysicalDeviceProperties properties;
+		vkGetPhysicalDeviceProperties(devices[i], &properties);
+
+		uint32_t rank = 0;
+		if (properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU) rank = 4;
+		else if (properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU) rank = 3;
+		else if (properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU) rank = 2;
+		else if (properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_CPU && context->info.cpu_fallback_enabled) rank = 1;
+
+		struct QueueFamilyIndices indices;
+		if (rank == 0 || !find_queue_families(context->instance, devices[i], context->info.presentable, &indices) || !device_extensions_supported(devices[i], &context->info)) continue;
+
+		VkPhysicalDeviceMemoryProperties memory_properties;
+		vkGetPhysicalDeviceMemoryProperties(devices[i], &memory_properties);
+
+		VkDeviceSize vram = 0;
+		for (uint32_t j = 0; j < memory_properties.memoryHeapCount; j++)
+		{
+			if (memory_properties.memoryHeaps[j].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) vram += memory_properties.memoryHeaps[j].size;
+		}
+
+		// insertion sort, there are only a handful
+		uint32_t j = candidate_count++;
+		while (j > 0 && (candidates[j - 1].rank < rank || (candidates[j - 1].rank == rank && candidates[j - 1].vram < vram)))
+		{
+			candidates[j] = candidates[j - 1];
+			j--;
+		}
+
+		candidates[j] = (struct DeviceCandidate) {
+			.physical_device = devices[i],
+			.indices = indices,
+			.rank = rank,
+			.vram = vram,
+		};
+	}
+
+	free(devices);
+
+	return candidate_count;
+}
+
+static VkResult create_device_objects(struct RenderContext *context)
+{
+	struct RenderContextInfo *info = &context->info;
+	struct DeviceCandidate candidates[RENDER_MAX_DEVICES];
+
+	uint32_t candidate_count = rank_devices(context, candidates);
+	if (candidate_count == 0) return fail_context(context, VK_ERROR_INITIALIZATION_FAILED, "find a physical device with graphics and present support");
+
+	uint32_t first = 0;
+
+	// a pinned device has no fallback, whoever pinned it runs something else on the others
+	if (info->device_pinned) {
+		if (info->device_index >= candidate_count) return fail_context(context, VK_ERROR_INITIALIZATION_FAILED, "find the pinned physical device");
+
+		first = info->device_index;
+		candidate_count = first + 1;
+	}
+
+	VkPipelineCacheCreateInfo cache_info = {
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+		.pNext = NULL,
+		.flags = 0,
+		.initialDataSize = 0,
+		.pInitialData = NULL,
+	};
+
+	VkResult result = VK_ERROR_INITIALIZATION_FAILED;
+
+	for (uint32_t i = first; i < candidate_count; i++)
+	{
+		const struct DeviceCandidate *candidate = &candidates[i];
+
+		VkPhysicalDeviceProperties properties;
+		vkGetPhysicalDeviceProperties(candidate->physical_device, &properties);
+
+		context->features = (struct DeviceFeatures) {
+			.dynamic_rendering = info->dynamic_rendering_enabled,
+		};
+
+		result = try_create_device(info->validation_layers_enabled, info->validation_layers, info->validation_layer_count, candidate->physical_device, candidate->indices, info->device_extension_count, info->device_extensions, &context->features, &context->device);
+
+		// the render pass path needs nothing beyond 1.0
+		if ((result == VK_ERROR_FEATURE_NOT_PRESENT || result == VK_ERROR_EXTENSION_NOT_PRESENT) && info->dynamic_rendering_enabled) {
+			printf("%s without dynamic rendering: %s\n", properties.deviceName, get_result_string(result));
+
+			info->dynamic_rendering_enabled = false;
+			context->fallbacks++;
+
+			context->features = (struct DeviceFeatures) {0};
+			result = try_create_device(info->validation_layers_enabled, info->validation_layers, info->validation_layer_count, candidate->physical_device, candidate->indices, info->device_extension_count, info->device_extensions, &context->features, &context->device);
+		}
+
+		if (result == VK_SUCCESS) {
+			printf("device: %s, %s\n", properties.deviceName, get_device_type_string(properties.deviceType));
+
+			context->physical_device = candidate->physical_device;
+			context->indices = candidate->indices;
+			context->graphics_queue = create_device_queue(context->device, candidate->indices.graphicsFamily, 0);
+			context->present_queue = create_device_queue(context->device, candidate->indices.presentFamily, 0);
+
+			// registries compile without one, only without sharing what they compiled
+			if (vkCreatePipelineCache(context->device, &cache_info, NULL, &context->pipeline_cache) != VK_SUCCESS) {
+				printf("failed to create the shared pipeline cache\n");
+				context->pipeline_cache = VK_NULL_HANDLE;
+			}
+
+			track_resource(RESOURCE_PIPELINE_CACHE, context->pipeline_cache, 0);
+
+			return VK_SUCCESS;
+		}
+
+		fail_context(context, result, "create logical device");
+
+		if (i + 1 < candidate_count) {
+			printf("failed to create a device on %s: %s, trying the next one\n", properties.deviceName, get_result_string(result));
+			context->fallbacks++;
+		}
+	}
+
+	return result;
+}
+
+static void destroy_device_objects(struct RenderContext *context)
+{
+	untrack_resource(RESOURCE_PIPELINE_CACHE, context->pipeline_cache);
+	if (context->pipeline_cache != VK_NULL_HANDLE) vkDestroyPipelineCache(context->device, context->pipeline_cache, NULL);
+
+	if (context->device != VK_NULL_HANDLE) vkDestroyDevice(context->device, NULL);
+
+	context->pipeline_cache = VK_NULL_HANDLE;
+	context->device = VK_NULL_HANDLE;
+	context->graphics_queue = VK_NULL_HANDLE;
+	context->present_queue = VK_NULL_HANDLE;
+	context->physical_device = VK_NULL_HANDLE;
+}
+
+VkResult create_render_context(struct RenderContext *context, const struct RenderContextInfo *info)
+{
+	*context = (struct RenderContext) {
+		.info = *info,
+	};
+
+	VkResult result = create_instance_objects(context);
+	if (result == VK_SUCCESS) result = create_device_objects(context);
+
+	if (result != VK_SUCCESS) destroy_render_context(context);
+
+	return result;
+}
+
+void destroy_render_context(struct RenderContext *context)
+{
+	destroy_device_objects(context);
+	destroy_instance_objects(context);
+}
+
+VkResult recover_render_context(struct RenderContext *context, VkResult cause)
+{
+	context->device_losses++;
+	context->lost_in_a_row++;
+	context->error = (struct RenderError) {0};
+
+	if (context->lost_in_a_row > RENDER_MAX_RECOVERIES) {
+		return fail_context(context, cause, "recover, the device was lost too many times in a row");
+	}
+
+	printf("recovering from %s, %u in a row\n", get_result_string(cause), context->lost_in_a_row);
+
+	// on a lost device this returns right away, anything still running is gone
+	if (context->device != VK_NULL_HANDLE) vkDeviceWaitIdle(context->device);
+
+	destroy_device_objects(context);
+
+	VkResult result = create_device_objects(context);
+
+	// a driver reset can take the physical devices with it, they are only found again on a new
+	// instance; the caller's surfaces are made again after this either way
+	if (result == VK_ERROR_DEVICE_LOST || result == VK_ERROR_INITIALIZATION_FAILED) {
+		destroy_device_objects(context);
+		destroy_instance_objects(context);
+
+		context->error = (struct RenderError) {0};
+
+		result = create_instance_objects(context);
+		if (result == VK_SUCCESS) result = create_device_objects(context);
+	}
+
+	if (result != VK_SUCCESS) destroy_device_objects(context);
+
+	return result;
+}
+
+uint32_t render_device_count(const struct RenderContext *context)
+{
+	struct DeviceCandidate candidates[RENDER_MAX_DEVICES];
+
+	return rank_devices(context, candidates);
+}
+
+void render_frame_finished(struct RenderContext *context)
+{
+	context->lost_in_a_row = 0;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "render.h"
+
+// Instance and device behind VkResult returns, shared by every window the
+// process draws to (see surface.h for the windows' swapchains). Where the
+// create_* helpers print, hand back VK_NULL_HANDLE and leave the caller to
+// check a watched error, the context stops at the first failure, records what
+// failed and where, and tears down what it made. Failures with a cheaper way out take it instead:
+//
+//   missing validation layers    the instance is made again without them
+//   device creation fails        the next physical device is tried, down to a
+//                                cpu implementation when cpu_fallback_enabled,
+//                                unless the device is pinned
+//   a missing device feature     the device is made again without dynamic
+//                                rendering
+//
+// A lost device is recovered with recover_render_context, after the caller
+// has destroyed everything it made on the device, surfaces included. The
+// device is made again, the instance too when the device cannot be made on
+// the old one; surfaces are made again by the caller afterwards.
+
+#define RENDER_MAX_DEVICES 8
+#define RENDER_MAX_RECOVERIES 3 // device losses in a row, without a frame finishing in between
+
+// what the caller does about a result from a frame's vulkan calls
+enum RenderRecovery {
+	RENDER_RECOVERY_NONE,   // carry on
+	RENDER_RECOVERY_MEMORY, // out of memory, make the device objects again with less
+	RENDER_RECOVERY_DEVICE, // device or surface lost, destroy the device objects and recover_render_context
+};
+
+struct RenderContextInfo {
+	bool presentable;          // windows are drawn to, glfw's instance extensions and a queue that presents
+	bool validation_layers_enabled;
+	bool dynamic_rendering_enabled;
+	bool cpu_fallback_enabled; // software implementations are last, and only used with this
+	bool device_pinned;        // only the usable device at device_index is tried, best first
+	uint32_t device_index;
+	uint32_t validation_layer_count;
+	const char **validation_layers;
+	uint32_t device_extension_count;
+	const char **device_extensions;
+};
+
+struct RenderContext {
+	struct RenderContextInfo info; // validation and dynamic rendering are cleared when they had to go
+
+	VkInstance instance;
+	VkDebugUtilsMessengerEXT debug_messenger;
+
+	VkPhysicalDevice physical_device;
+	struct QueueFamilyIndices indices;
+	VkDevice device;
+	struct DeviceFeatures features;
+	VkQueue graphics_queue;
+	VkQueue present_queue;          // the graphics queue when headless
+	VkPipelineCache pipeline_cache; // for every pipeline registry on the device
+
+	struct RenderError error; // the first failure, from creation or the last recovery
+	uint32_t fallbacks;       // cheaper ways out taken
+	uint32_t device_losses;   // since creation
+	uint32_t lost_in_a_row;   // cleared by render_frame_finished
+};
+
+// on failure nothing is left to destroy and context->error says what failed
+VkResult create_render_context(struct RenderContext *context, const struct RenderContextInfo *info);
+void destroy_render_context(struct RenderContext *context);
+
+// cause is the result that lost the device; gives up after RENDER_MAX_RECOVERIES losses in a row
+VkResult recover_render_context(struct RenderContext *context, VkResult cause);
+
+// usable physical devices on the context's instance, what device_index counts through
+uint32_t render_device_count(const struct RenderContext *context);
+
+// a frame made it through, the device is healthy again
+void render_frame_finished(struct RenderContext *context);
+
+enum RenderRecovery render_recovery(VkResult result);
@@ -0,0 +1,282 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+#include <setjmp.h>
+
+#ifdef VG_HAVE_PNG
+#include <png.h>
+#endif
+
+#ifdef VG_HAVE_JPEG
+#include <jpeglib.h>
+#endif
+
+#include "decode.h"
+
+#define DECODE_MAX_DIMENSION 16384
+
+// ppm, binary P6 with a maxval of 255
+
+static bool ppm_token(const uint8_t *data, size_t size, size_t *offset, uint32_t *value)
+{
+	size_t i = *offset;
+
+	// whitespace and comments
+	while (i < size && (data[i] == ' ' || data[i] == '\t' || data[i] == '\r' || data[i] == '\n' || data[i] == '#'))
+	{
+		if (data[i] == '#') {
+			while (i < size && data[i] != '\n') i++;
+		}
+		else {
+			i++;
+		}
+	}
+
+	if (i >= size || data[i] < '0' || data[i] > '9') return false;
+
+	uint64_t number = 0;
+
+	while (i < size && data[i] >= '0' && data[i] <= '9' && number <= UINT32_MAX)
+	{
+		number = number * 10 + (data[i++] - '0');
+	}
+
+	if (number > UINT32_MAX) return false;
+
+	*value = (uint32_t) number;
+	*offset = i;
+
+	return true;
+}
+
+static bool ppm_header(const uint8_t *data, size_t size, uint32_t *width, uint32_t *height, size_t *pixel_offset)
+{
+	size_t offset = 2;
+	uint32_t max_value;
+
+	if (!ppm_token(data, size, &offset, width)) return false;
+	if (!ppm_token(data, size, &offset, height)) return false;
+	if (!ppm_token(data, size, &offset, &max_value) || max_value != 255) return false;
+
+	// exactly one whitespace byte before the pixels
+	*pixel_offset = offset + 1;
+
+	return *pixel_offset + (size_t) *width * *height * 3 <= size;
+}
+
+static bool decode_ppm(const uint8_t *data, size_t size, const struct ImageInfo *info, uint8_t *pixels)
+{
+	uint32_t width, height;
+	size_t offset;
+
+	if (!ppm_header(data, size, &width, &height, &offset)) return false;
+
+	// pixels was sized from info
+	if (width != info->width || height != info->height) return false;
+
+	const uint8_t *rgb = data + offset;
+	size_t count = (size_t) width * height;
+
+	for (size_t i = 0; i < count; i++)
+	{
+		pixels[4 * i + 0] = rgb[3 * i + 0];
+		pixels[4 * i + 1] = rgb[3 * i + 1];
+		pixels[4 * i + 2] = rgb[3 * i + 2];
+		pixels[4 * i + 3] = 255;
+	}
+
+	return true;
+}
+
+// png, through libpng's simplified api
+
+#ifdef VG_HAVE_PNG
+static bool read_png_info(const uint8_t *data, size_t size, uint32_t *width, uint32_t *height)
+{
+	png_image image;
+	memset(&image, 0, sizeof(image));
+	image.version = PNG_IMAGE_VERSION;
+
+	if (!png_image_begin_read_from_memory(&image, data, size)) return false;
+
+	*width = image.width;
+	*height = image.height;
+	png_image_free(&image);
+
+	return true;
+}
+
+static bool decode_png(const uint8_t *data, size_t size, const struct ImageInfo *info, uint8_t *pixels)
+{
+	png_image image;
+	memset(&image, 0, sizeof(image));
+	image.version = PNG_IMAGE_VERSION;
+
+	if (!png_image_begin_read_from_memory(&image, data, size)) return false;
+
+	if (image.width != info->width || image.height != info->height) {
+		png_image_free(&image);
+		return false;
+	}
+
+	image.format = PNG_FORMAT_RGBA;
+
+	// finish_read frees the image on success and failure
+	return png_image_finish_read(&image, NULL, pixels, 0, NULL) != 0;
+}
+#endif
+
+// jpeg, errors longjmp back instead of exiting
+
+#ifdef VG_HAVE_JPEG
+struct JpegError {
+	struct jpeg_error_mgr manager;
+	jmp_buf jump;
+};
+
+static void jpeg_error_exit(j_common_ptr info)
+{
+	struct JpegError *error = (struct JpegError *) info->err;
+	longjmp(error->jump, 1);
+}
+
+static bool read_jpeg_info(const uint8_t *data, size_t size, uint32_t *width, uint32_t *height)
+{
+	struct jpeg_decompress_struct jpeg;
+	struct JpegError error;
+
+	jpeg.err = jpeg_std_error(&error.manager);
+	error.manager.error_exit = jpeg_error_exit;
+
+	if (setjmp(error.jump)) {
+		jpeg_destroy_decompress(&jpeg);
+		return false;
+	}
+
+	jpeg_create_decompress(&jpeg);
+	jpeg_mem_src(&jpeg, (unsigned char *) data, (unsigned long) size);
+	jpeg_read_header(&jpeg, TRUE);
+
+	*width = jpeg.image_width;
+	*height = jpeg.image_height;
+	jpeg_destroy_decompress(&jpeg);
+
+	return true;
+}
+
+static bool decode_jpeg(const uint8_t *data, size_t size, const struct ImageInfo *info, uint8_t *pixels)
+{
+	struct jpeg_decompress_struct jpeg;
+	struct JpegError error;
+	uint8_t *volatile row = NULL;
+
+	jpeg.err = jpeg_std_error(&error.manager);
+	error.manager.error_exit = jpeg_error_exit;
+
+	if (setjmp(error.jump)) {
+		jpeg_destroy_decompress(&jpeg);
+		free(row);
+		return false;
+	}
+
+	jpeg_create_decompress(&jpeg);
+	jpeg_mem_src(&jpeg, (unsigned char *) data, (unsigned long) size);
+	jpeg_read_header(&jpeg, TRUE);
+
+	if (jpeg.image_width != info->width || jpeg.image_height != info->height) {
+		jpeg_destroy_decompress(&jpeg);
+		return false;
+	}
+
+#ifdef JCS_EXTENSIONS
+	// libjpeg-turbo writes rgba rows directly
+	jpeg.out_color_space = JCS_EXT_RGBA;
+#else
+	jpeg.out_color_space = JCS_RGB;
+	row = malloc((size_t) info->width * 3);
+#endif
+
+	jpeg_start_decompress(&jpeg);
+
+	while (jpeg.output_scanline < jpeg.output_height)
+	{
+		uint8_t *dst = pixels + (size_t) jpeg.output_scanline * info->width * 4;
+
+		if (row == NULL) {
+			JSAMPROW rows[1] = {dst};
+			jpeg_read_scanlines(&jpeg, rows, 1);
+			continue;
+		}
+
+		JSAMPROW rows[1] = {row};
+		jpeg_read_scanlines(&jpeg, rows, 1);
+
+		for (uint32_t x = 0; x < info->width; x++)
+		{
+			dst[4 * x + 0] = row[3 * x + 0];
+			dst[4 * x + 1] = row[3 * x + 1];
+			dst[4 * x + 2] = row[3 * x + 2];
+			dst[4 * x + 3] = 255;
+		}
+	}
+
+	jpeg_finish_decompress(&jpeg);
+	jpeg_destroy_decompress(&jpeg);
+	free(row);
+
+	return true;
+}
+#endif
+
+bool decode_image_info(const uint8_t *data, size_t size, struct ImageInfo *info)
+{
+	*info = (struct ImageInfo) {0};
+
+	if (size >= 2 && data[0] == 'P' && data[1] == '6') {
+		size_t offset;
+		info->format = IMAGE_FILE_PPM;
+		if (!ppm_header(data, size, &info->width, &info->height, &offset)) return false;
+	}
+	else if (size >= 8 && memcmp(data, "\x89PNG\r\n\x1a\n", 8) == 0) {
+		info->format = IMAGE_FILE_PNG;
+#ifdef VG_HAVE_PNG
+		if (!read_png_info(data, size, &info->width, &info->height)) return false;
+#else
+		return false;
+#endif
+	}
+	else if (size >= 3 && data[0] == 0xff && data[1] == 0xd8 && data[2] == 0xff) {
+		info->format = IMAGE_FILE_JPEG;
+#ifdef VG_HAVE_JPEG
+		if (!read_jpeg_info(data, size, &info->width, &info->height)) return false;
+#else
+		return false;
+#endif
+	}
+	else {
+		return false;
+	}
+
+	return info->width > 0 && info->height > 0 && info->width <= DECODE_MAX_DIMENSION && info->height <= DECODE_MAX_DIMENSION;
+}
+
+bool decode_image(const uint8_t *data, size_t size, const struct ImageInfo *info, uint8_t *pixels)
+{
+	switch (info->format)
+	{
+		case IMAGE_FILE_PPM:
+			return decode_ppm(data, size, info, pixels);
+#ifdef VG_HAVE_PNG
+		case IMAGE_FILE_PNG:
+			return decode_png(data, size, info, pixels);
+#endif
+#ifdef VG_HAVE_JPEG
+		case IMAGE_FILE_JPEG:
+			return decode_jpeg(data, size, info, pixels);
+#endif
+		default:
+			return false;
+	}
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Image decoders working on files already in memory. Every decoder writes
+// tightly packed RGBA8 rows straight into the caller's pixels, which is
+// usually mapped staging memory. Binary PPM is always available, PNG and
+// JPEG when the build found libpng and libjpeg (VG_HAVE_PNG, VG_HAVE_JPEG).
+
+enum ImageFileFormat {
+	IMAGE_FILE_UNKNOWN,
+	IMAGE_FILE_PPM,
+	IMAGE_FILE_PNG,
+	IMAGE_FILE_JPEG,
+};
+
+struct ImageInfo {
+	enum ImageFileFormat format;
+	uint32_t width;
+	uint32_t height;
+};
+
+// reads the header only, false for unsupported or malformed files
+bool decode_image_info(const uint8_t *data, size_t size, struct ImageInfo *info);
+
+// pixels has room for width * height * 4 bytes
+bool decode_image(const uint8_t *data, size_t size, const struct ImageInfo *info, uint8_t *pixels);
@@ -0,0 +1,328 @@
+#include <vulkan/vulkan.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "render.h"
+#include "drawlist.h"
+
+#define DRAW_LIST_MAX_STATE_ID 0xfff
+
+struct DrawList create_draw_list(uint32_t capacity)
+{
+	struct DrawList list = {0};
+
+	if (capacity > DRAW_LIST_MAX_DRAWS) {
+		printf("draw list capacity %u is too large, using %u\n", capacity, DRAW_LIST_MAX_DRAWS);
+		capacity = DRAW_LIST_MAX_DRAWS;
+	}
+
+	list.commands = malloc(capacity * sizeof(struct DrawCommand));
+	list.keys = malloc(capacity * sizeof(uint64_t));
+	list.order = malloc(capacity * sizeof(uint32_t));
+	list.scratch_keys = malloc(capacity * sizeof(uint64_t));
+	list.scratch_order = malloc(capacity * sizeof(uint32_t));
+	list.capacity = capacity;
+
+	reset_draw_list(&list);
+
+	return list;
+}
+
+void destroy_draw_list(struct DrawList *list)
+{
+	free(list->commands);
+	free(list->keys);
+	free(list->order);
+	free(list->scratch_keys);
+	free(list->scratch_order);
+
+	*list = (struct DrawList) {0};
+}
+
+void reset_draw_list(struct DrawList *list)
+{
+	list->count = 0;
+
+	memset(list->segments, 0, sizeof(list->segments));
+	memset(list->last_blended, 0, sizeof(list->last_blended));
+	memset(list->state_handles, 0, sizeof(list->state_handles));
+	list->state_count = 0;
+}
+
+// small id for a pipeline or descriptor set, so draws sharing state sort next to each other
+static uint64_t intern_state(struct DrawList *list, uint64_t handle)
+{
+	if (handle == 0) return 0;
+
+	uint32_t mask = DRAW_LIST_STATE_SLOTS - 1;
+	uint32_t slot = (uint32_t) ((handle * 0x9e3779b97f4a7c15ull) >> 40) & mask;
+
+	for (uint32_t probe = 0; probe < DRAW_LIST_STATE_SLOTS; probe++, slot = (slot + 1) & mask)
+	{
+		if (list->state_handles[slot] == handle) return list->state_ids[slot];
+
+		if (list->state_handles[slot] == 0) {
+			if (list->state_count >= DRAW_LIST_MAX_STATE_ID) return DRAW_LIST_MAX_STATE_ID;
+
+			list->state_handles[slot] = handle;
+			list->state_ids[slot] = (uint16_t) ++list->state_count;
+
+			return list->state_ids[slot];
+		}
+	}
+
+	return DRAW_LIST_MAX_STATE_ID;
+}
+
+bool push_draw(struct DrawList *list, const struct DrawCommand *command)
+{
+	if (command->pipeline == VK_NULL_HANDLE) return false;
+
+	if (list->count == list->capacity) {
+		printf("failed to push draw, draw list is full\n");
+		return false;
+	}
+
+	uint32_t layer = command->layer;
+
+	// a blended draw gets a segment of its own, the first opaque draw after it opens the next one;
+	// the capacity keeps the counter from wrapping
+	if (command->blended || list->last_blended[layer]) list->segments[layer]++;
+	list->last_blended[layer] = command->blended;
+
+	uint64_t pipeline = intern_state(list, (uint64_t) (uintptr_t) command->pipeline);
+	uint64_t texture = intern_state(list, (uint64_t) (uintptr_t) command->set);
+
+	uint64_t key = (uint64_t) layer << 56 |
+		(uint64_t) list->segments[layer] << 40 |
+		pipeline << 28 |
+		texture << 16 |
+		command->depth;
+
+	list->commands[list->count] = *command;
+	list->keys[list->count] = key;
+	list->order[list->count] = list->count;
+	list->count++;
+
+	return true;
+}
+
+// lsd radix sort of keys with their draw indices, a byte per pass; stable, so equal keys
+// stay in submission order
+static void sort_draw_list(struct DrawList *list)
+{
+	uint64_t *keys = list->keys;
+	uint32_t *order = list->order;
+	uint64_t *scratch_keys = list->scratch_keys;
+	uint32_t *scratch_order = list->scratch_order;
+
+	for (uint32_t shift = 0; shift < 64; shift += 8)
+	{
+		uint32_t counts[256] = {0};
+
+		for (uint32_t i = 0; i < list->count; i++)
+		{
+			counts[(keys[i] >> shift) & 0xff]++;
+		}
+
+		// every key has the same byte here, nothing moves
+		if (counts[(keys[0] >> shift) & 0xff] == list->count) continue;
+
+		uint32_t offset = 0;
+
+		for (uint32_t digit = 0; digit < 256; digit++)
+		{
+			uint32_t count = counts[digit];
+			counts[digit] = offset;
+			offset += count;
+		}
+
+		for (uint32_t i = 0; i < list->count; i++)
+		{
+			uint32_t dst = counts[(keys[i] >> shift) & 0xff]++;
+
+			scratch_keys[dst] = keys[i];
+			scratch_order[dst] = order[i];
+		}
+
+		uint64_t *swap_keys = keys;
+		keys = scratch_keys;
+		scratch_keys = swap_keys;
+
+		uint32_t *swap_order = order;
+		order = scratch_order;
+		scratch_order = swap_order;
+	}
+
+	list->keys = keys;
+	list->order = order;
+	list->scratch_keys = scratch_keys;
+	list->scratch_order = scratch_order;
+}
+
+static bool same_state(const struct DrawCommand *a, const struct DrawCommand *b)
+{
+	return a->pipeline == b->pipeline &&
+		a->layout == b->layout &&
+		a->set == b->set &&
+		a->dynamic_offset_count == b->dynamic_offset_count &&
+		(a->dynamic_offset_count == 0 || a->dynamic_offset == b->dynamic_offset) &&
+		a->vertex_buffer == b->vertex_buffer &&
+		a->vertex_offset == b->vertex_offset &&
+		a->index_buffer == b->index_buffer &&
+		(a->index_buffer == VK_NULL_HANDLE || (a->index_offset == b->index_offset && a->index_type == b->index_type && a->base_vertex == b->base_vertex)) &&
+		a->push_stages == b->push_stages &&
+		a->push_size == b->push_size &&
+		memcmp(a->push, b->push, a->push_size) == 0;
+}
+
+// folds next into draw when it continues draw's instance, vertex or index range
+static bool merge_draw(struct DrawCommand *draw, const struct DrawCommand *next)
+{
+	if (!same_state(draw, next)) return false;
+
+	bool indexed = draw->index_buffer != VK_NULL_HANDLE;
+
+	uint32_t *count = indexed ? &draw->index_count : &draw->vertex_count;
+	uint32_t first = indexed ? draw->first_index : draw->first_vertex;
+	uint32_t next_count = indexed ? next->index_count : next->vertex_count;
+	uint32_t next_first = indexed ? next->first_index : next->first_vertex;
+
+	if (first == next_first && *count == next_count &&
+		draw->first_instance + draw->instance_count == next->first_instance) {
+		draw->instance_count += next->instance_count;
+		return true;
+	}
+
+	if (draw->vertex_mergeable && next->vertex_mergeable &&
+		draw->first_instance == next->first_instance && draw->instance_count == next->instance_count &&
+		first + *count == next_first) {
+		*count += next_count;
+		return true;
+	}
+
+	return false;
+}
+
+void record_draw_list(VkCommandBuffer command_buffer, struct DrawList *list)
+{
+	struct DrawListStats stats = {
+		.draws_submitted = list->count,
+	};
+
+	if (list->count > 0) sort_draw_list(list);
+
+	VkPipeline bound_pipeline = VK_NULL_HANDLE;
+	VkPipelineLayout bound_layout = VK_NULL_HANDLE;
+	VkDescriptorSet bound_set = VK_NULL_HANDLE;
+	uint32_t bound_offset = 0;
+	VkBuffer bound_vertex_buffer = VK_NULL_HANDLE;
+	VkDeviceSize bound_vertex_offset = 0;
+	VkBuffer bound_index_buffer = VK_NULL_HANDLE;
+	VkDeviceSize bound_index_offset = 0;
+	VkIndexType bound_index_type = VK_INDEX_TYPE_UINT32;
+	const struct DrawCommand *pushed = NULL;
+
+	uint32_t i = 0;
+
+	while (i < list->count)
+	{
+		struct DrawCommand draw = list->commands[list->order[i++]];
+
+		while (i < list->count && merge_draw(&draw, &list->commands[list->order[i]]))
+		{
+			stats.draws_merged++;
+			i++;
+		}
+
+		if (draw.pipeline != bound_pipeline) {
+			vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, draw.pipeline);
+			bound_pipeline = draw.pipeline;
+			stats.pipeline_binds++;
+		}
+		else {
+			stats.binds_skipped++;
+		}
+
+		// sets stay bound across pipelines with the same layout
+		if (draw.set != VK_NULL_HANDLE) {
+			bool offset_changed = draw.dynamic_offset_count > 0 && draw.dynamic_offset != bound_offset;
+
+			if (draw.set != bound_set || draw.layout != bound_layout || offset_changed) {
+				vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, draw.layout, 0, 1, &draw.set, draw.dynamic_offset_count, &draw.dynamic_offset);
+				bound_set = draw.set;
+				bound_layout = draw.layout;
+				bound_offset = draw.dynamic_offset;
+				stats.descriptor_binds++;
+			}
+			else {
+				stats.binds_skipped++;
+			}
+		}
+
+		if (draw.vertex_buffer != VK_NULL_HANDLE) {
+			if (draw.vertex_buffer != bound_vertex_buffer || draw.vertex_offset != bound_vertex_offset) {
+				vkCmdBindVertexBuffers(command_buffer, 0, 1, &draw.vertex_buffer, &draw.vertex_offset);
+				bound_vertex_buffer = draw.vertex_buffer;
+				bound_vertex_offset = draw.vertex_offset;
+				stats.vertex_binds++;
+			}
+			else {
+				stats.binds_skipped++;
+			}
+		}
+
+		if (draw.index_buffer != VK_NULL_HANDLE) {
+			if (draw.index_buffer != bound_index_buffer || draw.index_offset != bound_index_offset || draw.index_type != bound_index_type) {
+				vkCmdBindIndexBuffer(command_buffer, draw.index_buffer, draw.index_offset, draw.index_type);
+				bound_index_buffer = draw.index_buffer;
+				bound_index_offset = draw.index_offset;
+				bound_index_type = draw.index_type;
+				stats.index_binds++;
+			}
+			else {
+				stats.binds_skipped++;
+			}
+		}
+
+		if (draw.push_size > 0) {
+			bool push_changed = pushed == NULL ||
+				pushed->layout != draw.layout ||
+				pushed->push_stages != draw.push_stages ||
+				pushed->push_size != draw.push_size ||
+				memcmp(pushed->push, draw.push, draw.push_size) != 0;
+
+			if (push_changed) {
+				vkCmdPushConstants(command_buffer, draw.layout, draw.push_stages, 0, draw.push_size, draw.push);
+				pushed = &list->commands[list->order[i - 1]];
+				stats.push_constants++;
+			}
+			else {
+				stats.binds_skipped++;
+			}
+		}
+
+		if (draw.index_buffer != VK_NULL_HANDLE) {
+			vkCmdDrawIndexed(command_buffer, draw.index_count, draw.instance_count, draw.first_index, draw.base_vertex, draw.first_instance);
+		}
+		else {
+			vkCmdDraw(command_buffer, draw.vertex_count, draw.instance_count, draw.first_vertex, draw.first_instance);
+		}
+
+		stats.draws_issued++;
+	}
+
+	list->stats = stats;
+}
+
+void print_draw_list_stats(const struct DrawList *list)
+{
+	const struct DrawListStats *stats = &list->stats;
+
+	printf("draw list: %u draws submitted, %u issued, %u merged\n", stats->draws_submitted, stats->draws_issued, stats->draws_merged);
+	printf("\tbinds: %u pipeline, %u descriptor, %u vertex, %u index, %u push constant, %u skipped\n", stats->pipeline_binds, stats->descriptor_binds, stats->vertex_binds, stats->index_binds, stats->push_constants, stats->binds_skipped);
+}
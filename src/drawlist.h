@@ -0,0 +1,105 @@
+#pragma once
+
+#include "render.h"
+
+// Draw list. Draws are collected for a frame, sorted by a 64 bit key and
+// recorded with as few state changes as possible:
+//
+//   63      56 55         40 39      28 27      16 15       0
+//   |  layer  |   segment   | pipeline | texture  |  depth   |
+//
+// Layers are drawn in order. Within a layer every blended draw starts a new
+// segment, so blended draws keep their painter's order relative to
+// everything around them; opaque draws between two blended ones share a
+// segment and are grouped by pipeline and texture. Opaque draws in the same
+// layer are assumed not to overlap, put overlapping content in its own layer.
+//
+// After sorting, adjacent draws with identical state and consecutive
+// instance (or, for list topologies, vertex or index) ranges are merged, and binds
+// that would not change anything are skipped.
+
+#define DRAW_LIST_MAX_PUSH 32
+#define DRAW_LIST_MAX_DRAWS 0xffff // a draw opens at most one segment, so up to this many never run out of them
+#define DRAW_LIST_MAX_LAYERS 256
+#define DRAW_LIST_STATE_SLOTS 4096 // power of two, distinct pipelines and sets per frame
+
+struct DrawCommand {
+	uint8_t layer;
+	bool blended;
+	uint16_t depth; // tie break within a segment, back to front
+
+	VkPipeline pipeline;
+	VkPipelineLayout layout;
+
+	VkDescriptorSet set; // bound at set 0, VK_NULL_HANDLE for none
+	uint32_t dynamic_offset_count; // 0 or 1
+	uint32_t dynamic_offset;
+
+	VkBuffer vertex_buffer; // VK_NULL_HANDLE for none
+	VkDeviceSize vertex_offset;
+
+	VkBuffer index_buffer; // VK_NULL_HANDLE for a non-indexed draw
+	VkDeviceSize index_offset;
+	VkIndexType index_type;
+
+	uint32_t vertex_count;   // non-indexed
+	uint32_t first_vertex;
+	uint32_t index_count;    // indexed
+	uint32_t first_index;
+	int32_t base_vertex;
+	uint32_t instance_count;
+	uint32_t first_instance;
+	bool vertex_mergeable; // list topology, consecutive vertex or index ranges can be joined
+
+	VkShaderStageFlags push_stages;
+	uint32_t push_size;
+	uint8_t push[DRAW_LIST_MAX_PUSH];
+};
+
+struct DrawListStats {
+	uint32_t draws_submitted;
+	uint32_t draws_issued;
+	uint32_t draws_merged;
+	uint32_t pipeline_binds;
+	uint32_t descriptor_binds;
+	uint32_t vertex_binds;
+	uint32_t index_binds;
+	uint32_t push_constants;
+	uint32_t binds_skipped;
+};
+
+struct DrawList {
+	struct DrawCommand *commands;
+	uint64_t *keys;
+	uint32_t *order;
+	uint64_t *scratch_keys;
+	uint32_t *scratch_order;
+	uint32_t count;
+	uint32_t capacity;
+
+	// per layer segment counters
+	uint16_t segments[DRAW_LIST_MAX_LAYERS];
+	bool last_blended[DRAW_LIST_MAX_LAYERS];
+
+	// pipeline and descriptor set handles interned to small ids, in order of first use
+	uint64_t state_handles[DRAW_LIST_STATE_SLOTS];
+	uint16_t state_ids[DRAW_LIST_STATE_SLOTS];
+	uint32_t state_count;
+
+	struct DrawListStats stats; // for the last recorded frame
+};
+
+// capacity is at most DRAW_LIST_MAX_DRAWS
+struct DrawList create_draw_list(uint32_t capacity);
+void destroy_draw_list(struct DrawList *list);
+
+// forgets every draw, call once per frame before pushing
+void reset_draw_list(struct DrawList *list);
+
+// returns false when the list is full or the draw has no pipeline, which drops it
+bool push_draw(struct DrawList *list, const struct DrawCommand *command);
+
+// sorts, merges and records every draw, inside a render pass
+void record_draw_list(VkCommandBuffer command_buffer, struct DrawList *list);
+
+void print_draw_list_stats(const struct DrawList *list);
@@ -0,0 +1,627 @@
+#include <vulkan/vulkan.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "render.h"
+#include "filter.h"
+#include "track.h"
+
+#define FILTER_GROUP_SIZE 8
+
+struct FilterParams {
+	float texel[2];     // 1 / source size
+	float direction[2]; // gaussian only
+	float offset;       // kawase tap distance in source half texels
+	float sigma;
+	int32_t radius;     // gaussian taps either side of the center
+	uint32_t pad;
+};
+
+struct CompositeParams {
+	float rect[4];  // x0, y0, x1, y1 in clip space
+	float color[4];
+};
+
+// keeps the first failure, like fail_render without the call site
+static void keep_failure(VkResult *first, VkResult result)
+{
+	if (*first == VK_SUCCESS) *first = result;
+}
+
+static VkDescriptorSetLayout create_filter_set_layout(VkDevice device, VkResult *failure)
+{
+	VkDescriptorSetLayoutBinding bindings[2] = {
+		{
+			.binding = 0,
+			.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+			.descriptorCount = 1,
+			.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+			.pImmutableSamplers = NULL,
+		},
+		{
+			.binding = 1,
+			.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+			.descriptorCount = 1,
+			.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+			.pImmutableSamplers = NULL,
+		},
+	};
+
+	VkDescriptorSetLayoutCreateInfo set_layout_info = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+		.pNext = NULL,
+		.flags = 0,
+		.bindingCount = 2,
+		.pBindings = bindings,
+	};
+
+	VkDescriptorSetLayout set_layout;
+	VkResult result = vkCreateDescriptorSetLayout(device, &set_layout_info, NULL, &set_layout);
+	if (result != VK_SUCCESS) printf("failed to create filter descriptor set layout\n");
+	if (result != VK_SUCCESS) set_layout = VK_NULL_HANDLE;
+	if (result != VK_SUCCESS) keep_failure(failure, result);
+	if (result == VK_SUCCESS) track_resource(RESOURCE_DESCRIPTOR_SET_LAYOUT, set_layout, 0);
+
+	return set_layout;
+}
+
+static VkPipelineLayout create_filter_pipeline_layout(VkDevice device, VkDescriptorSetLayout set_layout, VkShaderStageFlags stage, uint32_t push_size, VkResult *failure)
+{
+	VkPushConstantRange push_range = {
+		.stageFlags = stage,
+		.offset = 0,
+		.size = push_size,
+	};
+
+	VkPipelineLayoutCreateInfo pipeline_layout_info = {
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+		.pNext = NULL,
+		.flags = 0,
+		.setLayoutCount = 1,
+		.pSetLayouts = &set_layout,
+		.pushConstantRangeCount = 1,
+		.pPushConstantRanges = &push_range,
+	};
+
+	VkPipelineLayout pipeline_layout;
+	VkResult result = vkCreatePipelineLayout(device, &pipeline_layout_info, NULL, &pipeline_layout);
+	if (result != VK_SUCCESS) printf("failed to create filter pipeline layout\n");
+	if (result != VK_SUCCESS) pipeline_layout = VK_NULL_HANDLE;
+	if (result != VK_SUCCESS) keep_failure(failure, result);
+	if (result == VK_SUCCESS) track_resource(RESOURCE_PIPELINE_LAYOUT, pipeline_layout, 0);
+
+	return pipeline_layout;
+}
+
+static VkDescriptorPool create_filter_descriptor_pool(VkDevice device, VkResult *failure)
+{
+	VkDescriptorPoolSize pool_sizes[2] = {
+		{
+			.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+			.descriptorCount = FILTER_MAX_LAYERS * FILTER_SET_COUNT,
+		},
+		{
+			.type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+			.descriptorCount = FILTER_MAX_LAYERS * FILTER_SET_COUNT,
+		},
+	};
+
+	VkDescriptorPoolCreateInfo pool_info = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+		.pNext = NULL,
+		.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT,
+		.maxSets = FILTER_MAX_LAYERS * FILTER_SET_COUNT,
+		.poolSizeCount = 2,
+		.pPoolSizes = pool_sizes,
+	};
+
+	VkDescriptorPool descriptor_pool;
+	VkResult result = vkCreateDescriptorPool(device, &pool_info, NULL, &descriptor_pool);
+	if (result != VK_SUCCESS) printf("failed to create filter descriptor pool\n");
+	if (result != VK_SUCCESS) descriptor_pool = VK_NULL_HANDLE;
+	if (result != VK_SUCCESS) keep_failure(failure, result);
+	if (result == VK_SUCCESS) track_resource(RESOURCE_DESCRIPTOR_POOL, descriptor_pool, 0);
+
+	return descriptor_pool;
+}
+
+// layers are cleared on load and handed straight to the blur
+static VkRenderPass create_layer_render_pass(VkDevice device, VkResult *failure)
+{
+	VkAttachmentDescription colorAttachment = {
+		.flags = 0,
+		.format = FILTER_FORMAT,
+		.samples = VK_SAMPLE_COUNT_1_BIT,
+		.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+		.storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+		.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+		.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+		.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+		.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+	};
+
+	VkAttachmentReference colorAttachmentRef = {
+		.attachment = 0,
+		.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+	};
+
+	VkSubpassDescription subpass = {
+		.flags = 0,
+		.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
+		.inputAttachmentCount = 0,
+		.pInputAttachments = NULL,
+		.colorAttachmentCount = 1,
+		.pColorAttachments = &colorAttachmentRef,
+		.pResolveAttachments = NULL,
+		.pDepthStencilAttachment = NULL,
+		.preserveAttachmentCount = 0,
+		.pPreserveAttachments = NULL,
+	};
+
+	VkSubpassDependency dependency = {
+		.srcSubpass = 0,
+		.dstSubpass = VK_SUBPASS_EXTERNAL,
+		.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+		.dstStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+		.dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+		.dependencyFlags = 0,
+	};
+
+	VkRenderPassCreateInfo renderPassInfo = {
+		.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
+		.pNext = NULL,
+		.flags = 0,
+		.attachmentCount = 1,
+		.pAttachments = &colorAttachment,
+		.subpassCount = 1,
+		.pSubpasses = &subpass,
+		.dependencyCount = 1,
+		.pDependencies = &dependency,
+	};
+
+	VkRenderPass renderPass;
+	VkResult result = vkCreateRenderPass(device, &renderPassInfo, NULL, &renderPass);
+	if (result != VK_SUCCESS) printf("failed to create filter layer render pass\n");
+	if (result != VK_SUCCESS) renderPass = VK_NULL_HANDLE;
+	if (result != VK_SUCCESS) keep_failure(failure, result);
+	if (result == VK_SUCCESS) track_resource(RESOURCE_RENDER_PASS, renderPass, 0);
+
+	return renderPass;
+}
+
+// the pipelines are made with the try_ variants, a filter that cannot be made costs its layers, not the scene
+static VkPipeline create_filter_pipeline(VkDevice device, VkPipelineLayout layout, const char *comp_path, VkResult *failure)
+{
+	VkPipeline pipeline;
+	VkResult result = try_create_compute_pipeline(device, layout, comp_path, &pipeline);
+
+	if (result != VK_SUCCESS) {
+		printf("failed to create filter pipeline %s: %s\n", comp_path, get_result_string(result));
+		keep_failure(failure, result);
+	}
+
+	return pipeline;
+}
+
+struct FilterSystem create_filter_system(VkDevice device, const struct DeviceFeatures *features, VkExtent2D extent, VkRenderPass render_pass, VkFormat color_format, VkFormat stencil_format)
+{
+	struct FilterSystem system = {0};
+	VkResult *failure = &system.result;
+
+	system.features = features;
+
+	VkResult result = try_create_sampler(device, VK_FILTER_LINEAR, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, &system.sampler);
+	if (result != VK_SUCCESS) printf("failed to create filter sampler: %s\n", get_result_string(result));
+	if (result != VK_SUCCESS) keep_failure(failure, result);
+
+	system.set_layout = create_filter_set_layout(device, failure);
+	system.descriptor_pool = create_filter_descriptor_pool(device, failure);
+	system.layer_render_pass = features->dynamic_rendering ? VK_NULL_HANDLE : create_layer_render_pass(device, failure);
+
+	system.blur_layout = create_filter_pipeline_layout(device, system.set_layout, VK_SHADER_STAGE_COMPUTE_BIT, sizeof(struct FilterParams), failure);
+	system.gaussian_pipeline = create_filter_pipeline(device, system.blur_layout, "../assets/shaders/gaussian_comp.spv", failure);
+	system.down_pipeline = create_filter_pipeline(device, system.blur_layout, "../assets/shaders/kawase_down_comp.spv", failure);
+	system.up_pipeline = create_filter_pipeline(device, system.blur_layout, "../assets/shaders/kawase_up_comp.spv", failure);
+
+	system.composite_layout = create_filter_pipeline_layout(device, system.set_layout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(struct CompositeParams), failure);
+
+	struct PipelineState composite_state = {
+		.render_pass = render_pass,
+		.color_format = color_format,
+		.stencil_format = stencil_format,
+		.stencil = STENCIL_MODE_CLIP_TEST,
+		.blend = BLEND_MODE_PREMULTIPLIED,
+		.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+		.samples = VK_SAMPLE_COUNT_1_BIT,
+		.vertex_layout = VERTEX_LAYOUT_NONE,
+	};
+
+	result = try_create_graphics_pipeline_state(device, VK_NULL_HANDLE, extent, system.composite_layout, "../assets/shaders/composite_vert.spv", "../assets/shaders/composite_frag.spv", &composite_state, &system.composite_pipeline);
+	if (result != VK_SUCCESS) printf("failed to create filter composite pipeline: %s\n", get_result_string(result));
+	if (result != VK_SUCCESS) keep_failure(failure, result);
+
+	return system;
+}
+
+void destroy_filter_system(VkDevice device, struct FilterSystem *system)
+{
+	untrack_resource(RESOURCE_PIPELINE, system->composite_pipeline);
+	vkDestroyPipeline(device, system->composite_pipeline, NULL);
+	untrack_resource(RESOURCE_PIPELINE_LAYOUT, system->composite_layout);
+	vkDestroyPipelineLayout(device, system->composite_layout, NULL);
+	untrack_resource(RESOURCE_PIPELINE, system->up_pipeline);
+	vkDestroyPipeline(device, system->up_pipeline, NULL);
+	untrack_resource(RESOURCE_PIPELINE, system->down_pipeline);
+	vkDestroyPipeline(device, system->down_pipeline, NULL);
+	untrack_resource(RESOURCE_PIPELINE, system->gaussian_pipeline);
+	vkDestroyPipeline(device, system->gaussian_pipeline, NULL);
+	untrack_resource(RESOURCE_PIPELINE_LAYOUT, system->blur_layout);
+	vkDestroyPipelineLayout(device, system->blur_layout, NULL);
+
+	untrack_resource(RESOURCE_RENDER_PASS, system->layer_render_pass);
+	vkDestroyRenderPass(device, system->layer_render_pass, NULL);
+	untrack_resource(RESOURCE_DESCRIPTOR_POOL, system->descriptor_pool);
+	vkDestroyDescriptorPool(device, system->descriptor_pool, NULL);
+	untrack_resource(RESOURCE_DESCRIPTOR_SET_LAYOUT, system->set_layout);
+	vkDestroyDescriptorSetLayout(device, system->set_layout, NULL);
+	untrack_resource(RESOURCE_SAMPLER, system->sampler);
+	vkDestroySampler(device, system->sampler, NULL);
+}
+
+static void write_filter_set(VkDevice device, struct FilterSystem *system, VkDescriptorSet set, const struct Image *src, const struct Image *dst)
+{
+	VkDescriptorImageInfo image_infos[2] = {
+		{
+			.sampler = system->sampler,
+			.imageView = src->view,
+			.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+		},
+		{
+			.sampler = VK_NULL_HANDLE,
+			.imageView = dst != NULL ? dst->view : VK_NULL_HANDLE,
+			.imageLayout = VK_IMAGE_LAYOUT_GENERAL,
+		},
+	};
+
+	VkWriteDescriptorSet writes[2];
+
+	for (uint32_t i = 0; i < 2; i++)
+	{
+		writes[i] = (VkWriteDescriptorSet) {
+			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			.pNext = NULL,
+			.dstSet = set,
+			.dstBinding = i,
+			.dstArrayElement = 0,
+			.descriptorCount = 1,
+			.descriptorType = i == 0 ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER : VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+			.pImageInfo = &image_infos[i],
+			.pBufferInfo = NULL,
+			.pTexelBufferView = NULL,
+		};
+	}
+
+	// the composite set only samples
+	vkUpdateDescriptorSets(device, dst != NULL ? 2 : 1, writes, 0, NULL);
+}
+
+static VkExtent2D level_extent(VkExtent2D extent, uint32_t level)
+{
+	VkExtent2D result = {
+		.width = extent.width >> (level + 1),
+		.height = extent.height >> (level + 1),
+	};
+
+	if (result.width == 0) result.width = 1;
+	if (result.height == 0) result.height = 1;
+
+	return result;
+}
+
+// what creation got to, also what destroy_filter_layer releases
+static void release_filter_layer(VkDevice device, struct FilterSystem *system, struct FilterLayer *layer)
+{
+	if (layer->sets[0] != VK_NULL_HANDLE) vkFreeDescriptorSets(device, system->descriptor_pool, FILTER_SET_COUNT, layer->sets);
+	untrack_resource(RESOURCE_FRAMEBUFFER, layer->framebuffer);
+	if (layer->framebuffer != VK_NULL_HANDLE) vkDestroyFramebuffer(device, layer->framebuffer, NULL);
+
+	for (uint32_t i = 0; i < FILTER_MAX_LEVELS; i++)
+	{
+		destroy_image(device, &layer->levels[i]);
+	}
+
+	destroy_image(device, &layer->result);
+	destroy_image(device, &layer->scratch);
+	destroy_image(device, &layer->source);
+}
+
+VkResult create_filter_layer(VkPhysicalDevice physical_device, VkDevice device, struct FilterSystem *system, VkExtent2D extent, float radius, struct FilterLayer *layer)
+{
+	*layer = (struct FilterLayer) {0};
+
+	if (system->result != VK_SUCCESS) return system->result;
+	if (system->layer_count == FILTER_MAX_LAYERS) return VK_ERROR_TOO_MANY_OBJECTS;
+
+	layer->extent = extent;
+	layer->radius = radius;
+	layer->dirty = true;
+
+	VkImageUsageFlags blur_usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT;
+
+	VkResult result = try_create_image(physical_device, device, extent, FILTER_FORMAT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, &layer->source);
+	if (result == VK_SUCCESS) result = try_create_image(physical_device, device, extent, FILTER_FORMAT, blur_usage, &layer->scratch);
+	if (result == VK_SUCCESS) result = try_create_image(physical_device, device, extent, FILTER_FORMAT, blur_usage, &layer->result);
+
+	for (uint32_t i = 0; i < FILTER_MAX_LEVELS && result == VK_SUCCESS; i++)
+	{
+		result = try_create_image(physical_device, device, level_extent(extent, i), FILTER_FORMAT, blur_usage, &layer->levels[i]);
+	}
+
+	// dynamic rendering draws straight into the source view
+	if (result == VK_SUCCESS && system->layer_render_pass != VK_NULL_HANDLE) {
+		VkFramebufferCreateInfo framebuffer_info = {
+			.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
+			.pNext = NULL,
+			.flags = 0,
+			.renderPass = system->layer_render_pass,
+			.attachmentCount = 1,
+			.pAttachments = &layer->source.view,
+			.width = extent.width,
+			.height = extent.height,
+			.layers = 1,
+		};
+
+		result = vkCreateFramebuffer(device, &framebuffer_info, NULL, &layer->framebuffer);
+		if (result != VK_SUCCESS) layer->framebuffer = VK_NULL_HANDLE;
+		if (result == VK_SUCCESS) track_resource(RESOURCE_FRAMEBUFFER, layer->framebuffer, 0);
+	}
+
+	if (result == VK_SUCCESS) {
+		VkDescriptorSetLayout set_layouts[FILTER_SET_COUNT];
+		for (uint32_t i = 0; i < FILTER_SET_COUNT; i++) set_layouts[i] = system->set_layout;
+
+		VkDescriptorSetAllocateInfo allocate_info = {
+			.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+			.pNext = NULL,
+			.descriptorPool = system->descriptor_pool,
+			.descriptorSetCount = FILTER_SET_COUNT,
+			.pSetLayouts = set_layouts,
+		};
+
+		result = vkAllocateDescriptorSets(device, &allocate_info, layer->sets);
+		if (result != VK_SUCCESS) memset(layer->sets, 0, sizeof(layer->sets));
+	}
+
+	if (result != VK_SUCCESS) {
+		release_filter_layer(device, system, layer);
+		*layer = (struct FilterLayer) {0};
+		return result;
+	}
+
+	// every step of every chain gets its own set, so any radius can be recorded without updates
+
+	write_filter_set(device, system, layer->sets[FILTER_SET_GAUSSIAN_H], &layer->source, &layer->scratch);
+	write_filter_set(device, system, layer->sets[FILTER_SET_GAUSSIAN_V], &layer->scratch, &layer->result);
+
+	for (uint32_t i = 0; i < FILTER_MAX_LEVELS; i++)
+	{
+		const struct Image *larger = i == 0 ? &layer->source : &layer->levels[i - 1];
+		const struct Image *upsampled = i == 0 ? &layer->result : &layer->levels[i - 1];
+
+		write_filter_set(device, system, layer->sets[FILTER_SET_DOWN + i], larger, &layer->levels[i]);
+		write_filter_set(device, system, layer->sets[FILTER_SET_UP + i], &layer->levels[i], upsampled);
+	}
+
+	write_filter_set(device, system, layer->sets[FILTER_SET_COMPOSITE], &layer->result, NULL);
+
+	layer->usable = true;
+	system->layer_count++;
+
+	return VK_SUCCESS;
+}
+
+void destroy_filter_layer(VkDevice device, struct FilterSystem *system, struct FilterLayer *layer)
+{
+	if (!layer->usable) return;
+
+	release_filter_layer(device, system, layer);
+	layer->usable = false;
+
+	system->layer_count--;
+}
+
+void set_filter_radius(struct FilterLayer *layer, float radius)
+{
+	if (layer->radius == radius) return;
+
+	layer->radius = radius;
+	layer->dirty = true;
+}
+
+static void source_barrier(VkCommandBuffer command_buffer, struct FilterLayer *layer, bool begin)
+{
+	VkImageMemoryBarrier barrier = {
+		.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+		.pNext = NULL,
+		.srcAccessMask = begin ? 0 : VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+		.dstAccessMask = begin ? VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT : VK_ACCESS_SHADER_READ_BIT,
+		.oldLayout = begin ? VK_IMAGE_LAYOUT_UNDEFINED : VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+		.newLayout = begin ? VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+		.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.image = layer->source.image,
+		.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1},
+	};
+
+	VkPipelineStageFlags src_stage = begin ? VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT : VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	VkPipelineStageFlags dst_stage = begin ? VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT : VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+
+	vkCmdPipelineBarrier(command_buffer, src_stage, dst_stage, 0, 0, NULL, 0, NULL, 1, &barrier);
+}
+
+void begin_filter_layer(VkCommandBuffer command_buffer, struct FilterSystem *system, struct FilterLayer *layer)
+{
+	if (!layer->usable) return;
+
+	layer->dirty = true;
+
+	// the layer render pass does these transitions itself, dynamic rendering needs them spelled out
+
+	if (system->features->dynamic_rendering) {
+		source_barrier(command_buffer, layer, true);
+		begin_dynamic_rendering(system->features, command_buffer, layer->source.view, VK_NULL_HANDLE, layer->extent, (VkClearColorValue) {{0.0f, 0.0f, 0.0f, 0.0f}});
+		return;
+	}
+
+	VkRenderPassBeginInfo renderPassInfo = {
+		.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+		.pNext = NULL,
+		.renderPass = system->layer_render_pass,
+		.framebuffer = layer->framebuffer,
+		.renderArea = {
+			.offset = {0, 0},
+			.extent = layer->extent,
+		},
+		.clearValueCount = 1,
+		.pClearValues = &(VkClearValue) {{{0.0f, 0.0f, 0.0f, 0.0f}}},
+	};
+
+	vkCmdBeginRenderPass(command_buffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+}
+
+void end_filter_layer(VkCommandBuffer command_buffer, struct FilterSystem *system, struct FilterLayer *layer)
+{
+	if (!layer->usable) return;
+
+	if (system->features->dynamic_rendering) {
+		end_dynamic_rendering(system->features, command_buffer);
+		source_barrier(command_buffer, layer, false);
+		return;
+	}
+
+	vkCmdEndRenderPass(command_buffer);
+}
+
+// writes dst with one dispatch, dst contents are discarded first and left readable by the next step or the composite
+static void record_filter_step(VkCommandBuffer command_buffer, struct FilterSystem *system, VkPipeline pipeline, VkDescriptorSet set, const struct Image *dst, const struct FilterParams *params)
+{
+	VkImageMemoryBarrier barrier = {
+		.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+		.pNext = NULL,
+		.srcAccessMask = 0,
+		.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+		.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+		.newLayout = VK_IMAGE_LAYOUT_GENERAL,
+		.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.image = dst->image,
+		.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1},
+	};
+
+	vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, NULL, 0, NULL, 1, &barrier);
+
+	vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+	vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, system->blur_layout, 0, 1, &set, 0, NULL);
+	vkCmdPushConstants(command_buffer, system->blur_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(*params), params);
+	vkCmdDispatch(command_buffer, (dst->extent.width + FILTER_GROUP_SIZE - 1) / FILTER_GROUP_SIZE, (dst->extent.height + FILTER_GROUP_SIZE - 1) / FILTER_GROUP_SIZE, 1);
+
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+	barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+	vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, NULL, 0, NULL, 1, &barrier);
+}
+
+// each kawase level roughly doubles the reach, the offset covers what is left over
+static uint32_t kawase_levels(const struct FilterLayer *layer, float *offset)
+{
+	uint32_t levels = 1;
+
+	while (levels < FILTER_MAX_LEVELS && (float) (4u << levels) < layer->radius)
+	{
+		VkExtent2D next = level_extent(layer->extent, levels);
+		if (next.width < 2 || next.height < 2) break;
+
+		levels++;
+	}
+
+	*offset = layer->radius / (float) (2u << levels);
+	if (*offset < 1.0f) *offset = 1.0f;
+
+	return levels;
+}
+
+void record_filter_layer(VkCommandBuffer command_buffer, struct FilterSystem *system, struct FilterLayer *layer)
+{
+	if (!layer->usable || !layer->dirty) return;
+
+	struct FilterParams params = {
+		.texel = {1.0f / layer->extent.width, 1.0f / layer->extent.height},
+		.direction = {1.0f, 0.0f},
+		.offset = 1.0f,
+		.sigma = layer->radius * 0.5f,
+		.radius = (int32_t) (layer->radius + 0.5f),
+		.pad = 0,
+	};
+
+	if (layer->radius <= FILTER_GAUSSIAN_MAX_RADIUS) {
+		if (params.sigma < 0.5f) params.sigma = 0.5f;
+
+		record_filter_step(command_buffer, system, system->gaussian_pipeline, layer->sets[FILTER_SET_GAUSSIAN_H], &layer->scratch, &params);
+
+		params.direction[0] = 0.0f;
+		params.direction[1] = 1.0f;
+		record_filter_step(command_buffer, system, system->gaussian_pipeline, layer->sets[FILTER_SET_GAUSSIAN_V], &layer->result, &params);
+	}
+	else {
+		uint32_t levels = kawase_levels(layer, &params.offset);
+
+		for (uint32_t i = 0; i < levels; i++)
+		{
+			VkExtent2D src = i == 0 ? layer->extent : level_extent(layer->extent, i - 1);
+
+			params.texel[0] = 1.0f / src.width;
+			params.texel[1] = 1.0f / src.height;
+			record_filter_step(command_buffer, system, system->down_pipeline, layer->sets[FILTER_SET_DOWN + i], &layer->levels[i], &params);
+		}
+
+		for (uint32_t i = levels; i-- > 0;)
+		{
+			VkExtent2D src = level_extent(layer->extent, i);
+			const struct Image *dst = i == 0 ? &layer->result : &layer->levels[i - 1];
+
+			params.texel[0] = 1.0f / src.width;
+			params.texel[1] = 1.0f / src.height;
+			record_filter_step(command_buffer, system, system->up_pipeline, layer->sets[FILTER_SET_UP + i], dst, &params);
+		}
+	}
+
+	layer->dirty = false;
+	system->blur_count++;
+}
+
+void record_filter_composite(VkCommandBuffer command_buffer, struct FilterSystem *system, struct FilterLayer *layer, VkExtent2D target, const float rect[4], const float color[4])
+{
+	if (!layer->usable) return;
+
+	struct CompositeParams params = {
+		.rect = {
+			rect[0] / target.width * 2.0f - 1.0f,
+			rect[1] / target.height * 2.0f - 1.0f,
+			(rect[0] + rect[2]) / target.width * 2.0f - 1.0f,
+			(rect[1] + rect[3]) / target.height * 2.0f - 1.0f,
+		},
+		.color = {color[0], color[1], color[2], color[3]},
+	};
+
+	vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, system->composite_pipeline);
+	vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, system->composite_layout, 0, 1, &layer->sets[FILTER_SET_COMPOSITE], 0, NULL);
+	vkCmdPushConstants(command_buffer, system->composite_layout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(params), &params);
+	vkCmdDraw(command_buffer, 6, 1, 0, 0);
+}
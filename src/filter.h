@@ -0,0 +1,84 @@
+#pragma once
+
+#include "render.h"
+
+// Blur filters for shadows and backdrops. Content is rendered into an
+// offscreen layer, blurred in compute and composited into the main pass.
+//
+// Small radii use a separable gaussian at full resolution. Larger radii use
+// a dual Kawase chain: each level halves the resolution on the way down and
+// doubles it on the way up, so the cost stays roughly flat as the radius
+// grows. The blurred result is cached until the layer is redrawn or its
+// radius changes.
+
+#define FILTER_MAX_LAYERS 16
+#define FILTER_MAX_LEVELS 5
+#define FILTER_GAUSSIAN_MAX_RADIUS 8.0f
+#define FILTER_FORMAT VK_FORMAT_R8G8B8A8_UNORM
+
+// per layer descriptor sets: two gaussian passes, the down and up chains and the composite
+#define FILTER_SET_GAUSSIAN_H 0
+#define FILTER_SET_GAUSSIAN_V 1
+#define FILTER_SET_DOWN 2
+#define FILTER_SET_UP (FILTER_SET_DOWN + FILTER_MAX_LEVELS)
+#define FILTER_SET_COMPOSITE (FILTER_SET_UP + FILTER_MAX_LEVELS)
+#define FILTER_SET_COUNT (FILTER_SET_COMPOSITE + 1)
+
+struct FilterLayer {
+	VkExtent2D extent;
+	float radius;
+	bool dirty;  // content or radius changed since the last blur
+	bool usable; // false when creation failed, the layer is then skipped wherever it is used
+
+	struct Image source; // rendered into by begin_filter_layer
+	struct Image scratch; // horizontal gaussian result
+	struct Image levels[FILTER_MAX_LEVELS]; // half, quarter, ... resolution
+	struct Image result;
+
+	VkFramebuffer framebuffer; // render pass path only
+	VkDescriptorSet sets[FILTER_SET_COUNT];
+};
+
+struct FilterSystem {
+	const struct DeviceFeatures *features;
+
+	VkSampler sampler;
+
+	VkDescriptorSetLayout set_layout;
+	VkDescriptorPool descriptor_pool;
+
+	VkRenderPass layer_render_pass; // VK_NULL_HANDLE with dynamic rendering
+
+	VkPipelineLayout blur_layout;
+	VkPipeline gaussian_pipeline;
+	VkPipeline down_pipeline;
+	VkPipeline up_pipeline;
+
+	VkPipelineLayout composite_layout;
+	VkPipeline composite_pipeline;
+
+	VkResult result; // the first failure making the above, no layer is made after one
+
+	uint32_t layer_count;
+	uint32_t blur_count; // blurs actually recorded, cache misses
+};
+
+struct FilterSystem create_filter_system(VkDevice device, const struct DeviceFeatures *features, VkExtent2D extent, VkRenderPass render_pass, VkFormat color_format, VkFormat stencil_format);
+void destroy_filter_system(VkDevice device, struct FilterSystem *system);
+
+// on failure, the system's own included, the layer is left unusable with nothing to release;
+// VK_ERROR_TOO_MANY_OBJECTS past FILTER_MAX_LAYERS
+VkResult create_filter_layer(VkPhysicalDevice physical_device, VkDevice device, struct FilterSystem *system, VkExtent2D extent, float radius, struct FilterLayer *layer);
+void destroy_filter_layer(VkDevice device, struct FilterSystem *system, struct FilterLayer *layer);
+void set_filter_radius(struct FilterLayer *layer, float radius);
+
+// begins a render pass on the layer, cleared to transparent, and marks it dirty
+void begin_filter_layer(VkCommandBuffer command_buffer, struct FilterSystem *system, struct FilterLayer *layer);
+void end_filter_layer(VkCommandBuffer command_buffer, struct FilterSystem *system, struct FilterLayer *layer);
+
+// blurs the layer if it is dirty, leaves the result ready for fragment shader reads;
+// a layer has to be drawn once before its first blur
+void record_filter_layer(VkCommandBuffer command_buffer, struct FilterSystem *system, struct FilterLayer *layer);
+
+// draws the blurred layer at rect (x, y, width, height in pixels) multiplied by a premultiplied color
+void record_filter_composite(VkCommandBuffer command_buffer, struct FilterSystem *system, struct FilterLayer *layer, VkExtent2D target, const float rect[4], const float color[4]);
@@ -0,0 +1,486 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+#include <math.h>
+#include <pthread.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define GEOMETRY_X86
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define GEOMETRY_NEON
+#endif
+
+#include "geometry.h"
+
+// every version multiplies and adds in the same order, and the file is built
+// with -ffp-contract=off so none of them turns into an fma; they all produce
+// the same bits as the scalar one
+
+static void transform_scalar(const float *x, const float *y, uint32_t count, const float matrix[6], void *out, uint32_t stride)
+{
+	uint8_t *dst = out;
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		float point[2] = {
+			matrix[0] * x[i] + matrix[2] * y[i] + matrix[4],
+			matrix[1] * x[i] + matrix[3] * y[i] + matrix[5],
+		};
+
+		memcpy(dst + (size_t) i * stride, point, sizeof(point));
+	}
+}
+
+static struct Aabb bounds_scalar(const float *x, const float *y, uint32_t count)
+{
+	struct Aabb box = {INFINITY, INFINITY, -INFINITY, -INFINITY};
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		box.x0 = x[i] < box.x0 ? x[i] : box.x0;
+		box.y0 = y[i] < box.y0 ? y[i] : box.y0;
+		box.x1 = x[i] > box.x1 ? x[i] : box.x1;
+		box.y1 = y[i] > box.y1 ? y[i] : box.y1;
+	}
+
+	return box;
+}
+
+static uint32_t clip_scalar(const float *x0, const float *y0, const float *x1, const float *y1, uint32_t count, struct Aabb clip, uint32_t *visible)
+{
+	uint32_t visible_count = 0;
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		if (x0[i] < clip.x1 && x1[i] > clip.x0 && y0[i] < clip.y1 && y1[i] > clip.y0) {
+			visible[visible_count++] = i;
+		}
+	}
+
+	return visible_count;
+}
+
+static struct Aabb merge_bounds(struct Aabb a, struct Aabb b)
+{
+	a.x0 = b.x0 < a.x0 ? b.x0 : a.x0;
+	a.y0 = b.y0 < a.y0 ? b.y0 : a.y0;
+	a.x1 = b.x1 > a.x1 ? b.x1 : a.x1;
+	a.y1 = b.y1 > a.y1 ? b.y1 : a.y1;
+
+	return a;
+}
+
+#ifdef GEOMETRY_X86
+
+// sse2
+
+__attribute__((target("sse2")))
+static void transform_sse2(const float *x, const float *y, uint32_t count, const float matrix[6], void *out, uint32_t stride)
+{
+	uint8_t *dst = out;
+
+	__m128 m0 = _mm_set1_ps(matrix[0]);
+	__m128 m1 = _mm_set1_ps(matrix[1]);
+	__m128 m2 = _mm_set1_ps(matrix[2]);
+	__m128 m3 = _mm_set1_ps(matrix[3]);
+	__m128 m4 = _mm_set1_ps(matrix[4]);
+	__m128 m5 = _mm_set1_ps(matrix[5]);
+
+	uint32_t i = 0;
+
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 vx = _mm_loadu_ps(x + i);
+		__m128 vy = _mm_loadu_ps(y + i);
+
+		__m128 ox = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m0, vx), _mm_mul_ps(m2, vy)), m4);
+		__m128 oy = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m1, vx), _mm_mul_ps(m3, vy)), m5);
+
+		__m128 lo = _mm_unpacklo_ps(ox, oy); // x0 y0 x1 y1
+		__m128 hi = _mm_unpackhi_ps(ox, oy); // x2 y2 x3 y3
+
+		uint8_t *p = dst + (size_t) i * stride;
+
+		if (stride == 2 * sizeof(float)) {
+			_mm_storeu_ps((float *) p, lo);
+			_mm_storeu_ps((float *) (p + 16), hi);
+		}
+		else {
+			_mm_storel_pi((__m64 *) p, lo);
+			_mm_storeh_pi((__m64 *) (p + stride), lo);
+			_mm_storel_pi((__m64 *) (p + 2 * stride), hi);
+			_mm_storeh_pi((__m64 *) (p + 3 * stride), hi);
+		}
+	}
+
+	transform_scalar(x + i, y + i, count - i, matrix, dst + (size_t) i * stride, stride);
+}
+
+__attribute__((target("sse2")))
+static struct Aabb bounds_sse2(const float *x, const float *y, uint32_t count)
+{
+	__m128 min_x = _mm_set1_ps(INFINITY);
+	__m128 min_y = _mm_set1_ps(INFINITY);
+	__m128 max_x = _mm_set1_ps(-INFINITY);
+	__m128 max_y = _mm_set1_ps(-INFINITY);
+
+	uint32_t i = 0;
+
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 vx = _mm_loadu_ps(x + i);
+		__m128 vy = _mm_loadu_ps(y + i);
+
+		min_x = _mm_min_ps(min_x, vx);
+		min_y = _mm_min_ps(min_y, vy);
+		max_x = _mm_max_ps(max_x, vx);
+		max_y = _mm_max_ps(max_y, vy);
+	}
+
+	float lanes[4][4];
+	_mm_storeu_ps(lanes[0], min_x);
+	_mm_storeu_ps(lanes[1], min_y);
+	_mm_storeu_ps(lanes[2], max_x);
+	_mm_storeu_ps(lanes[3], max_y);
+
+	struct Aabb box = bounds_scalar(x + i, y + i, count - i);
+
+	for (int lane = 0; lane < 4; lane++)
+	{
+		box = merge_bounds(box, (struct Aabb) {lanes[0][lane], lanes[1][lane], lanes[2][lane], lanes[3][lane]});
+	}
+
+	return box;
+}
+
+__attribute__((target("sse2")))
+static uint32_t clip_sse2(const float *x0, const float *y0, const float *x1, const float *y1, uint32_t count, struct Aabb clip, uint32_t *visible)
+{
+	__m128 clip_x0 = _mm_set1_ps(clip.x0);
+	__m128 clip_y0 = _mm_set1_ps(clip.y0);
+	__m128 clip_x1 = _mm_set1_ps(clip.x1);
+	__m128 clip_y1 = _mm_set1_ps(clip.y1);
+
+	uint32_t visible_count = 0;
+	uint32_t i = 0;
+
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 inside_x = _mm_and_ps(_mm_cmplt_ps(_mm_loadu_ps(x0 + i), clip_x1), _mm_cmpgt_ps(_mm_loadu_ps(x1 + i), clip_x0));
+		__m128 inside_y = _mm_and_ps(_mm_cmplt_ps(_mm_loadu_ps(y0 + i), clip_y1), _mm_cmpgt_ps(_mm_loadu_ps(y1 + i), clip_y0));
+
+		uint32_t mask = (uint32_t) _mm_movemask_ps(_mm_and_ps(inside_x, inside_y));
+
+		while (mask != 0)
+		{
+			visible[visible_count++] = i + (uint32_t) __builtin_ctz(mask);
+			mask &= mask - 1;
+		}
+	}
+
+	uint32_t tail = clip_scalar(x0 + i, y0 + i, x1 + i, y1 + i, count - i, clip, visible + visible_count);
+
+	for (uint32_t j = 0; j < tail; j++)
+	{
+		visible[visible_count + j] += i;
+	}
+
+	return visible_count + tail;
+}
+
+// avx2
+
+__attribute__((target("avx2")))
+static void transform_avx2(const float *x, const float *y, uint32_t count, const float matrix[6], void *out, uint32_t stride)
+{
+	uint8_t *dst = out;
+
+	__m256 m0 = _mm256_set1_ps(matrix[0]);
+	__m256 m1 = _mm256_set1_ps(matrix[1]);
+	__m256 m2 = _mm256_set1_ps(matrix[2]);
+	__m256 m3 = _mm256_set1_ps(matrix[3]);
+	__m256 m4 = _mm256_set1_ps(matrix[4]);
+	__m256 m5 = _mm256_set1_ps(matrix[5]);
+
+	uint32_t i = 0;
+
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256 vx = _mm256_loadu_ps(x + i);
+		__m256 vy = _mm256_loadu_ps(y + i);
+
+		__m256 ox = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m0, vx), _mm256_mul_ps(m2, vy)), m4);
+		__m256 oy = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m1, vx), _mm256_mul_ps(m3, vy)), m5);
+
+		// unpacks work per 128 bit lane, the permutes put the points back in order
+		__m256 lo = _mm256_unpacklo_ps(ox, oy); // p0 p1 | p4 p5
+		__m256 hi = _mm256_unpackhi_ps(ox, oy); // p2 p3 | p6 p7
+		__m256 first = _mm256_permute2f128_ps(lo, hi, 0x20);  // p0 p1 p2 p3
+		__m256 second = _mm256_permute2f128_ps(lo, hi, 0x31); // p4 p5 p6 p7
+
+		uint8_t *p = dst + (size_t) i * stride;
+
+		if (stride == 2 * sizeof(float)) {
+			_mm256_storeu_ps((float *) p, first);
+			_mm256_storeu_ps((float *) (p + 32), second);
+		}
+		else {
+			__m128 quarters[4] = {
+				_mm256_castps256_ps128(first),
+				_mm256_extractf128_ps(first, 1),
+				_mm256_castps256_ps128(second),
+				_mm256_extractf128_ps(second, 1),
+			};
+
+			for (int q = 0; q < 4; q++)
+			{
+				_mm_storel_pi((__m64 *) (p + (2 * q) * stride), quarters[q]);
+				_mm_storeh_pi((__m64 *) (p + (2 * q + 1) * stride), quarters[q]);
+			}
+		}
+	}
+
+	transform_sse2(x + i, y + i, count - i, matrix, dst + (size_t) i * stride, stride);
+}
+
+__attribute__((target("avx2")))
+static struct Aabb bounds_avx2(const float *x, const float *y, uint32_t count)
+{
+	__m256 min_x = _mm256_set1_ps(INFINITY);
+	__m256 min_y = _mm256_set1_ps(INFINITY);
+	__m256 max_x = _mm256_set1_ps(-INFINITY);
+	__m256 max_y = _mm256_set1_ps(-INFINITY);
+
+	uint32_t i = 0;
+
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256 vx = _mm256_loadu_ps(x + i);
+		__m256 vy = _mm256_loadu_ps(y + i);
+
+		min_x = _mm256_min_ps(min_x, vx);
+		min_y = _mm256_min_ps(min_y, vy);
+		max_x = _mm256_max_ps(max_x, vx);
+		max_y = _mm256_max_ps(max_y, vy);
+	}
+
+	float lanes[4][8];
+	_mm256_storeu_ps(lanes[0], min_x);
+	_mm256_storeu_ps(lanes[1], min_y);
+	_mm256_storeu_ps(lanes[2], max_x);
+	_mm256_storeu_ps(lanes[3], max_y);
+
+	struct Aabb box = bounds_sse2(x + i, y + i, count - i);
+
+	for (int lane = 0; lane < 8; lane++)
+	{
+		box = merge_bounds(box, (struct Aabb) {lanes[0][lane], lanes[1][lane], lanes[2][lane], lanes[3][lane]});
+	}
+
+	return box;
+}
+
+__attribute__((target("avx2")))
+static uint32_t clip_avx2(const float *x0, const float *y0, const float *x1, const float *y1, uint32_t count, struct Aabb clip, uint32_t *visible)
+{
+	__m256 clip_x0 = _mm256_set1_ps(clip.x0);
+	__m256 clip_y0 = _mm256_set1_ps(clip.y0);
+	__m256 clip_x1 = _mm256_set1_ps(clip.x1);
+	__m256 clip_y1 = _mm256_set1_ps(clip.y1);
+
+	uint32_t visible_count = 0;
+	uint32_t i = 0;
+
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256 inside_x = _mm256_and_ps(_mm256_cmp_ps(_mm256_loadu_ps(x0 + i), clip_x1, _CMP_LT_OQ), _mm256_cmp_ps(_mm256_loadu_ps(x1 + i), clip_x0, _CMP_GT_OQ));
+		__m256 inside_y = _mm256_and_ps(_mm256_cmp_ps(_mm256_loadu_ps(y0 + i), clip_y1, _CMP_LT_OQ), _mm256_cmp_ps(_mm256_loadu_ps(y1 + i), clip_y0, _CMP_GT_OQ));
+
+		uint32_t mask = (uint32_t) _mm256_movemask_ps(_mm256_and_ps(inside_x, inside_y));
+
+		while (mask != 0)
+		{
+			visible[visible_count++] = i + (uint32_t) __builtin_ctz(mask);
+			mask &= mask - 1;
+		}
+	}
+
+	uint32_t tail = clip_sse2(x0 + i, y0 + i, x1 + i, y1 + i, count - i, clip, visible + visible_count);
+
+	for (uint32_t j = 0; j < tail; j++)
+	{
+		visible[visible_count + j] += i;
+	}
+
+	return visible_count + tail;
+}
+
+static const struct GeometryKernels sse2_kernels = {
+	.name = "sse2",
+	.transform = transform_sse2,
+	.bounds = bounds_sse2,
+	.clip = clip_sse2,
+};
+
+static const struct GeometryKernels avx2_kernels = {
+	.name = "avx2",
+	.transform = transform_avx2,
+	.bounds = bounds_avx2,
+	.clip = clip_avx2,
+};
+
+#endif
+
+#ifdef GEOMETRY_NEON
+
+static void transform_neon(const float *x, const float *y, uint32_t count, const float matrix[6], void *out, uint32_t stride)
+{
+	uint8_t *dst = out;
+
+	float32x4_t m4 = vdupq_n_f32(matrix[4]);
+	float32x4_t m5 = vdupq_n_f32(matrix[5]);
+
+	uint32_t i = 0;
+
+	for (; i + 4 <= count; i += 4)
+	{
+		float32x4_t vx = vld1q_f32(x + i);
+		float32x4_t vy = vld1q_f32(y + i);
+
+		float32x4_t ox = vaddq_f32(vaddq_f32(vmulq_n_f32(vx, matrix[0]), vmulq_n_f32(vy, matrix[2])), m4);
+		float32x4_t oy = vaddq_f32(vaddq_f32(vmulq_n_f32(vx, matrix[1]), vmulq_n_f32(vy, matrix[3])), m5);
+
+		uint8_t *p = dst + (size_t) i * stride;
+
+		if (stride == 2 * sizeof(float)) {
+			float32x4x2_t points = {{ox, oy}};
+			vst2q_f32((float *) p, points);
+		}
+		else {
+			float32x4x2_t points = vzipq_f32(ox, oy);
+
+			vst1_f32((float *) p, vget_low_f32(points.val[0]));
+			vst1_f32((float *) (p + stride), vget_high_f32(points.val[0]));
+			vst1_f32((float *) (p + 2 * stride), vget_low_f32(points.val[1]));
+			vst1_f32((float *) (p + 3 * stride), vget_high_f32(points.val[1]));
+		}
+	}
+
+	transform_scalar(x + i, y + i, count - i, matrix, dst + (size_t) i * stride, stride);
+}
+
+static struct Aabb bounds_neon(const float *x, const float *y, uint32_t count)
+{
+	float32x4_t min_x = vdupq_n_f32(INFINITY);
+	float32x4_t min_y = vdupq_n_f32(INFINITY);
+	float32x4_t max_x = vdupq_n_f32(-INFINITY);
+	float32x4_t max_y = vdupq_n_f32(-INFINITY);
+
+	uint32_t i = 0;
+
+	for (; i + 4 <= count; i += 4)
+	{
+		float32x4_t vx = vld1q_f32(x + i);
+		float32x4_t vy = vld1q_f32(y + i);
+
+		min_x = vminq_f32(min_x, vx);
+		min_y = vminq_f32(min_y, vy);
+		max_x = vmaxq_f32(max_x, vx);
+		max_y = vmaxq_f32(max_y, vy);
+	}
+
+	float lanes[4][4];
+	vst1q_f32(lanes[0], min_x);
+	vst1q_f32(lanes[1], min_y);
+	vst1q_f32(lanes[2], max_x);
+	vst1q_f32(lanes[3], max_y);
+
+	struct Aabb box = bounds_scalar(x + i, y + i, count - i);
+
+	for (int lane = 0; lane < 4; lane++)
+	{
+		box = merge_bounds(box, (struct Aabb) {lanes[0][lane], lanes[1][lane], lanes[2][lane], lanes[3][lane]});
+	}
+
+	return box;
+}
+
+static uint32_t clip_neon(const float *x0, const float *y0, const float *x1, const float *y1, uint32_t count, struct Aabb clip, uint32_t *visible)
+{
+	float32x4_t clip_x0 = vdupq_n_f32(clip.x0);
+	float32x4_t clip_y0 = vdupq_n_f32(clip.y0);
+	float32x4_t clip_x1 = vdupq_n_f32(clip.x1);
+	float32x4_t clip_y1 = vdupq_n_f32(clip.y1);
+
+	uint32_t visible_count = 0;
+	uint32_t i = 0;
+
+	for (; i + 4 <= count; i += 4)
+	{
+		uint32x4_t inside_x = vandq_u32(vcltq_f32(vld1q_f32(x0 + i), clip_x1), vcgtq_f32(vld1q_f32(x1 + i), clip_x0));
+		uint32x4_t inside_y = vandq_u32(vcltq_f32(vld1q_f32(y0 + i), clip_y1), vcgtq_f32(vld1q_f32(y1 + i), clip_y0));
+
+		uint32_t lanes[4];
+		vst1q_u32(lanes, vandq_u32(inside_x, inside_y));
+
+		for (uint32_t lane = 0; lane < 4; lane++)
+		{
+			if (lanes[lane] != 0) visible[visible_count++] = i + lane;
+		}
+	}
+
+	uint32_t tail = clip_scalar(x0 + i, y0 + i, x1 + i, y1 + i, count - i, clip, visible + visible_count);
+
+	for (uint32_t j = 0; j < tail; j++)
+	{
+		visible[visible_count + j] += i;
+	}
+
+	return visible_count + tail;
+}
+
+static const struct GeometryKernels neon_kernels = {
+	.name = "neon",
+	.transform = transform_neon,
+	.bounds = bounds_neon,
+	.clip = clip_neon,
+};
+
+#endif
+
+static const struct GeometryKernels scalar_kernels = {
+	.name = "scalar",
+	.transform = transform_scalar,
+	.bounds = bounds_scalar,
+	.clip = clip_scalar,
+};
+
+static const struct GeometryKernels *selected_kernels = &scalar_kernels;
+static pthread_once_t select_once = PTHREAD_ONCE_INIT;
+
+static void select_kernels(void)
+{
+#if defined(GEOMETRY_X86)
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("sse2")) selected_kernels = &sse2_kernels;
+	if (__builtin_cpu_supports("avx2")) selected_kernels = &avx2_kernels;
+#elif defined(GEOMETRY_NEON)
+	selected_kernels = &neon_kernels;
+#endif
+}
+
+const struct GeometryKernels *get_geometry_kernels(void)
+{
+	pthread_once(&select_once, select_kernels);
+
+	return selected_kernels;
+}
+
+const struct GeometryKernels *get_scalar_geometry_kernels(void)
+{
+	return &scalar_kernels;
+}
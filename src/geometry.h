@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "spatial.h"
+
+// CPU kernels for batched 2D geometry on structure of arrays streams. Each
+// kernel has a scalar version and SSE2, AVX2 and NEON versions; the widest
+// one the cpu supports is picked once at runtime. Outputs can point straight
+// into mapped upload buffers, kernels only ever write them sequentially.
+//
+// Affine transforms are 2x3, column major like a canvas matrix:
+//
+//   x' = m[0] * x + m[2] * y + m[4]
+//   y' = m[1] * x + m[3] * y + m[5]
+
+struct GeometryKernels {
+	const char *name;
+
+	// writes count (x', y') float pairs, stride bytes apart
+	void (*transform)(const float *x, const float *y, uint32_t count, const float matrix[6], void *out, uint32_t stride);
+
+	// bounds of every point, an inverted box for no points
+	struct Aabb (*bounds)(const float *x, const float *y, uint32_t count);
+
+	// writes the indices of the boxes that overlap clip, in order, and returns how many
+	uint32_t (*clip)(const float *x0, const float *y0, const float *x1, const float *y1, uint32_t count, struct Aabb clip, uint32_t *visible);
+};
+
+const struct GeometryKernels *get_geometry_kernels(void);
+const struct GeometryKernels *get_scalar_geometry_kernels(void);
@@ -0,0 +1,750 @@
+#include <vulkan/vulkan.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "render.h"
+#include "graph.h"
+#include "track.h"
+
+struct GraphAccessInfo {
+	VkPipelineStageFlags stage;
+	VkAccessFlags access;
+	VkImageLayout layout;
+	VkImageUsageFlags usage;
+	bool write;
+};
+
+static const struct GraphAccessInfo access_infos[GRAPH_ACCESS_COUNT] = {
+	[GRAPH_ACCESS_NONE] = {VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0, VK_IMAGE_LAYOUT_UNDEFINED, 0, false},
+	[GRAPH_ACCESS_ACQUIRE] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0, VK_IMAGE_LAYOUT_UNDEFINED, 0, false},
+	[GRAPH_ACCESS_PRESENT] = {VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, 0, false},
+	[GRAPH_ACCESS_COLOR_ATTACHMENT] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, true},
+	[GRAPH_ACCESS_STENCIL_ATTACHMENT] = {VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, true},
+	[GRAPH_ACCESS_FRAGMENT_SAMPLED] = {VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_USAGE_SAMPLED_BIT, false},
+	[GRAPH_ACCESS_COMPUTE_SAMPLED] = {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_USAGE_SAMPLED_BIT, false},
+	[GRAPH_ACCESS_COMPUTE_READ] = {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_USAGE_STORAGE_BIT, false},
+	[GRAPH_ACCESS_COMPUTE_WRITE] = {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_USAGE_STORAGE_BIT, true},
+	[GRAPH_ACCESS_VERTEX_READ] = {VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_USAGE_SAMPLED_BIT, false},
+	[GRAPH_ACCESS_INDIRECT_READ] = {VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, 0, false},
+	[GRAPH_ACCESS_TRANSFER_READ] = {VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_SRC_BIT, false},
+	[GRAPH_ACCESS_TRANSFER_WRITE] = {VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT, true},
+};
+
+static const VkAccessFlags write_accesses = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+	VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_HOST_WRITE_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+
+// synchronization state of one resource while barriers are being worked out
+struct GraphState {
+	VkImageLayout layout;
+	VkPipelineStageFlags write_stage;   // last write, or what a later access must wait on
+	VkAccessFlags write_access;         // still needs to be made available
+	VkPipelineStageFlags visible_stage; // stages the last write is visible to
+	VkAccessFlags visible_access;
+	VkPipelineStageFlags read_stage;    // reads since the last write
+};
+
+struct FrameGraph *create_frame_graph(void)
+{
+	struct FrameGraph *graph = calloc(1, sizeof(struct FrameGraph));
+	if (graph == NULL) printf("failed to allocate frame graph\n");
+
+	return graph;
+}
+
+static void destroy_transients(VkDevice device, struct FrameGraph *graph)
+{
+	for (uint32_t i = 0; i < graph->resource_count; i++)
+	{
+		struct GraphResource *resource = &graph->resources[i];
+
+		if (resource->imported || !resource->is_image) continue;
+
+		untrack_resource(RESOURCE_IMAGE_VIEW, resource->view);
+		if (resource->view != VK_NULL_HANDLE) vkDestroyImageView(device, resource->view, NULL);
+		untrack_resource(RESOURCE_IMAGE, resource->image);
+		if (resource->image != VK_NULL_HANDLE) vkDestroyImage(device, resource->image, NULL);
+
+		resource->view = VK_NULL_HANDLE;
+		resource->image = VK_NULL_HANDLE;
+	}
+
+	for (uint32_t i = 0; i < graph->memory_count; i++)
+	{
+		untrack_resource(RESOURCE_MEMORY, graph->memories[i].memory);
+		vkFreeMemory(device, graph->memories[i].memory, NULL);
+	}
+
+	graph->memory_count = 0;
+}
+
+void destroy_frame_graph(VkDevice device, struct FrameGraph *graph)
+{
+	destroy_transients(device, graph);
+
+	free(graph);
+}
+
+static uint32_t add_resource(struct FrameGraph *graph, const char *name)
+{
+	if (graph->resource_count == GRAPH_MAX_RESOURCES) {
+		printf("frame graph resource limit reached at %s\n", name);
+		return GRAPH_NONE;
+	}
+
+	uint32_t index = graph->resource_count++;
+
+	struct GraphResource *resource = &graph->resources[index];
+	memset(resource, 0, sizeof(*resource));
+
+	resource->name = name;
+	resource->initial = GRAPH_ACCESS_NONE;
+	resource->final = GRAPH_ACCESS_NONE;
+	resource->memory = GRAPH_NONE;
+	resource->alias_of = GRAPH_NONE;
+
+	return index;
+}
+
+uint32_t graph_import_image(struct FrameGraph *graph, const char *name, VkFormat format, VkExtent2D extent, enum GraphAccess initial, enum GraphAccess final)
+{
+	uint32_t index = add_resource(graph, name);
+	if (index == GRAPH_NONE) return index;
+
+	struct GraphResource *resource = &graph->resources[index];
+	resource->is_image = true;
+	resource->imported = true;
+	resource->format = format;
+	resource->extent = extent;
+	resource->initial = initial;
+	resource->final = final;
+
+	return index;
+}
+
+uint32_t graph_import_buffer(struct FrameGraph *graph, const char *name, VkBuffer buffer)
+{
+	uint32_t index = add_resource(graph, name);
+	if (index == GRAPH_NONE) return index;
+
+	struct GraphResource *resource = &graph->resources[index];
+	resource->is_image = false;
+	resource->imported = true;
+	resource->buffer = buffer;
+
+	return index;
+}
+
+uint32_t graph_create_image(struct FrameGraph *graph, const char *name, VkFormat format, VkExtent2D extent)
+{
+	uint32_t index = add_resource(graph, name);
+	if (index == GRAPH_NONE) return index;
+
+	struct GraphResource *resource = &graph->resources[index];
+	resource->is_image = true;
+	resource->imported = false;
+	resource->format = format;
+	resource->extent = extent;
+
+	return index;
+}
+
+void graph_bind_image(struct FrameGraph *graph, uint32_t resource, VkImage image, VkImageView view)
+{
+	graph->resources[resource].image = image;
+	graph->resources[resource].view = view;
+}
+
+uint32_t graph_add_pass(struct FrameGraph *graph, const char *name, GraphExecute execute, void *user_data)
+{
+	if (graph->pass_count == GRAPH_MAX_PASSES) {
+		printf("frame graph pass limit reached at %s\n", name);
+		return GRAPH_NONE;
+	}
+
+	uint32_t index = graph->pass_count++;
+
+	struct GraphPass *pass = &graph->passes[index];
+	memset(pass, 0, sizeof(*pass));
+
+	pass->name = name;
+	pass->execute = execute;
+	pass->user_data = user_data;
+
+	return index;
+}
+
+static void add_use(struct FrameGraph *graph, uint32_t pass_index, uint32_t resource, enum GraphAccess access)
+{
+	struct GraphPass *pass = &graph->passes[pass_index];
+
+	if (pass->use_count == GRAPH_MAX_USES) {
+		printf("frame graph pass %s uses too many resources\n", pass->name);
+		return;
+	}
+
+	pass->uses[pass->use_count++] = (struct GraphUse) {
+		.resource = resource,
+		.access = access,
+	};
+
+	graph->compiled = false;
+}
+
+void graph_read(struct FrameGraph *graph, uint32_t pass, uint32_t resource, enum GraphAccess access)
+{
+	if (access_infos[access].write) printf("frame graph pass %s declares a write as a read\n", graph->passes[pass].name);
+
+	add_use(graph, pass, resource, access);
+}
+
+void graph_write(struct FrameGraph *graph, uint32_t pass, uint32_t resource, enum GraphAccess access)
+{
+	if (!access_infos[access].write) printf("frame graph pass %s declares a read as a write\n", graph->passes[pass].name);
+
+	add_use(graph, pass, resource, access);
+}
+
+void graph_set_side_effects(struct FrameGraph *graph, uint32_t pass)
+{
+	graph->passes[pass].side_effects = true;
+}
+
+// reference counting from the outputs back, anything left at zero is never observed
+static void cull_passes(struct FrameGraph *graph)
+{
+	uint32_t stack[GRAPH_MAX_RESOURCES];
+	uint32_t stack_count = 0;
+
+	for (uint32_t i = 0; i < graph->resource_count; i++)
+	{
+		struct GraphResource *resource = &graph->resources[i];
+		resource->refcount = (resource->imported && resource->final != GRAPH_ACCESS_NONE) ? 1 : 0;
+	}
+
+	for (uint32_t i = 0; i < graph->pass_count; i++)
+	{
+		struct GraphPass *pass = &graph->passes[i];
+		pass->culled = false;
+		pass->refcount = 0;
+
+		for (uint32_t j = 0; j < pass->use_count; j++)
+		{
+			if (access_infos[pass->uses[j].access].write) {
+				pass->refcount++;
+			}
+			else {
+				graph->resources[pass->uses[j].resource].refcount++;
+			}
+		}
+	}
+
+	for (uint32_t i = 0; i < graph->resource_count; i++)
+	{
+		if (graph->resources[i].refcount == 0) stack[stack_count++] = i;
+	}
+
+	while (stack_count > 0)
+	{
+		uint32_t unused = stack[--stack_count];
+
+		for (uint32_t i = 0; i < graph->pass_count; i++)
+		{
+			struct GraphPass *pass = &graph->passes[i];
+			if (pass->culled || pass->side_effects) continue;
+
+			for (uint32_t j = 0; j < pass->use_count; j++)
+			{
+				if (pass->uses[j].resource != unused || !access_infos[pass->uses[j].access].write) continue;
+
+				if (--pass->refcount > 0) continue;
+
+				pass->culled = true;
+
+				for (uint32_t k = 0; k < pass->use_count; k++)
+				{
+					struct GraphUse use = pass->uses[k];
+					if (access_infos[use.access].write) continue;
+
+					if (--graph->resources[use.resource].refcount == 0) stack[stack_count++] = use.resource;
+				}
+			}
+		}
+	}
+
+	graph->culled_pass_count = 0;
+	for (uint32_t i = 0; i < graph->pass_count; i++)
+	{
+		if (graph->passes[i].culled) graph->culled_pass_count++;
+	}
+}
+
+static void compute_lifetimes(struct FrameGraph *graph)
+{
+	for (uint32_t i = 0; i < graph->resource_count; i++)
+	{
+		graph->resources[i].first_pass = GRAPH_NONE;
+		graph->resources[i].last_pass = GRAPH_NONE;
+		graph->resources[i].memory = GRAPH_NONE;
+		graph->resources[i].alias_of = GRAPH_NONE;
+		if (!graph->resources[i].imported) graph->resources[i].usage = 0;
+	}
+
+	for (uint32_t i = 0; i < graph->pass_count; i++)
+	{
+		struct GraphPass *pass = &graph->passes[i];
+		if (pass->culled) continue;
+
+		for (uint32_t j = 0; j < pass->use_count; j++)
+		{
+			struct GraphResource *resource = &graph->resources[pass->uses[j].resource];
+
+			if (resource->first_pass == GRAPH_NONE) resource->first_pass = i;
+			resource->last_pass = i;
+
+			if (!resource->imported) resource->usage |= access_infos[pass->uses[j].access].usage;
+		}
+	}
+}
+
+static bool lifetimes_overlap(const struct GraphResource *a, const struct GraphResource *b)
+{
+	return !(a->last_pass < b->first_pass || b->last_pass < a->first_pass);
+}
+
+static void create_transients(struct FrameGraph *graph, VkPhysicalDevice physical_device, VkDevice device)
+{
+	uint32_t transients[GRAPH_MAX_RESOURCES];
+	uint32_t transient_count = 0;
+
+	graph->transient_bytes = 0;
+	graph->allocated_bytes = 0;
+
+	for (uint32_t i = 0; i < graph->resource_count; i++)
+	{
+		struct GraphResource *resource = &graph->resources[i];
+
+		if (resource->imported || !resource->is_image || resource->first_pass == GRAPH_NONE) continue;
+
+		VkImageCreateInfo image_info = {
+			.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+			.pNext = NULL,
+			.flags = 0,
+			.imageType = VK_IMAGE_TYPE_2D,
+			.format = resource->format,
+			.extent = {resource->extent.width, resource->extent.height, 1},
+			.mipLevels = 1,
+			.arrayLayers = 1,
+			.samples = VK_SAMPLE_COUNT_1_BIT,
+			.tiling = VK_IMAGE_TILING_OPTIMAL,
+			.usage = resource->usage,
+			.sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+			.queueFamilyIndexCount = 0,
+			.pQueueFamilyIndices = NULL,
+			.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+		};
+
+		VkResult result = vkCreateImage(device, &image_info, NULL, &resource->image);
+
+		if (result != VK_SUCCESS) {
+			resource->image = VK_NULL_HANDLE;
+			report_render_failure(result, "create transient image");
+			continue;
+		}
+
+		track_resource(RESOURCE_IMAGE, resource->image, 0);
+
+		vkGetImageMemoryRequirements(device, resource->image, &resource->requirements);
+
+		graph->transient_bytes += resource->requirements.size;
+		transients[transient_count++] = i;
+	}
+
+	// largest first, so small images fill in behind large ones
+
+	for (uint32_t i = 1; i < transient_count; i++)
+	{
+		uint32_t current = transients[i];
+		uint32_t j = i;
+
+		while (j > 0 && graph->resources[transients[j - 1]].requirements.size < graph->resources[current].requirements.size)
+		{
+			transients[j] = transients[j - 1];
+			j--;
+		}
+
+		transients[j] = current;
+	}
+
+	for (uint32_t i = 0; i < transient_count; i++)
+	{
+		struct GraphResource *resource = &graph->resources[transients[i]];
+		uint32_t chosen = GRAPH_NONE;
+
+		for (uint32_t m = 0; m < graph->memory_count && chosen == GRAPH_NONE; m++)
+		{
+			if ((graph->memories[m].type_bits & resource->requirements.memoryTypeBits) == 0) continue;
+
+			bool free = true;
+
+			for (uint32_t j = 0; j < i && free; j++)
+			{
+				struct GraphResource *other = &graph->resources[transients[j]];
+				if (other->memory == m && lifetimes_overlap(resource, other)) free = false;
+			}
+
+			if (free) chosen = m;
+		}
+
+		if (chosen == GRAPH_NONE) {
+			chosen = graph->memory_count++;
+			graph->memories[chosen] = (struct GraphMemory) {
+				.memory = VK_NULL_HANDLE,
+				.size = 0,
+				.type_bits = resource->requirements.memoryTypeBits,
+			};
+		}
+
+		struct GraphMemory *memory = &graph->memories[chosen];
+
+		if (memory->size < resource->requirements.size) memory->size = resource->requirements.size;
+		memory->type_bits &= resource->requirements.memoryTypeBits;
+
+		resource->memory = chosen;
+	}
+
+	// the previous occupant of the memory has to be finished before the next one starts
+
+	for (uint32_t i = 0; i < transient_count; i++)
+	{
+		struct GraphResource *resource = &graph->resources[transients[i]];
+
+		for (uint32_t j = 0; j < transient_count; j++)
+		{
+			struct GraphResource *other = &graph->resources[transients[j]];
+
+			if (i == j || other->memory != resource->memory || other->last_pass >= resource->first_pass) continue;
+
+			if (resource->alias_of == GRAPH_NONE || graph->resources[resource->alias_of].last_pass < other->last_pass) {
+				resource->alias_of = transients[j];
+			}
+		}
+	}
+
+	for (uint32_t m = 0; m < graph->memory_count; m++)
+	{
+		struct GraphMemory *memory = &graph->memories[m];
+
+		VkMemoryAllocateInfo allocate_info = {
+			.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+			.pNext = NULL,
+			.allocationSize = memory->size,
+			.memoryTypeIndex = find_memory_type(physical_device, memory->type_bits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT),
+		};
+
+		VkResult result = vkAllocateMemory(device, &allocate_info, NULL, &memory->memory);
+		if (result != VK_SUCCESS) memory->memory = VK_NULL_HANDLE;
+		if (result != VK_SUCCESS) report_render_failure(result, "allocate frame graph memory");
+		if (result == VK_SUCCESS) track_resource(RESOURCE_MEMORY, memory->memory, allocate_info.allocationSize);
+
+		graph->allocated_bytes += memory->size;
+	}
+
+	for (uint32_t i = 0; i < transient_count; i++)
+	{
+		struct GraphResource *resource = &graph->resources[transients[i]];
+
+		// the failed allocation was reported, the view is left out with it
+		if (graph->memories[resource->memory].memory == VK_NULL_HANDLE) continue;
+
+		vkBindImageMemory(device, resource->image, graph->memories[resource->memory].memory, 0);
+
+		VkImageViewCreateInfo view_info = {
+			.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+			.pNext = NULL,
+			.flags = 0,
+			.image = resource->image,
+			.viewType = VK_IMAGE_VIEW_TYPE_2D,
+			.format = resource->format,
+			.components = {
+				VK_COMPONENT_SWIZZLE_IDENTITY,
+				VK_COMPONENT_SWIZZLE_IDENTITY,
+				VK_COMPONENT_SWIZZLE_IDENTITY,
+				VK_COMPONENT_SWIZZLE_IDENTITY,
+			},
+			.subresourceRange = {
+				.aspectMask = format_aspect_flags(resource->format),
+				.baseMipLevel = 0,
+				.levelCount = 1,
+				.baseArrayLayer = 0,
+				.layerCount = 1,
+			},
+		};
+
+		VkResult result = vkCreateImageView(device, &view_info, NULL, &resource->view);
+		if (result != VK_SUCCESS) resource->view = VK_NULL_HANDLE;
+		if (result != VK_SUCCESS) report_render_failure(result, "create transient image view");
+		if (result == VK_SUCCESS) track_resource(RESOURCE_IMAGE_VIEW, resource->view, 0);
+	}
+}
+
+static struct GraphState initial_state(const struct GraphResource *resource, const struct GraphState *states)
+{
+	const struct GraphAccessInfo *info = &access_infos[resource->initial];
+
+	struct GraphState state = {
+		.layout = info->layout,
+		.write_stage = (resource->initial == GRAPH_ACCESS_NONE) ? 0 : info->stage,
+		.write_access = info->access & write_accesses,
+		.visible_stage = 0,
+		.visible_access = 0,
+		.read_stage = 0,
+	};
+
+	if (resource->alias_of != GRAPH_NONE) {
+		const struct GraphState *previous = &states[resource->alias_of];
+
+		state.write_stage = previous->write_stage | previous->read_stage;
+		state.write_access = previous->write_access;
+	}
+
+	return state;
+}
+
+static void add_barrier(struct FrameGraph *graph, struct GraphBarrier barrier)
+{
+	if (graph->barrier_count == GRAPH_MAX_BARRIERS) {
+		printf("frame graph barrier limit reached\n");
+		return;
+	}
+
+	graph->barriers[graph->barrier_count++] = barrier;
+}
+
+// records the barrier access needs against state, if any, and advances state
+static void transition(struct FrameGraph *graph, uint32_t resource_index, struct GraphState *state, enum GraphAccess access)
+{
+	const struct GraphResource *resource = &graph->resources[resource_index];
+	const struct GraphAccessInfo *info = &access_infos[access];
+
+	bool layout_change = resource->is_image && info->layout != state->layout;
+
+	struct GraphBarrier barrier = {
+		.resource = resource_index,
+		.src_stage = 0,
+		.dst_stage = info->stage,
+		.src_access = 0,
+		.dst_access = info->access,
+		.old_layout = state->layout,
+		.new_layout = resource->is_image ? info->layout : state->layout,
+	};
+
+	bool needed = layout_change;
+
+	if (info->write) {
+		// write after write and write after read
+		barrier.src_stage = state->write_stage | state->read_stage;
+		barrier.src_access = state->write_access;
+		needed = needed || barrier.src_stage != 0;
+
+		state->write_stage = info->stage;
+		state->write_access = info->access & write_accesses;
+		state->visible_stage = info->stage;
+		state->visible_access = info->access;
+		state->read_stage = 0;
+	}
+	else {
+		// read after write, only when this stage has not been made visible yet
+		bool hidden = (info->stage & ~state->visible_stage) || (info->access & ~state->visible_access);
+
+		needed = needed || (state->write_stage != 0 && hidden);
+
+		barrier.src_stage = state->write_stage | (layout_change ? state->read_stage : 0);
+		barrier.src_access = state->write_access;
+
+		if (layout_change) {
+			// the transition itself is a write later readers have to wait for
+			state->write_stage = info->stage;
+			state->write_access = 0;
+			state->visible_stage = info->stage;
+			state->visible_access = info->access;
+			state->read_stage = info->stage;
+		}
+		else {
+			if (needed) {
+				state->visible_stage |= info->stage;
+				state->visible_access |= info->access;
+			}
+			state->read_stage |= info->stage;
+		}
+	}
+
+	if (resource->is_image) state->layout = info->layout;
+
+	if (needed) add_barrier(graph, barrier);
+}
+
+static void compute_barriers(struct FrameGraph *graph)
+{
+	struct GraphState states[GRAPH_MAX_RESOURCES];
+	bool started[GRAPH_MAX_RESOURCES] = {false};
+
+	graph->barrier_count = 0;
+
+	for (uint32_t i = 0; i < graph->pass_count; i++)
+	{
+		struct GraphPass *pass = &graph->passes[i];
+
+		pass->barrier_first = graph->barrier_count;
+		pass->barrier_count = 0;
+
+		if (pass->culled) continue;
+
+		for (uint32_t j = 0; j < pass->use_count; j++)
+		{
+			struct GraphUse use = pass->uses[j];
+
+			if (!started[use.resource]) {
+				states[use.resource] = initial_state(&graph->resources[use.resource], states);
+				started[use.resource] = true;
+			}
+
+			transition(graph, use.resource, &states[use.resource], use.access);
+		}
+
+		pass->barrier_count = graph->barrier_count - pass->barrier_first;
+	}
+
+	graph->tail_first = graph->barrier_count;
+
+	for (uint32_t i = 0; i < graph->resource_count; i++)
+	{
+		struct GraphResource *resource = &graph->resources[i];
+
+		if (!resource->imported || resource->final == GRAPH_ACCESS_NONE) continue;
+
+		if (!started[i]) {
+			states[i] = initial_state(resource, states);
+			started[i] = true;
+		}
+
+		transition(graph, i, &states[i], resource->final);
+	}
+
+	graph->tail_count = graph->barrier_count - graph->tail_first;
+}
+
+void graph_compile(struct FrameGraph *graph, VkPhysicalDevice physical_device, VkDevice device)
+{
+	destroy_transients(device, graph);
+
+	cull_passes(graph);
+	compute_lifetimes(graph);
+	create_transients(graph, physical_device, device);
+	compute_barriers(graph);
+
+	graph->compiled = true;
+}
+
+static void emit_barriers(const struct FrameGraph *graph, VkCommandBuffer command_buffer, uint32_t first, uint32_t count)
+{
+	if (count == 0) return;
+
+	VkImageMemoryBarrier image_barriers[GRAPH_MAX_USES + GRAPH_MAX_RESOURCES];
+	uint32_t image_barrier_count = 0;
+
+	VkMemoryBarrier memory_barrier = {
+		.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+		.pNext = NULL,
+		.srcAccessMask = 0,
+		.dstAccessMask = 0,
+	};
+	bool has_memory_barrier = false;
+
+	VkPipelineStageFlags src_stage = 0;
+	VkPipelineStageFlags dst_stage = 0;
+
+	for (uint32_t i = first; i < first + count; i++)
+	{
+		const struct GraphBarrier *barrier = &graph->barriers[i];
+		const struct GraphResource *resource = &graph->resources[barrier->resource];
+
+		src_stage |= barrier->src_stage;
+		dst_stage |= barrier->dst_stage;
+
+		if (!resource->is_image) {
+			// buffer hazards fold into a single global memory barrier
+			memory_barrier.srcAccessMask |= barrier->src_access;
+			memory_barrier.dstAccessMask |= barrier->dst_access;
+			has_memory_barrier = true;
+			continue;
+		}
+
+		image_barriers[image_barrier_count++] = (VkImageMemoryBarrier) {
+			.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+			.pNext = NULL,
+			.srcAccessMask = barrier->src_access,
+			.dstAccessMask = barrier->dst_access,
+			.oldLayout = barrier->old_layout,
+			.newLayout = barrier->new_layout,
+			.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.image = resource->image,
+			.subresourceRange = {
+				.aspectMask = format_aspect_flags(resource->format),
+				.baseMipLevel = 0,
+				.levelCount = VK_REMAINING_MIP_LEVELS,
+				.baseArrayLayer = 0,
+				.layerCount = VK_REMAINING_ARRAY_LAYERS,
+			},
+		};
+	}
+
+	if (src_stage == 0) src_stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+	if (dst_stage == 0) dst_stage = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+
+	vkCmdPipelineBarrier(command_buffer, src_stage, dst_stage, 0, has_memory_barrier ? 1 : 0, &memory_barrier, 0, NULL, image_barrier_count, image_barriers);
+}
+
+void graph_execute(struct FrameGraph *graph, VkCommandBuffer command_buffer)
+{
+	if (!graph->compiled) printf("frame graph executed before it was compiled\n");
+
+	for (uint32_t i = 0; i < graph->pass_count; i++)
+	{
+		struct GraphPass *pass = &graph->passes[i];
+		if (pass->culled) continue;
+
+		emit_barriers(graph, command_buffer, pass->barrier_first, pass->barrier_count);
+
+		if (pass->execute != NULL) pass->execute(command_buffer, pass->user_data);
+	}
+
+	emit_barriers(graph, command_buffer, graph->tail_first, graph->tail_count);
+}
+
+VkImage graph_image(const struct FrameGraph *graph, uint32_t resource)
+{
+	return graph->resources[resource].image;
+}
+
+VkImageView graph_image_view(const struct FrameGraph *graph, uint32_t resource)
+{
+	return graph->resources[resource].view;
+}
+
+void print_frame_graph(const struct FrameGraph *graph)
+{
+	printf("frame graph: %u passes (%u culled), %u barriers\n", graph->pass_count, graph->culled_pass_count, graph->barrier_count);
+
+	for (uint32_t i = 0; i < graph->pass_count; i++)
+	{
+		const struct GraphPass *pass = &graph->passes[i];
+		printf("\tpass[%u] %s%s, %u barriers\n", i, pass->name, pass->culled ? " (culled)" : "", pass->barrier_count);
+	}
+
+	printf("\ttransient memory: %lu bytes in %u allocations, %lu bytes without aliasing\n", (unsigned long) graph->allocated_bytes, graph->memory_count, (unsigned long) graph->transient_bytes);
+}
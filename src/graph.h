@@ -0,0 +1,144 @@
+#pragma once
+
+#include "render.h"
+
+// Frame graph. Passes declare which resources they read and write, and
+// graph_compile works out everything that used to be written by hand:
+//
+//   - passes whose results never reach an output are culled
+//   - every hazard gets the minimal pipeline barrier and layout transition,
+//     merged into one vkCmdPipelineBarrier per pass
+//   - transient images whose lifetimes do not overlap share device memory
+//
+// Imported resources (swapchain images, long lived buffers) keep their
+// handles outside the graph and may be rebound every frame.
+
+#define GRAPH_MAX_PASSES 32
+#define GRAPH_MAX_RESOURCES 64
+#define GRAPH_MAX_USES 16
+#define GRAPH_MAX_BARRIERS 256
+#define GRAPH_NONE UINT32_MAX
+
+enum GraphAccess {
+	GRAPH_ACCESS_NONE,             // contents are undefined
+	GRAPH_ACCESS_ACQUIRE,          // swapchain image, acquire semaphore waited at color output
+	GRAPH_ACCESS_PRESENT,
+	GRAPH_ACCESS_COLOR_ATTACHMENT,
+	GRAPH_ACCESS_STENCIL_ATTACHMENT,
+	GRAPH_ACCESS_FRAGMENT_SAMPLED,
+	GRAPH_ACCESS_COMPUTE_SAMPLED,
+	GRAPH_ACCESS_COMPUTE_READ,
+	GRAPH_ACCESS_COMPUTE_WRITE,
+	GRAPH_ACCESS_VERTEX_READ,
+	GRAPH_ACCESS_INDIRECT_READ,
+	GRAPH_ACCESS_TRANSFER_READ,
+	GRAPH_ACCESS_TRANSFER_WRITE,
+	GRAPH_ACCESS_COUNT,
+};
+
+typedef void (*GraphExecute)(VkCommandBuffer command_buffer, void *user_data);
+
+struct GraphResource {
+	const char *name;
+	bool is_image;
+	bool imported;
+
+	VkFormat format;
+	VkExtent2D extent;
+	VkImageUsageFlags usage;
+
+	VkImage image;
+	VkImageView view;
+	VkBuffer buffer;
+
+	enum GraphAccess initial;
+	enum GraphAccess final;
+
+	// filled in by graph_compile
+	uint32_t refcount;
+	uint32_t first_pass;
+	uint32_t last_pass;
+	uint32_t memory;
+	uint32_t alias_of; // previous occupant of the same memory, or GRAPH_NONE
+	VkMemoryRequirements requirements;
+};
+
+struct GraphUse {
+	uint32_t resource;
+	enum GraphAccess access;
+};
+
+struct GraphBarrier {
+	uint32_t resource;
+	VkPipelineStageFlags src_stage;
+	VkPipelineStageFlags dst_stage;
+	VkAccessFlags src_access;
+	VkAccessFlags dst_access;
+	VkImageLayout old_layout;
+	VkImageLayout new_layout;
+};
+
+struct GraphPass {
+	const char *name;
+	GraphExecute execute;
+	void *user_data;
+
+	struct GraphUse uses[GRAPH_MAX_USES];
+	uint32_t use_count;
+
+	bool side_effects;
+
+	// filled in by graph_compile
+	bool culled;
+	uint32_t refcount;
+	uint32_t barrier_first;
+	uint32_t barrier_count;
+};
+
+struct GraphMemory {
+	VkDeviceMemory memory;
+	VkDeviceSize size;
+	uint32_t type_bits;
+};
+
+struct FrameGraph {
+	struct GraphPass passes[GRAPH_MAX_PASSES];
+	uint32_t pass_count;
+
+	struct GraphResource resources[GRAPH_MAX_RESOURCES];
+	uint32_t resource_count;
+
+	// barriers[passes[i].barrier_first ...] run before pass i, the tail moves outputs to their final state
+	struct GraphBarrier barriers[GRAPH_MAX_BARRIERS];
+	uint32_t barrier_count;
+	uint32_t tail_first;
+	uint32_t tail_count;
+
+	struct GraphMemory memories[GRAPH_MAX_RESOURCES];
+	uint32_t memory_count;
+
+	bool compiled;
+	uint32_t culled_pass_count;
+	VkDeviceSize transient_bytes; // what the transients would need without aliasing
+	VkDeviceSize allocated_bytes;
+};
+
+struct FrameGraph *create_frame_graph(void);
+void destroy_frame_graph(VkDevice device, struct FrameGraph *graph);
+
+uint32_t graph_import_image(struct FrameGraph *graph, const char *name, VkFormat format, VkExtent2D extent, enum GraphAccess initial, enum GraphAccess final);
+uint32_t graph_import_buffer(struct FrameGraph *graph, const char *name, VkBuffer buffer);
+uint32_t graph_create_image(struct FrameGraph *graph, const char *name, VkFormat format, VkExtent2D extent);
+void graph_bind_image(struct FrameGraph *graph, uint32_t resource, VkImage image, VkImageView view);
+
+uint32_t graph_add_pass(struct FrameGraph *graph, const char *name, GraphExecute execute, void *user_data);
+void graph_read(struct FrameGraph *graph, uint32_t pass, uint32_t resource, enum GraphAccess access);
+void graph_write(struct FrameGraph *graph, uint32_t pass, uint32_t resource, enum GraphAccess access);
+void graph_set_side_effects(struct FrameGraph *graph, uint32_t pass);
+
+void graph_compile(struct FrameGraph *graph, VkPhysicalDevice physical_device, VkDevice device);
+void graph_execute(struct FrameGraph *graph, VkCommandBuffer command_buffer);
+
+VkImage graph_image(const struct FrameGraph *graph, uint32_t resource);
+VkImageView graph_image_view(const struct FrameGraph *graph, uint32_t resource);
+void print_frame_graph(const struct FrameGraph *graph);
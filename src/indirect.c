@@ -0,0 +1,315 @@
+#include <vulkan/vulkan.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "render.h"
+#include "indirect.h"
+#include "track.h"
+
+struct CullParams {
+	float viewport[4];
+	uint32_t count;
+	uint32_t phase;
+};
+
+static VkDescriptorSetLayout create_indirect_set_layout(VkDevice device)
+{
+	VkDescriptorSetLayoutBinding bindings[5];
+
+	for (uint32_t i = 0; i < 5; i++)
+	{
+		bindings[i] = (VkDescriptorSetLayoutBinding) {
+			.binding = i,
+			.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			.descriptorCount = 1,
+			.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_VERTEX_BIT,
+			.pImmutableSamplers = NULL,
+		};
+	}
+
+	VkDescriptorSetLayoutCreateInfo set_layout_info = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+		.pNext = NULL,
+		.flags = 0,
+		.bindingCount = 5,
+		.pBindings = bindings,
+	};
+
+	VkDescriptorSetLayout set_layout;
+	VkResult result = vkCreateDescriptorSetLayout(device, &set_layout_info, NULL, &set_layout);
+	if (result != VK_SUCCESS) printf("failed to create indirect descriptor set layout\n");
+	if (result == VK_SUCCESS) track_resource(RESOURCE_DESCRIPTOR_SET_LAYOUT, set_layout, 0);
+
+	return set_layout;
+}
+
+static VkPipelineLayout create_indirect_pipeline_layout(VkDevice device, VkDescriptorSetLayout set_layout, VkShaderStageFlags stage, uint32_t push_size)
+{
+	VkPushConstantRange push_range = {
+		.stageFlags = stage,
+		.offset = 0,
+		.size = push_size,
+	};
+
+	VkPipelineLayoutCreateInfo pipeline_layout_info = {
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+		.pNext = NULL,
+		.flags = 0,
+		.setLayoutCount = 1,
+		.pSetLayouts = &set_layout,
+		.pushConstantRangeCount = 1,
+		.pPushConstantRanges = &push_range,
+	};
+
+	VkPipelineLayout pipeline_layout;
+	VkResult result = vkCreatePipelineLayout(device, &pipeline_layout_info, NULL, &pipeline_layout);
+	if (result != VK_SUCCESS) printf("failed to create indirect pipeline layout\n");
+	if (result == VK_SUCCESS) track_resource(RESOURCE_PIPELINE_LAYOUT, pipeline_layout, 0);
+
+	return pipeline_layout;
+}
+
+static VkDescriptorSet create_indirect_descriptor_set(VkDevice device, struct IndirectRenderer *renderer)
+{
+	VkDescriptorPoolSize pool_size = {
+		.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+		.descriptorCount = 5,
+	};
+
+	VkDescriptorPoolCreateInfo pool_info = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+		.pNext = NULL,
+		.flags = 0,
+		.maxSets = 1,
+		.poolSizeCount = 1,
+		.pPoolSizes = &pool_size,
+	};
+
+	VkResult result = vkCreateDescriptorPool(device, &pool_info, NULL, &renderer->descriptor_pool);
+	if (result != VK_SUCCESS) printf("failed to create indirect descriptor pool\n");
+	if (result == VK_SUCCESS) track_resource(RESOURCE_DESCRIPTOR_POOL, renderer->descriptor_pool, 0);
+
+	VkDescriptorSetAllocateInfo allocate_info = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+		.pNext = NULL,
+		.descriptorPool = renderer->descriptor_pool,
+		.descriptorSetCount = 1,
+		.pSetLayouts = &renderer->set_layout,
+	};
+
+	VkDescriptorSet descriptor_set;
+	result = vkAllocateDescriptorSets(device, &allocate_info, &descriptor_set);
+	if (result != VK_SUCCESS) printf("failed to allocate indirect descriptor set\n");
+
+	struct Buffer *buffers[5] = {
+		&renderer->instance_buffer,
+		&renderer->clip_buffer,
+		&renderer->visible_buffer,
+		&renderer->indirect_buffer,
+		&renderer->group_buffer,
+	};
+
+	VkDescriptorBufferInfo buffer_infos[5];
+	VkWriteDescriptorSet writes[5];
+
+	for (uint32_t i = 0; i < 5; i++)
+	{
+		buffer_infos[i] = (VkDescriptorBufferInfo) {
+			.buffer = buffers[i]->buffer,
+			.offset = 0,
+			.range = VK_WHOLE_SIZE,
+		};
+
+		writes[i] = (VkWriteDescriptorSet) {
+			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			.pNext = NULL,
+			.dstSet = descriptor_set,
+			.dstBinding = i,
+			.dstArrayElement = 0,
+			.descriptorCount = 1,
+			.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			.pImageInfo = NULL,
+			.pBufferInfo = &buffer_infos[i],
+			.pTexelBufferView = NULL,
+		};
+	}
+
+	vkUpdateDescriptorSets(device, 5, writes, 0, NULL);
+
+	return descriptor_set;
+}
+
+struct IndirectRenderer create_indirect_renderer(VkPhysicalDevice physical_device, VkDevice device, VkCommandPool command_pool, VkQueue queue, VkExtent2D extent, VkRenderPass render_pass, VkFormat color_format, VkFormat stencil_format, const struct SpriteInstance *instances, uint32_t instance_count, const struct ClipRect *clips, uint32_t clip_count)
+{
+	struct IndirectRenderer renderer = {0};
+
+	renderer.instance_count = instance_count;
+	renderer.clip_count = clip_count;
+	renderer.group_count = (instance_count + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE;
+
+	// zero sized buffers are not allowed, so empty scenes still get one element
+
+	VkDeviceSize instance_size = (instance_count ? instance_count : 1) * sizeof(struct SpriteInstance);
+	VkDeviceSize clip_size = (clip_count ? clip_count : 1) * sizeof(struct ClipRect);
+	VkDeviceSize visible_size = (instance_count ? instance_count : 1) * sizeof(uint32_t);
+	VkDeviceSize group_size = (renderer.group_count ? renderer.group_count : 1) * sizeof(uint32_t);
+
+	VkMemoryPropertyFlags device_local = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+
+	renderer.instance_buffer = create_buffer(physical_device, device, instance_size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, device_local);
+	renderer.clip_buffer = create_buffer(physical_device, device, clip_size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, device_local);
+	renderer.visible_buffer = create_buffer(physical_device, device, visible_size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, device_local);
+	renderer.group_buffer = create_buffer(physical_device, device, group_size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, device_local);
+	renderer.indirect_buffer = create_buffer(physical_device, device, sizeof(VkDrawIndexedIndirectCommand), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, device_local);
+	renderer.index_buffer = create_buffer(physical_device, device, 6 * sizeof(uint16_t), VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, device_local);
+	renderer.host_visible_buffer = create_buffer(physical_device, device, visible_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+	// everything static is uploaded exactly once
+
+	if (instance_count) upload_buffer(physical_device, device, command_pool, queue, &renderer.instance_buffer, instances, instance_count * sizeof(struct SpriteInstance));
+	if (clip_count) upload_buffer(physical_device, device, command_pool, queue, &renderer.clip_buffer, clips, clip_count * sizeof(struct ClipRect));
+
+	uint16_t indices[6] = {0, 1, 2, 2, 3, 0};
+	upload_buffer(physical_device, device, command_pool, queue, &renderer.index_buffer, indices, sizeof(indices));
+
+	VkDrawIndexedIndirectCommand command = {
+		.indexCount = 6,
+		.instanceCount = 0, // written by the cull pass
+		.firstIndex = 0,
+		.vertexOffset = 0,
+		.firstInstance = 0,
+	};
+	upload_buffer(physical_device, device, command_pool, queue, &renderer.indirect_buffer, &command, sizeof(command));
+
+	renderer.set_layout = create_indirect_set_layout(device);
+	renderer.descriptor_set = create_indirect_descriptor_set(device, &renderer);
+
+	renderer.cull_layout = create_indirect_pipeline_layout(device, renderer.set_layout, VK_SHADER_STAGE_COMPUTE_BIT, sizeof(struct CullParams));
+	renderer.cull_pipeline = create_compute_pipeline(device, renderer.cull_layout, "../assets/shaders/cull_comp.spv");
+
+	renderer.draw_layout = create_indirect_pipeline_layout(device, renderer.set_layout, VK_SHADER_STAGE_VERTEX_BIT, 4 * sizeof(float));
+	renderer.draw_pipeline = create_graphics_pipeline(device, extent, render_pass, color_format, stencil_format, renderer.draw_layout, "../assets/shaders/sprite_vert.spv", "../assets/shaders/sprite_frag.spv", false);
+
+	return renderer;
+}
+
+void destroy_indirect_renderer(VkDevice device, struct IndirectRenderer *renderer)
+{
+	untrack_resource(RESOURCE_PIPELINE, renderer->draw_pipeline);
+	vkDestroyPipeline(device, renderer->draw_pipeline, NULL);
+	untrack_resource(RESOURCE_PIPELINE_LAYOUT, renderer->draw_layout);
+	vkDestroyPipelineLayout(device, renderer->draw_layout, NULL);
+	untrack_resource(RESOURCE_PIPELINE, renderer->cull_pipeline);
+	vkDestroyPipeline(device, renderer->cull_pipeline, NULL);
+	untrack_resource(RESOURCE_PIPELINE_LAYOUT, renderer->cull_layout);
+	vkDestroyPipelineLayout(device, renderer->cull_layout, NULL);
+
+	untrack_resource(RESOURCE_DESCRIPTOR_POOL, renderer->descriptor_pool);
+	vkDestroyDescriptorPool(device, renderer->descriptor_pool, NULL);
+	untrack_resource(RESOURCE_DESCRIPTOR_SET_LAYOUT, renderer->set_layout);
+	vkDestroyDescriptorSetLayout(device, renderer->set_layout, NULL);
+
+	destroy_buffer(device, &renderer->host_visible_buffer);
+	destroy_buffer(device, &renderer->index_buffer);
+	destroy_buffer(device, &renderer->indirect_buffer);
+	destroy_buffer(device, &renderer->group_buffer);
+	destroy_buffer(device, &renderer->visible_buffer);
+	destroy_buffer(device, &renderer->clip_buffer);
+	destroy_buffer(device, &renderer->instance_buffer);
+}
+
+static void compute_to_compute_barrier(VkCommandBuffer command_buffer)
+{
+	VkMemoryBarrier barrier = {
+		.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+		.pNext = NULL,
+		.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+		.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+	};
+
+	vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, NULL, 0, NULL);
+}
+
+void record_indirect_cull(VkCommandBuffer command_buffer, struct IndirectRenderer *renderer, struct ClipRect viewport)
+{
+	if (renderer->group_count == 0) return;
+
+	struct CullParams params = {
+		.viewport = {viewport.x0, viewport.y0, viewport.x1, viewport.y1},
+		.count = renderer->instance_count,
+		.phase = 0,
+	};
+
+	vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, renderer->cull_pipeline);
+	vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, renderer->cull_layout, 0, 1, &renderer->descriptor_set, 0, NULL);
+
+	// count survivors per group
+
+	vkCmdPushConstants(command_buffer, renderer->cull_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(params), &params);
+	vkCmdDispatch(command_buffer, renderer->group_count, 1, 1);
+
+	compute_to_compute_barrier(command_buffer);
+
+	// scan group counts into offsets, writes the indirect instance count
+
+	params.phase = 1;
+	vkCmdPushConstants(command_buffer, renderer->cull_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(params), &params);
+	vkCmdDispatch(command_buffer, 1, 1, 1);
+
+	compute_to_compute_barrier(command_buffer);
+
+	// compact survivors in submission order
+
+	params.phase = 2;
+	vkCmdPushConstants(command_buffer, renderer->cull_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(params), &params);
+	vkCmdDispatch(command_buffer, renderer->group_count, 1, 1);
+
+	// the frame graph makes the results visible to the indirect draw
+}
+
+// cpu culled alternative to record_indirect_cull, feeds the same indirect draw
+void record_indirect_visible(VkCommandBuffer command_buffer, struct IndirectRenderer *renderer, const uint32_t *visible, uint32_t visible_count)
+{
+	if (visible_count > renderer->instance_count) visible_count = renderer->instance_count;
+
+	// the previous frame has finished with the host buffer once its fence is waited on
+
+	if (visible_count > 0) {
+		// callers may have culled straight into the host buffer
+		if (visible != renderer->host_visible_buffer.mapped) memcpy(renderer->host_visible_buffer.mapped, visible, visible_count * sizeof(uint32_t));
+
+		VkBufferCopy region = {
+			.srcOffset = 0,
+			.dstOffset = 0,
+			.size = visible_count * sizeof(uint32_t),
+		};
+
+		vkCmdCopyBuffer(command_buffer, renderer->host_visible_buffer.buffer, renderer->visible_buffer.buffer, 1, &region);
+	}
+
+	vkCmdUpdateBuffer(command_buffer, renderer->indirect_buffer.buffer, offsetof(VkDrawIndexedIndirectCommand, instanceCount), sizeof(uint32_t), &visible_count);
+}
+
+void record_indirect_draw(VkCommandBuffer command_buffer, struct IndirectRenderer *renderer, struct ClipRect viewport)
+{
+	if (renderer->group_count == 0) return;
+
+	float transform[4] = {
+		viewport.x0,
+		viewport.y0,
+		2.0f / (viewport.x1 - viewport.x0),
+		2.0f / (viewport.y1 - viewport.y0),
+	};
+
+	vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, renderer->draw_pipeline);
+	vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, renderer->draw_layout, 0, 1, &renderer->descriptor_set, 0, NULL);
+	vkCmdPushConstants(command_buffer, renderer->draw_layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(transform), transform);
+	vkCmdBindIndexBuffer(command_buffer, renderer->index_buffer.buffer, 0, VK_INDEX_TYPE_UINT16);
+
+	vkCmdDrawIndexedIndirect(command_buffer, renderer->indirect_buffer.buffer, 0, 1, sizeof(VkDrawIndexedIndirectCommand));
+}
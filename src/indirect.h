@@ -0,0 +1,54 @@
+#pragma once
+
+#include "render.h"
+
+// GPU driven sprite drawing: every instance is uploaded once, a compute pass
+// culls them against the viewport and their clip rect and compacts the
+// survivors, and a single vkCmdDrawIndexedIndirect draws whatever is left.
+
+#define CULL_GROUP_SIZE 256
+
+struct SpriteInstance {
+	float rect[4];  // x, y, width, height
+	float color[4];
+	uint32_t clip;  // index into the clip rect array
+	uint32_t layer;
+	uint32_t pad[2];
+};
+
+struct ClipRect {
+	float x0, y0, x1, y1;
+};
+
+struct IndirectRenderer {
+	uint32_t instance_count;
+	uint32_t clip_count;
+	uint32_t group_count;
+
+	struct Buffer instance_buffer;
+	struct Buffer clip_buffer;
+	struct Buffer visible_buffer;
+	struct Buffer group_buffer;
+	struct Buffer indirect_buffer;
+	struct Buffer index_buffer;
+	struct Buffer host_visible_buffer; // cpu culled visible list, see record_indirect_visible
+
+	VkDescriptorSetLayout set_layout;
+	VkDescriptorPool descriptor_pool;
+	VkDescriptorSet descriptor_set;
+
+	VkPipelineLayout cull_layout;
+	VkPipeline cull_pipeline;
+
+	VkPipelineLayout draw_layout;
+	VkPipeline draw_pipeline;
+};
+
+struct IndirectRenderer create_indirect_renderer(VkPhysicalDevice physical_device, VkDevice device, VkCommandPool command_pool, VkQueue queue, VkExtent2D extent, VkRenderPass render_pass, VkFormat color_format, VkFormat stencil_format, const struct SpriteInstance *instances, uint32_t instance_count, const struct ClipRect *clips, uint32_t clip_count);
+void destroy_indirect_renderer(VkDevice device, struct IndirectRenderer *renderer);
+
+// both leave the visible and indirect buffers written without a barrier, the
+// frame graph synchronizes them with record_indirect_draw
+void record_indirect_cull(VkCommandBuffer command_buffer, struct IndirectRenderer *renderer, struct ClipRect viewport);
+void record_indirect_visible(VkCommandBuffer command_buffer, struct IndirectRenderer *renderer, const uint32_t *visible, uint32_t visible_count);
+void record_indirect_draw(VkCommandBuffer command_buffer, struct IndirectRenderer *renderer, struct ClipRect viewport);
@@ -0,0 +1,251 @@
+#include <vulkan/vulkan.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "render.h"
+#include "ktx.h"
+
+static const uint8_t ktx_identifier[12] = {0xab, 'K', 'T', 'X', ' ', '2', '0', 0xbb, '\r', '\n', 0x1a, '\n'};
+
+struct KtxHeader {
+	uint8_t identifier[12];
+	uint32_t vk_format;
+	uint32_t type_size;
+	uint32_t pixel_width;
+	uint32_t pixel_height;
+	uint32_t pixel_depth;
+	uint32_t layer_count;
+	uint32_t face_count;
+	uint32_t level_count;
+	uint32_t supercompression_scheme;
+	uint32_t dfd_offset;
+	uint32_t dfd_size;
+	uint32_t kvd_offset;
+	uint32_t kvd_size;
+	uint64_t sgd_offset;
+	uint64_t sgd_size;
+};
+
+struct KtxLevelIndex {
+	uint64_t offset;
+	uint64_t size;
+	uint64_t uncompressed_size;
+};
+
+bool is_ktx(const uint8_t *data, size_t size)
+{
+	return size >= sizeof(struct KtxHeader) && memcmp(data, ktx_identifier, sizeof(ktx_identifier)) == 0;
+}
+
+bool read_ktx_info(const uint8_t *data, size_t size, struct KtxInfo *info)
+{
+	if (!is_ktx(data, size)) return false;
+
+	struct KtxHeader header;
+	memcpy(&header, data, sizeof(header));
+
+	info->format = find_block_format((VkFormat) header.vk_format);
+	info->width = header.pixel_width;
+	info->height = header.pixel_height;
+	info->level_count = header.level_count > 0 ? header.level_count : 1; // 0 asks for mips to be generated
+
+	if (info->format == NULL) {
+		printf("ktx: unsupported vkFormat %u\n", header.vk_format);
+		return false;
+	}
+
+	if (header.supercompression_scheme != 0) {
+		printf("ktx: supercompressed textures are not supported\n");
+		return false;
+	}
+
+	bool flat = header.pixel_width > 0 && header.pixel_height > 0 && header.pixel_depth == 0 && header.layer_count <= 1 && header.face_count == 1;
+
+	if (!flat || info->level_count > KTX_MAX_LEVELS || sizeof(struct KtxHeader) + info->level_count * sizeof(struct KtxLevelIndex) > size) {
+		printf("ktx: only single 2d images are supported\n");
+		return false;
+	}
+
+	for (uint32_t i = 0; i < info->level_count; i++)
+	{
+		struct KtxLevelIndex level;
+		memcpy(&level, data + sizeof(struct KtxHeader) + i * sizeof(struct KtxLevelIndex), sizeof(level));
+
+		uint32_t width = info->width >> i > 0 ? info->width >> i : 1;
+		uint32_t height = info->height >> i > 0 ? info->height >> i : 1;
+
+		if (level.size != block_level_size(info->format, width, height) || level.offset > size || level.size > size - level.offset) {
+			printf("ktx: level %u does not match its format or runs past the file\n", i);
+			return false;
+		}
+
+		info->levels[i] = (struct KtxLevel) {level.offset, level.size};
+	}
+
+	return true;
+}
+
+// data format descriptor, one basic block
+
+#define DFD_MODEL_RGBSDA 1
+#define DFD_MODEL_BC1A 128
+#define DFD_MODEL_BC3 130
+#define DFD_CHANNEL_ALPHA 15
+#define DFD_TRANSFER_LINEAR 1
+#define DFD_TRANSFER_SRGB 2
+#define DFD_PRIMARIES_BT709 1
+
+struct DfdSample {
+	uint32_t bit_offset;
+	uint32_t bit_length;
+	uint32_t channel;
+	uint32_t upper;
+};
+
+static uint32_t write_dfd(const struct BlockFormat *format, uint32_t *words)
+{
+	struct DfdSample samples[4];
+	uint32_t sample_count = 0;
+	uint32_t model;
+
+	switch (format->format)
+	{
+		case VK_FORMAT_R8G8B8A8_UNORM:
+		case VK_FORMAT_R8G8B8A8_SRGB:
+			model = DFD_MODEL_RGBSDA;
+			samples[sample_count++] = (struct DfdSample) {0, 8, 0, 255};
+			samples[sample_count++] = (struct DfdSample) {8, 8, 1, 255};
+			samples[sample_count++] = (struct DfdSample) {16, 8, 2, 255};
+			samples[sample_count++] = (struct DfdSample) {24, 8, DFD_CHANNEL_ALPHA, 255};
+			break;
+		case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+		case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+			model = DFD_MODEL_BC1A;
+			samples[sample_count++] = (struct DfdSample) {0, 64, 1, UINT32_MAX}; // alpha present
+			break;
+		case VK_FORMAT_BC3_UNORM_BLOCK:
+		case VK_FORMAT_BC3_SRGB_BLOCK:
+			model = DFD_MODEL_BC3;
+			samples[sample_count++] = (struct DfdSample) {0, 64, DFD_CHANNEL_ALPHA, UINT32_MAX};
+			samples[sample_count++] = (struct DfdSample) {64, 64, 0, UINT32_MAX};
+			break;
+		default:
+			return 0;
+	}
+
+	uint32_t transfer = format->fallback == VK_FORMAT_R8G8B8A8_SRGB ? DFD_TRANSFER_SRGB : DFD_TRANSFER_LINEAR;
+	uint32_t block_size = 24 + 16 * sample_count;
+
+	words[0] = 4 + block_size;
+	words[1] = 0;                      // khronos vendor, basic descriptor
+	words[2] = 2 | block_size << 16;   // version 1.3
+	words[3] = model | DFD_PRIMARIES_BT709 << 8 | transfer << 16;
+	words[4] = (format->block_width - 1) | (format->block_height - 1) << 8;
+	words[5] = format->block_size;
+	words[6] = 0;
+
+	for (uint32_t i = 0; i < sample_count; i++)
+	{
+		uint32_t *sample = &words[7 + 4 * i];
+
+		// alpha in an srgb format stays linear
+		uint32_t linear = transfer == DFD_TRANSFER_SRGB && samples[i].channel == DFD_CHANNEL_ALPHA && model == DFD_MODEL_RGBSDA ? 0x10 : 0;
+
+		sample[0] = samples[i].bit_offset | (samples[i].bit_length - 1) << 16 | (samples[i].channel | linear) << 24;
+		sample[1] = 0;
+		sample[2] = 0;
+		sample[3] = samples[i].upper;
+	}
+
+	return words[0];
+}
+
+static void pad_to(FILE *file, uint64_t *offset, uint64_t target)
+{
+	static const uint8_t zeros[16] = {0};
+
+	while (*offset < target)
+	{
+		uint64_t count = target - *offset < sizeof(zeros) ? target - *offset : sizeof(zeros);
+		fwrite(zeros, 1, count, file);
+		*offset += count;
+	}
+}
+
+bool write_ktx(const char *path, const struct BlockFormat *format, uint32_t width, uint32_t height, uint32_t level_count, const uint8_t *const *levels)
+{
+	uint32_t dfd[4 + 7 + 16];
+	uint32_t dfd_size = write_dfd(format, dfd);
+
+	if (dfd_size == 0 || level_count == 0 || level_count > KTX_MAX_LEVELS) {
+		printf("failed to write %s, %s textures can not be packed\n", path, format->name);
+		return false;
+	}
+
+	FILE *file = fopen(path, "wb");
+	if (file == NULL) {
+		printf("failed to open %s\n", path);
+		return false;
+	}
+
+	struct KtxHeader header = {
+		.vk_format = format->format,
+		.type_size = 1,
+		.pixel_width = width,
+		.pixel_height = height,
+		.pixel_depth = 0,
+		.layer_count = 0,
+		.face_count = 1,
+		.level_count = level_count,
+		.supercompression_scheme = 0,
+		.dfd_offset = sizeof(struct KtxHeader) + level_count * sizeof(struct KtxLevelIndex),
+		.dfd_size = dfd_size,
+		.kvd_offset = 0,
+		.kvd_size = 0,
+		.sgd_offset = 0,
+		.sgd_size = 0,
+	};
+	memcpy(header.identifier, ktx_identifier, sizeof(ktx_identifier));
+
+	// levels go smallest first, each aligned to the block size and 4
+	uint64_t alignment = format->block_size > 4 ? format->block_size : 4;
+	uint64_t offset = header.dfd_offset + dfd_size;
+
+	struct KtxLevelIndex index[KTX_MAX_LEVELS];
+
+	for (int i = (int) level_count - 1; i >= 0; i--)
+	{
+		uint32_t level_width = width >> i > 0 ? width >> i : 1;
+		uint32_t level_height = height >> i > 0 ? height >> i : 1;
+
+		uint64_t size = block_level_size(format, level_width, level_height);
+
+		offset = (offset + alignment - 1) / alignment * alignment;
+		index[i] = (struct KtxLevelIndex) {offset, size, size};
+		offset += size;
+	}
+
+	fwrite(&header, 1, sizeof(header), file);
+	fwrite(index, sizeof(struct KtxLevelIndex), level_count, file);
+	fwrite(dfd, 1, dfd_size, file);
+
+	offset = header.dfd_offset + dfd_size;
+
+	for (int i = (int) level_count - 1; i >= 0; i--)
+	{
+		pad_to(file, &offset, index[i].offset);
+		fwrite(levels[i], 1, index[i].size, file);
+		offset += index[i].size;
+	}
+
+	bool written = ferror(file) == 0;
+	if (fclose(file) != 0) written = false;
+
+	if (!written) printf("failed to write %s\n", path);
+
+	return written;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "render.h"
+#include "blocks.h"
+
+// KTX2 containers, as written by vg_pack. Only 2D textures with one layer
+// and face and no supercompression are read; the data format descriptor is
+// written for other tools but ignored here, vkFormat says everything the
+// loader needs.
+
+#define KTX_MAX_LEVELS 16
+
+struct KtxLevel {
+	uint64_t offset; // in the file
+	uint64_t size;
+};
+
+struct KtxInfo {
+	const struct BlockFormat *format;
+	uint32_t width;
+	uint32_t height;
+	uint32_t level_count;
+	struct KtxLevel levels[KTX_MAX_LEVELS]; // level 0 is the full size image
+};
+
+bool is_ktx(const uint8_t *data, size_t size);
+
+// checks the level index against the file, false for anything that can not be loaded
+bool read_ktx_info(const uint8_t *data, size_t size, struct KtxInfo *info);
+
+// levels[i] holds level i, block_level_size bytes
+bool write_ktx(const char *path, const struct BlockFormat *format, uint32_t width, uint32_t height, uint32_t level_count, const uint8_t *const *levels);
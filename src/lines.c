@@ -0,0 +1,502 @@
+#include <vulkan/vulkan.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "render.h"
+#include "lines.h"
+#include "track.h"
+
+#define LINES_GROUP_SIZE 256
+#define LINES_MAX_GROUPS 65535 // per dispatch dimension, the least every device allows
+
+// counters lines.comp adds to, per frame in flight
+#define LINES_STAT_CULLED 0
+#define LINES_STAT_FOLDED 1
+#define LINES_STAT_BINNED 2
+#define LINES_STAT_OVERFLOWED 3
+#define LINES_STAT_COUNT 4
+
+enum LinePhase {
+	LINE_PHASE_SEGMENTS, // cull, fold into columns or bin
+	LINE_PHASE_COLUMNS,  // bin the column spans
+	LINE_PHASE_RASTER,   // one workgroup per tile
+};
+
+// push constants of lines.comp
+struct LineParams {
+	uint32_t size[2];
+	uint32_t tiles_x;
+	uint32_t slot;
+	uint32_t polyline_count;
+	uint32_t segment_count;
+	uint32_t column_count; // series times target width
+	uint32_t phase;        // enum LinePhase
+	uint32_t series[LINES_MAX_SERIES];
+};
+
+// push constants of composite.vert and composite.frag
+struct LineCompositeParams {
+	float rect[4];  // x0, y0, x1, y1 in clip space
+	float color[4];
+};
+
+static VkDescriptorSetLayout create_lines_set_layout(VkDevice device)
+{
+	VkDescriptorSetLayoutBinding bindings[7];
+
+	for (uint32_t i = 0; i < 7; i++)
+	{
+		bindings[i] = (VkDescriptorSetLayoutBinding) {
+			.binding = i,
+			.descriptorType = i == 6 ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			.descriptorCount = 1,
+			.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+			.pImmutableSamplers = NULL,
+		};
+	}
+
+	VkDescriptorSetLayoutCreateInfo set_layout_info = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+		.pNext = NULL,
+		.flags = 0,
+		.bindingCount = 7,
+		.pBindings = bindings,
+	};
+
+	VkDescriptorSetLayout set_layout;
+	VkResult result = vkCreateDescriptorSetLayout(device, &set_layout_info, NULL, &set_layout);
+	if (result != VK_SUCCESS) printf("failed to create lines descriptor set layout\n");
+	if (result == VK_SUCCESS) track_resource(RESOURCE_DESCRIPTOR_SET_LAYOUT, set_layout, 0);
+
+	return set_layout;
+}
+
+static VkDescriptorSetLayout create_composite_set_layout(VkDevice device)
+{
+	VkDescriptorSetLayoutBinding binding = {
+		.binding = 0,
+		.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+		.descriptorCount = 1,
+		.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+		.pImmutableSamplers = NULL,
+	};
+
+	VkDescriptorSetLayoutCreateInfo set_layout_info = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+		.pNext = NULL,
+		.flags = 0,
+		.bindingCount = 1,
+		.pBindings = &binding,
+	};
+
+	VkDescriptorSetLayout set_layout;
+	VkResult result = vkCreateDescriptorSetLayout(device, &set_layout_info, NULL, &set_layout);
+	if (result != VK_SUCCESS) printf("failed to create lines composite descriptor set layout\n");
+	if (result == VK_SUCCESS) track_resource(RESOURCE_DESCRIPTOR_SET_LAYOUT, set_layout, 0);
+
+	return set_layout;
+}
+
+static void create_lines_descriptor_sets(VkDevice device, struct LineRenderer *lines)
+{
+	VkDescriptorPoolSize pool_sizes[3] = {
+		{
+			.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			.descriptorCount = 6,
+		},
+		{
+			.type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+			.descriptorCount = 1,
+		},
+		{
+			.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+			.descriptorCount = 1,
+		},
+	};
+
+	VkDescriptorPoolCreateInfo pool_info = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+		.pNext = NULL,
+		.flags = 0,
+		.maxSets = 2,
+		.poolSizeCount = 3,
+		.pPoolSizes = pool_sizes,
+	};
+
+	VkResult result = vkCreateDescriptorPool(device, &pool_info, NULL, &lines->descriptor_pool);
+	if (result != VK_SUCCESS) printf("failed to create lines descriptor pool\n");
+	if (result == VK_SUCCESS) track_resource(RESOURCE_DESCRIPTOR_POOL, lines->descriptor_pool, 0);
+
+	VkDescriptorSetLayout set_layouts[2] = {lines->set_layout, lines->composite_set_layout};
+	VkDescriptorSet sets[2];
+
+	VkDescriptorSetAllocateInfo allocate_info = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+		.pNext = NULL,
+		.descriptorPool = lines->descriptor_pool,
+		.descriptorSetCount = 2,
+		.pSetLayouts = set_layouts,
+	};
+
+	result = vkAllocateDescriptorSets(device, &allocate_info, sets);
+	if (result != VK_SUCCESS) printf("failed to allocate lines descriptor sets\n");
+
+	lines->set = sets[0];
+	lines->composite_set = sets[1];
+
+	const struct Buffer *buffers[6] = {
+		&lines->point_buffer,
+		&lines->polyline_buffer,
+		&lines->column_buffer,
+		&lines->count_buffer,
+		&lines->entry_buffer,
+		&lines->stats_buffer,
+	};
+
+	VkDescriptorBufferInfo buffer_infos[6];
+	VkWriteDescriptorSet writes[8];
+
+	for (uint32_t i = 0; i < 6; i++)
+	{
+		buffer_infos[i] = (VkDescriptorBufferInfo) {
+			.buffer = buffers[i]->buffer,
+			.offset = 0,
+			.range = VK_WHOLE_SIZE,
+		};
+
+		writes[i] = (VkWriteDescriptorSet) {
+			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			.pNext = NULL,
+			.dstSet = lines->set,
+			.dstBinding = i,
+			.dstArrayElement = 0,
+			.descriptorCount = 1,
+			.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			.pImageInfo = NULL,
+			.pBufferInfo = &buffer_infos[i],
+			.pTexelBufferView = NULL,
+		};
+	}
+
+	VkDescriptorImageInfo image_infos[2] = {
+		{
+			.sampler = VK_NULL_HANDLE,
+			.imageView = lines->image.view,
+			.imageLayout = VK_IMAGE_LAYOUT_GENERAL,
+		},
+		{
+			.sampler = lines->sampler,
+			.imageView = lines->image.view,
+			.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+		},
+	};
+
+	for (uint32_t i = 0; i < 2; i++)
+	{
+		writes[6 + i] = (VkWriteDescriptorSet) {
+			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			.pNext = NULL,
+			.dstSet = i == 0 ? lines->set : lines->composite_set,
+			.dstBinding = i == 0 ? 6 : 0,
+			.dstArrayElement = 0,
+			.descriptorCount = 1,
+			.descriptorType = i == 0 ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+			.pImageInfo = &image_infos[i],
+			.pBufferInfo = NULL,
+			.pTexelBufferView = NULL,
+		};
+	}
+
+	vkUpdateDescriptorSets(device, 8, writes, 0, NULL);
+}
+
+struct LineRenderer *create_line_renderer(VkPhysicalDevice physical_device, VkDevice device, struct PipelineRegistry *registry, VkExtent2D extent, uint32_t point_capacity, uint32_t frames_in_flight)
+{
+	struct LineRenderer *lines = calloc(1, sizeof(struct LineRenderer));
+
+	lines->device = device;
+	lines->extent = extent;
+	lines->frames_in_flight = frames_in_flight > 0 ? frames_in_flight : 1;
+	lines->registry = registry;
+	lines->tiles[0] = (extent.width + LINES_TILE_SIZE - 1) / LINES_TILE_SIZE;
+	lines->tiles[1] = (extent.height + LINES_TILE_SIZE - 1) / LINES_TILE_SIZE;
+
+	// an empty buffer cannot be bound, the points always have room for one segment
+	lines->point_capacity = point_capacity > 2 ? point_capacity : 2;
+
+	VkMemoryPropertyFlags host = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	VkBufferUsageFlags storage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	uint32_t tile_count = lines->tiles[0] * lines->tiles[1];
+
+	lines->point_buffer = create_buffer(physical_device, device, (VkDeviceSize) lines->point_capacity * 2 * sizeof(float), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, host);
+	lines->polyline_buffer = create_buffer(physical_device, device, (VkDeviceSize) lines->frames_in_flight * LINES_MAX_POLYLINES * sizeof(struct LinePolylineData), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, host);
+	lines->column_buffer = create_buffer(physical_device, device, (VkDeviceSize) 2 * LINES_MAX_SERIES * extent.width * sizeof(uint32_t), storage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	lines->count_buffer = create_buffer(physical_device, device, (VkDeviceSize) tile_count * sizeof(uint32_t), storage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	lines->entry_buffer = create_buffer(physical_device, device, (VkDeviceSize) tile_count * LINES_TILE_CAPACITY * 2 * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	lines->stats_buffer = create_buffer(physical_device, device, (VkDeviceSize) lines->frames_in_flight * LINES_STAT_COUNT * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, host);
+	if (lines->stats_buffer.mapped != NULL) memset(lines->stats_buffer.mapped, 0, lines->stats_buffer.size);
+
+	lines->image = create_image(physical_device, device, extent, LINES_FORMAT, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
+	lines->sampler = create_sampler(device, VK_FILTER_NEAREST, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE);
+
+	lines->set_layout = create_lines_set_layout(device);
+	lines->composite_set_layout = create_composite_set_layout(device);
+	create_lines_descriptor_sets(device, lines);
+
+	lines->layout = create_pipeline_layout(device, 1, &lines->set_layout, VK_SHADER_STAGE_COMPUTE_BIT, sizeof(struct LineParams));
+	lines->pipeline = create_compute_pipeline(device, lines->layout, "../assets/shaders/lines_comp.spv");
+
+	// the image covers the target, the registry builds a composite pipeline for the pass drawing it
+	lines->composite_layout = create_pipeline_layout(device, 1, &lines->composite_set_layout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(struct LineCompositeParams));
+	lines->composite_program = register_pipeline_program(registry, "../assets/shaders/composite_vert.spv", "../assets/shaders/composite_frag.spv", lines->composite_layout);
+
+	return lines;
+}
+
+void destroy_line_renderer(struct LineRenderer *lines)
+{
+	VkDevice device = lines->device;
+
+	untrack_resource(RESOURCE_PIPELINE_LAYOUT, lines->composite_layout);
+	vkDestroyPipelineLayout(device, lines->composite_layout, NULL);
+	untrack_resource(RESOURCE_PIPELINE, lines->pipeline);
+	vkDestroyPipeline(device, lines->pipeline, NULL);
+	untrack_resource(RESOURCE_PIPELINE_LAYOUT, lines->layout);
+	vkDestroyPipelineLayout(device, lines->layout, NULL);
+
+	untrack_resource(RESOURCE_DESCRIPTOR_POOL, lines->descriptor_pool);
+	vkDestroyDescriptorPool(device, lines->descriptor_pool, NULL);
+	untrack_resource(RESOURCE_DESCRIPTOR_SET_LAYOUT, lines->composite_set_layout);
+	vkDestroyDescriptorSetLayout(device, lines->composite_set_layout, NULL);
+	untrack_resource(RESOURCE_DESCRIPTOR_SET_LAYOUT, lines->set_layout);
+	vkDestroyDescriptorSetLayout(device, lines->set_layout, NULL);
+
+	untrack_resource(RESOURCE_SAMPLER, lines->sampler);
+	vkDestroySampler(device, lines->sampler, NULL);
+	destroy_image(device, &lines->image);
+	destroy_buffer(device, &lines->stats_buffer);
+	destroy_buffer(device, &lines->entry_buffer);
+	destroy_buffer(device, &lines->count_buffer);
+	destroy_buffer(device, &lines->column_buffer);
+	destroy_buffer(device, &lines->polyline_buffer);
+	destroy_buffer(device, &lines->point_buffer);
+
+	free(lines);
+}
+
+bool write_line_points(struct LineRenderer *lines, uint32_t first, const float *points, uint32_t count)
+{
+	if (first > lines->point_capacity || count > lines->point_capacity - first) return false;
+	if (lines->point_buffer.mapped == NULL) return false;
+
+	float *mapped = lines->point_buffer.mapped;
+	memcpy(mapped + 2 * (size_t) first, points, 2 * (size_t) count * sizeof(float));
+
+	return true;
+}
+
+void begin_line_frame(struct LineRenderer *lines, uint64_t frame_index)
+{
+	lines->slot = (uint32_t) (frame_index % lines->frames_in_flight);
+	lines->polyline_count = 0;
+	lines->segment_count = 0;
+	lines->series_count = 0;
+
+	// whatever the gpu counted when it last used this slot, zeroed for this frame
+	uint32_t *counters = (uint32_t *) lines->stats_buffer.mapped + lines->slot * LINES_STAT_COUNT;
+
+	lines->stats.culled = counters[LINES_STAT_CULLED];
+	lines->stats.folded = counters[LINES_STAT_FOLDED];
+	lines->stats.binned = counters[LINES_STAT_BINNED];
+	lines->stats.overflowed = counters[LINES_STAT_OVERFLOWED];
+
+	memset(counters, 0, LINES_STAT_COUNT * sizeof(uint32_t));
+}
+
+bool push_polyline(struct LineRenderer *lines, const struct Polyline *polyline)
+{
+	if (lines->polyline_count == LINES_MAX_POLYLINES) return false;
+	if (polyline->first_point > lines->point_capacity || polyline->point_count > lines->point_capacity - polyline->first_point) return false;
+
+	// a single point has no segment, it takes no room
+	if (polyline->point_count < 2 || polyline->color[3] <= 0.0f) return true;
+
+	uint32_t series = LINES_NO_SERIES;
+
+	if (polyline->series && lines->series_count < LINES_MAX_SERIES) {
+		series = lines->series_count;
+		lines->series[lines->series_count++] = lines->polyline_count;
+	}
+
+	const float *color = polyline->color;
+	float half_width = 0.5f * polyline->width;
+
+	struct LinePolylineData data = {
+		.transform = {polyline->transform[0], polyline->transform[1], polyline->transform[2], polyline->transform[3]},
+		.color = {color[0] * color[3], color[1] * color[3], color[2] * color[3], color[3]},
+		.first_point = polyline->first_point,
+		.point_count = polyline->point_count,
+		.first_segment = lines->segment_count,
+		.series = series,
+		.half_width = half_width > 0.0f ? half_width : 0.0f,
+		.pad = {0, 0, 0},
+	};
+
+	struct LinePolylineData *slice = (struct LinePolylineData *) lines->polyline_buffer.mapped + lines->slot * LINES_MAX_POLYLINES;
+	slice[lines->polyline_count++] = data;
+
+	lines->segment_count += polyline->point_count - 1;
+
+	return true;
+}
+
+static void lines_barrier(VkCommandBuffer command_buffer, VkPipelineStageFlags src_stage, VkAccessFlags src_access, VkPipelineStageFlags dst_stage, VkAccessFlags dst_access)
+{
+	VkMemoryBarrier barrier = {
+		.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+		.pNext = NULL,
+		.srcAccessMask = src_access,
+		.dstAccessMask = dst_access,
+	};
+
+	vkCmdPipelineBarrier(command_buffer, src_stage, dst_stage, 0, 1, &barrier, 0, NULL, 0, NULL);
+}
+
+static void image_barrier(VkCommandBuffer command_buffer, struct LineRenderer *lines, bool write)
+{
+	// the raster phase writes every pixel, the previous contents are never needed
+	VkImageMemoryBarrier barrier = {
+		.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+		.pNext = NULL,
+		.srcAccessMask = write ? 0 : VK_ACCESS_SHADER_WRITE_BIT,
+		.dstAccessMask = write ? VK_ACCESS_SHADER_WRITE_BIT : VK_ACCESS_SHADER_READ_BIT,
+		.oldLayout = write ? VK_IMAGE_LAYOUT_UNDEFINED : VK_IMAGE_LAYOUT_GENERAL,
+		.newLayout = write ? VK_IMAGE_LAYOUT_GENERAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+		.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.image = lines->image.image,
+		.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1},
+	};
+
+	VkPipelineStageFlags src_stage = write ? VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT : VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+	VkPipelineStageFlags dst_stage = write ? VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT : VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+
+	vkCmdPipelineBarrier(command_buffer, src_stage, dst_stage, 0, 0, NULL, 0, NULL, 1, &barrier);
+}
+
+void record_lines(VkCommandBuffer command_buffer, struct LineRenderer *lines)
+{
+	lines->stats.polylines = lines->polyline_count;
+	lines->stats.segments = lines->segment_count;
+	lines->stats.series = lines->series_count;
+
+	if (lines->polyline_count == 0) return;
+
+	uint32_t width = lines->extent.width;
+	uint32_t column_count = lines->series_count * width;
+
+	// the tile, column and entry buffers are shared by the frames in flight, the fills wait for
+	// the compute work of earlier frames still reading or writing them; the image is ordered
+	// against their composites by image_barrier
+	lines_barrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+	// tiles start empty, column minima high and maxima low so the first fold sets both
+
+	vkCmdFillBuffer(command_buffer, lines->count_buffer.buffer, 0, VK_WHOLE_SIZE, 0);
+
+	if (column_count > 0) {
+		VkDeviceSize half = (VkDeviceSize) LINES_MAX_SERIES * width * sizeof(uint32_t);
+		VkDeviceSize used = (VkDeviceSize) column_count * sizeof(uint32_t);
+
+		vkCmdFillBuffer(command_buffer, lines->column_buffer.buffer, 0, used, UINT32_MAX);
+		vkCmdFillBuffer(command_buffer, lines->column_buffer.buffer, half, used, 0);
+	}
+
+	lines_barrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+	image_barrier(command_buffer, lines, true);
+
+	struct LineParams params = {
+		.size = {width, lines->extent.height},
+		.tiles_x = lines->tiles[0],
+		.slot = lines->slot,
+		.polyline_count = lines->polyline_count,
+		.segment_count = lines->segment_count,
+		.column_count = column_count,
+		.phase = LINE_PHASE_SEGMENTS,
+	};
+	memcpy(params.series, lines->series, sizeof(lines->series));
+
+	vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, lines->pipeline);
+	vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, lines->layout, 0, 1, &lines->set, 0, NULL);
+
+	// one invocation per segment, rows of groups past what one dimension can dispatch
+
+	uint32_t groups = (lines->segment_count + LINES_GROUP_SIZE - 1) / LINES_GROUP_SIZE;
+	uint32_t groups_x = groups < LINES_MAX_GROUPS ? groups : LINES_MAX_GROUPS;
+	uint32_t groups_y = (groups + groups_x - 1) / groups_x;
+
+	vkCmdPushConstants(command_buffer, lines->layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(params), &params);
+	vkCmdDispatch(command_buffer, groups_x, groups_y, 1);
+
+	lines_barrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+	// one invocation per column of every series
+
+	if (column_count > 0) {
+		params.phase = LINE_PHASE_COLUMNS;
+		vkCmdPushConstants(command_buffer, lines->layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(params), &params);
+		vkCmdDispatch(command_buffer, (column_count + LINES_GROUP_SIZE - 1) / LINES_GROUP_SIZE, 1, 1);
+
+		lines_barrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+	}
+
+	// one workgroup per tile, one invocation per pixel
+
+	params.phase = LINE_PHASE_RASTER;
+	vkCmdPushConstants(command_buffer, lines->layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(params), &params);
+	vkCmdDispatch(command_buffer, lines->tiles[0], lines->tiles[1], 1);
+
+	image_barrier(command_buffer, lines, false);
+
+	// counters are read on the host once the frame's fence is waited on
+	lines_barrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT);
+}
+
+void record_line_composite(VkCommandBuffer command_buffer, struct LineRenderer *lines, const struct PipelineState *target)
+{
+	if (lines->polyline_count == 0) return;
+
+	struct PipelineState state = *target;
+	state.blend = BLEND_MODE_PREMULTIPLIED;
+	state.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+	state.vertex_layout = VERTEX_LAYOUT_NONE;
+
+	struct PipelineKey key = make_pipeline_key(lines->composite_program, &state);
+
+	struct LineCompositeParams params = {
+		.rect = {-1.0f, -1.0f, 1.0f, 1.0f},
+		.color = {1.0f, 1.0f, 1.0f, 1.0f},
+	};
+
+	VkPipeline pipeline = get_pipeline(lines->registry, &key);
+	if (pipeline == VK_NULL_HANDLE) return;
+
+	vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+	vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, lines->composite_layout, 0, 1, &lines->composite_set, 0, NULL);
+	vkCmdPushConstants(command_buffer, lines->composite_layout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(params), &params);
+	vkCmdDraw(command_buffer, 6, 1, 0, 0);
+}
+
+void print_line_stats(const struct LineRenderer *lines)
+{
+	const struct LineStats *stats = &lines->stats;
+
+	printf("lines:\n");
+	printf("\tpolylines: %u, %u segments, %u series\n", stats->polylines, stats->segments, stats->series);
+	printf("\tsegments: %u culled, %u folded into columns\n", stats->culled, stats->folded);
+	printf("\ttiles: %u segments and spans binned, %u dropped from full tiles\n", stats->binned, stats->overflowed);
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include "render.h"
+#include "pipeline.h"
+
+// Antialiased wide polylines rasterized in compute, for charts with
+// millions of segments. Nothing is expanded into triangles: one dispatch
+// reads the raw points, culls every segment against the target and bins
+// the survivors into 16x16 pixel tiles, a second turns dense series into
+// one span per pixel column, and a third draws each tile with one
+// invocation per pixel into a storage image. That image is composited into
+// the main pass.
+//
+// Series, polylines whose x never decreases, fold their short segments into
+// the min and max y of every pixel column they cross, so a time series of a
+// million points costs one span per column however dense it gets. Longer
+// segments of a series and every segment of other polylines are binned as
+// they are.
+//
+// Tiles draw their polylines in order and blend each over the ones before,
+// a polyline's coverage being the max over its own segments, so joints and
+// overlaps within one polyline never blend twice. A tile holds at most
+// LINES_TILE_CAPACITY segments and spans, the rest are dropped and counted.
+//
+// Points live in host visible memory the gpu reads every frame; they can be
+// rewritten between frames once the frames using them are finished.
+
+#define LINES_TILE_SIZE 16
+#define LINES_TILE_CAPACITY 256 // one per invocation of a tile
+#define LINES_MAX_POLYLINES 256 // per frame
+#define LINES_MAX_SERIES 16     // per frame, later series are drawn segment by segment
+#define LINES_NO_SERIES UINT32_MAX
+#define LINES_FORMAT VK_FORMAT_R16G16B16A16_SFLOAT
+
+struct Polyline {
+	uint32_t first_point;
+	uint32_t point_count;
+	float transform[4]; // scale x, y then offset x, y from points to target pixels
+	float color[4];     // linear, straight alpha
+	float width;        // in pixels, thinner than a pixel only lowers the coverage
+	bool series;        // x never decreases
+};
+
+struct LineStats {
+	uint32_t polylines; // last recorded frame
+	uint32_t segments;  // last recorded frame
+	uint32_t series;    // last recorded frame
+
+	// counted on the gpu, for the last finished frame
+	uint32_t culled;     // segments outside the target
+	uint32_t folded;     // segments folded into pixel columns
+	uint32_t binned;     // segments and column spans drawn by tiles
+	uint32_t overflowed; // dropped from full tiles
+};
+
+// std430, the polylines of lines.comp
+struct LinePolylineData {
+	float transform[4];
+	float color[4]; // premultiplied
+	uint32_t first_point;
+	uint32_t point_count;
+	uint32_t first_segment;
+	uint32_t series; // column slot, LINES_NO_SERIES for none
+	float half_width;
+	uint32_t pad[3];
+};
+
+struct LineRenderer {
+	VkDevice device;
+	VkExtent2D extent;
+	uint32_t frames_in_flight;
+	uint32_t tiles[2];
+
+	struct Buffer point_buffer;    // x, y pairs
+	uint32_t point_capacity;
+	struct Buffer polyline_buffer; // LINES_MAX_POLYLINES per frame in flight
+	// scratch shared by the frames in flight, each frame's dispatches wait for the ones before
+	struct Buffer column_buffer;   // LINES_MAX_SERIES columns of minima, then as many maxima
+	struct Buffer count_buffer;    // per tile
+	struct Buffer entry_buffer;    // LINES_TILE_CAPACITY polyline and item pairs per tile
+	struct Buffer stats_buffer;    // four counters per frame in flight
+	struct Image image;
+	VkSampler sampler;
+
+	VkDescriptorSetLayout set_layout;
+	VkDescriptorSetLayout composite_set_layout;
+	VkDescriptorPool descriptor_pool;
+	VkDescriptorSet set;
+	VkDescriptorSet composite_set;
+
+	VkPipelineLayout layout;
+	VkPipeline pipeline;
+	VkPipelineLayout composite_layout;
+	struct PipelineRegistry *registry;
+	uint32_t composite_program;
+
+	// the frame being recorded
+	uint32_t slot;
+	uint32_t polyline_count;
+	uint32_t segment_count;
+	uint32_t series_count;
+	uint32_t series[LINES_MAX_SERIES]; // polyline of each column slot
+
+	struct LineStats stats;
+};
+
+// room for point_capacity points; registers the composite shaders with registry, which has to
+// outlive the renderer
+struct LineRenderer *create_line_renderer(VkPhysicalDevice physical_device, VkDevice device, struct PipelineRegistry *registry, VkExtent2D extent, uint32_t point_capacity, uint32_t frames_in_flight);
+void destroy_line_renderer(struct LineRenderer *lines);
+
+// points are x, y pairs; false when they do not fit
+bool write_line_points(struct LineRenderer *lines, uint32_t first, const float *points, uint32_t count);
+
+// the previous use of frame_index's slot has to be finished, its counters are read back here
+void begin_line_frame(struct LineRenderer *lines, uint64_t frame_index);
+
+// false when the frame is full or the points are out of range
+bool push_polyline(struct LineRenderer *lines, const struct Polyline *polyline);
+
+// outside any render pass, leaves the image ready for fragment shader reads
+void record_lines(VkCommandBuffer command_buffer, struct LineRenderer *lines);
+
+// draws the lines over the whole target of the current pass; nothing when no polylines were pushed
+void record_line_composite(VkCommandBuffer command_buffer, struct LineRenderer *lines, const struct PipelineState *target);
+
+void print_line_stats(const struct LineRenderer *lines);
@@ -0,0 +1,885 @@
+#define _POSIX_C_SOURCE 200809L // mmap, posix_madvise, clock_gettime
+
+#include <vulkan/vulkan.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "render.h"
+#include "loader.h"
+#include "track.h"
+
+#define LOADER_FORMAT VK_FORMAT_R8G8B8A8_SRGB
+#define STAGING_ALIGNMENT 16
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+}
+
+// staging allocator, under the lock
+
+static bool reserve_staging(struct AssetLoader *loader, VkDeviceSize size, struct StagingRange *range)
+{
+	size = (size + STAGING_ALIGNMENT - 1) & ~(VkDeviceSize) (STAGING_ALIGNMENT - 1);
+
+	for (uint32_t i = 0; i < loader->free_count; i++)
+	{
+		struct StagingRange *free_range = &loader->free_ranges[i];
+		if (free_range->size < size) continue;
+
+		*range = (struct StagingRange) {free_range->offset, size};
+
+		free_range->offset += size;
+		free_range->size -= size;
+
+		if (free_range->size == 0) {
+			memmove(free_range, free_range + 1, (loader->free_count - i - 1) * sizeof(struct StagingRange));
+			loader->free_count--;
+		}
+
+		return true;
+	}
+
+	return false;
+}
+
+static void release_staging(struct AssetLoader *loader, struct StagingRange *range)
+{
+	if (range->size == 0) return;
+
+	uint32_t i = 0;
+	while (i < loader->free_count && loader->free_ranges[i].offset < range->offset) i++;
+
+	bool joins_previous = i > 0 && loader->free_ranges[i - 1].offset + loader->free_ranges[i - 1].size == range->offset;
+	bool joins_next = i < loader->free_count && range->offset + range->size == loader->free_ranges[i].offset;
+
+	if (joins_previous && joins_next) {
+		loader->free_ranges[i - 1].size += range->size + loader->free_ranges[i].size;
+		memmove(&loader->free_ranges[i], &loader->free_ranges[i + 1], (loader->free_count - i - 1) * sizeof(struct StagingRange));
+		loader->free_count--;
+	}
+	else if (joins_previous) {
+		loader->free_ranges[i - 1].size += range->size;
+	}
+	else if (joins_next) {
+		loader->free_ranges[i].offset = range->offset;
+		loader->free_ranges[i].size += range->size;
+	}
+	else {
+		memmove(&loader->free_ranges[i + 1], &loader->free_ranges[i], (loader->free_count - i) * sizeof(struct StagingRange));
+		loader->free_ranges[i] = *range;
+		loader->free_count++;
+	}
+
+	*range = (struct StagingRange) {0, 0};
+
+	pthread_cond_broadcast(&loader->staging_freed);
+}
+
+// queues, under the lock
+
+static void push_queued(struct AssetLoader *loader, uint32_t texture)
+{
+	struct TextureLoad *load = &loader->loads[texture];
+
+	load->state = LOAD_STATE_QUEUED;
+	load->queued_ns = now_ns();
+
+	loader->queues[load->priority][loader->queue_tails[load->priority]++ % LOADER_MAX_TEXTURES] = texture;
+
+	loader->stats.queue_depth++;
+	if (loader->stats.queue_depth > loader->stats.max_queue_depth) loader->stats.max_queue_depth = loader->stats.queue_depth;
+
+	pthread_cond_signal(&loader->work_ready);
+}
+
+static uint32_t pop_queued(struct AssetLoader *loader)
+{
+	for (int priority = LOAD_PRIORITY_COUNT - 1; priority >= 0; priority--)
+	{
+		while (loader->queue_heads[priority] != loader->queue_tails[priority])
+		{
+			uint32_t texture = loader->queues[priority][loader->queue_heads[priority]++ % LOADER_MAX_TEXTURES];
+
+			// cancelled requests stay queued until they come up
+			if (loader->loads[texture].state == LOAD_STATE_QUEUED) return texture;
+		}
+	}
+
+	return LOADER_NO_TEXTURE;
+}
+
+static void remove_handle(uint32_t *handles, uint32_t *count, uint32_t texture)
+{
+	for (uint32_t i = 0; i < *count; i++)
+	{
+		if (handles[i] != texture) continue;
+
+		memmove(&handles[i], &handles[i + 1], (*count - i - 1) * sizeof(uint32_t));
+		(*count)--;
+		return;
+	}
+}
+
+// the coarsest level of the file still at least size pixels, level 0 without a size
+static uint32_t level_for_size(uint32_t width, uint32_t height, uint32_t level_count, const float size[2])
+{
+	uint32_t level = 0;
+
+	if (size[0] <= 0.0f || size[1] <= 0.0f) return 0;
+
+	while (level + 1 < level_count)
+	{
+		uint32_t next_width = width >> (level + 1) > 0 ? width >> (level + 1) : 1;
+		uint32_t next_height = height >> (level + 1) > 0 ? height >> (level + 1) : 1;
+
+		if (next_width < size[0] || next_height < size[1]) break;
+
+		level++;
+	}
+
+	return level;
+}
+
+// a full chain blitted on the gpu from a single staged level, when the format can be blitted with filtering
+static uint32_t generated_level_count(struct AssetLoader *loader, VkFormat format, VkExtent2D extent)
+{
+	VkFormatFeatureFlags features = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+
+	return format_supported(loader->physical_device, format, features) ? mip_level_count(extent) : 1;
+}
+
+// worker side: map, reserve staging, decode or copy into it; each returns the state the load ends up in
+
+// waits for the render thread to upload and release older textures, false when cancelled first
+static bool wait_for_staging(struct AssetLoader *loader, struct TextureLoad *load, VkDeviceSize size)
+{
+	pthread_mutex_lock(&loader->lock);
+
+	struct StagingRange range;
+	bool reserved = false;
+
+	while (!loader->stopping && load->state != LOAD_STATE_CANCELLED && !(reserved = reserve_staging(loader, size, &range)))
+	{
+		pthread_cond_wait(&loader->staging_freed, &loader->lock);
+	}
+
+	if (reserved) load->staging = range;
+
+	pthread_mutex_unlock(&loader->lock);
+
+	return reserved;
+}
+
+static enum LoadState stage_image(struct AssetLoader *loader, struct TextureLoad *load, const uint8_t *data, size_t size)
+{
+	if (!decode_image_info(data, size, &load->info)) {
+		printf("failed to load texture %s, unsupported or malformed image\n", load->path);
+		return LOAD_STATE_FAILED;
+	}
+
+	VkDeviceSize pixel_size = (VkDeviceSize) load->info.width * load->info.height * 4;
+
+	if (pixel_size > loader->staging.size) {
+		printf("failed to load texture %s, %ux%u does not fit in staging memory\n", load->path, load->info.width, load->info.height);
+		return LOAD_STATE_FAILED;
+	}
+
+	load->format = LOADER_FORMAT;
+	load->first_level = 0;
+	load->file_level_count = 1;
+	load->staged_levels = 1;
+	load->level_count = generated_level_count(loader, LOADER_FORMAT, (VkExtent2D) {load->info.width, load->info.height});
+	load->level_offsets[0] = 0;
+
+	if (!wait_for_staging(loader, load, pixel_size)) return LOAD_STATE_CANCELLED;
+
+	if (!decode_image(data, size, &load->info, (uint8_t *) loader->staging.mapped + load->staging.offset)) {
+		printf("failed to decode texture %s\n", load->path);
+		return LOAD_STATE_FAILED;
+	}
+
+	return LOAD_STATE_DECODED;
+}
+
+static enum LoadState stage_ktx(struct AssetLoader *loader, struct TextureLoad *load, const uint8_t *data, size_t size)
+{
+	struct KtxInfo ktx;
+
+	if (!read_ktx_info(data, size, &ktx)) {
+		printf("failed to load texture %s\n", load->path);
+		return LOAD_STATE_FAILED;
+	}
+
+	// blocks the device can not sample are decoded to the uncompressed fallback
+	bool supported = format_supported(loader->physical_device, ktx.format->format, VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT);
+
+	if (!supported && ktx.format->decode == NULL) {
+		printf("failed to load texture %s, %s is not supported by the device and can not be transcoded\n", load->path, ktx.format->name);
+		return LOAD_STATE_FAILED;
+	}
+
+	// streaming loads start at the level the texture is drawn at, restreams at the one asked for
+	pthread_mutex_lock(&loader->lock);
+	uint32_t first_level = loader->streaming ? level_for_size(ktx.width, ktx.height, ktx.level_count, load->wanted_size) : 0;
+	pthread_mutex_unlock(&loader->lock);
+
+	uint32_t first_width = ktx.width >> first_level > 0 ? ktx.width >> first_level : 1;
+	uint32_t first_height = ktx.height >> first_level > 0 ? ktx.height >> first_level : 1;
+
+	load->info = (struct ImageInfo) {IMAGE_FILE_UNKNOWN, ktx.width, ktx.height};
+	load->format = supported ? ktx.format->format : ktx.format->fallback;
+	load->first_level = first_level;
+	load->file_level_count = ktx.level_count;
+	load->staged_levels = ktx.level_count - first_level;
+	load->level_count = load->staged_levels > 1 ? load->staged_levels : generated_level_count(loader, load->format, (VkExtent2D) {first_width, first_height});
+
+	VkDeviceSize staging_size = 0;
+
+	for (uint32_t i = 0; i < load->staged_levels; i++)
+	{
+		uint32_t level = first_level + i;
+		uint32_t width = ktx.width >> level > 0 ? ktx.width >> level : 1;
+		uint32_t height = ktx.height >> level > 0 ? ktx.height >> level : 1;
+
+		load->level_offsets[i] = staging_size;
+		staging_size += supported ? ktx.levels[level].size : (VkDeviceSize) width * height * 4;
+		staging_size = (staging_size + STAGING_ALIGNMENT - 1) & ~(VkDeviceSize) (STAGING_ALIGNMENT - 1);
+	}
+
+	if (staging_size > loader->staging.size) {
+		printf("failed to load texture %s, %ux%u %s does not fit in staging memory\n", load->path, ktx.width, ktx.height, ktx.format->name);
+		return LOAD_STATE_FAILED;
+	}
+
+	if (!wait_for_staging(loader, load, staging_size)) return LOAD_STATE_CANCELLED;
+
+	uint8_t *staging = (uint8_t *) loader->staging.mapped + load->staging.offset;
+
+	for (uint32_t i = 0; i < load->staged_levels; i++)
+	{
+		uint32_t level = first_level + i;
+		uint32_t width = ktx.width >> level > 0 ? ktx.width >> level : 1;
+		uint32_t height = ktx.height >> level > 0 ? ktx.height >> level : 1;
+
+		// the only copy between the file and the gpu when the format is supported
+		if (supported) memcpy(staging + load->level_offsets[i], data + ktx.levels[level].offset, ktx.levels[level].size);
+		else decode_blocks(ktx.format, data + ktx.levels[level].offset, width, height, staging + load->level_offsets[i]);
+	}
+
+	if (!supported) {
+		pthread_mutex_lock(&loader->lock);
+		loader->stats.transcoded++;
+		pthread_mutex_unlock(&loader->lock);
+	}
+
+	return LOAD_STATE_DECODED;
+}
+
+static enum LoadState decode_texture(struct AssetLoader *loader, struct TextureLoad *load)
+{
+	// the staging buffer failed with the loader, which is about to be destroyed
+	if (loader->staging.mapped == NULL) return LOAD_STATE_FAILED;
+
+	int fd = open(load->path, O_RDONLY);
+	if (fd < 0) {
+		printf("failed to open texture %s\n", load->path);
+		return LOAD_STATE_FAILED;
+	}
+
+	struct stat info;
+	if (fstat(fd, &info) != 0 || info.st_size == 0) {
+		printf("failed to read texture %s\n", load->path);
+		close(fd);
+		return LOAD_STATE_FAILED;
+	}
+
+	size_t size = info.st_size;
+	const uint8_t *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if (data == MAP_FAILED) {
+		printf("failed to map texture %s\n", load->path);
+		return LOAD_STATE_FAILED;
+	}
+
+	// decoders and level copies read front to back
+	posix_madvise((void *) data, size, POSIX_MADV_SEQUENTIAL);
+
+	enum LoadState state = is_ktx(data, size) ? stage_ktx(loader, load, data, size) : stage_image(loader, load, data, size);
+	munmap((void *) data, size);
+
+	return state;
+}
+
+static void *loader_worker(void *user_data)
+{
+	struct AssetLoader *loader = user_data;
+
+	pthread_mutex_lock(&loader->lock);
+
+	while (true)
+	{
+		uint32_t texture = pop_queued(loader);
+
+		if (texture == LOADER_NO_TEXTURE) {
+			if (loader->stopping) break;
+
+			pthread_cond_wait(&loader->work_ready, &loader->lock);
+			continue;
+		}
+
+		struct TextureLoad *load = &loader->loads[texture];
+		load->state = LOAD_STATE_DECODING;
+		loader->stats.queue_depth--;
+
+		pthread_mutex_unlock(&loader->lock);
+
+		uint64_t start = now_ns();
+		enum LoadState result = decode_texture(loader, load);
+		uint64_t decode_ns = now_ns() - start;
+
+		pthread_mutex_lock(&loader->lock);
+
+		if (load->state == LOAD_STATE_CANCELLED || result != LOAD_STATE_DECODED) {
+			release_staging(loader, &load->staging);
+
+			// a restream that could not be read leaves the levels already resident
+			if (load->restream) {
+				load->restream = false;
+				load->state = LOAD_STATE_READY;
+				if (result == LOAD_STATE_FAILED) loader->stats.failed++;
+			}
+			else if (load->state != LOAD_STATE_CANCELLED) {
+				load->state = result;
+				if (result == LOAD_STATE_FAILED) loader->stats.failed++;
+			}
+
+			continue;
+		}
+
+		load->state = LOAD_STATE_DECODED;
+		loader->decoded[loader->decoded_count++] = texture;
+
+		loader->stats.decode_ns += decode_ns;
+		if (decode_ns > loader->stats.max_decode_ns) loader->stats.max_decode_ns = decode_ns;
+	}
+
+	pthread_mutex_unlock(&loader->lock);
+
+	return NULL;
+}
+
+// render thread side
+
+static void image_barrier(VkCommandBuffer command_buffer, const struct Image *image, VkImageLayout old_layout, VkImageLayout new_layout, VkAccessFlags src_access, VkAccessFlags dst_access, VkPipelineStageFlags src_stage, VkPipelineStageFlags dst_stage)
+{
+	VkImageMemoryBarrier barrier = {
+		.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+		.pNext = NULL,
+		.srcAccessMask = src_access,
+		.dstAccessMask = dst_access,
+		.oldLayout = old_layout,
+		.newLayout = new_layout,
+		.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.image = image->image,
+		.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, image->level_count, 0, 1},
+	};
+
+	vkCmdPipelineBarrier(command_buffer, src_stage, dst_stage, 0, 0, NULL, 0, NULL, 1, &barrier);
+}
+
+// staging ranges to a fresh image, one per staged level, left ready for sampling in fragment shaders;
+// levels past the staged ones are blitted down from the last of them
+static void record_texture_copy(VkCommandBuffer command_buffer, struct AssetLoader *loader, const struct Image *image, VkDeviceSize offset, const VkDeviceSize *level_offsets, uint32_t staged_levels)
+{
+	image_barrier(command_buffer, image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+	VkBufferImageCopy regions[KTX_MAX_LEVELS];
+
+	for (uint32_t i = 0; i < staged_levels; i++)
+	{
+		uint32_t width = image->extent.width >> i > 0 ? image->extent.width >> i : 1;
+		uint32_t height = image->extent.height >> i > 0 ? image->extent.height >> i : 1;
+
+		regions[i] = (VkBufferImageCopy) {
+			.bufferOffset = offset + level_offsets[i],
+			.bufferRowLength = 0,
+			.bufferImageHeight = 0,
+			.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, i, 0, 1},
+			.imageOffset = {0, 0, 0},
+			.imageExtent = {width, height, 1},
+		};
+	}
+
+	vkCmdCopyBufferToImage(command_buffer, loader->staging.buffer, image->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, staged_levels, regions);
+
+	if (staged_levels < image->level_count) {
+		record_generate_mips(command_buffer, image, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+		return;
+	}
+
+	image_barrier(command_buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+}
+
+static VkDescriptorSet create_texture_set(struct AssetLoader *loader, const struct Image *image)
+{
+	VkDescriptorSetAllocateInfo allocate_info = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+		.pNext = NULL,
+		.descriptorPool = loader->descriptor_pool,
+		.descriptorSetCount = 1,
+		.pSetLayouts = &loader->set_layout,
+	};
+
+	VkDescriptorSet set;
+	VkResult result = vkAllocateDescriptorSets(loader->device, &allocate_info, &set);
+	if (result != VK_SUCCESS) {
+		printf("failed to allocate texture descriptor set\n");
+		return VK_NULL_HANDLE;
+	}
+
+	VkDescriptorImageInfo image_info = {
+		.sampler = loader->sampler,
+		.imageView = image->view,
+		.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+	};
+
+	VkWriteDescriptorSet write = {
+		.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+		.pNext = NULL,
+		.dstSet = set,
+		.dstBinding = 0,
+		.dstArrayElement = 0,
+		.descriptorCount = 1,
+		.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+		.pImageInfo = &image_info,
+		.pBufferInfo = NULL,
+		.pTexelBufferView = NULL,
+	};
+
+	vkUpdateDescriptorSets(loader->device, 1, &write, 0, NULL);
+
+	return set;
+}
+
+static VkDescriptorSetLayout create_texture_set_layout(VkDevice device)
+{
+	VkDescriptorSetLayoutBinding binding = {
+		.binding = 0,
+		.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+		.descriptorCount = 1,
+		.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+		.pImmutableSamplers = NULL,
+	};
+
+	VkDescriptorSetLayoutCreateInfo set_layout_info = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+		.pNext = NULL,
+		.flags = 0,
+		.bindingCount = 1,
+		.pBindings = &binding,
+	};
+
+	VkDescriptorSetLayout set_layout;
+	VkResult result = vkCreateDescriptorSetLayout(device, &set_layout_info, NULL, &set_layout);
+	if (result != VK_SUCCESS) printf("failed to create texture descriptor set layout\n");
+	if (result == VK_SUCCESS) track_resource(RESOURCE_DESCRIPTOR_SET_LAYOUT, set_layout, 0);
+
+	return set_layout;
+}
+
+static VkDescriptorPool create_texture_descriptor_pool(VkDevice device)
+{
+	// every texture, a retired set for each and the placeholder; only restreams free sets early
+	VkDescriptorPoolSize pool_size = {
+		.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+		.descriptorCount = 2 * LOADER_MAX_TEXTURES + 1,
+	};
+
+	VkDescriptorPoolCreateInfo pool_info = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+		.pNext = NULL,
+		.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT,
+		.maxSets = 2 * LOADER_MAX_TEXTURES + 1,
+		.poolSizeCount = 1,
+		.pPoolSizes = &pool_size,
+	};
+
+	VkDescriptorPool descriptor_pool;
+	VkResult result = vkCreateDescriptorPool(device, &pool_info, NULL, &descriptor_pool);
+	if (result != VK_SUCCESS) printf("failed to create texture descriptor pool\n");
+	if (result == VK_SUCCESS) track_resource(RESOURCE_DESCRIPTOR_POOL, descriptor_pool, 0);
+
+	return descriptor_pool;
+}
+
+struct AssetLoader *create_asset_loader(VkPhysicalDevice physical_device, VkDevice device, VkCommandPool command_pool, VkQueue queue, uint32_t worker_count, VkDeviceSize staging_size, uint32_t frames_in_flight, float lod_bias, bool streaming)
+{
+	struct AssetLoader *loader = calloc(1, sizeof(struct AssetLoader));
+
+	loader->physical_device = physical_device;
+	loader->device = device;
+	loader->frames_in_flight = frames_in_flight;
+	loader->upload_budget = staging_size / 4;
+	loader->streaming = streaming;
+
+	pthread_mutex_init(&loader->lock, NULL);
+	pthread_cond_init(&loader->work_ready, NULL);
+	pthread_cond_init(&loader->staging_freed, NULL);
+
+	loader->staging = create_buffer(physical_device, device, staging_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	loader->free_ranges[0] = (struct StagingRange) {0, staging_size};
+	loader->free_count = 1;
+
+	loader->sampler = create_mip_sampler(device, VK_FILTER_LINEAR, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, lod_bias);
+	loader->set_layout = create_texture_set_layout(device);
+	loader->descriptor_pool = create_texture_descriptor_pool(device);
+
+	// grey checkerboard, uploaded before any worker can touch the staging buffer
+
+	static const uint8_t checker[2 * 2 * 4] = {
+		96, 96, 96, 255,    160, 160, 160, 255,
+		160, 160, 160, 255, 96, 96, 96, 255,
+	};
+
+	VkExtent2D placeholder_extent = {2, 2};
+	loader->placeholder = create_image(physical_device, device, placeholder_extent, LOADER_FORMAT, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+
+	// either failure was reported, the loader is thrown away with the scene
+	if (loader->staging.mapped != NULL && loader->placeholder.image != VK_NULL_HANDLE) {
+		memcpy(loader->staging.mapped, checker, sizeof(checker));
+
+		VkCommandBuffer command_buffer = begin_single_time_commands(device, command_pool);
+		VkDeviceSize placeholder_offsets[1] = {0};
+		record_texture_copy(command_buffer, loader, &loader->placeholder, 0, placeholder_offsets, 1);
+		end_single_time_commands(device, command_pool, queue, command_buffer);
+	}
+
+	loader->placeholder_set = create_texture_set(loader, &loader->placeholder);
+
+	if (worker_count == 0) worker_count = 1;
+	if (worker_count > LOADER_MAX_WORKERS) worker_count = LOADER_MAX_WORKERS;
+
+	for (uint32_t i = 0; i < worker_count; i++)
+	{
+		if (pthread_create(&loader->workers[i], NULL, loader_worker, loader) != 0) {
+			printf("failed to start texture loader worker\n");
+			break;
+		}
+
+		loader->worker_count++;
+	}
+
+	return loader;
+}
+
+void destroy_asset_loader(struct AssetLoader *loader)
+{
+	pthread_mutex_lock(&loader->lock);
+	loader->stopping = true;
+	pthread_cond_broadcast(&loader->work_ready);
+	pthread_cond_broadcast(&loader->staging_freed);
+	pthread_mutex_unlock(&loader->lock);
+
+	for (uint32_t i = 0; i < loader->worker_count; i++)
+	{
+		pthread_join(loader->workers[i], NULL);
+	}
+
+	VkDevice device = loader->device;
+
+	for (uint32_t i = 0; i < loader->load_count; i++)
+	{
+		if (loader->loads[i].image.image != VK_NULL_HANDLE) destroy_image(device, &loader->loads[i].image);
+		if (loader->loads[i].upload_image.image != VK_NULL_HANDLE) destroy_image(device, &loader->loads[i].upload_image);
+	}
+
+	for (uint32_t i = 0; i < loader->retired_count; i++)
+	{
+		destroy_image(device, &loader->retired[i].image);
+	}
+
+	destroy_image(device, &loader->placeholder);
+	untrack_resource(RESOURCE_DESCRIPTOR_POOL, loader->descriptor_pool);
+	vkDestroyDescriptorPool(device, loader->descriptor_pool, NULL);
+	untrack_resource(RESOURCE_DESCRIPTOR_SET_LAYOUT, loader->set_layout);
+	vkDestroyDescriptorSetLayout(device, loader->set_layout, NULL);
+	untrack_resource(RESOURCE_SAMPLER, loader->sampler);
+	vkDestroySampler(device, loader->sampler, NULL);
+	destroy_buffer(device, &loader->staging);
+
+	pthread_cond_destroy(&loader->staging_freed);
+	pthread_cond_destroy(&loader->work_ready);
+	pthread_mutex_destroy(&loader->lock);
+
+	free(loader);
+}
+
+uint32_t load_texture(struct AssetLoader *loader, const char *path, enum LoadPriority priority)
+{
+	if (strlen(path) >= LOADER_PATH_LENGTH) {
+		printf("failed to load texture %s, path too long\n", path);
+		return LOADER_NO_TEXTURE;
+	}
+
+	if (priority >= LOAD_PRIORITY_COUNT) priority = LOAD_PRIORITY_NORMAL;
+
+	pthread_mutex_lock(&loader->lock);
+
+	if (loader->load_count == LOADER_MAX_TEXTURES) {
+		pthread_mutex_unlock(&loader->lock);
+		printf("failed to load texture %s, loader is full\n", path);
+		return LOADER_NO_TEXTURE;
+	}
+
+	uint32_t texture = loader->load_count++;
+	struct TextureLoad *load = &loader->loads[texture];
+
+	memset(load, 0, sizeof(*load));
+	strcpy(load->path, path);
+	load->priority = priority;
+
+	push_queued(loader, texture);
+	pthread_mutex_unlock(&loader->lock);
+
+	return texture;
+}
+
+bool cancel_texture_load(struct AssetLoader *loader, uint32_t texture)
+{
+	if (texture >= LOADER_MAX_TEXTURES) return false;
+
+	pthread_mutex_lock(&loader->lock);
+
+	struct TextureLoad *load = &loader->loads[texture];
+	bool cancelled = true;
+
+	// a restream only replaces levels of a texture that is already ready
+	switch (texture < loader->load_count && !load->restream ? load->state : LOAD_STATE_FAILED)
+	{
+		case LOAD_STATE_QUEUED:
+			loader->stats.queue_depth--;
+			break;
+		case LOAD_STATE_DECODING:
+			// the worker notices when it is done, or while it waits for staging memory
+			pthread_cond_broadcast(&loader->staging_freed);
+			break;
+		case LOAD_STATE_DECODED:
+			remove_handle(loader->decoded, &loader->decoded_count, texture);
+			release_staging(loader, &load->staging);
+			break;
+		case LOAD_STATE_UPLOADING:
+			// the copy is in flight, its image goes once the frame has finished
+			break;
+		default:
+			cancelled = false;
+			break;
+	}
+
+	if (cancelled) {
+		load->state = LOAD_STATE_CANCELLED;
+		loader->stats.cancelled++;
+	}
+
+	pthread_mutex_unlock(&loader->lock);
+
+	return cancelled;
+}
+
+void request_texture_size(struct AssetLoader *loader, uint32_t texture, float width, float height)
+{
+	if (!loader->streaming || texture >= LOADER_MAX_TEXTURES) return;
+
+	pthread_mutex_lock(&loader->lock);
+
+	struct TextureLoad *load = &loader->loads[texture];
+
+	if (texture < loader->load_count) {
+		load->wanted_size[0] = width;
+		load->wanted_size[1] = height;
+	}
+
+	// finer levels come back as soon as they are needed, coarser ones only go once two levels would do
+	if (texture < loader->load_count && load->state == LOAD_STATE_READY && load->file_level_count > 1) {
+		uint32_t level = level_for_size(load->info.width, load->info.height, load->file_level_count, load->wanted_size);
+
+		if (level < load->base_level || level > load->base_level + 1) {
+			load->restream = true;
+			push_queued(loader, texture);
+		}
+	}
+
+	pthread_mutex_unlock(&loader->lock);
+}
+
+VkDescriptorSet get_texture_set(const struct AssetLoader *loader, uint32_t texture)
+{
+	if (texture >= LOADER_MAX_TEXTURES || loader->loads[texture].set == VK_NULL_HANDLE) return loader->placeholder_set;
+
+	return loader->loads[texture].set;
+}
+
+bool texture_ready(const struct AssetLoader *loader, uint32_t texture)
+{
+	return texture < LOADER_MAX_TEXTURES && loader->loads[texture].set != VK_NULL_HANDLE;
+}
+
+static VkDeviceSize image_size(const struct Image *image)
+{
+	const struct BlockFormat *format = find_block_format(image->format);
+	VkDeviceSize size = 0;
+
+	for (uint32_t i = 0; i < image->level_count; i++)
+	{
+		uint32_t width = image->extent.width >> i > 0 ? image->extent.width >> i : 1;
+		uint32_t height = image->extent.height >> i > 0 ? image->extent.height >> i : 1;
+
+		size += format != NULL ? block_level_size(format, width, height) : (VkDeviceSize) width * height * 4;
+	}
+
+	return size;
+}
+
+void record_texture_uploads(VkCommandBuffer command_buffer, struct AssetLoader *loader, uint64_t frame_index)
+{
+	uint32_t started[LOADER_MAX_TEXTURES];
+	uint32_t started_count = 0;
+
+	// images replaced by restreams, once no frame in flight can still sample them
+
+	uint32_t kept = 0;
+
+	for (uint32_t i = 0; i < loader->retired_count; i++)
+	{
+		struct RetiredTexture *retired = &loader->retired[i];
+
+		if (frame_index < retired->frame + loader->frames_in_flight) {
+			loader->retired[kept++] = *retired;
+			continue;
+		}
+
+		vkFreeDescriptorSets(loader->device, loader->descriptor_pool, 1, &retired->set);
+		destroy_image(loader->device, &retired->image);
+	}
+
+	loader->retired_count = kept;
+
+	pthread_mutex_lock(&loader->lock);
+
+	// copies whose frame has finished: the staging range goes back and the texture goes live
+
+	uint32_t pending = 0;
+
+	while (pending < loader->uploading_count)
+	{
+		uint32_t texture = loader->uploading[pending];
+		struct TextureLoad *load = &loader->loads[texture];
+
+		bool retire_full = load->restream && loader->retired_count == LOADER_MAX_TEXTURES;
+
+		if (frame_index < load->upload_frame + loader->frames_in_flight || retire_full) {
+			pending++;
+			continue;
+		}
+
+		release_staging(loader, &load->staging);
+		remove_handle(loader->uploading, &loader->uploading_count, texture);
+
+		if (load->state == LOAD_STATE_CANCELLED) {
+			destroy_image(loader->device, &load->upload_image);
+			continue;
+		}
+
+		// the levels a restream replaces stay until the frames sampling them are done
+		if (load->restream) {
+			loader->retired[loader->retired_count++] = (struct RetiredTexture) {load->image, load->set, frame_index};
+			loader->stats.resident_bytes -= image_size(&load->image);
+			loader->stats.restreamed++;
+		}
+		else {
+			uint64_t latency_ns = now_ns() - load->queued_ns;
+
+			loader->stats.loaded++;
+			loader->stats.latency_ns += latency_ns;
+			if (latency_ns > loader->stats.max_latency_ns) loader->stats.max_latency_ns = latency_ns;
+		}
+
+		load->image = load->upload_image;
+		load->upload_image = (struct Image) {0};
+		load->set = create_texture_set(loader, &load->image);
+		load->base_level = load->first_level;
+		load->restream = false;
+		load->state = LOAD_STATE_READY;
+
+		loader->stats.resident_bytes += image_size(&load->image);
+	}
+
+	// new copies, oldest decoded first, within the per frame budget
+
+	VkDeviceSize budget = loader->upload_budget;
+
+	while (loader->decoded_count > 0)
+	{
+		struct TextureLoad *load = &loader->loads[loader->decoded[0]];
+		if (started_count > 0 && load->staging.size > budget) break;
+
+		budget = load->staging.size < budget ? budget - load->staging.size : 0;
+
+		load->state = LOAD_STATE_UPLOADING;
+		load->upload_frame = frame_index;
+		loader->uploading[loader->uploading_count++] = loader->decoded[0];
+		loader->stats.uploaded_bytes += load->staging.size;
+		if (load->staged_levels < load->level_count) loader->stats.mipmapped++;
+
+		started[started_count++] = loader->decoded[0];
+		remove_handle(loader->decoded, &loader->decoded_count, loader->decoded[0]);
+	}
+
+	pthread_mutex_unlock(&loader->lock);
+
+	// the images and staging ranges of started loads are the render thread's until they finish
+
+	for (uint32_t i = 0; i < started_count; i++)
+	{
+		struct TextureLoad *load = &loader->loads[started[i]];
+
+		uint32_t width = load->info.width >> load->first_level;
+		uint32_t height = load->info.height >> load->first_level;
+		VkExtent2D extent = {width > 0 ? width : 1, height > 0 ? height : 1};
+
+		// generated levels are blitted from the one above them
+		VkImageUsageFlags usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		if (load->staged_levels < load->level_count) usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+
+		// a failure was recorded for the frame, which is dropped and made again with the scene
+		load->upload_image = create_image_levels(loader->physical_device, loader->device, extent, load->format, load->level_count, usage);
+		if (load->upload_image.image != VK_NULL_HANDLE) record_texture_copy(command_buffer, loader, &load->upload_image, load->staging.offset, load->level_offsets, load->staged_levels);
+	}
+}
+
+void print_asset_loader_stats(struct AssetLoader *loader)
+{
+	pthread_mutex_lock(&loader->lock);
+	struct LoaderStats stats = loader->stats;
+	pthread_mutex_unlock(&loader->lock);
+
+	uint32_t loaded = stats.loaded > 0 ? stats.loaded : 1;
+
+	printf("asset loader: %u loaded, %u failed, %u cancelled, %u transcoded, %u queued (at most %u), %.1f MB uploaded\n", stats.loaded, stats.failed, stats.cancelled, stats.transcoded, stats.queue_depth, stats.max_queue_depth, stats.uploaded_bytes / (1024.0 * 1024.0));
+	printf("\t%u mip chains generated, %u restreamed, %.1f MB resident\n", stats.mipmapped, stats.restreamed, stats.resident_bytes / (1024.0 * 1024.0));
+	printf("\tdecode %.2f ms average, %.2f ms max; ready after %.2f ms average, %.2f ms max\n", stats.decode_ns / 1e6 / loaded, stats.max_decode_ns / 1e6, stats.latency_ns / 1e6 / loaded, stats.max_latency_ns / 1e6);
+}
@@ -0,0 +1,177 @@
+#pragma once
+
+#include <pthread.h>
+
+#include "render.h"
+#include "decode.h"
+#include "ktx.h"
+
+// Asynchronous texture loading. Files are mmapped and decoded on a pool of
+// worker threads straight into one shared host visible staging buffer; the
+// render thread then copies finished images into device local textures, a
+// bounded number of bytes per frame. Until a texture has arrived it hands
+// out the placeholder's descriptor set, so a texture can be drawn from the
+// moment it is requested.
+//
+// Requests are served highest priority first and can be cancelled at any
+// point before they are ready.
+//
+// KTX2 files are copied into staging as they are, every level of them, when
+// the device can sample their format; otherwise they are transcoded to
+// RGBA8 on the worker. Textures arriving with a single level get their mip
+// chain blitted on the gpu where the format allows it.
+//
+// In streaming mode only the levels a texture is drawn at stay resident:
+// request_texture_size reloads finer levels from the file when a texture
+// grows on screen and drops them again when it shrinks. The old image is
+// sampled until the new one has arrived.
+
+#define LOADER_MAX_TEXTURES 1024
+#define LOADER_MAX_WORKERS 8
+#define LOADER_NO_TEXTURE UINT32_MAX
+#define LOADER_PATH_LENGTH 256
+
+enum LoadPriority {
+	LOAD_PRIORITY_LOW,
+	LOAD_PRIORITY_NORMAL,
+	LOAD_PRIORITY_HIGH,
+	LOAD_PRIORITY_COUNT,
+};
+
+enum LoadState {
+	LOAD_STATE_QUEUED,
+	LOAD_STATE_DECODING,
+	LOAD_STATE_DECODED,   // in staging memory, waiting for the render thread
+	LOAD_STATE_UPLOADING, // copy recorded, waiting for its frame to finish
+	LOAD_STATE_READY,
+	LOAD_STATE_FAILED,
+	LOAD_STATE_CANCELLED,
+};
+
+struct StagingRange {
+	VkDeviceSize offset;
+	VkDeviceSize size;
+};
+
+struct TextureLoad {
+	char path[LOADER_PATH_LENGTH];
+	enum LoadPriority priority;
+	enum LoadState state; // under the loader lock
+
+	struct ImageInfo info; // full size, whatever level the load starts at
+	VkFormat format;
+	uint32_t first_level;      // of the file, where the load in progress starts
+	uint32_t file_level_count;
+	uint32_t level_count;      // of the image being loaded
+	uint32_t staged_levels;    // copied from staging, the rest are generated
+	struct StagingRange staging; // size 0 when none is held
+	VkDeviceSize level_offsets[KTX_MAX_LEVELS]; // within staging
+
+	// streaming, under the loader lock
+	float wanted_size[2]; // on screen, 0 for the full size
+	uint32_t base_level;  // of the file, the finest level resident
+	bool restream;        // the load in progress replaces a ready texture's levels
+	uint64_t queued_ns;
+	uint64_t upload_frame;
+
+	// render thread only
+	struct Image image;
+	VkDescriptorSet set; // VK_NULL_HANDLE until ready
+	struct Image upload_image;
+};
+
+// replaced by a restream, destroyed once no frame in flight can sample it
+struct RetiredTexture {
+	struct Image image;
+	VkDescriptorSet set;
+	uint64_t frame;
+};
+
+struct LoaderStats {
+	uint32_t queue_depth; // requests waiting for a worker
+	uint32_t max_queue_depth;
+	uint32_t loaded;
+	uint32_t failed;
+	uint32_t cancelled;
+	uint32_t transcoded; // compressed textures the device could not sample
+	uint32_t mipmapped;  // mip chains generated on the gpu
+	uint32_t restreamed;
+
+	uint64_t decode_ns; // map and decode, summed over loaded textures
+	uint64_t max_decode_ns;
+	uint64_t latency_ns; // request to ready
+	uint64_t max_latency_ns;
+	uint64_t uploaded_bytes;
+	uint64_t resident_bytes; // every level of every ready texture
+};
+
+struct AssetLoader {
+	VkPhysicalDevice physical_device;
+	VkDevice device;
+	uint32_t frames_in_flight;
+	VkDeviceSize upload_budget; // bytes copied per frame, at least one texture goes every frame
+	bool streaming;
+
+	pthread_t workers[LOADER_MAX_WORKERS];
+	uint32_t worker_count;
+	pthread_mutex_t lock;
+	pthread_cond_t work_ready;    // something queued, or stopping
+	pthread_cond_t staging_freed; // a staging range was returned, or stopping
+	bool stopping;
+
+	struct TextureLoad loads[LOADER_MAX_TEXTURES];
+	uint32_t load_count;
+
+	// queued handles, a ring per priority; a handle is in at most one queue at a time, so they never overflow
+	uint32_t queues[LOAD_PRIORITY_COUNT][LOADER_MAX_TEXTURES];
+	uint32_t queue_heads[LOAD_PRIORITY_COUNT];
+	uint32_t queue_tails[LOAD_PRIORITY_COUNT];
+
+	uint32_t decoded[LOADER_MAX_TEXTURES]; // in the order they finished
+	uint32_t decoded_count;
+	uint32_t uploading[LOADER_MAX_TEXTURES];
+	uint32_t uploading_count;
+
+	// first fit over the staging buffer, free ranges sorted by offset
+	struct Buffer staging;
+	struct StagingRange free_ranges[LOADER_MAX_TEXTURES + 1];
+	uint32_t free_count;
+
+	struct RetiredTexture retired[LOADER_MAX_TEXTURES]; // render thread only
+	uint32_t retired_count;
+
+	VkSampler sampler; // trilinear, with the loader's lod bias
+	VkDescriptorSetLayout set_layout; // one combined image sampler, fragment stage
+	VkDescriptorPool descriptor_pool;
+
+	struct Image placeholder;
+	VkDescriptorSet placeholder_set;
+
+	struct LoaderStats stats;
+};
+
+// a positive lod_bias samples smaller levels, sharper textures for a negative one
+struct AssetLoader *create_asset_loader(VkPhysicalDevice physical_device, VkDevice device, VkCommandPool command_pool, VkQueue queue, uint32_t worker_count, VkDeviceSize staging_size, uint32_t frames_in_flight, float lod_bias, bool streaming);
+
+// the device has to be idle
+void destroy_asset_loader(struct AssetLoader *loader);
+
+// thread safe; returns LOADER_NO_TEXTURE when every handle is taken
+uint32_t load_texture(struct AssetLoader *loader, const char *path, enum LoadPriority priority);
+
+// thread safe; false when the load had already finished, failed or been cancelled
+bool cancel_texture_load(struct AssetLoader *loader, uint32_t texture);
+
+// thread safe; in streaming mode keeps the levels resident that cover width x height pixels
+// on screen, a level finer than needed stays to avoid reloading on every small change
+void request_texture_size(struct AssetLoader *loader, uint32_t texture, float width, float height);
+
+// render thread; the placeholder's set until the texture is ready
+VkDescriptorSet get_texture_set(const struct AssetLoader *loader, uint32_t texture);
+bool texture_ready(const struct AssetLoader *loader, uint32_t texture);
+
+// render thread, once per frame outside a render pass; frame_index increases by one every
+// frame and the frame frames_in_flight before it has finished
+void record_texture_uploads(VkCommandBuffer command_buffer, struct AssetLoader *loader, uint64_t frame_index);
+
+void print_asset_loader_stats(struct AssetLoader *loader);
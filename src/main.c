@@ -10,253 +10,802 @@
 #include <stdint.h>
 #include <string.h>
 #include <stdbool.h>
+#include <math.h>
 
 #include "render.h"
-
-int main()
+#include "scene.h"
+#include "trace.h"
+#include "reload.h"
+#include "series.h"
+#include "track.h"
+#include "context.h"
+#include "surface.h"
+
+// a scrolling bar chart along the bottom of the view, a field of soft dots in a
+// rounded card, a conic dial and a patterned tile with rounded corners; every
+// shape has its own geometry, they share a few stop lists
+static void build_chart(struct SceneFrame *frame, struct ClipRect view, float time)
 {
-	bool validation_layers_enabled = true;
+	for (uint32_t i = 0; i < 16; i++)
+	{
+		float hue = 6.2831853f * i / 16.0f;
+		float r = 0.5f + 0.5f * cosf(hue);
+		float g = 0.5f + 0.5f * cosf(hue - 2.0943951f);
+		float b = 0.5f + 0.5f * cosf(hue + 2.0943951f);
+
+		frame->gradients[i] = (struct Gradient) {
+			.stop_count = 3,
+			.stops = {
+				{0.0f, {r, g, b, 1.0f}},
+				{0.6f, {0.6f * r, 0.6f * g, 0.6f * b, 1.0f}},
+				{1.0f, {0.05f, 0.05f, 0.1f, 0.9f}},
+			},
+		};
+	}
 
-	uint32_t validation_layer_count = 1;
-	const char *validation_layers[] = {
-		"VK_LAYER_KHRONOS_validation",
+	struct Gradient *rainbow = &frame->gradients[16];
+	rainbow->stop_count = 7;
+
+	for (uint32_t i = 0; i < 7; i++)
+	{
+		float hue = 6.2831853f * i / 6.0f;
+		rainbow->stops[i] = (struct GradientStop) {i / 6.0f, {0.5f + 0.5f * cosf(hue), 0.5f + 0.5f * cosf(hue - 2.0943951f), 0.5f + 0.5f * cosf(hue + 2.0943951f), 1.0f}};
+	}
+
+	frame->gradients[17] = (struct Gradient) {
+		.stop_count = 2,
+		.stops = {
+			{0.0f, {1.0f, 1.0f, 1.0f, 1.0f}},
+			{1.0f, {1.0f, 1.0f, 1.0f, 0.0f}},
+		},
 	};
 
-	uint32_t device_extension_count = 1;
-	const char *device_extensions[] = {
-		VK_KHR_SWAPCHAIN_EXTENSION_NAME
+	frame->gradient_count = 18;
+
+	// the bars scroll sideways in a plain rect, the dots in a scroll view nested in a rounded card
+	float card[4] = {view.x1 - 360.0f, view.y0 + 40.0f, 320.0f, 240.0f};
+
+	frame->clips[0] = (struct SceneClip) {{view.x0 + 40.0f, view.y1 - 200.0f, view.x1 - view.x0 - 80.0f, 160.0f}, 0.0f, SCENE_NO_CLIP};
+	frame->clips[1] = (struct SceneClip) {{card[0], card[1], card[2], card[3]}, 16.0f, SCENE_NO_CLIP};
+	frame->clips[2] = (struct SceneClip) {{card[0] + 8.0f, card[1] + 8.0f, card[2] - 16.0f, card[3] - 16.0f}, 0.0f, 1};
+	frame->clips[3] = (struct SceneClip) {{view.x0 + 220.0f, view.y0 + 40.0f, 256.0f, 128.0f}, 24.0f, SCENE_NO_CLIP};
+	frame->clip_count = 4;
+
+	uint32_t count = 0;
+
+	uint32_t bar_count = 1024;
+	float bar_width = 2.0f * (view.x1 - view.x0 - 80.0f) / bar_count;
+	float scroll_x = fmodf(40.0f * time, 0.5f * bar_count * bar_width);
+
+	for (uint32_t i = 0; i < bar_count; i++)
+	{
+		float height = 40.0f + 120.0f * (0.5f + 0.5f * sinf(0.05f * i + 2.0f * time));
+		float x = view.x0 + 40.0f + i * bar_width - scroll_x;
+		float y = view.y1 - 40.0f - height;
+
+		frame->shapes[count++] = (struct SceneShape) {
+			.rect = {x, y, 0.8f * bar_width, height},
+			.paint = {
+				.kind = PAINT_KIND_LINEAR,
+				.extend = PAINT_EXTEND_PAD,
+				.params = {x, y, x, y + height},
+				.color = {1.0f, 1.0f, 1.0f, 1.0f},
+			},
+			.gradient = i % 16,
+			.clip = 0,
+		};
+	}
+
+	float scroll_y = fmodf(20.0f * time, 96.0f);
+
+	for (uint32_t i = 0; i < 1024; i++)
+	{
+		float x = card[0] + 8.0f + (i % 32) * 10.0f;
+		float y = card[1] + 8.0f + (i / 32) * 10.0f - scroll_y;
+		float hue = 0.1f * i + time;
+
+		frame->shapes[count++] = (struct SceneShape) {
+			.rect = {x, y, 10.0f, 10.0f},
+			.paint = {
+				.kind = PAINT_KIND_RADIAL,
+				.extend = PAINT_EXTEND_PAD,
+				.params = {x + 5.0f, y + 5.0f, 5.0f * (0.6f + 0.4f * sinf(time + i))},
+				.color = {0.5f + 0.5f * cosf(hue), 0.5f + 0.5f * cosf(hue - 2.0943951f), 0.5f + 0.5f * cosf(hue + 2.0943951f), 1.0f},
+			},
+			.gradient = 17,
+			.clip = 2,
+		};
+	}
+
+	frame->shapes[count++] = (struct SceneShape) {
+		.rect = {view.x0 + 40.0f, view.y0 + 40.0f, 160.0f, 160.0f},
+		.paint = {
+			.kind = PAINT_KIND_CONIC,
+			.extend = PAINT_EXTEND_REPEAT,
+			.params = {view.x0 + 120.0f, view.y0 + 120.0f, time},
+			.color = {1.0f, 1.0f, 1.0f, 1.0f},
+		},
+		.gradient = 16,
+		.clip = SCENE_NO_CLIP,
 	};
 
-	glfwInit();
+	frame->shapes[count++] = (struct SceneShape) {
+		.rect = {view.x0 + 220.0f, view.y0 + 40.0f, 256.0f, 128.0f},
+		.paint = {
+			.kind = PAINT_KIND_PATTERN,
+			.extend = PAINT_EXTEND_REPEAT,
+			.params = {view.x0 + 220.0f, view.y0 + 40.0f, 64.0f, 64.0f},
+			.color = {1.0f, 1.0f, 1.0f, 1.0f},
+		},
+		.gradient = 0,
+		.clip = 3,
+	};
+
+	frame->shape_count = count;
+}
+
+#define TRACE_POINTS (1 << 20)
+#define WAVE_POINTS 512
+
+// a noisy time series of TRACE_POINTS samples followed by one period of a sine in WAVE_POINTS,
+// x is the sample index for both
+static float *build_line_points(void)
+{
+	float *points = malloc(2 * (TRACE_POINTS + WAVE_POINTS) * sizeof(float));
+	float value = 0.0f;
+	uint32_t seed = 1;
 
-	uint32_t instance_extension_count = 0;
-	char **instance_extensions = get_required_instance_extensions(validation_layers_enabled, &instance_extension_count);
+	for (uint32_t i = 0; i < TRACE_POINTS; i++)
+	{
+		seed = seed * 1664525u + 1013904223u;
+		value = 0.999f * value + ((float) (seed >> 8) / (1 << 24) - 0.5f);
 
-	check_validation_layer_support(validation_layers_enabled, validation_layers, validation_layer_count);
-	check_instance_extension_support(instance_extensions, instance_extension_count);
+		points[2 * i] = (float) i;
+		points[2 * i + 1] = value + 8.0f * sinf(i * 0.0001f);
+	}
 
-	GLFWwindow *window = create_window();
+	for (uint32_t i = 0; i < WAVE_POINTS; i++)
+	{
+		points[2 * (TRACE_POINTS + i)] = (float) i;
+		points[2 * (TRACE_POINTS + i) + 1] = sinf(6.2831853f * i / (WAVE_POINTS - 1));
+	}
 
-	VkInstance instance = create_instance(validation_layers_enabled, validation_layer_count, validation_layers, instance_extension_count, instance_extensions);
-	VkSurfaceKHR surface = create_surface(window, instance);
-	VkDebugUtilsMessengerEXT debugMessenger = create_debug_messenger(validation_layers_enabled, instance);
+	return points;
+}
 
-	// print_physical_device_info(instance, surface, device_extension_count, device_extensions);
+// the whole time series squeezed across the view, a few hundred points per pixel column,
+// and a sine swaying over it drawn segment by segment
+static void build_lines(struct SceneFrame *frame, struct ClipRect view, float time)
+{
+	float width = view.x1 - view.x0 - 80.0f;
+
+	frame->lines[0] = (struct SceneLine) {
+		.first_point = 0,
+		.point_count = TRACE_POINTS,
+		.transform = {width / (TRACE_POINTS - 1), -6.0f, view.x0 + 40.0f, view.y0 + 0.5f * (view.y1 - view.y0)},
+		.color = {0.2f, 0.9f, 0.4f, 1.0f},
+		.width = 1.5f,
+		.series = 1,
+	};
 
-	VkPhysicalDevice physicalDevice = create_physical_device(instance, surface, device_extension_count, device_extensions);
-	struct QueueFamilyIndices indices = create_queue_families(physicalDevice, surface);
-	VkSurfaceFormatKHR surfaceFormat = create_format(physicalDevice, surface);
-	VkPresentModeKHR presentMode = create_present_mode(physicalDevice, surface); // move inside swpachain creation?
-	VkSurfaceCapabilitiesKHR capabilities = create_capabilities(physicalDevice, surface);
+	frame->lines[1] = (struct SceneLine) {
+		.first_point = TRACE_POINTS,
+		.point_count = WAVE_POINTS,
+		.transform = {width / (WAVE_POINTS - 1), 80.0f * sinf(time), view.x0 + 40.0f, view.y0 + 0.5f * (view.y1 - view.y0)},
+		.color = {1.0f, 0.6f, 0.1f, 0.8f},
+		.width = 4.0f,
+		.series = 0,
+	};
 
-	VkDevice device = create_device(validation_layers_enabled, validation_layers, validation_layer_count, physicalDevice, indices, device_extension_count, device_extensions);
-	VkQueue graphicsQueue = create_device_queue(device, indices.graphicsFamily, 0);
-	VkQueue presentQueue = create_device_queue(device, indices.presentFamily, 0);
+	frame->line_count = 2;
+}
 
-	VkExtent2D extent = create_swap_extent(window, capabilities);
-	uint32_t imageCount = create_image_count(capabilities);
-	VkSwapchainKHR swapChain = create_swapchain(device, surface, imageCount, surfaceFormat, extent, indices, capabilities, presentMode);
-	VkImageView *swapChainImageViews = create_swapchain_image_views(device, swapChain, surfaceFormat.format, imageCount);
-	VkRenderPass renderPass = create_render_pass(device, surfaceFormat.format);
-	VkPipelineLayout pipelineLayout = create_pipeline_layout(device);
-	VkPipeline graphicsPipeline = create_graphics_pipeline(device, extent, renderPass, pipelineLayout);
-	VkFramebuffer *swapChainFramebuffers = create_swapchain_framebuffer(device, swapChainImageViews, imageCount, renderPass, extent);
-	VkCommandPool commandPool = create_command_pool(device, indices);
-	VkCommandBuffer commandBuffer = create_command_buffer(device, commandPool);
-	VkSemaphore imageAvailableSemaphores = create_semaphore(device);
-	VkSemaphore renderFinishedSemaphores = create_semaphore(device);
-	VkFence inFlightFence = create_fence(device);
+#define STREAM_HISTORY (1 << 21)
+#define STREAM_CHUNK 1024
 
-	// main loop
+// samples of a live signal, a slow drift with a faster ripple and a little noise, made up from
+// the sample index alone so the series can be extended any time
+static void append_stream(struct SeriesPyramid *series, uint32_t count)
+{
+	double x[STREAM_CHUNK];
+	float y[STREAM_CHUNK];
 
-	while (!glfwWindowShouldClose(window))
+	while (count > 0)
 	{
-		glfwPollEvents();
+		uint32_t chunk = count < STREAM_CHUNK ? count : STREAM_CHUNK;
+
+		for (uint32_t i = 0; i < chunk; i++)
+		{
+			uint32_t index = series->count + i;
+			uint32_t hash = index * 2654435761u;
 
-		// draw frame
+			x[i] = (double) index;
+			y[i] = 6.0f * sinf(index * 0.00003f) + 1.5f * sinf(index * 0.013f) + (float) (hash >> 8) / (1 << 24) - 0.5f;
+		}
 
-		vkWaitForFences(device, 1, &inFlightFence, VK_TRUE, UINT64_MAX);
-		vkResetFences(device, 1, &inFlightFence);
+		append_series(series, x, y, chunk);
+		count -= chunk;
+	}
+}
+
+// the newest samples of the stream along the top of the view, zooming between the last few
+// thousand and all of them; only what the pixels can show is extracted into the frame's points
+static void build_stream(struct SceneFrame *frame, struct SeriesPyramid *series, struct ClipRect view, float time)
+{
+	float width = view.x1 - view.x0 - 80.0f;
+
+	double end = (double) series->count;
+	double span = fmax(end * (0.5 + 0.5 * cos(time * 0.3)), 4096.0);
+	double start = end - span;
+
+	uint32_t count = extract_series(series, start, end, width, start, frame->line_points, SCENE_MAX_FRAME_POINTS);
+	frame->line_point_count = count;
+
+	frame->lines[frame->line_count++] = (struct SceneLine) {
+		.first_point = TRACE_POINTS + WAVE_POINTS,
+		.point_count = count,
+		.transform = {width / (float) span, -4.0f, view.x0 + 40.0f, view.y0 + 0.2f * (view.y1 - view.y0)},
+		.color = {0.3f, 0.6f, 1.0f, 1.0f},
+		.width = 1.5f,
+		.series = 1,
+	};
+}
 
-		uint32_t imageIndex;
-		vkAcquireNextImageKHR(device, swapChain, UINT64_MAX, imageAvailableSemaphores, VK_NULL_HANDLE, &imageIndex);
+#define FEED_RATE 1000.0f       // samples per second
+#define FEED_PIXELS_PER_SECOND 120.0f
 
-		vkResetCommandBuffer(commandBuffer, /*VkCommandBufferResetFlagBits*/ 0);
+// a live feed sampled at FEED_RATE up to time, appended to the frame from where the last frame
+// stopped; the tile scrolls so the newest sample sits at the right edge of the view
+static void build_feed(struct SceneFrame *frame, struct ClipRect view, float time, uint32_t *next_sample)
+{
+	uint32_t count = 0;
 
-		// begin record command buffer
+	while (count < SCENE_MAX_STREAM_VERTICES && *next_sample / FEED_RATE <= time)
+	{
+		float t = *next_sample / FEED_RATE;
+		float value = sinf(t * 2.3f) + 0.35f * sinf(t * 17.0f) + 0.15f * sinf(t * 61.0f);
 
-		VkCommandBufferBeginInfo beginInfo = {
-			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-			.pNext = NULL,
-			.flags = 0,
-			.pInheritanceInfo = NULL,
+		frame->stream_vertices[count++] = (struct Vertex) {
+			.position = {t, value},
+			.uv = {0.0f, 1.0f},
+			.color = {0.2f, 0.8f, 1.0f, 1.0f},
 		};
 
-		VkResult result = vkBeginCommandBuffer(commandBuffer, &beginInfo);
-		if (result != VK_SUCCESS) printf("failed to begin recording command buffer\n");
+		(*next_sample)++;
+	}
 
-		VkOffset2D offset = {
-			.x = 0,
-			.y = 0,
-		};
+	frame->stream_count = count;
+	frame->stream_tile[0] = view.x1 - 40.0f - time * FEED_PIXELS_PER_SECOND;
+	frame->stream_tile[1] = view.y0 + 0.35f * (view.y1 - view.y0);
+	frame->stream_tile[2] = FEED_PIXELS_PER_SECOND;
+	frame->stream_tile[3] = -40.0f;
+}
 
-		VkRect2D renderArea = {
-			.offset = offset,
-			.extent = extent,
-		};
+#define MAX_WINDOWS 4
+
+struct FrameOptions {
+	bool gpu_driven_enabled;
+	bool capture_enabled;
+	enum CaptureFormat capture_format;
+	const char *capture_path;
+	bool shader_reload_enabled;
+};
+
+// everything drawn into one window besides its swapchain, made again after the device was lost
+// or memory ran out
+struct SurfaceScene {
+	bool capturing;
+	struct FrameCapture capture;
+	struct SceneRenderer *scene;
+	VkFramebuffer *framebuffers; // one per swapchain image, only without dynamic rendering
+	uint32_t framebuffer_count;
+	struct ShaderReloader *reloader;
+};
+
+// only the first window is captured, one file holds one stream; what failed first is returned,
+// whatever was made is left for destroy_surface_scene
+static VkResult create_surface_scene(struct SurfaceScene *drawing, const struct RenderContext *context, const struct RenderSurface *surface, bool capturing, const struct SceneSetup *setup, const struct FrameOptions *options)
+{
+	VkDevice device = context->device;
 
-		VkRenderPassBeginInfo renderPassInfo = {
-			.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
-			.pNext = NULL,
-			.renderPass = renderPass,
-			.framebuffer = swapChainFramebuffers[imageIndex],
-			.renderArea = renderArea,
-			.clearValueCount = 1,
-			.pClearValues = &(VkClearValue) {{{0.0f, 0.0f, 0.0f, 1.0f}}},
-		};
+	struct RenderError error = {0};
+	struct RenderError *watched = watch_render_errors(&error);
 
-		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+	drawing->capturing = capturing;
+	drawing->capture = (struct FrameCapture) {0};
 
-		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+	if (drawing->capturing) {
+		drawing->capture = create_frame_capture(context->physical_device, device, surface->extent, surface->format.format, options->capture_format, options->capture_path, 60, 3);
+	}
 
-		vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+	drawing->scene = create_scene_renderer(context->physical_device, device, surface->command_pool, context->graphics_queue, context->pipeline_cache, &context->features, surface->extent, surface->format.format, GRAPH_ACCESS_ACQUIRE, GRAPH_ACCESS_PRESENT, options->gpu_driven_enabled, setup, drawing->capturing ? &drawing->capture : NULL);
 
-		vkCmdEndRenderPass(commandBuffer);
+	// without dynamic rendering the scene's render pass needs a framebuffer per swapchain image
+	drawing->framebuffers = NULL;
+	drawing->framebuffer_count = 0;
 
-		result = vkEndCommandBuffer(commandBuffer);
-		if (result != VK_SUCCESS) printf("failed to record command buffer\n");
+	if (drawing->scene->render_pass != VK_NULL_HANDLE) {
+		drawing->framebuffers = create_swapchain_framebuffer(device, surface->image_views, surface->image_count, drawing->scene->stencil_view, drawing->scene->render_pass, surface->extent);
+		drawing->framebuffer_count = surface->image_count;
+	}
 
-		// end record command buffer
+	drawing->reloader = NULL;
+	if (options->shader_reload_enabled) drawing->reloader = create_shader_reloader(device, drawing->scene->pipelines, "../assets/shaders", 1);
 
-		VkSemaphore signalSemaphores[] = {renderFinishedSemaphores};
+	watch_render_errors(watched);
+	if (error.result != VK_SUCCESS) print_render_error(&error);
 
-		VkSubmitInfo submitInfo = {
-			.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-			.pNext = NULL,
-			.waitSemaphoreCount = 1,
-			.pWaitSemaphores = &(VkSemaphore) {imageAvailableSemaphores},
-			.pWaitDstStageMask = &(VkPipelineStageFlags) {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT},
-			.commandBufferCount = 1,
-			.pCommandBuffers = &commandBuffer,
-			.signalSemaphoreCount = 1,
-			.pSignalSemaphores = signalSemaphores,
-		};
+	return error.result;
+}
 
-		result = vkQueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFence);
-		if (result != VK_SUCCESS) printf("failed to submit draw command buffer!");
-
-		VkPresentInfoKHR presentInfo = {
-			.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
-			.pNext = NULL,
-			.waitSemaphoreCount = 1,
-			.pWaitSemaphores = signalSemaphores,
-			.swapchainCount = 1,
-			.pSwapchains = &(VkSwapchainKHR) {swapChain},
-			.pImageIndices = &imageIndex,
-			.pResults = NULL,
-		};
+// the capture's readbacks never finish on a lost device, what they held is dropped
+static void destroy_surface_scene(struct SurfaceScene *drawing, const struct RenderContext *context, bool device_lost)
+{
+	VkDevice device = context->device;
 
-		vkQueuePresentKHR(presentQueue, &presentInfo);
+	if (drawing->scene == NULL) return;
+
+	if (drawing->capturing) {
+		if (!device_lost) finish_frame_capture(device, &drawing->capture);
+		destroy_frame_capture(device, &drawing->capture);
 	}
 
-	vkDeviceWaitIdle(device);
+	destroy_shader_reloader(drawing->reloader);
+	destroy_scene_renderer(drawing->scene);
 
-	// cleanup
+	if (drawing->framebuffers != NULL) {
+		for (uint32_t i = 0; i < drawing->framebuffer_count; i++)
+		{
+			untrack_resource(RESOURCE_FRAMEBUFFER, drawing->framebuffers[i]);
+			vkDestroyFramebuffer(device, drawing->framebuffers[i], NULL);
+		}
 
-	vkDestroySemaphore(device, renderFinishedSemaphores, NULL);
-	vkDestroySemaphore(device, imageAvailableSemaphores, NULL);
-	vkDestroyFence(device, inFlightFence, NULL);
+		free(drawing->framebuffers);
+	}
 
-	vkDestroyCommandPool(device, commandPool, NULL);
+	*drawing = (struct SurfaceScene) {0};
+}
 
-	for (int i = 0; i < imageCount; i++)
+static bool any_window_closed(const struct RenderSurface *surfaces, uint32_t surface_count)
+{
+	for (uint32_t i = 0; i < surface_count; i++)
 	{
-        	vkDestroyFramebuffer(device, swapChainFramebuffers[i], NULL);
+		if (glfwWindowShouldClose(surfaces[i].window)) return true;
+	}
+
+	return false;
+}
+
+// out of memory first gives up the capture and shader reload, then the device and everything on
+// it; the swapchains are made again either way, an image acquired for a frame that never got
+// submitted stays held otherwise. Scenes that run out of memory or lose the device while they
+// are made again go around once more. false when the device, a window or a scene could not be
+// brought back
+static bool recover_frame(VkResult result, struct RenderContext *context, struct RenderSurface *surfaces, struct SurfaceScene *drawings, uint32_t surface_count, const struct SceneSetup *setup, struct FrameOptions *options)
+{
+	enum RenderRecovery recovery = render_recovery(result);
+
+	if (recovery == RENDER_RECOVERY_NONE) {
+		printf("skipped a frame: %s\n", get_result_string(result));
+		return true;
 	}
 
-	vkDestroyPipeline(device, graphicsPipeline, NULL);
-	vkDestroyPipelineLayout(device, pipelineLayout, NULL);
-	vkDestroyRenderPass(device, renderPass, NULL);
+	// a capture made again would write its file over from the start
+	if (options->capture_enabled) printf("capture stopped by %s\n", get_result_string(result));
 
-	for (int i = 0; i < imageCount; i++)
+	while (recovery != RENDER_RECOVERY_NONE)
 	{
-        	vkDestroyImageView(device, swapChainImageViews[i], NULL);
+		bool lost = recovery == RENDER_RECOVERY_DEVICE;
+		bool extras = options->capture_enabled || options->shader_reload_enabled;
+
+		if (!lost) vkDeviceWaitIdle(context->device);
+
+		for (uint32_t i = 0; i < surface_count; i++)
+		{
+			destroy_surface_scene(&drawings[i], context, lost);
+			destroy_render_surface(&surfaces[i], context);
+		}
+
+		options->capture_enabled = false;
+
+		if (recovery == RENDER_RECOVERY_MEMORY && extras) {
+			printf("out of memory, shader reload and capture are off\n");
+			options->shader_reload_enabled = false;
+		}
+		else {
+			VkResult recovered = recover_render_context(context, result);
+
+			if (recovered != VK_SUCCESS) {
+				print_render_error(&context->error);
+				return false;
+			}
+		}
+
+		for (uint32_t i = 0; i < surface_count; i++)
+		{
+			if (create_render_surface(&surfaces[i], context, surfaces[i].window) != VK_SUCCESS) {
+				print_render_error(&surfaces[i].error);
+				return false;
+			}
+		}
+
+		result = VK_SUCCESS;
+
+		for (uint32_t i = 0; i < surface_count && result == VK_SUCCESS; i++)
+		{
+			result = create_surface_scene(&drawings[i], context, &surfaces[i], false, setup, options);
+		}
+
+		// anything else, a missing shader say, will not go away by trying again
+		if (result != VK_SUCCESS && render_recovery(result) == RENDER_RECOVERY_NONE) return false;
+
+		recovery = render_recovery(result);
 	}
 
-	vkDestroySwapchainKHR(device, swapChain, NULL);
-	vkDestroyDevice(device, NULL);
+	return true;
+}
+
+int main()
+{
+	bool validation_layers_enabled = true;
+	bool gpu_driven_enabled = true;
+	bool dynamic_rendering_enabled = true; // falls back to render passes when unsupported
+	bool cpu_fallback_enabled = true;      // a software device when no gpu can be used
+
+	// one per display, sharing the device and presenting together; each shows the stretch of the
+	// world to the right of the one before, like a video wall
+	uint32_t window_count = 1;
+
+	// writes every frame of the first window out as well, "|ffmpeg -i - out.mp4" pipes it into an encoder
+	bool capture_enabled = false;
+	enum CaptureFormat capture_format = CAPTURE_FORMAT_Y4M;
+	const char *capture_path = "capture.y4m";
+
+	// records every frame's draws in the first window for vg_replay
+	bool trace_enabled = false;
+	const char *trace_path = "frames.vgt";
+
+	// development mode, recompiles shaders when their sources are saved and swaps the pipelines in
+	bool shader_reload_enabled = false;
 
-	if (validation_layers_enabled) {
-		PFN_vkDestroyDebugUtilsMessengerEXT func = (PFN_vkDestroyDebugUtilsMessengerEXT) vkGetInstanceProcAddr(instance, "vkDestroyDebugUtilsMessengerEXT");
-		if (func == VK_NULL_HANDLE) printf("failed to load vkDestroyDebugUtilsMessengerEXT function\n");
+	// live vulkan objects per type in prometheus text format, rewritten every few seconds for a scraper
+	bool metrics_enabled = false;
+	const char *metrics_path = "vg_metrics.prom";
 
-		func(instance, debugMessenger, NULL);
+	uint32_t validation_layer_count = 1;
+	const char *validation_layers[] = {
+		"VK_LAYER_KHRONOS_validation",
+	};
+
+	uint32_t device_extension_count = 1;
+	const char *device_extensions[] = {
+		VK_KHR_SWAPCHAIN_EXTENSION_NAME
+	};
+
+	glfwInit();
+
+	if (window_count > MAX_WINDOWS) window_count = MAX_WINDOWS;
+
+	struct RenderSurface surfaces[MAX_WINDOWS] = {0};
+	uint32_t windowWidth = 800;
+	uint32_t windowHeight = 600;
+
+	for (uint32_t i = 0; i < window_count; i++)
+	{
+		char title[32] = "Vulkan";
+		if (window_count > 1) snprintf(title, sizeof(title), "Vulkan %u", i + 1);
+
+		surfaces[i].window = create_window(windowWidth, windowHeight, title);
+		if (surfaces[i].window != NULL && window_count > 1) glfwSetWindowPos(surfaces[i].window, 40 + i * (windowWidth + 20), 80);
 	}
 
-	vkDestroySurfaceKHR(instance, surface, NULL);
-	vkDestroyInstance(instance, NULL);
+	struct RenderContextInfo contextInfo = {
+		.presentable = true,
+		.validation_layers_enabled = validation_layers_enabled,
+		.dynamic_rendering_enabled = dynamic_rendering_enabled,
+		.cpu_fallback_enabled = cpu_fallback_enabled,
+		.device_pinned = false,
+		.device_index = 0,
+		.validation_layer_count = validation_layer_count,
+		.validation_layers = validation_layers,
+		.device_extension_count = device_extension_count,
+		.device_extensions = device_extensions,
+	};
 
-	glfwDestroyWindow(window);
+	struct RenderContext context;
+	VkResult result = create_render_context(&context, &contextInfo);
+	bool contextCreated = result == VK_SUCCESS;
+	if (!contextCreated) print_render_error(&context.error);
 
-	glfwTerminate();
+	for (uint32_t i = 0; i < window_count && result == VK_SUCCESS; i++)
+	{
+		result = surfaces[i].window != NULL ? create_render_surface(&surfaces[i], &context, surfaces[i].window) : VK_ERROR_INITIALIZATION_FAILED;
+		if (result != VK_SUCCESS) print_render_error(&surfaces[i].error);
+	}
 
-	return EXIT_SUCCESS;
-}
+	if (result != VK_SUCCESS) {
+		for (uint32_t i = 0; i < window_count; i++)
+		{
+			if (contextCreated) destroy_render_surface(&surfaces[i], &context);
+			if (surfaces[i].window != NULL) glfwDestroyWindow(surfaces[i].window);
+		}
+
+		if (contextCreated) destroy_render_context(&context);
+		glfwTerminate();
+
+		return EXIT_FAILURE;
+	}
+
+	// print_physical_device_info(context.instance, surfaces[0].surface, device_extension_count, device_extensions);
+
+	// sprites, uploaded once and culled every frame
+
+	uint32_t sprite_grid = 256;
+	uint32_t sprite_count = sprite_grid * sprite_grid;
+	float sprite_spacing = 16.0f;
+
+	struct SpriteInstance *sprites = malloc(sprite_count * sizeof(struct SpriteInstance));
+
+	for (uint32_t i = 0; i < sprite_count; i++)
+	{
+		uint32_t x = i % sprite_grid;
+		uint32_t y = i / sprite_grid;
+
+		sprites[i] = (struct SpriteInstance) {
+			.rect = {x * sprite_spacing, y * sprite_spacing, sprite_spacing - 2.0f, sprite_spacing - 2.0f},
+			.color = {(float) x / sprite_grid, (float) y / sprite_grid, 0.5f, 1.0f},
+			.clip = 0,
+			.layer = 0,
+		};
+	}
+
+	struct ClipRect worldClip = {0.0f, 0.0f, sprite_grid * sprite_spacing, sprite_grid * sprite_spacing};
+
+	// line points, uploaded once, frames pick stretches of them
+	float *linePoints = build_line_points();
+
+	struct SceneSetup sceneSetup = {
+		.sprites = sprites,
+		.sprite_count = sprite_count,
+		.clips = &worldClip,
+		.clip_count = 1,
+		.line_points = linePoints,
+		.line_point_count = TRACE_POINTS + WAVE_POINTS,
+		.panel_size = {240.0f, 160.0f},
+		.shadow_radius = 24.0f,
+		.panel_image = "../assets/images/panel.ktx2",
+		.vertex_layout = VERTEX_LAYOUT_COMPACT,
+		.image_lod_bias = 0.0f,
+	};
+
+	struct FrameOptions frameOptions = {
+		.gpu_driven_enabled = gpu_driven_enabled,
+		.capture_enabled = capture_enabled,
+		.capture_format = capture_format,
+		.capture_path = capture_path,
+		.shader_reload_enabled = shader_reload_enabled,
+	};
 
+	// every window draws the same scene through its own renderer, their pipelines come out of the context's cache
+	struct SurfaceScene drawings[MAX_WINDOWS] = {0};
 
+	for (uint32_t i = 0; i < window_count && result == VK_SUCCESS; i++)
+	{
+		result = create_surface_scene(&drawings[i], &context, &surfaces[i], capture_enabled && i == 0, &sceneSetup, &frameOptions);
+	}
+
+	// running out of memory this early is recovered from like in any frame
+	bool failed = result != VK_SUCCESS;
+	if (render_recovery(result) != RENDER_RECOVERY_NONE) failed = !recover_frame(result, &context, surfaces, drawings, window_count, &sceneSetup, &frameOptions);
 
+	struct TraceWriter *traceWriter = NULL;
+	if (trace_enabled) traceWriter = open_trace_writer(trace_path, surfaces[0].extent, &sceneSetup);
 
+	// a long recording that keeps growing, drawn at the level of detail the zoom needs
+	struct SeriesPyramid *stream = create_series_pyramid(2 * STREAM_HISTORY);
+	append_stream(stream, STREAM_HISTORY);
 
+	struct SceneFrame *sceneFrame = malloc(sizeof(struct SceneFrame));
+	bool mouseWasPressed[MAX_WINDOWS] = {false};
+
+	// main loop
+
+	uint64_t frameIndex = 0;
+	uint32_t feedSample = 0;
+
+	// failures of the helpers while a frame is recorded, streamed textures running out of memory say
+	struct RenderError frameError = {0};
+	watch_render_errors(&frameError);
+
+	while (!failed && !any_window_closed(surfaces, window_count))
+	{
+		glfwPollEvents();
+		frameError = (struct RenderError) {0};
 
+		// draw frame; every window waits for its slot and acquires first, a window without an
+		// image sits the frame out
 
+		for (uint32_t i = 0; i < window_count; i++)
+		{
+			result = begin_surface_frame(&surfaces[i], &context);
+			if (render_recovery(result) != RENDER_RECOVERY_NONE) break;
+			if (result != VK_SUCCESS) printf("skipped a frame of window %u: %s\n", i + 1, get_result_string(result));
+		}
 
+		if (render_recovery(result) != RENDER_RECOVERY_NONE) {
+			failed = !recover_frame(result, &context, surfaces, drawings, window_count, &sceneSetup, &frameOptions);
+			if (failed) break;
+			continue;
+		}
 
+		float time = (float) glfwGetTime();
+		float pan = time * 60.0f;
 
+		append_stream(stream, STREAM_CHUNK);
 
+		// every window appends the same samples to its own feed
+		uint32_t nextFeedSample = feedSample;
 
+		for (uint32_t i = 0; i < window_count; i++)
+		{
+			struct RenderSurface *surface = &surfaces[i];
+			struct SurfaceScene *drawing = &drawings[i];
 
+			if (!surface->acquired) continue;
 
+			VkCommandBuffer commandBuffer = current_surface_frame(surface)->command_buffer;
 
+			if (drawing->capturing) poll_frame_capture(context.device, &drawing->capture);
+			poll_shader_reload(drawing->reloader, frameIndex);
 
+			// begin record command buffer
 
+			VkCommandBufferBeginInfo beginInfo = {
+				.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+				.pNext = NULL,
+				.flags = 0,
+				.pInheritanceInfo = NULL,
+			};
 
+			result = vkBeginCommandBuffer(commandBuffer, &beginInfo);
+			if (result != VK_SUCCESS) printf("failed to begin recording command buffer\n");
 
+			struct ClipRect viewport = {
+				.x0 = pan + i * (float) surface->extent.width,
+				.y0 = pan,
+				.x1 = pan + (i + 1) * (float) surface->extent.width,
+				.y1 = pan + surface->extent.height,
+			};
 
+			// picking
 
+			bool mousePressed = glfwGetMouseButton(surface->window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS;
 
+			if (mousePressed && !mouseWasPressed[i]) {
+				double cursor_x, cursor_y;
+				glfwGetCursorPos(surface->window, &cursor_x, &cursor_y);
 
+				uint32_t picked = spatial_pick(&drawing->scene->sprite_tree, viewport.x0 + (float) cursor_x, viewport.y0 + (float) cursor_y);
+				if (picked != SPATIAL_NO_ITEM) printf("picked sprite %u\n", picked);
+			}
 
+			mouseWasPressed[i] = mousePressed;
 
+			// everything drawn this frame, replayable from a trace
 
+			enum BlendMode triangleBlend[3] = {BLEND_MODE_NONE, BLEND_MODE_NONE, BLEND_MODE_ADDITIVE};
 
+			sceneFrame->time = time;
+			sceneFrame->view = viewport;
+			sceneFrame->triangle_count = 3;
 
+			for (uint32_t j = 0; j < 3; j++)
+			{
+				sceneFrame->triangles[j] = (struct SceneTriangle) {
+					.transform = {400.0f + j * 300.0f, 300.0f + j * 200.0f, 200.0f, 0.5f + j * 0.5f},
+					.blend = triangleBlend[j],
+				};
+			}
 
+			sceneFrame->panel_position[0] = 200.0f;
+			sceneFrame->panel_position[1] = 150.0f;
+			sceneFrame->panel_color[0] = 0.9f;
+			sceneFrame->panel_color[1] = 0.9f;
+			sceneFrame->panel_color[2] = 0.9f;
+			sceneFrame->panel_color[3] = 1.0f;
 
+			build_chart(sceneFrame, viewport, time);
+			build_lines(sceneFrame, viewport, time);
+			build_stream(sceneFrame, stream, viewport, time);
 
+			nextFeedSample = feedSample;
+			build_feed(sceneFrame, viewport, time, &nextFeedSample);
 
+			if (traceWriter != NULL && i == 0) write_trace_frame(traceWriter, sceneFrame);
 
+			// the fence wait in begin_surface_frame means this frame's ring slot is free again
 
+			VkFramebuffer framebuffer = drawing->framebuffers != NULL ? drawing->framebuffers[surface->image_index] : VK_NULL_HANDLE;
+			record_scene_frame(commandBuffer, drawing->scene, sceneFrame, frameIndex, surface->images[surface->image_index], surface->image_views[surface->image_index], framebuffer);
 
+			result = vkEndCommandBuffer(commandBuffer);
+			if (result != VK_SUCCESS) printf("failed to record command buffer\n");
 
+			// end record command buffer
 
+			// the frame refers to what failed, it is dropped unsubmitted and everything made again
+			if (render_recovery(frameError.result) != RENDER_RECOVERY_NONE) {
+				result = frameError.result;
+				break;
+			}
 
+			result = submit_surface_frame(surface, &context);
 
+			if (result != VK_SUCCESS) {
+				printf("failed to submit draw command buffer: %s\n", get_result_string(result));
+				if (render_recovery(result) != RENDER_RECOVERY_NONE) break;
+			}
+			else if (drawing->capturing) {
+				confirm_frame_capture(&drawing->capture);
+			}
+		}
 
+		feedSample = nextFeedSample;
+		frameIndex++;
 
+		// one present for every window that got this far
+		if (render_recovery(result) == RENDER_RECOVERY_NONE) result = present_surfaces(&context, surfaces, window_count);
 
+		if (render_recovery(result) != RENDER_RECOVERY_NONE) {
+			failed = !recover_frame(result, &context, surfaces, drawings, window_count, &sceneSetup, &frameOptions);
+			if (failed) break;
+		}
 
+		if (metrics_enabled && frameIndex % 300 == 0) write_resource_metrics_file(metrics_path);
+	}
 
+	watch_render_errors(NULL);
 
+	// lost for good when the loop gave up on it
+	bool deviceLost = context.device == VK_NULL_HANDLE || vkDeviceWaitIdle(context.device) == VK_ERROR_DEVICE_LOST;
 
+	if (traceWriter != NULL) close_trace_writer(traceWriter);
 
+	for (uint32_t i = 0; i < window_count; i++)
+	{
+		if (drawings[i].scene == NULL || failed) continue;
 
+		if (window_count > 1) printf("window %u:\n", i + 1);
+		print_scene_stats(drawings[i].scene);
+		print_reload_stats(drawings[i].reloader);
+	}
 
+	print_series_stats(stream);
 
+	printf("rendering with %s\n", context.features.dynamic_rendering ? "dynamic rendering" : "render passes");
+	if (context.device_losses > 0 || context.fallbacks > 0) printf("context: %u device losses recovered, %u fallbacks\n", context.device_losses, context.fallbacks);
 
+	// cleanup
 
+	free(sceneFrame);
+	free(linePoints);
+	free(sprites);
+	destroy_series_pyramid(stream);
 
+	for (uint32_t i = 0; i < window_count; i++)
+	{
+		destroy_surface_scene(&drawings[i], &context, deviceLost);
+		destroy_render_surface(&surfaces[i], &context);
+	}
 
+	destroy_render_context(&context);
 
+	// everything created on the device should be gone by now
+	report_resource_leaks();
 
+	for (uint32_t i = 0; i < window_count; i++) glfwDestroyWindow(surfaces[i].window);
 
+	glfwTerminate();
 
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
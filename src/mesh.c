@@ -0,0 +1,164 @@
+#include <vulkan/vulkan.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+#include <math.h>
+
+#include "render.h"
+#include "mesh.h"
+
+static float clampf(float value, float low, float high)
+{
+	return value < low ? low : value > high ? high : value;
+}
+
+// bounding tile of every position, the half extent never collapses to zero
+static void mesh_tile(const struct Vertex *vertices, uint32_t vertex_count, float tile[4])
+{
+	float x0 = INFINITY, y0 = INFINITY, x1 = -INFINITY, y1 = -INFINITY;
+
+	for (uint32_t i = 0; i < vertex_count; i++)
+	{
+		x0 = fminf(x0, vertices[i].position[0]);
+		y0 = fminf(y0, vertices[i].position[1]);
+		x1 = fmaxf(x1, vertices[i].position[0]);
+		y1 = fmaxf(y1, vertices[i].position[1]);
+	}
+
+	if (vertex_count == 0) x0 = y0 = x1 = y1 = 0.0f;
+
+	tile[0] = 0.5f * (x0 + x1);
+	tile[1] = 0.5f * (y0 + y1);
+	tile[2] = fmaxf(0.5f * (x1 - x0), 1e-3f);
+	tile[3] = fmaxf(0.5f * (y1 - y0), 1e-3f);
+}
+
+static struct CompactVertex compact_vertex(const struct Vertex *vertex, const float tile[4])
+{
+	struct CompactVertex compact;
+
+	for (int i = 0; i < 2; i++)
+	{
+		float position = (vertex->position[i] - tile[i]) / tile[2 + i];
+
+		compact.position[i] = (int16_t) lrintf(clampf(position, -1.0f, 1.0f) * 32767.0f);
+		compact.uv[i] = (uint16_t) lrintf(clampf(vertex->uv[i], 0.0f, 1.0f) * 65535.0f);
+	}
+
+	for (int i = 0; i < 4; i++)
+	{
+		compact.color[i] = (uint8_t) lrintf(clampf(vertex->color[i], 0.0f, 1.0f) * 255.0f);
+	}
+
+	return compact;
+}
+
+struct Mesh create_mesh(VkPhysicalDevice physical_device, VkDevice device, VkCommandPool command_pool, VkQueue queue, enum VertexLayout layout, const struct Vertex *vertices, uint32_t vertex_count, const uint32_t *indices, uint32_t index_count)
+{
+	VkIndexType index_type = vertex_count <= UINT16_MAX + 1 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+
+	return create_mesh_indexed(physical_device, device, command_pool, queue, layout, index_type, vertices, vertex_count, indices, index_count);
+}
+
+struct Mesh create_mesh_indexed(VkPhysicalDevice physical_device, VkDevice device, VkCommandPool command_pool, VkQueue queue, enum VertexLayout layout, VkIndexType index_type, const struct Vertex *vertices, uint32_t vertex_count, const uint32_t *indices, uint32_t index_count)
+{
+	struct Mesh mesh = {
+		.layout = layout,
+		.index_type = index_type,
+		.vertex_count = vertex_count,
+		.index_count = index_count,
+		.tile = {0.0f, 0.0f, 1.0f, 1.0f},
+	};
+
+	if (layout != VERTEX_LAYOUT_FLOAT && layout != VERTEX_LAYOUT_COMPACT) {
+		printf("failed to create mesh, it needs a vertex layout\n");
+		return mesh;
+	}
+
+	if (index_type != VK_INDEX_TYPE_UINT16 && index_type != VK_INDEX_TYPE_UINT32) {
+		printf("failed to create mesh, it needs 16 or 32 bit indices\n");
+		return mesh;
+	}
+
+	if (index_type == VK_INDEX_TYPE_UINT16 && vertex_count > UINT16_MAX + 1) {
+		printf("failed to create mesh, %u vertices do not fit 16 bit indices\n", vertex_count);
+		return mesh;
+	}
+
+	VkMemoryPropertyFlags device_local = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+
+	// vertices
+
+	VkDeviceSize vertex_size = (VkDeviceSize) vertex_count * vertex_layout_stride(layout);
+	void *vertex_data = (void *) vertices;
+
+	if (layout == VERTEX_LAYOUT_COMPACT) {
+		mesh_tile(vertices, vertex_count, mesh.tile);
+
+		struct CompactVertex *compact = malloc(vertex_size);
+
+		for (uint32_t i = 0; i < vertex_count; i++)
+		{
+			compact[i] = compact_vertex(&vertices[i], mesh.tile);
+		}
+
+		vertex_data = compact;
+	}
+
+	mesh.vertex_buffer = create_buffer(physical_device, device, vertex_size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, device_local);
+	upload_buffer(physical_device, device, command_pool, queue, &mesh.vertex_buffer, vertex_data, vertex_size);
+
+	if (vertex_data != vertices) free(vertex_data);
+
+	// indices
+
+	VkDeviceSize index_size = (VkDeviceSize) index_count * (mesh.index_type == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t));
+	void *index_data = (void *) indices;
+
+	if (mesh.index_type == VK_INDEX_TYPE_UINT16) {
+		uint16_t *narrow = malloc(index_size);
+
+		for (uint32_t i = 0; i < index_count; i++)
+		{
+			narrow[i] = (uint16_t) indices[i];
+		}
+
+		index_data = narrow;
+	}
+
+	mesh.index_buffer = create_buffer(physical_device, device, index_size, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, device_local);
+	upload_buffer(physical_device, device, command_pool, queue, &mesh.index_buffer, index_data, index_size);
+
+	if (index_data != indices) free(index_data);
+
+	return mesh;
+}
+
+void destroy_mesh(VkDevice device, struct Mesh *mesh)
+{
+	if (mesh->vertex_buffer.buffer != VK_NULL_HANDLE) destroy_buffer(device, &mesh->vertex_buffer);
+	if (mesh->index_buffer.buffer != VK_NULL_HANDLE) destroy_buffer(device, &mesh->index_buffer);
+}
+
+VkDeviceSize mesh_size(const struct Mesh *mesh)
+{
+	return mesh->vertex_buffer.size + mesh->index_buffer.size;
+}
+
+void print_mesh_info(const char *name, const struct Mesh *mesh)
+{
+	// what the same mesh costs with float vertices and 32 bit indices
+	VkDeviceSize float_size = (VkDeviceSize) mesh->vertex_count * sizeof(struct Vertex) + (VkDeviceSize) mesh->index_count * sizeof(uint32_t);
+
+	printf("mesh %s: %u vertices at %u bytes, %u %s indices, %.1f KB (%.0f%% of float vertices and 32 bit indices)\n",
+		name,
+		mesh->vertex_count,
+		vertex_layout_stride(mesh->layout),
+		mesh->index_count,
+		mesh->index_type == VK_INDEX_TYPE_UINT16 ? "16 bit" : "32 bit",
+		mesh_size(mesh) / 1024.0,
+		float_size > 0 ? 100.0 * mesh_size(mesh) / float_size : 0.0);
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "render.h"
+
+// Static indexed meshes in either vertex layout. Compact meshes quantize
+// positions to snorm16 within the mesh's bounding tile, uvs to unorm16 and
+// colors to rgba8, 12 bytes a vertex instead of 32. Indices are 16 bit
+// whenever the mesh has few enough vertices, in either layout.
+
+struct Mesh {
+	struct Buffer vertex_buffer;
+	struct Buffer index_buffer;
+	enum VertexLayout layout;
+	VkIndexType index_type;
+	uint32_t vertex_count;
+	uint32_t index_count;
+
+	// origin x, y, half extent x, y; the vertex shader places vertices at
+	// origin + position * half extent, so draws push this with the mesh
+	float tile[4];
+};
+
+struct Mesh create_mesh(VkPhysicalDevice physical_device, VkDevice device, VkCommandPool command_pool, VkQueue queue, enum VertexLayout layout, const struct Vertex *vertices, uint32_t vertex_count, const uint32_t *indices, uint32_t index_count);
+// the same with the index type chosen by the caller, 16 bit fails for more than 65536 vertices
+struct Mesh create_mesh_indexed(VkPhysicalDevice physical_device, VkDevice device, VkCommandPool command_pool, VkQueue queue, enum VertexLayout layout, VkIndexType index_type, const struct Vertex *vertices, uint32_t vertex_count, const uint32_t *indices, uint32_t index_count);
+void destroy_mesh(VkDevice device, struct Mesh *mesh);
+
+// bytes the gpu fetches to draw the whole mesh once, vertices and indices
+VkDeviceSize mesh_size(const struct Mesh *mesh);
+void print_mesh_info(const char *name, const struct Mesh *mesh);
@@ -0,0 +1,207 @@
+// vg_pack: packs an image into a KTX2 texture the asset loader can copy
+// straight into staging memory, with a full mip chain.
+//
+//   vg_pack in.png out.ktx2 [--format bc1|bc3|rgba8] [--linear] [--no-mips]
+
+#include <vulkan/vulkan.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+#include <math.h>
+
+#include "render.h"
+#include "decode.h"
+#include "blocks.h"
+#include "ktx.h"
+
+static uint8_t *read_file(const char *path, size_t *size)
+{
+	FILE *file = fopen(path, "rb");
+	if (file == NULL) {
+		printf("failed to open %s\n", path);
+		return NULL;
+	}
+
+	fseek(file, 0, SEEK_END);
+	long length = ftell(file);
+	fseek(file, 0, SEEK_SET);
+
+	uint8_t *data = length > 0 ? malloc(length) : NULL;
+
+	if (data == NULL || fread(data, 1, length, file) != (size_t) length) {
+		printf("failed to read %s\n", path);
+		free(data);
+		fclose(file);
+		return NULL;
+	}
+
+	fclose(file);
+	*size = length;
+
+	return data;
+}
+
+static float srgb_to_linear(uint8_t value)
+{
+	float c = value / 255.0f;
+
+	return c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+}
+
+static uint8_t linear_to_srgb(float value)
+{
+	float c = value <= 0.0031308f ? value * 12.92f : 1.055f * powf(value, 1.0f / 2.4f) - 0.055f;
+
+	return (uint8_t) (c * 255.0f + 0.5f);
+}
+
+// 2x2 box filter, averaged in linear light for srgb textures; odd edges repeat the last texel
+static void downsample(const uint8_t *src, uint32_t width, uint32_t height, uint8_t *dst, bool srgb)
+{
+	uint32_t dst_width = width > 1 ? width / 2 : 1;
+	uint32_t dst_height = height > 1 ? height / 2 : 1;
+
+	for (uint32_t y = 0; y < dst_height; y++)
+	{
+		for (uint32_t x = 0; x < dst_width; x++)
+		{
+			uint32_t x0 = 2 * x < width ? 2 * x : width - 1;
+			uint32_t y0 = 2 * y < height ? 2 * y : height - 1;
+			uint32_t x1 = x0 + 1 < width ? x0 + 1 : x0;
+			uint32_t y1 = y0 + 1 < height ? y0 + 1 : y0;
+
+			const uint8_t *texels[4] = {
+				&src[4 * ((size_t) y0 * width + x0)],
+				&src[4 * ((size_t) y0 * width + x1)],
+				&src[4 * ((size_t) y1 * width + x0)],
+				&src[4 * ((size_t) y1 * width + x1)],
+			};
+
+			uint8_t *out = &dst[4 * ((size_t) y * dst_width + x)];
+
+			for (int c = 0; c < 4; c++)
+			{
+				if (srgb && c < 3) {
+					float sum = 0.0f;
+					for (int i = 0; i < 4; i++) sum += srgb_to_linear(texels[i][c]);
+
+					out[c] = linear_to_srgb(sum / 4.0f);
+				}
+				else {
+					out[c] = (uint8_t) ((texels[0][c] + texels[1][c] + texels[2][c] + texels[3][c] + 2) / 4);
+				}
+			}
+		}
+	}
+}
+
+int main(int argc, char **argv)
+{
+	const char *input_path = NULL;
+	const char *output_path = NULL;
+	const char *format_name = "bc3";
+	bool srgb = true;
+	bool mips = true;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--format") == 0 && i + 1 < argc) format_name = argv[++i];
+		else if (strcmp(argv[i], "--linear") == 0) srgb = false;
+		else if (strcmp(argv[i], "--no-mips") == 0) mips = false;
+		else if (input_path == NULL) input_path = argv[i];
+		else output_path = argv[i];
+	}
+
+	VkFormat format;
+
+	if (strcmp(format_name, "bc1") == 0) format = srgb ? VK_FORMAT_BC1_RGBA_SRGB_BLOCK : VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+	else if (strcmp(format_name, "bc3") == 0) format = srgb ? VK_FORMAT_BC3_SRGB_BLOCK : VK_FORMAT_BC3_UNORM_BLOCK;
+	else if (strcmp(format_name, "rgba8") == 0) format = srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+	else input_path = NULL;
+
+	if (input_path == NULL || output_path == NULL) {
+		printf("usage: vg_pack in.png out.ktx2 [--format bc1|bc3|rgba8] [--linear] [--no-mips]\n");
+		return EXIT_FAILURE;
+	}
+
+	const struct BlockFormat *block_format = find_block_format(format);
+
+	size_t size;
+	uint8_t *data = read_file(input_path, &size);
+	if (data == NULL) return EXIT_FAILURE;
+
+	struct ImageInfo info;
+
+	if (!decode_image_info(data, size, &info)) {
+		printf("failed to load %s, unsupported or malformed image\n", input_path);
+		free(data);
+		return EXIT_FAILURE;
+	}
+
+	uint32_t level_count = 1;
+
+	while (mips && level_count < KTX_MAX_LEVELS && (info.width >> level_count > 0 || info.height >> level_count > 0))
+	{
+		level_count++;
+	}
+
+	// every level decoded, then encoded
+	uint8_t *pixels[KTX_MAX_LEVELS];
+	uint8_t *blocks[KTX_MAX_LEVELS];
+
+	pixels[0] = malloc((size_t) info.width * info.height * 4);
+	bool decoded = decode_image(data, size, &info, pixels[0]);
+	free(data);
+
+	if (!decoded) {
+		printf("failed to decode %s\n", input_path);
+		free(pixels[0]);
+		return EXIT_FAILURE;
+	}
+
+	size_t packed_size = 0;
+	size_t unpacked_size = 0;
+
+	for (uint32_t i = 0; i < level_count; i++)
+	{
+		uint32_t width = info.width >> i > 0 ? info.width >> i : 1;
+		uint32_t height = info.height >> i > 0 ? info.height >> i : 1;
+
+		if (i + 1 < level_count) {
+			uint32_t next_width = width > 1 ? width / 2 : 1;
+			uint32_t next_height = height > 1 ? height / 2 : 1;
+
+			pixels[i + 1] = malloc((size_t) next_width * next_height * 4);
+			downsample(pixels[i], width, height, pixels[i + 1], srgb);
+		}
+
+		VkDeviceSize level_size = block_level_size(block_format, width, height);
+		packed_size += level_size;
+		unpacked_size += (size_t) width * height * 4;
+
+		if (block_format->block_width == 1) {
+			blocks[i] = pixels[i];
+			continue;
+		}
+
+		blocks[i] = malloc(level_size);
+		encode_blocks(block_format, pixels[i], width, height, blocks[i]);
+	}
+
+	bool written = write_ktx(output_path, block_format, info.width, info.height, level_count, (const uint8_t *const *) blocks);
+
+	if (written) {
+		printf("%s: %ux%u, %u levels, %s, %.1f KB (%.1f KB as rgba8)\n", output_path, info.width, info.height, level_count, block_format->name, packed_size / 1024.0, unpacked_size / 1024.0);
+	}
+
+	for (uint32_t i = 0; i < level_count; i++)
+	{
+		if (blocks[i] != pixels[i]) free(blocks[i]);
+		free(pixels[i]);
+	}
+
+	return written ? EXIT_SUCCESS : EXIT_FAILURE;
+}
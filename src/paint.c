@@ -0,0 +1,471 @@
+#include <vulkan/vulkan.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+#include <math.h>
+
+#include "render.h"
+#include "paint.h"
+#include "track.h"
+
+static uint8_t linear_to_srgb(float value)
+{
+	float c = value < 0.0f ? 0.0f : value > 1.0f ? 1.0f : value;
+	c = c <= 0.0031308f ? c * 12.92f : 1.055f * powf(c, 1.0f / 2.4f) - 0.055f;
+
+	return (uint8_t) (c * 255.0f + 0.5f);
+}
+
+// fnv-1a over the stops in use, the whole 64 bits are the cache key
+static uint64_t hash_gradient(const struct Gradient *gradient)
+{
+	uint32_t count = gradient->stop_count < PAINT_MAX_STOPS ? gradient->stop_count : PAINT_MAX_STOPS;
+
+	const uint8_t *bytes = (const uint8_t *) gradient->stops;
+	size_t size = count * sizeof(struct GradientStop);
+
+	uint64_t hash = 0xcbf29ce484222325ull ^ count;
+
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 0x100000001b3ull;
+	}
+
+	return hash;
+}
+
+// one row of RGBA8 texels, stops out of order are pushed up to the one before them
+static void bake_ramp(const struct Gradient *gradient, uint8_t *texels)
+{
+	uint32_t count = gradient->stop_count < PAINT_MAX_STOPS ? gradient->stop_count : PAINT_MAX_STOPS;
+
+	if (count == 0) {
+		memset(texels, 0, PAINT_RAMP_WIDTH * 4);
+		return;
+	}
+
+	float offsets[PAINT_MAX_STOPS];
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		offsets[i] = i > 0 && gradient->stops[i].offset < offsets[i - 1] ? offsets[i - 1] : gradient->stops[i].offset;
+	}
+
+	uint32_t next = 0;
+
+	for (uint32_t x = 0; x < PAINT_RAMP_WIDTH; x++)
+	{
+		float t = (float) x / (PAINT_RAMP_WIDTH - 1);
+
+		while (next < count && offsets[next] < t) next++;
+
+		float color[4];
+
+		if (next == 0 || next == count) {
+			memcpy(color, gradient->stops[next == 0 ? 0 : count - 1].color, sizeof(color));
+		}
+		else {
+			const float *a = gradient->stops[next - 1].color;
+			const float *b = gradient->stops[next].color;
+			float span = offsets[next] - offsets[next - 1];
+			float f = span > 0.0f ? (t - offsets[next - 1]) / span : 1.0f;
+
+			for (int c = 0; c < 4; c++) color[c] = a[c] + (b[c] - a[c]) * f;
+		}
+
+		texels[4 * x + 0] = linear_to_srgb(color[0]);
+		texels[4 * x + 1] = linear_to_srgb(color[1]);
+		texels[4 * x + 2] = linear_to_srgb(color[2]);
+		texels[4 * x + 3] = (uint8_t) ((color[3] < 0.0f ? 0.0f : color[3] > 1.0f ? 1.0f : color[3]) * 255.0f + 0.5f);
+	}
+}
+
+// ramp cache, open addressing with linear probing; the slot holding key, or the empty one it would go in
+static uint32_t find_ramp_slot(const struct PaintSystem *system, uint64_t key)
+{
+	uint32_t slot = (uint32_t) key & (PAINT_RAMP_TABLE - 1);
+
+	while (system->ramp_table[slot] != 0 && system->ramp_keys[system->ramp_table[slot] - 1] != key)
+	{
+		slot = (slot + 1) & (PAINT_RAMP_TABLE - 1);
+	}
+
+	return slot;
+}
+
+// evictions are rare, the table is simply rebuilt after one
+static void rebuild_ramp_table(struct PaintSystem *system)
+{
+	memset(system->ramp_table, 0, sizeof(system->ramp_table));
+
+	for (uint32_t row = 0; row < system->ramp_count; row++)
+	{
+		system->ramp_table[find_ramp_slot(system, system->ramp_keys[row])] = (uint16_t) (row + 1);
+	}
+}
+
+static void ramp_barrier(VkCommandBuffer command_buffer, VkImage image, VkImageLayout old_layout, VkImageLayout new_layout, VkAccessFlags src_access, VkAccessFlags dst_access, VkPipelineStageFlags src_stage, VkPipelineStageFlags dst_stage)
+{
+	VkImageMemoryBarrier barrier = {
+		.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+		.pNext = NULL,
+		.srcAccessMask = src_access,
+		.dstAccessMask = dst_access,
+		.oldLayout = old_layout,
+		.newLayout = new_layout,
+		.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.image = image,
+		.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1},
+	};
+
+	vkCmdPipelineBarrier(command_buffer, src_stage, dst_stage, 0, 0, NULL, 0, NULL, 1, &barrier);
+}
+
+static VkDescriptorSetLayout create_paint_set_layout(VkDevice device)
+{
+	VkDescriptorSetLayoutBinding bindings[2] = {
+		{
+			.binding = 0,
+			.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+			.descriptorCount = 1,
+			.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+			.pImmutableSamplers = NULL,
+		},
+		{
+			.binding = 1,
+			.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			.descriptorCount = 1,
+			.stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+			.pImmutableSamplers = NULL,
+		},
+	};
+
+	VkDescriptorSetLayoutCreateInfo set_layout_info = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+		.pNext = NULL,
+		.flags = 0,
+		.bindingCount = 2,
+		.pBindings = bindings,
+	};
+
+	VkDescriptorSetLayout set_layout;
+	VkResult result = vkCreateDescriptorSetLayout(device, &set_layout_info, NULL, &set_layout);
+	if (result != VK_SUCCESS) printf("failed to create paint descriptor set layout\n");
+	if (result == VK_SUCCESS) track_resource(RESOURCE_DESCRIPTOR_SET_LAYOUT, set_layout, 0);
+
+	return set_layout;
+}
+
+static VkDescriptorSet create_paint_descriptor_set(VkDevice device, struct PaintSystem *system)
+{
+	VkDescriptorPoolSize pool_sizes[2] = {
+		{
+			.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+			.descriptorCount = 1,
+		},
+		{
+			.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			.descriptorCount = 1,
+		},
+	};
+
+	VkDescriptorPoolCreateInfo pool_info = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+		.pNext = NULL,
+		.flags = 0,
+		.maxSets = 1,
+		.poolSizeCount = 2,
+		.pPoolSizes = pool_sizes,
+	};
+
+	VkResult result = vkCreateDescriptorPool(device, &pool_info, NULL, &system->descriptor_pool);
+	if (result != VK_SUCCESS) printf("failed to create paint descriptor pool\n");
+	if (result == VK_SUCCESS) track_resource(RESOURCE_DESCRIPTOR_POOL, system->descriptor_pool, 0);
+
+	VkDescriptorSetAllocateInfo allocate_info = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+		.pNext = NULL,
+		.descriptorPool = system->descriptor_pool,
+		.descriptorSetCount = 1,
+		.pSetLayouts = &system->set_layout,
+	};
+
+	VkDescriptorSet descriptor_set;
+	result = vkAllocateDescriptorSets(device, &allocate_info, &descriptor_set);
+	if (result != VK_SUCCESS) printf("failed to allocate paint descriptor set\n");
+
+	VkDescriptorImageInfo image_info = {
+		.sampler = system->sampler,
+		.imageView = system->ramps.view,
+		.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+	};
+
+	VkDescriptorBufferInfo buffer_info = {
+		.buffer = system->instance_buffer.buffer,
+		.offset = 0,
+		.range = VK_WHOLE_SIZE,
+	};
+
+	VkWriteDescriptorSet writes[2] = {
+		{
+			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			.pNext = NULL,
+			.dstSet = descriptor_set,
+			.dstBinding = 0,
+			.dstArrayElement = 0,
+			.descriptorCount = 1,
+			.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+			.pImageInfo = &image_info,
+			.pBufferInfo = NULL,
+			.pTexelBufferView = NULL,
+		},
+		{
+			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			.pNext = NULL,
+			.dstSet = descriptor_set,
+			.dstBinding = 1,
+			.dstArrayElement = 0,
+			.descriptorCount = 1,
+			.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			.pImageInfo = NULL,
+			.pBufferInfo = &buffer_info,
+			.pTexelBufferView = NULL,
+		},
+	};
+
+	vkUpdateDescriptorSets(device, 2, writes, 0, NULL);
+
+	return descriptor_set;
+}
+
+struct PaintSystem *create_paint_system(VkPhysicalDevice physical_device, VkDevice device, VkCommandPool command_pool, VkQueue queue, VkDescriptorSetLayout texture_set_layout, uint32_t frames_in_flight)
+{
+	struct PaintSystem *system = calloc(1, sizeof(struct PaintSystem));
+
+	system->device = device;
+	system->frames_in_flight = frames_in_flight > 0 ? frames_in_flight : 1;
+
+	VkExtent2D ramp_extent = {PAINT_RAMP_WIDTH, PAINT_RAMP_COUNT};
+	system->ramps = create_image(physical_device, device, ramp_extent, PAINT_RAMP_FORMAT, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+	system->ramp_staging = create_buffer(physical_device, device, PAINT_RAMP_COUNT * PAINT_RAMP_WIDTH * 4, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+	// rows are only sampled once baked, the rest of the texture never needs contents
+	VkCommandBuffer command_buffer = begin_single_time_commands(device, command_pool);
+	ramp_barrier(command_buffer, system->ramps.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 0, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+	end_single_time_commands(device, command_pool, queue, command_buffer);
+
+	VkDeviceSize instance_size = (VkDeviceSize) system->frames_in_flight * PAINT_MAX_INSTANCES * sizeof(struct PaintInstance);
+	system->instance_buffer = create_buffer(physical_device, device, instance_size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+	// texels are evaluated at the centre of a row, linear filtering never blends two stop lists
+	system->sampler = create_sampler(device, VK_FILTER_LINEAR, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE);
+	system->set_layout = create_paint_set_layout(device);
+	system->set = create_paint_descriptor_set(device, system);
+
+	VkDescriptorSetLayout set_layouts[2] = {system->set_layout, texture_set_layout};
+	system->layout = create_pipeline_layout(device, 2, set_layouts, VK_SHADER_STAGE_VERTEX_BIT, 4 * sizeof(float));
+
+	return system;
+}
+
+void destroy_paint_system(struct PaintSystem *system)
+{
+	VkDevice device = system->device;
+
+	untrack_resource(RESOURCE_PIPELINE_LAYOUT, system->layout);
+	vkDestroyPipelineLayout(device, system->layout, NULL);
+	untrack_resource(RESOURCE_DESCRIPTOR_POOL, system->descriptor_pool);
+	vkDestroyDescriptorPool(device, system->descriptor_pool, NULL);
+	untrack_resource(RESOURCE_DESCRIPTOR_SET_LAYOUT, system->set_layout);
+	vkDestroyDescriptorSetLayout(device, system->set_layout, NULL);
+	untrack_resource(RESOURCE_SAMPLER, system->sampler);
+	vkDestroySampler(device, system->sampler, NULL);
+	destroy_buffer(device, &system->instance_buffer);
+	destroy_buffer(device, &system->ramp_staging);
+	destroy_image(device, &system->ramps);
+
+	free(system);
+}
+
+void begin_paint_frame(struct PaintSystem *system, uint64_t frame_index)
+{
+	system->frame_index = frame_index;
+	system->instance_count = 0;
+	system->stats.instances = 0;
+	system->stats.draws = 0;
+}
+
+uint32_t get_gradient_ramp(struct PaintSystem *system, const struct Gradient *gradient)
+{
+	uint64_t key = hash_gradient(gradient);
+	uint32_t slot = find_ramp_slot(system, key);
+
+	if (system->ramp_table[slot] != 0) {
+		uint32_t row = system->ramp_table[slot] - 1;
+
+		system->ramp_frames[row] = system->frame_index;
+		system->stats.ramp_hits++;
+
+		return row;
+	}
+
+	uint32_t row = PAINT_NO_RAMP;
+	bool evicted = false;
+
+	if (system->ramp_count < PAINT_RAMP_COUNT) {
+		row = system->ramp_count++;
+	}
+	else {
+		// the least recently used row no frame in flight samples any more
+		for (uint32_t i = 0; i < PAINT_RAMP_COUNT; i++)
+		{
+			if (system->ramp_frames[i] + system->frames_in_flight > system->frame_index) continue;
+			if (row == PAINT_NO_RAMP || system->ramp_frames[i] < system->ramp_frames[row]) row = i;
+		}
+
+		if (row == PAINT_NO_RAMP) return PAINT_NO_RAMP;
+
+		evicted = true;
+		system->stats.ramps_evicted++;
+	}
+
+	system->ramp_keys[row] = key;
+	system->ramp_frames[row] = system->frame_index;
+
+	if (evicted) rebuild_ramp_table(system);
+	else system->ramp_table[slot] = (uint16_t) (row + 1);
+
+	bake_ramp(gradient, (uint8_t *) system->ramp_staging.mapped + (size_t) row * PAINT_RAMP_WIDTH * 4);
+
+	system->dirty[system->dirty_count++] = row;
+	system->stats.ramps_baked++;
+	system->stats.ramps_resident = system->ramp_count;
+
+	return row;
+}
+
+bool push_paint_rect(struct PaintSystem *system, const float rect[4], const struct Paint *paint, const struct Gradient *gradient, uint32_t texture)
+{
+	if (system->instance_count == PAINT_MAX_INSTANCES) return false;
+
+	uint32_t kind = paint->kind < PAINT_KIND_COUNT ? paint->kind : PAINT_KIND_SOLID;
+	uint32_t ramp = 0;
+	float color[4] = {paint->color[0], paint->color[1], paint->color[2], paint->color[3]};
+
+	bool gradient_kind = kind == PAINT_KIND_LINEAR || kind == PAINT_KIND_RADIAL || kind == PAINT_KIND_CONIC;
+
+	if (gradient_kind && gradient != NULL && gradient->stop_count > 0) {
+		ramp = get_gradient_ramp(system, gradient);
+	}
+	else if (gradient_kind) {
+		kind = PAINT_KIND_SOLID;
+	}
+
+	// every row still in use: the first stop's color stands in for the gradient this frame
+	if (ramp == PAINT_NO_RAMP) {
+		for (int c = 0; c < 4; c++) color[c] *= gradient->stops[0].color[c];
+
+		kind = PAINT_KIND_SOLID;
+		ramp = 0;
+	}
+
+	if (kind == PAINT_KIND_PATTERN && texture == LOADER_NO_TEXTURE) kind = PAINT_KIND_SOLID;
+
+	uint32_t slice = (uint32_t) (system->frame_index % system->frames_in_flight);
+	struct PaintInstance *instances = system->instance_buffer.mapped;
+
+	instances[slice * PAINT_MAX_INSTANCES + system->instance_count] = (struct PaintInstance) {
+		.rect = {rect[0], rect[1], rect[2], rect[3]},
+		.params = {paint->params[0], paint->params[1], paint->params[2], paint->params[3]},
+		.color = {color[0], color[1], color[2], color[3]},
+		.kind = kind,
+		.extend = paint->extend < PAINT_EXTEND_COUNT ? paint->extend : PAINT_EXTEND_PAD,
+		.ramp = ramp,
+		.pad = 0,
+	};
+
+	system->textures[system->instance_count++] = kind == PAINT_KIND_PATTERN ? texture : LOADER_NO_TEXTURE;
+
+	return true;
+}
+
+void record_paint_uploads(VkCommandBuffer command_buffer, struct PaintSystem *system)
+{
+	if (system->dirty_count == 0) return;
+
+	// rows in use by earlier frames are left alone, only fresh ones are written
+	ramp_barrier(command_buffer, system->ramps.image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+	VkBufferImageCopy regions[PAINT_RAMP_COUNT];
+
+	for (uint32_t i = 0; i < system->dirty_count; i++)
+	{
+		uint32_t row = system->dirty[i];
+
+		regions[i] = (VkBufferImageCopy) {
+			.bufferOffset = (VkDeviceSize) row * PAINT_RAMP_WIDTH * 4,
+			.bufferRowLength = 0,
+			.bufferImageHeight = 0,
+			.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},
+			.imageOffset = {0, (int32_t) row, 0},
+			.imageExtent = {PAINT_RAMP_WIDTH, 1, 1},
+		};
+	}
+
+	vkCmdCopyBufferToImage(command_buffer, system->ramp_staging.buffer, system->ramps.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, system->dirty_count, regions);
+
+	ramp_barrier(command_buffer, system->ramps.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+
+	system->dirty_count = 0;
+}
+
+void record_paints(VkCommandBuffer command_buffer, struct PaintSystem *system, VkPipeline pipeline, const struct AssetLoader *loader, const float view[4], uint32_t first, uint32_t count)
+{
+	uint32_t end = first + count < system->instance_count ? first + count : system->instance_count;
+	if (first >= end || pipeline == VK_NULL_HANDLE) return;
+
+	system->stats.instances += end - first;
+
+	uint32_t base = (uint32_t) (system->frame_index % system->frames_in_flight) * PAINT_MAX_INSTANCES;
+
+	vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+	vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, system->layout, 0, 1, &system->set, 0, NULL);
+	vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, system->layout, 1, 1, &loader->placeholder_set, 0, NULL);
+	vkCmdPushConstants(command_buffer, system->layout, VK_SHADER_STAGE_VERTEX_BIT, 0, 4 * sizeof(float), view);
+
+	// one instanced draw per run of shapes that agree on the pattern texture, anything but a pattern fits any run
+
+	uint32_t start = first;
+	uint32_t bound = LOADER_NO_TEXTURE;
+
+	for (uint32_t i = first; i < end; i++)
+	{
+		uint32_t texture = system->textures[i];
+		if (texture == LOADER_NO_TEXTURE || texture == bound) continue;
+
+		if (bound != LOADER_NO_TEXTURE && i > start) {
+			vkCmdDraw(command_buffer, 4, i - start, 0, base + start);
+			system->stats.draws++;
+			start = i;
+		}
+
+		VkDescriptorSet set = get_texture_set(loader, texture);
+		vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, system->layout, 1, 1, &set, 0, NULL);
+		bound = texture;
+	}
+
+	vkCmdDraw(command_buffer, 4, end - start, 0, base + start);
+	system->stats.draws++;
+}
+
+void print_paint_stats(const struct PaintSystem *system)
+{
+	const struct PaintStats *stats = &system->stats;
+
+	printf("paint: %u shapes in %u draws, %u ramps resident, %u baked, %u evicted, %u ramp hits\n", stats->instances, stats->draws, stats->ramps_resident, stats->ramps_baked, stats->ramps_evicted, stats->ramp_hits);
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include "render.h"
+#include "loader.h"
+
+// Paints for filled rectangles: solid colors, linear, radial and conic
+// gradients and repeating image patterns, all evaluated per pixel by one
+// fragment shader from a compact per instance description.
+//
+// Gradient stops are baked into rows of a shared ramp texture, one row per
+// distinct stop list, found again by a hash of the stops. Shapes are drawn
+// instanced in painter's order; a new draw only starts where a pattern
+// needs a different texture, so thousands of gradients cost a few draws.
+//
+// Colors are linear with straight alpha, the ramps are interpolated in
+// linear light and premultiplied in the shader.
+
+#define PAINT_MAX_STOPS 8
+#define PAINT_RAMP_WIDTH 256
+#define PAINT_RAMP_COUNT 256  // rows, distinct stop lists in use at once
+#define PAINT_RAMP_TABLE 512  // power of two, at least twice PAINT_RAMP_COUNT
+#define PAINT_MAX_INSTANCES 8192
+#define PAINT_RAMP_FORMAT VK_FORMAT_R8G8B8A8_SRGB
+#define PAINT_NO_RAMP UINT32_MAX
+
+enum PaintKind {
+	PAINT_KIND_SOLID,
+	PAINT_KIND_LINEAR,  // params: start x, y, end x, y
+	PAINT_KIND_RADIAL,  // params: center x, y, radius
+	PAINT_KIND_CONIC,   // params: center x, y, start angle in radians
+	PAINT_KIND_PATTERN, // params: origin x, y, tile width, height
+	PAINT_KIND_COUNT,
+};
+
+// what happens past the ends of a gradient or pattern; conic gradients always wrap
+enum PaintExtend {
+	PAINT_EXTEND_PAD,
+	PAINT_EXTEND_REPEAT,
+	PAINT_EXTEND_REFLECT,
+	PAINT_EXTEND_COUNT,
+};
+
+struct GradientStop {
+	float offset; // 0 to 1, never less than the stop before
+	float color[4];
+};
+
+struct Gradient {
+	uint32_t stop_count;
+	struct GradientStop stops[PAINT_MAX_STOPS];
+};
+
+// plain data, so scenes can trace it; positions are in the same space as the rect
+struct Paint {
+	uint32_t kind;   // enum PaintKind
+	uint32_t extend; // enum PaintExtend
+	float params[4];
+	float color[4];  // solid color, multiplies gradients and patterns
+};
+
+// per instance, std430, read by paint.vert and paint.frag
+struct PaintInstance {
+	float rect[4];   // x, y, width, height
+	float params[4];
+	float color[4];
+	uint32_t kind;
+	uint32_t extend;
+	uint32_t ramp;   // row of the ramp texture
+	uint32_t pad;
+};
+
+struct PaintStats {
+	uint32_t instances; // last recorded frame
+	uint32_t draws;     // last recorded frame
+	uint32_t ramp_hits;
+	uint32_t ramps_baked;
+	uint32_t ramps_evicted;
+	uint32_t ramps_resident;
+};
+
+struct PaintSystem {
+	VkDevice device;
+	uint32_t frames_in_flight;
+	uint64_t frame_index;
+
+	// one row per stop list, rows unused for frames_in_flight frames are evicted when the texture is full
+	struct Image ramps;
+	struct Buffer ramp_staging; // a row's texels, written when it is baked
+	uint64_t ramp_keys[PAINT_RAMP_COUNT];
+	uint64_t ramp_frames[PAINT_RAMP_COUNT]; // last used
+	uint32_t ramp_count;
+	uint16_t ramp_table[PAINT_RAMP_TABLE]; // open addressing on the key, row + 1, 0 when empty
+	uint32_t dirty[PAINT_RAMP_COUNT];      // rows baked since the last upload
+	uint32_t dirty_count;
+
+	// a slice of PAINT_MAX_INSTANCES per frame in flight
+	struct Buffer instance_buffer;
+	uint32_t instance_count;
+	uint32_t textures[PAINT_MAX_INSTANCES]; // pattern of each instance, LOADER_NO_TEXTURE for none
+
+	VkSampler sampler;
+	VkDescriptorSetLayout set_layout;
+	VkDescriptorPool descriptor_pool;
+	VkDescriptorSet set;
+	VkPipelineLayout layout; // paint set, then a loader texture set for patterns
+
+	struct PaintStats stats;
+};
+
+struct PaintSystem *create_paint_system(VkPhysicalDevice physical_device, VkDevice device, VkCommandPool command_pool, VkQueue queue, VkDescriptorSetLayout texture_set_layout, uint32_t frames_in_flight);
+void destroy_paint_system(struct PaintSystem *system);
+
+// forgets the last frame's shapes; the previous use of frame_index's instance slice has to be finished
+void begin_paint_frame(struct PaintSystem *system, uint64_t frame_index);
+
+// the ramp row for a stop list, baked on first use; PAINT_NO_RAMP when every row is still in use
+uint32_t get_gradient_ramp(struct PaintSystem *system, const struct Gradient *gradient);
+
+// gradient is only read for gradient paints, texture only for patterns; false when the frame is full
+bool push_paint_rect(struct PaintSystem *system, const float rect[4], const struct Paint *paint, const struct Gradient *gradient, uint32_t texture);
+
+// copies rows baked this frame into the ramp texture, outside a render pass
+void record_paint_uploads(VkCommandBuffer command_buffer, struct PaintSystem *system);
+
+// draws count shapes pushed this frame starting at first, in the order they were pushed, inside a
+// render pass; a frame's shapes can be drawn in several ranges, with other draws or clips between them.
+// view is x0, y0, 2 / width, 2 / height
+void record_paints(VkCommandBuffer command_buffer, struct PaintSystem *system, VkPipeline pipeline, const struct AssetLoader *loader, const float view[4], uint32_t first, uint32_t count);
+
+void print_paint_stats(const struct PaintSystem *system);
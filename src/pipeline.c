@@ -0,0 +1,349 @@
+#define _POSIX_C_SOURCE 199309L // clock_gettime
+
+#include <vulkan/vulkan.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+
+#include "render.h"
+#include "pipeline.h"
+#include "track.h"
+
+static uint64_t hash_combine(uint64_t hash, uint64_t value)
+{
+	// fnv-1a over the bytes of value
+	for (int i = 0; i < 8; i++)
+	{
+		hash ^= (value >> (i * 8)) & 0xff;
+		hash *= 0x100000001b3ull;
+	}
+
+	return hash;
+}
+
+static uint64_t hash_pipeline_key(const struct PipelineKey *key)
+{
+	uint64_t hash = 0xcbf29ce484222325ull;
+
+	hash = hash_combine(hash, (uint64_t) (uintptr_t) key->render_pass);
+	hash = hash_combine(hash, key->program);
+	hash = hash_combine(hash, key->blend);
+	hash = hash_combine(hash, key->topology);
+	hash = hash_combine(hash, key->samples);
+	hash = hash_combine(hash, key->color_format);
+	hash = hash_combine(hash, key->stencil_format);
+	hash = hash_combine(hash, key->stencil);
+	hash = hash_combine(hash, key->vertex_layout);
+
+	// 0 marks an empty slot
+	return hash != 0 ? hash : 1;
+}
+
+static bool pipeline_key_equal(const struct PipelineKey *a, const struct PipelineKey *b)
+{
+	return a->render_pass == b->render_pass &&
+		a->program == b->program &&
+		a->blend == b->blend &&
+		a->topology == b->topology &&
+		a->samples == b->samples &&
+		a->color_format == b->color_format &&
+		a->stencil_format == b->stencil_format &&
+		a->stencil == b->stencil &&
+		a->vertex_layout == b->vertex_layout;
+}
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+}
+
+struct PipelineRegistry *create_pipeline_registry(VkDevice device, VkPipelineCache cache, VkExtent2D extent)
+{
+	struct PipelineRegistry *registry = calloc(1, sizeof(struct PipelineRegistry));
+
+	if (registry == NULL) {
+		report_render_failure(VK_ERROR_OUT_OF_HOST_MEMORY, "allocate pipeline registry");
+		return NULL;
+	}
+
+	registry->device = device;
+	registry->extent = extent;
+	registry->cache = cache;
+	registry->owns_cache = cache == VK_NULL_HANDLE;
+
+	VkPipelineCacheCreateInfo cache_info = {
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+		.pNext = NULL,
+		.flags = 0,
+		.initialDataSize = 0,
+		.pInitialData = NULL,
+	};
+
+	VkResult result = registry->owns_cache ? vkCreatePipelineCache(device, &cache_info, NULL, &registry->cache) : VK_SUCCESS;
+	if (result != VK_SUCCESS) {
+		printf("failed to create pipeline cache\n");
+		registry->cache = VK_NULL_HANDLE;
+	}
+
+	if (result == VK_SUCCESS && registry->owns_cache) track_resource(RESOURCE_PIPELINE_CACHE, registry->cache, 0);
+
+	pthread_mutex_init(&registry->lock, NULL);
+
+	for (uint32_t i = 0; i < PIPELINE_REGISTRY_CAPACITY; i++)
+	{
+		atomic_init(&registry->slots[i].hash, 0);
+	}
+
+	atomic_init(&registry->hits, 0);
+	atomic_init(&registry->misses, 0);
+	atomic_init(&registry->compile_ns, 0);
+	atomic_init(&registry->reloads, 0);
+
+	return registry;
+}
+
+void destroy_pipeline_registry(struct PipelineRegistry *registry)
+{
+	if (registry == NULL) return;
+
+	for (uint32_t i = 0; i < PIPELINE_REGISTRY_CAPACITY; i++)
+	{
+		if (atomic_load_explicit(&registry->slots[i].hash, memory_order_acquire) != 0) {
+			untrack_resource(RESOURCE_PIPELINE, registry->slots[i].pipeline);
+			vkDestroyPipeline(registry->device, registry->slots[i].pipeline, NULL);
+		}
+	}
+
+	if (registry->owns_cache) {
+		untrack_resource(RESOURCE_PIPELINE_CACHE, registry->cache);
+		if (registry->cache != VK_NULL_HANDLE) vkDestroyPipelineCache(registry->device, registry->cache, NULL);
+	}
+
+	pthread_mutex_destroy(&registry->lock);
+	free(registry);
+}
+
+uint32_t register_pipeline_program(struct PipelineRegistry *registry, const char *vert_path, const char *frag_path, VkPipelineLayout layout)
+{
+	if (registry == NULL) return PIPELINE_NO_PROGRAM;
+
+	if (registry->program_count == PIPELINE_MAX_PROGRAMS) {
+		printf("failed to register pipeline program, too many programs\n");
+		return PIPELINE_NO_PROGRAM;
+	}
+
+	registry->programs[registry->program_count] = (struct PipelineProgram) {
+		.vert_path = vert_path,
+		.frag_path = frag_path,
+		.layout = layout,
+	};
+
+	return registry->program_count++;
+}
+
+struct PipelineKey make_pipeline_key(uint32_t program, const struct PipelineState *state)
+{
+	struct PipelineKey key = {
+		.render_pass = state->render_pass,
+		.program = program,
+		.blend = state->blend,
+		.topology = state->topology,
+		.samples = state->samples,
+		.color_format = state->color_format,
+		.stencil_format = state->stencil_format,
+		.stencil = state->stencil_format != VK_FORMAT_UNDEFINED ? state->stencil : STENCIL_MODE_NONE,
+		.vertex_layout = state->vertex_layout,
+	};
+
+	return key;
+}
+
+static struct PipelineState key_state(const struct PipelineKey *key)
+{
+	struct PipelineState state = {
+		.render_pass = key->render_pass,
+		.color_format = (VkFormat) key->color_format,
+		.stencil_format = (VkFormat) key->stencil_format,
+		.stencil = (enum StencilMode) key->stencil,
+		.blend = (enum BlendMode) key->blend,
+		.topology = (VkPrimitiveTopology) key->topology,
+		.samples = (VkSampleCountFlagBits) key->samples,
+		.vertex_layout = (enum VertexLayout) key->vertex_layout,
+	};
+
+	return state;
+}
+
+// returns the slot holding key, or the empty slot where it would go; NULL when full
+static struct PipelineSlot *find_slot(struct PipelineRegistry *registry, const struct PipelineKey *key, uint64_t hash, bool *found)
+{
+	uint32_t mask = PIPELINE_REGISTRY_CAPACITY - 1;
+
+	for (uint32_t probe = 0; probe < PIPELINE_REGISTRY_CAPACITY; probe++)
+	{
+		struct PipelineSlot *slot = &registry->slots[(hash + probe) & mask];
+
+		// acquire pairs with the release in get_pipeline, key and pipeline are visible once the hash is
+		uint64_t slot_hash = atomic_load_explicit(&slot->hash, memory_order_acquire);
+
+		*found = slot_hash != 0;
+
+		if (slot_hash == 0) return slot;
+		if (slot_hash == hash && pipeline_key_equal(&slot->key, key)) return slot;
+	}
+
+	*found = false;
+	return NULL;
+}
+
+VkPipeline get_pipeline(struct PipelineRegistry *registry, const struct PipelineKey *key)
+{
+	if (registry == NULL) return VK_NULL_HANDLE;
+
+	uint64_t hash = hash_pipeline_key(key);
+
+	bool found = false;
+	struct PipelineSlot *slot = find_slot(registry, key, hash, &found);
+
+	if (found) {
+		atomic_fetch_add_explicit(&registry->hits, 1, memory_order_relaxed);
+		return slot->pipeline;
+	}
+
+	// miss, another thread may have built it while we were looking
+
+	pthread_mutex_lock(&registry->lock);
+
+	slot = find_slot(registry, key, hash, &found);
+
+	if (slot == NULL) {
+		pthread_mutex_unlock(&registry->lock);
+		printf("failed to create pipeline, registry is full\n");
+		return VK_NULL_HANDLE;
+	}
+
+	if (found) {
+		pthread_mutex_unlock(&registry->lock);
+		atomic_fetch_add_explicit(&registry->hits, 1, memory_order_relaxed);
+		return slot->pipeline;
+	}
+
+	if (key->program >= registry->program_count) {
+		pthread_mutex_unlock(&registry->lock);
+		printf("failed to create pipeline, unknown program %u\n", key->program);
+		return VK_NULL_HANDLE;
+	}
+
+	const struct PipelineProgram *program = &registry->programs[key->program];
+
+	struct PipelineState state = key_state(key);
+
+	uint64_t start = now_ns();
+
+	VkPipeline pipeline = create_graphics_pipeline_state(registry->device, registry->cache, registry->extent, program->layout, program->vert_path, program->frag_path, &state);
+
+	atomic_fetch_add_explicit(&registry->compile_ns, now_ns() - start, memory_order_relaxed);
+	atomic_fetch_add_explicit(&registry->misses, 1, memory_order_relaxed);
+
+	// a failure stays unpublished, the next lookup tries again
+	if (pipeline == VK_NULL_HANDLE) {
+		pthread_mutex_unlock(&registry->lock);
+		return VK_NULL_HANDLE;
+	}
+
+	slot->key = *key;
+	slot->pipeline = pipeline;
+	registry->pipeline_count++;
+
+	atomic_store_explicit(&slot->hash, hash, memory_order_release);
+
+	pthread_mutex_unlock(&registry->lock);
+
+	return pipeline;
+}
+
+uint32_t rebuild_pipelines(struct PipelineRegistry *registry, const char *path, struct PipelineReload *reloads, uint32_t capacity)
+{
+	if (registry == NULL) return 0;
+
+	struct PipelineKey *keys = malloc(capacity * sizeof(struct PipelineKey));
+	uint32_t count = 0;
+
+	if (keys == NULL) {
+		printf("failed to rebuild pipelines for %s, out of memory\n", path);
+		return 0;
+	}
+
+	// only the list of keys is taken under the lock, compiling happens without it
+
+	pthread_mutex_lock(&registry->lock);
+
+	for (uint32_t i = 0; i < PIPELINE_REGISTRY_CAPACITY && count < capacity; i++)
+	{
+		const struct PipelineSlot *slot = &registry->slots[i];
+		if (atomic_load_explicit(&slot->hash, memory_order_acquire) == 0) continue;
+
+		const struct PipelineProgram *program = &registry->programs[slot->key.program];
+		if (strcmp(program->vert_path, path) != 0 && strcmp(program->frag_path, path) != 0) continue;
+
+		reloads[count].slot = i;
+		keys[count++] = slot->key;
+	}
+
+	pthread_mutex_unlock(&registry->lock);
+
+	uint32_t built = 0;
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		const struct PipelineProgram *program = &registry->programs[keys[i].program];
+		struct PipelineState state = key_state(&keys[i]);
+
+		VkPipeline pipeline = create_graphics_pipeline_state(registry->device, registry->cache, registry->extent, program->layout, program->vert_path, program->frag_path, &state);
+		if (pipeline == VK_NULL_HANDLE) continue;
+
+		reloads[built].slot = reloads[i].slot;
+		reloads[built++].pipeline = pipeline;
+	}
+
+	free(keys);
+
+	return built;
+}
+
+void swap_pipelines(struct PipelineRegistry *registry, struct PipelineReload *reloads, uint32_t count)
+{
+	if (registry == NULL) return;
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		struct PipelineSlot *slot = &registry->slots[reloads[i].slot];
+
+		VkPipeline previous = slot->pipeline;
+		slot->pipeline = reloads[i].pipeline;
+		reloads[i].pipeline = previous;
+	}
+
+	atomic_fetch_add_explicit(&registry->reloads, count, memory_order_relaxed);
+}
+
+void print_pipeline_registry(struct PipelineRegistry *registry)
+{
+	if (registry == NULL) return;
+
+	uint64_t hits = atomic_load(&registry->hits);
+	uint64_t misses = atomic_load(&registry->misses);
+	uint64_t compile_ns = atomic_load(&registry->compile_ns);
+
+	printf("pipeline registry: %u pipelines, %u programs\n", registry->pipeline_count, registry->program_count);
+	printf("\tlookups: %llu hits, %llu misses\n", (unsigned long long) hits, (unsigned long long) misses);
+	printf("\tcompile time: %.2f ms total, %.2f ms per pipeline\n", compile_ns / 1e6, misses > 0 ? compile_ns / 1e6 / misses : 0.0);
+	printf("\treloads: %llu pipelines\n", (unsigned long long) atomic_load(&registry->reloads));
+}
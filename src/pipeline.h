@@ -0,0 +1,94 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "render.h"
+
+// Graphics pipelines created lazily from a compact render state key. A
+// program is a shader pair and layout registered up front; everything else
+// that varies between draws (blend mode, topology, sample count, vertex layout,
+// stencil use, render pass or attachment formats) goes into the key.
+//
+// Lookups are lock free: slots are published with a release store of their
+// hash, so readers only ever see fully built entries. Misses take a mutex,
+// look again and compile, so a key is never created twice.
+//
+// Pipelines can be rebuilt from new shader code while frames are recorded
+// and swapped into their slots between frames, for hot reloading.
+
+#define PIPELINE_MAX_PROGRAMS 32
+#define PIPELINE_REGISTRY_CAPACITY 256 // power of two
+#define PIPELINE_NO_PROGRAM UINT32_MAX
+
+struct PipelineProgram {
+	const char *vert_path;
+	const char *frag_path;
+	VkPipelineLayout layout;
+};
+
+struct PipelineKey {
+	VkRenderPass render_pass; // VK_NULL_HANDLE for dynamic rendering
+	uint32_t program;
+	uint32_t blend;           // enum BlendMode
+	uint32_t topology;        // VkPrimitiveTopology
+	uint32_t samples;         // VkSampleCountFlagBits
+	uint32_t color_format;    // VkFormat
+	uint32_t stencil_format;  // VkFormat
+	uint32_t stencil;         // enum StencilMode
+	uint32_t vertex_layout;   // enum VertexLayout
+};
+
+struct PipelineSlot {
+	_Atomic uint64_t hash; // 0 while empty, stored last
+	struct PipelineKey key;
+	VkPipeline pipeline;
+};
+
+struct PipelineRegistry {
+	VkDevice device;
+	VkExtent2D extent;
+	VkPipelineCache cache;
+	bool owns_cache; // false when the cache is shared with other registries
+
+	struct PipelineProgram programs[PIPELINE_MAX_PROGRAMS];
+	uint32_t program_count;
+
+	struct PipelineSlot slots[PIPELINE_REGISTRY_CAPACITY];
+	pthread_mutex_t lock; // serializes misses
+	uint32_t pipeline_count;
+
+	_Atomic uint64_t hits;
+	_Atomic uint64_t misses;
+	_Atomic uint64_t compile_ns;
+	_Atomic uint64_t reloads;
+};
+
+// a pipeline rebuilt for a slot, the one it replaces once swapped
+struct PipelineReload {
+	uint32_t slot;
+	VkPipeline pipeline;
+};
+
+// cache is shared with whoever passed it and outlives the registry, VK_NULL_HANDLE for one of its own.
+// NULL when it could not be allocated, reported like the create_ helpers; every function here takes
+// a NULL registry as one that holds nothing and builds nothing
+struct PipelineRegistry *create_pipeline_registry(VkDevice device, VkPipelineCache cache, VkExtent2D extent);
+void destroy_pipeline_registry(struct PipelineRegistry *registry);
+
+// not thread safe, register every program before recording starts
+uint32_t register_pipeline_program(struct PipelineRegistry *registry, const char *vert_path, const char *frag_path, VkPipelineLayout layout);
+
+struct PipelineKey make_pipeline_key(uint32_t program, const struct PipelineState *state);
+// VK_NULL_HANDLE when the pipeline could not be made, skip the draw; failures are never cached
+VkPipeline get_pipeline(struct PipelineRegistry *registry, const struct PipelineKey *key);
+
+// builds new pipelines for every key whose program reads the shader at path, at most capacity of them;
+// safe from any thread, lookups and misses go on meanwhile. Returns how many were built
+uint32_t rebuild_pipelines(struct PipelineRegistry *registry, const char *path, struct PipelineReload *reloads, uint32_t capacity);
+
+// puts rebuilt pipelines into their slots and hands back the ones they replace in reloads, frames
+// already recorded may still use those. Only between frames, while no thread looks pipelines up
+void swap_pipelines(struct PipelineRegistry *registry, struct PipelineReload *reloads, uint32_t count);
+
+void print_pipeline_registry(struct PipelineRegistry *registry);
@@ -0,0 +1,333 @@
+#define _POSIX_C_SOURCE 200809L // clock_gettime, poll
+
+#include <vulkan/vulkan.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+
+#ifdef __linux__
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <sys/wait.h>
+#endif
+
+#include "render.h"
+#include "reload.h"
+#include "track.h"
+
+#ifndef VG_GLSLC
+#define VG_GLSLC "glslc"
+#endif
+
+#define RELOAD_MAX_PENDING 32
+#define RELOAD_POLL_MS 100 // how long the watcher sleeps before it checks whether to stop
+
+#ifdef __linux__
+
+// ids of the reloaders created so far, see compile_shader
+static atomic_uint next_reloader_id = 0;
+
+static uint64_t now_ms(void)
+{
+	struct timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+
+	return (uint64_t) time.tv_sec * 1000 + (uint64_t) time.tv_nsec / 1000000;
+}
+
+// "shader.vert" compiles to "shader_vert.spv", the names CMake gives them
+static bool spirv_name(const char *source, char *name, size_t size)
+{
+	const char *dot = strrchr(source, '.');
+	if (dot == NULL) return false;
+
+	if (strcmp(dot, ".vert") != 0 && strcmp(dot, ".frag") != 0 && strcmp(dot, ".comp") != 0) return false;
+
+	int length = snprintf(name, size, "%.*s_%s.spv", (int) (dot - source), source, dot + 1);
+
+	return length > 0 && (size_t) length < size;
+}
+
+// the temporary file is named after the process and the reloader, so concurrent compiles of one
+// shader, from other windows or other instances, each write their own
+static bool compile_shader(const struct ShaderReloader *reloader, const char *source, const char *output)
+{
+	char temporary[RELOAD_PATH_LENGTH * 2 + 48];
+	snprintf(temporary, sizeof(temporary), "%s.%ld.%u.tmp", output, (long) getpid(), reloader->id);
+
+	pid_t child = fork();
+	if (child < 0) return false;
+
+	if (child == 0) {
+		execlp(VG_GLSLC, VG_GLSLC, source, "-o", temporary, (char *) NULL);
+		_exit(127);
+	}
+
+	int status;
+	if (waitpid(child, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+		unlink(temporary);
+		return false;
+	}
+
+	// renamed over the old one, so pipelines built meanwhile never read half a file
+	return rename(temporary, output) == 0;
+}
+
+// hands rebuilt pipelines to the render thread, replacing older rebuilds of the same slot
+static void queue_reloads(struct ShaderReloader *reloader, const struct PipelineReload *reloads, uint32_t count)
+{
+	pthread_mutex_lock(&reloader->lock);
+
+	reloader->stats.pipelines_built += count;
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		uint32_t j = 0;
+		while (j < reloader->ready_count && reloader->ready[j].slot != reloads[i].slot) j++;
+
+		if (j < reloader->ready_count) {
+			// never swapped in, nothing can be using it
+			untrack_resource(RESOURCE_PIPELINE, reloader->ready[j].pipeline);
+			vkDestroyPipeline(reloader->device, reloader->ready[j].pipeline, NULL);
+			reloader->ready[j].pipeline = reloads[i].pipeline;
+		} else if (reloader->ready_count < RELOAD_MAX_PIPELINES) {
+			reloader->ready[reloader->ready_count++] = reloads[i];
+		} else {
+			untrack_resource(RESOURCE_PIPELINE, reloads[i].pipeline);
+			vkDestroyPipeline(reloader->device, reloads[i].pipeline, NULL);
+			reloader->stats.pipelines_dropped++;
+		}
+	}
+
+	pthread_mutex_unlock(&reloader->lock);
+}
+
+static void reload_shader(struct ShaderReloader *reloader, const char *source_name)
+{
+	char name[RELOAD_PATH_LENGTH];
+	char source[RELOAD_PATH_LENGTH * 2];
+	char output[RELOAD_PATH_LENGTH * 2];
+
+	if (!spirv_name(source_name, name, sizeof(name))) return;
+
+	snprintf(source, sizeof(source), "%s/%s", reloader->directory, source_name);
+	snprintf(output, sizeof(output), "%s/%s", reloader->directory, name);
+
+	bool compiled = compile_shader(reloader, source, output);
+
+	pthread_mutex_lock(&reloader->lock);
+	if (compiled) reloader->stats.compiles++;
+	else reloader->stats.failed_compiles++;
+	pthread_mutex_unlock(&reloader->lock);
+
+	if (!compiled) {
+		printf("failed to compile %s, keeping the old shader\n", source);
+		return;
+	}
+
+	struct PipelineReload reloads[RELOAD_MAX_PIPELINES];
+	uint32_t count = rebuild_pipelines(reloader->registry, output, reloads, RELOAD_MAX_PIPELINES);
+
+	queue_reloads(reloader, reloads, count);
+
+	printf("reloaded %s, %u pipelines rebuilt\n", source_name, count);
+}
+
+static void *shader_watcher(void *argument)
+{
+	struct ShaderReloader *reloader = argument;
+
+	// sources saved but not compiled yet, waiting for the editor to settle
+	char pending[RELOAD_MAX_PENDING][RELOAD_PATH_LENGTH];
+	uint32_t pending_count = 0;
+	uint64_t settle_time = 0;
+
+	_Alignas(struct inotify_event) char buffer[4096];
+
+	while (!atomic_load(&reloader->stop))
+	{
+		struct pollfd descriptor = {
+			.fd = reloader->inotify_fd,
+			.events = POLLIN,
+			.revents = 0,
+		};
+
+		int ready = poll(&descriptor, 1, pending_count > 0 ? RELOAD_SETTLE_MS : RELOAD_POLL_MS);
+
+		if (ready > 0 && (descriptor.revents & POLLIN)) {
+			ssize_t length = read(reloader->inotify_fd, buffer, sizeof(buffer));
+
+			for (ssize_t offset = 0; offset < length;)
+			{
+				const struct inotify_event *event = (const struct inotify_event *) (buffer + offset);
+				offset += sizeof(struct inotify_event) + event->len;
+
+				char name[RELOAD_PATH_LENGTH];
+				if (event->len == 0 || !spirv_name(event->name, name, sizeof(name))) continue;
+
+				uint32_t i = 0;
+				while (i < pending_count && strcmp(pending[i], event->name) != 0) i++;
+
+				if (i == pending_count && pending_count < RELOAD_MAX_PENDING && strlen(event->name) < RELOAD_PATH_LENGTH) {
+					strcpy(pending[pending_count++], event->name);
+				}
+
+				settle_time = now_ms() + RELOAD_SETTLE_MS;
+			}
+		}
+
+		if (pending_count == 0 || now_ms() < settle_time) continue;
+
+		for (uint32_t i = 0; i < pending_count; i++) reload_shader(reloader, pending[i]);
+		pending_count = 0;
+	}
+
+	return NULL;
+}
+
+struct ShaderReloader *create_shader_reloader(VkDevice device, struct PipelineRegistry *registry, const char *directory, uint32_t frames_in_flight)
+{
+	if (strlen(directory) >= RELOAD_PATH_LENGTH) {
+		printf("failed to watch shaders, directory path too long\n");
+		return NULL;
+	}
+
+	int inotify_fd = inotify_init1(IN_CLOEXEC);
+	if (inotify_fd < 0) {
+		printf("failed to watch shaders, inotify unavailable\n");
+		return NULL;
+	}
+
+	// editors either write in place or write a copy and move it over
+	if (inotify_add_watch(inotify_fd, directory, IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+		printf("failed to watch shaders in %s\n", directory);
+		close(inotify_fd);
+		return NULL;
+	}
+
+	struct ShaderReloader *reloader = calloc(1, sizeof(struct ShaderReloader));
+
+	reloader->device = device;
+	reloader->registry = registry;
+	reloader->frames_in_flight = frames_in_flight;
+	reloader->inotify_fd = inotify_fd;
+	reloader->id = atomic_fetch_add(&next_reloader_id, 1);
+	strcpy(reloader->directory, directory);
+
+	atomic_init(&reloader->stop, false);
+	pthread_mutex_init(&reloader->lock, NULL);
+
+	if (pthread_create(&reloader->watcher, NULL, shader_watcher, reloader) != 0) {
+		printf("failed to start shader watcher\n");
+		pthread_mutex_destroy(&reloader->lock);
+		close(inotify_fd);
+		free(reloader);
+		return NULL;
+	}
+
+	return reloader;
+}
+
+void destroy_shader_reloader(struct ShaderReloader *reloader)
+{
+	if (reloader == NULL) return;
+
+	atomic_store(&reloader->stop, true);
+	pthread_join(reloader->watcher, NULL);
+
+	close(reloader->inotify_fd);
+
+	for (uint32_t i = 0; i < reloader->ready_count; i++)
+	{
+		untrack_resource(RESOURCE_PIPELINE, reloader->ready[i].pipeline);
+		vkDestroyPipeline(reloader->device, reloader->ready[i].pipeline, NULL);
+	}
+
+	for (uint32_t i = 0; i < reloader->retired_count; i++)
+	{
+		untrack_resource(RESOURCE_PIPELINE, reloader->retired[i].pipeline);
+		vkDestroyPipeline(reloader->device, reloader->retired[i].pipeline, NULL);
+	}
+
+	pthread_mutex_destroy(&reloader->lock);
+	free(reloader);
+}
+
+#else
+
+struct ShaderReloader *create_shader_reloader(VkDevice device, struct PipelineRegistry *registry, const char *directory, uint32_t frames_in_flight)
+{
+	(void) device;
+	(void) registry;
+	(void) directory;
+	(void) frames_in_flight;
+
+	printf("failed to watch shaders, not supported on this platform\n");
+	return NULL;
+}
+
+void destroy_shader_reloader(struct ShaderReloader *reloader)
+{
+	(void) reloader;
+}
+
+#endif
+
+void poll_shader_reload(struct ShaderReloader *reloader, uint64_t frame_index)
+{
+	if (reloader == NULL) return;
+
+	// the watcher may be queueing, the swap can wait a frame
+	if (reloader->retired_count + RELOAD_MAX_PIPELINES <= RELOAD_MAX_RETIRED && pthread_mutex_trylock(&reloader->lock) == 0) {
+		swap_pipelines(reloader->registry, reloader->ready, reloader->ready_count);
+
+		for (uint32_t i = 0; i < reloader->ready_count; i++)
+		{
+			reloader->retired[reloader->retired_count++] = (struct RetiredPipeline) {
+				.pipeline = reloader->ready[i].pipeline,
+				.frame = frame_index,
+			};
+		}
+
+		reloader->stats.pipelines_swapped += reloader->ready_count;
+		reloader->ready_count = 0;
+
+		pthread_mutex_unlock(&reloader->lock);
+	}
+
+	// frames before frame_index could still use a retired pipeline, the last of them is done once
+	// frame_index + 1 - frames_in_flight has been waited for
+	uint32_t kept = 0;
+
+	for (uint32_t i = 0; i < reloader->retired_count; i++)
+	{
+		struct RetiredPipeline retired = reloader->retired[i];
+
+		if (retired.frame + reloader->frames_in_flight <= frame_index + 1) {
+			untrack_resource(RESOURCE_PIPELINE, retired.pipeline);
+			vkDestroyPipeline(reloader->device, retired.pipeline, NULL);
+		} else {
+			reloader->retired[kept++] = retired;
+		}
+	}
+
+	reloader->retired_count = kept;
+}
+
+void print_reload_stats(struct ShaderReloader *reloader)
+{
+	if (reloader == NULL) return;
+
+	pthread_mutex_lock(&reloader->lock);
+	struct ReloadStats stats = reloader->stats;
+	pthread_mutex_unlock(&reloader->lock);
+
+	printf("shader reload:\n");
+	printf("\tcompiles: %u, %u failed\n", stats.compiles, stats.failed_compiles);
+	printf("\tpipelines: %u built, %u swapped, %u dropped\n", stats.pipelines_built, stats.pipelines_swapped, stats.pipelines_dropped);
+}
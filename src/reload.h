@@ -0,0 +1,71 @@
+#pragma once
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "render.h"
+#include "pipeline.h"
+
+// Hot shader reloading, a development mode. A watcher thread follows the
+// shader directory with inotify; when a .vert, .frag or .comp source is
+// saved it recompiles it to SPIR-V next to the others and rebuilds every
+// registry pipeline that reads the result, all without touching the render
+// thread. poll_shader_reload then swaps the new pipelines in between frames
+// and destroys the old ones once no frame in flight can use them anymore.
+//
+// A shader that fails to compile keeps its old SPIR-V and pipelines, the
+// compiler's errors go to the terminal. Only pipelines of the registry
+// reload; compute pipelines and those built outside it keep their shaders.
+
+#define RELOAD_MAX_PIPELINES 64 // rebuilt and waiting for a frame boundary
+#define RELOAD_MAX_RETIRED 256
+#define RELOAD_PATH_LENGTH 256
+#define RELOAD_SETTLE_MS 50 // editors save in bursts, compile once they are quiet
+
+struct RetiredPipeline {
+	VkPipeline pipeline;
+	uint64_t frame; // first frame recorded without it
+};
+
+struct ReloadStats {
+	uint32_t compiles;
+	uint32_t failed_compiles;
+	uint32_t pipelines_built;
+	uint32_t pipelines_swapped;
+	uint32_t pipelines_dropped; // built while ready was full
+};
+
+struct ShaderReloader {
+	VkDevice device;
+	struct PipelineRegistry *registry;
+	uint32_t frames_in_flight;
+	char directory[RELOAD_PATH_LENGTH];
+	uint32_t id; // unique in the process, names its temporary files
+
+	int inotify_fd;
+	pthread_t watcher;
+	atomic_bool stop;
+
+	// rebuilt pipelines waiting for poll_shader_reload
+	pthread_mutex_t lock;
+	struct PipelineReload ready[RELOAD_MAX_PIPELINES];
+	uint32_t ready_count;
+	struct ReloadStats stats; // under lock
+
+	// render thread only
+	struct RetiredPipeline retired[RELOAD_MAX_RETIRED];
+	uint32_t retired_count;
+};
+
+// watches directory, where the registry's programs have their SPIR-V; NULL when the platform
+// cannot watch files
+struct ShaderReloader *create_shader_reloader(VkDevice device, struct PipelineRegistry *registry, const char *directory, uint32_t frames_in_flight);
+
+// after the device is idle, before the registry is destroyed
+void destroy_shader_reloader(struct ShaderReloader *reloader);
+
+// once per frame, after the fence of the frame about to be recorded; swaps in what was rebuilt
+// since the last call, never waits for the watcher
+void poll_shader_reload(struct ShaderReloader *reloader, uint64_t frame_index);
+
+void print_reload_stats(struct ShaderReloader *reloader);
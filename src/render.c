@@ -8,21 +8,70 @@
 #include <stdint.h>
 #include <string.h>
 #include <stdbool.h>
+#include <stddef.h>
 
 #include "render.h"
+#include "track.h"
 
-GLFWwindow *create_window()
+// the error the calling thread watches, see watch_render_errors
+static _Thread_local struct RenderError *watched_error = NULL;
+
+VkResult record_render_error(struct RenderError *error, VkResult result, const char *call, const char *file, int line)
+{
+	if (error->result == VK_SUCCESS) {
+		*error = (struct RenderError) {
+			.result = result,
+			.call = call,
+			.file = file,
+			.line = line,
+		};
+	}
+
+	return result;
+}
+
+void print_render_error(const struct RenderError *error)
+{
+	if (error->result == VK_SUCCESS) return;
+
+	printf("failed to %s: %s (%s:%d)\n", error->call, get_result_string(error->result), error->file, error->line);
+}
+
+struct RenderError *watch_render_errors(struct RenderError *error)
+{
+	struct RenderError *previous = watched_error;
+	watched_error = error;
+
+	return previous;
+}
+
+void report_render_error(VkResult result, const char *call, const char *file, int line)
+{
+	printf("failed to %s: %s\n", call, get_result_string(result));
+	if (watched_error != NULL) record_render_error(watched_error, result, call, file, line);
+}
+
+GLFWwindow *create_window(uint32_t width, uint32_t height, const char *title)
 {
 	glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
 	glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
 
-	GLFWwindow *window = glfwCreateWindow(800, 600, "Vulkan", NULL, NULL);
+	GLFWwindow *window = glfwCreateWindow((int) width, (int) height, title, NULL, NULL);
 	if (window == NULL) printf("failed to create glfw window\n ");
 
 	return window;
 }
 
 VkInstance create_instance(bool validation_layers_enabled, uint32_t validation_layer_count, const char **validation_layers, uint32_t instance_extension_count, char **instance_extensions)
+{
+	VkInstance instance;
+	VkResult result = try_create_instance(validation_layers_enabled, validation_layer_count, validation_layers, instance_extension_count, instance_extensions, &instance);
+	if (result != VK_SUCCESS) printf("failed to create instance: %s\n", get_result_string(result));
+
+	return instance;
+}
+
+VkResult try_create_instance(bool validation_layers_enabled, uint32_t validation_layer_count, const char **validation_layers, uint32_t instance_extension_count, char **instance_extensions, VkInstance *instance)
 {
 	VkApplicationInfo app_info = {
 		.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO,
@@ -31,7 +80,7 @@ VkInstance create_instance(bool validation_layers_enabled, uint32_t validation_l
 		.applicationVersion = VK_MAKE_VERSION(1, 0, 0),
 		.pEngineName = "No Engine",
 		.engineVersion = VK_MAKE_VERSION(1, 0, 0),
-		.apiVersion = VK_API_VERSION_1_0,
+		.apiVersion = get_instance_version(),
 	};
 
 	VkInstanceCreateInfo instance_info = {
@@ -66,11 +115,10 @@ VkInstance create_instance(bool validation_layers_enabled, uint32_t validation_l
 		instance_info.ppEnabledLayerNames = validation_layers;
 	}
 
-	VkInstance instance;
-	VkResult result = vkCreateInstance(&instance_info, NULL, &instance);
-	if (result != VK_SUCCESS) printf("failed to create instance\n");
+	VkResult result = vkCreateInstance(&instance_info, NULL, instance);
+	if (result != VK_SUCCESS) *instance = VK_NULL_HANDLE;
 
-	return instance;
+	return result;
 }
 
 VkDebugUtilsMessengerEXT create_debug_messenger(bool validation_layers_enabled, VkInstance instance)
@@ -92,11 +140,17 @@ VkDebugUtilsMessengerEXT create_debug_messenger(bool validation_layers_enabled,
 	};
 
 	PFN_vkCreateDebugUtilsMessengerEXT func = (PFN_vkCreateDebugUtilsMessengerEXT) vkGetInstanceProcAddr(instance, "vkCreateDebugUtilsMessengerEXT");
-	if (func == VK_NULL_HANDLE) printf("failed to load vkCreateDebugUtilsMessengerEXT function\n");
+	if (func == VK_NULL_HANDLE) {
+		printf("failed to load vkCreateDebugUtilsMessengerEXT function\n");
+		return VK_NULL_HANDLE;
+	}
 
 	VkDebugUtilsMessengerEXT debug_messenger;
 	VkResult result = func(instance, &debug_messenger_info, NULL, &debug_messenger);
-	if (result != VK_SUCCESS) printf("failed to set up debug messenger\n");
+	if (result != VK_SUCCESS) {
+		printf("failed to set up debug messenger\n");
+		debug_messenger = VK_NULL_HANDLE;
+	}
 
 	return debug_messenger;
 }
@@ -106,7 +160,10 @@ VkSurfaceKHR create_surface(GLFWwindow *window, VkInstance instance)
 	VkSurfaceKHR surface;
 
 	VkResult result = glfwCreateWindowSurface(instance, window, NULL, &surface);
-	if (result != VK_SUCCESS) printf("failed to create window surface\n");
+	if (result != VK_SUCCESS) {
+		printf("failed to create window surface: %s\n", get_result_string(result));
+		surface = VK_NULL_HANDLE;
+	}
 
 	return surface;
 }
@@ -194,6 +251,7 @@ VkPhysicalDevice create_physical_device(VkInstance instance, VkSurfaceKHR surfac
 	vkEnumerateDeviceExtensionProperties(physical_device, NULL, &available_device_extension_count, available_device_extensions);
 
 	bool extensions_supported = check_extension_support(device_extensions, device_extension_count, available_device_extensions, available_device_extension_count);
+	free(available_device_extensions);
 
 	if (!extensions_supported) printf("physical device extensions requested, but not available\n");
 
@@ -221,8 +279,9 @@ struct QueueFamilyIndices create_queue_families(VkPhysicalDevice device, VkSurfa
 			graphics_family_has_value = true;
         	}
 
-        	VkBool32 present_support = false;
-        	vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &present_support);
+        	// without a surface there is nothing to present, the graphics queue stands in
+        	VkBool32 present_support = surface == VK_NULL_HANDLE && (queue_family_properties[i].queueFlags & VK_QUEUE_GRAPHICS_BIT);
+        	if (surface != VK_NULL_HANDLE) vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &present_support);
 
         	if (present_support) {
 			indices.presentFamily = i;
@@ -234,6 +293,8 @@ struct QueueFamilyIndices create_queue_families(VkPhysicalDevice device, VkSurfa
 		}
 	}
 
+	free(queue_family_properties);
+
 	if (!graphics_family_has_value || !present_family_has_value) {
 		printf("could not find queue family with both graphics and present support\n");
 	}
@@ -273,6 +334,28 @@ VkSurfaceFormatKHR create_format(VkPhysicalDevice physical_device, VkSurfaceKHR
 	return chosen_format;
 }
 
+// optimal tiling, which is all the renderer creates images with
+bool format_supported(VkPhysicalDevice physical_device, VkFormat format, VkFormatFeatureFlags features)
+{
+	VkFormatProperties properties;
+	vkGetPhysicalDeviceFormatProperties(physical_device, format, &properties);
+
+	return (properties.optimalTilingFeatures & features) == features;
+}
+
+// the smallest format with a stencil aspect the device can render to, VK_FORMAT_UNDEFINED for none
+VkFormat find_stencil_format(VkPhysicalDevice physical_device)
+{
+	VkFormat candidates[] = {VK_FORMAT_S8_UINT, VK_FORMAT_D16_UNORM_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT, VK_FORMAT_D32_SFLOAT_S8_UINT};
+
+	for (uint32_t i = 0; i < sizeof(candidates) / sizeof(candidates[0]); i++)
+	{
+		if (format_supported(physical_device, candidates[i], VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT)) return candidates[i];
+	}
+
+	return VK_FORMAT_UNDEFINED;
+}
+
 VkPresentModeKHR create_present_mode(VkPhysicalDevice physical_device, VkSurfaceKHR surface)
 {
 	// uint32_t present_mode_count = 0;
@@ -299,7 +382,44 @@ VkSurfaceCapabilitiesKHR create_capabilities(VkPhysicalDevice physical_device, V
 	return capabilities;
 }
 
-VkDevice create_device(bool validation_layers_enabled, const char **validation_layers, uint32_t validation_layer_count, VkPhysicalDevice physical_device, struct QueueFamilyIndices indices, uint32_t device_extension_count, const char **device_extensions)
+uint32_t get_instance_version(void)
+{
+	uint32_t version = VK_API_VERSION_1_0;
+
+	// 1.0 loaders do not have vkEnumerateInstanceVersion
+	PFN_vkEnumerateInstanceVersion enumerate_version = (PFN_vkEnumerateInstanceVersion) vkGetInstanceProcAddr(VK_NULL_HANDLE, "vkEnumerateInstanceVersion");
+	if (enumerate_version != NULL) enumerate_version(&version);
+
+	if (version > VK_API_VERSION_1_3) version = VK_API_VERSION_1_3;
+
+	return version;
+}
+
+static bool check_device_extension(VkPhysicalDevice physical_device, const char *extension)
+{
+	uint32_t available_count = 0;
+	vkEnumerateDeviceExtensionProperties(physical_device, NULL, &available_count, NULL);
+
+	VkExtensionProperties *available_extensions = malloc(available_count * sizeof(VkExtensionProperties));
+	vkEnumerateDeviceExtensionProperties(physical_device, NULL, &available_count, available_extensions);
+
+	bool supported = check_extension_support(&extension, 1, available_extensions, available_count);
+
+	free(available_extensions);
+
+	return supported;
+}
+
+VkDevice create_device(bool validation_layers_enabled, const char **validation_layers, uint32_t validation_layer_count, VkPhysicalDevice physical_device, struct QueueFamilyIndices indices, uint32_t device_extension_count, const char **device_extensions, struct DeviceFeatures *features)
+{
+	VkDevice device;
+	VkResult result = try_create_device(validation_layers_enabled, validation_layers, validation_layer_count, physical_device, indices, device_extension_count, device_extensions, features, &device);
+	if (result != VK_SUCCESS) printf("failed to create logical device: %s\n", get_result_string(result));
+
+	return device;
+}
+
+VkResult try_create_device(bool validation_layers_enabled, const char **validation_layers, uint32_t validation_layer_count, VkPhysicalDevice physical_device, struct QueueFamilyIndices indices, uint32_t device_extension_count, const char **device_extensions, struct DeviceFeatures *features, VkDevice *device)
 {
 	float queue_priority = 1.0f;
 
@@ -314,16 +434,72 @@ VkDevice create_device(bool validation_layers_enabled, const char **validation_l
 
 	VkPhysicalDeviceFeatures device_features = {0};
 
+	// dynamic rendering is core in 1.3 and an extension on 1.2, anything older keeps render passes
+
+	VkPhysicalDeviceProperties device_properties;
+	vkGetPhysicalDeviceProperties(physical_device, &device_properties);
+
+	uint32_t api_version = get_instance_version();
+	if (device_properties.apiVersion < api_version) api_version = device_properties.apiVersion;
+
+	const char **extensions = malloc((device_extension_count + 1) * sizeof(const char *));
+	memcpy(extensions, device_extensions, device_extension_count * sizeof(const char *));
+	uint32_t extension_count = device_extension_count;
+
+	VkPhysicalDeviceVulkan13Features vulkan13_features = {
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES,
+		.pNext = NULL,
+	};
+
+	VkPhysicalDeviceDynamicRenderingFeatures dynamic_rendering_features = {
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES,
+		.pNext = NULL,
+		.dynamicRendering = VK_FALSE,
+	};
+
+	const void *enabled_features = NULL;
+	bool dynamic_rendering_core = api_version >= VK_API_VERSION_1_3;
+	bool dynamic_rendering_requested = features->dynamic_rendering;
+
+	*features = (struct DeviceFeatures) {0};
+
+	if (dynamic_rendering_requested && (dynamic_rendering_core || (api_version >= VK_API_VERSION_1_2 && check_device_extension(physical_device, VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME)))) {
+		VkPhysicalDeviceFeatures2 supported_features = {
+			.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+			.pNext = dynamic_rendering_core ? (void *) &vulkan13_features : (void *) &dynamic_rendering_features,
+		};
+
+		vkGetPhysicalDeviceFeatures2(physical_device, &supported_features);
+
+		if (dynamic_rendering_core && vulkan13_features.dynamicRendering) {
+			// only enable what is used, not everything the query reported
+			vulkan13_features = (VkPhysicalDeviceVulkan13Features) {
+				.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES,
+				.pNext = NULL,
+				.dynamicRendering = VK_TRUE,
+			};
+
+			enabled_features = &vulkan13_features;
+			features->dynamic_rendering = true;
+		}
+		else if (!dynamic_rendering_core && dynamic_rendering_features.dynamicRendering) {
+			extensions[extension_count++] = VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME;
+
+			enabled_features = &dynamic_rendering_features;
+			features->dynamic_rendering = true;
+		}
+	}
+
 	VkDeviceCreateInfo device_info = {
 		.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
-		.pNext = NULL,
+		.pNext = enabled_features,
 		.flags = 0,
 		.queueCreateInfoCount = 1,
 		.pQueueCreateInfos = &device_queue_info,
 		.enabledLayerCount = 0,
 		.ppEnabledLayerNames = NULL,
-		.enabledExtensionCount = device_extension_count,
-		.ppEnabledExtensionNames = device_extensions,
+		.enabledExtensionCount = extension_count,
+		.ppEnabledExtensionNames = extensions,
 		.pEnabledFeatures = &device_features,
 	};
 
@@ -332,11 +508,27 @@ VkDevice create_device(bool validation_layers_enabled, const char **validation_l
         	device_info.ppEnabledLayerNames = validation_layers;
 	}
 
-	VkDevice device;
-	VkResult result = vkCreateDevice(physical_device, &device_info, NULL, &device);
-	if (result != VK_SUCCESS) printf("failed to create logical device\n");
+	VkResult result = vkCreateDevice(physical_device, &device_info, NULL, device);
 
-	return device;
+	free(extensions);
+
+	if (result != VK_SUCCESS) {
+		*device = VK_NULL_HANDLE;
+		*features = (struct DeviceFeatures) {0};
+		return result;
+	}
+
+	if (features->dynamic_rendering) {
+		features->cmd_begin_rendering = (PFN_vkCmdBeginRendering) vkGetDeviceProcAddr(*device, dynamic_rendering_core ? "vkCmdBeginRendering" : "vkCmdBeginRenderingKHR");
+		features->cmd_end_rendering = (PFN_vkCmdEndRendering) vkGetDeviceProcAddr(*device, dynamic_rendering_core ? "vkCmdEndRendering" : "vkCmdEndRenderingKHR");
+
+		if (features->cmd_begin_rendering == NULL || features->cmd_end_rendering == NULL) {
+			printf("failed to load dynamic rendering functions\n");
+			features->dynamic_rendering = false;
+		}
+	}
+
+	return VK_SUCCESS;
 }
 
 VkQueue create_device_queue(VkDevice device, uint32_t queue_family_index, uint32_t queue_index)
@@ -385,6 +577,15 @@ uint32_t create_image_count(VkSurfaceCapabilitiesKHR capabilities)
 }
 
 VkSwapchainKHR create_swapchain(VkDevice device, VkSurfaceKHR surface, uint32_t imageCount, VkSurfaceFormatKHR surfaceFormat, VkExtent2D extent, struct QueueFamilyIndices indices, VkSurfaceCapabilitiesKHR capabilities, VkPresentModeKHR presentMode)
+{
+	VkSwapchainKHR swapchain;
+	VkResult result = try_create_swapchain(device, surface, imageCount, surfaceFormat, extent, indices, capabilities, presentMode, &swapchain);
+	if (result != VK_SUCCESS) printf("failed to create swap chain: %s\n", get_result_string(result));
+
+	return swapchain;
+}
+
+VkResult try_create_swapchain(VkDevice device, VkSurfaceKHR surface, uint32_t imageCount, VkSurfaceFormatKHR surfaceFormat, VkExtent2D extent, struct QueueFamilyIndices indices, VkSurfaceCapabilitiesKHR capabilities, VkPresentModeKHR presentMode, VkSwapchainKHR *swapchain)
 {
 	VkSwapchainCreateInfoKHR swapchain_info = {
 		.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR,
@@ -396,7 +597,8 @@ VkSwapchainKHR create_swapchain(VkDevice device, VkSurfaceKHR surface, uint32_t
 		.imageColorSpace = surfaceFormat.colorSpace,
 		.imageExtent = extent,
 		.imageArrayLayers = 1,
-		.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+		// sampled and copied from when supported, frame capture reads the images back
+		.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | (capabilities.supportedUsageFlags & (VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT)),
 		.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE,
 		.queueFamilyIndexCount = 0,
 		.pQueueFamilyIndices = NULL,
@@ -415,49 +617,196 @@ VkSwapchainKHR create_swapchain(VkDevice device, VkSurfaceKHR surface, uint32_t
 		swapchain_info.pQueueFamilyIndices = queueFamilyIndices;
 	}
 
-	VkSwapchainKHR swapchain;
-	VkResult result = vkCreateSwapchainKHR(device, &swapchain_info, NULL, &swapchain);
-	if (result != VK_SUCCESS) printf("failed to create swap chain!");
+	VkResult result = vkCreateSwapchainKHR(device, &swapchain_info, NULL, swapchain);
+	if (result != VK_SUCCESS) *swapchain = VK_NULL_HANDLE;
 
-	return swapchain;
+	return result;
 }
 
-VkImageView *create_swapchain_image_views(VkDevice device, VkSwapchainKHR swapChain, VkFormat swapChainImageFormat, uint32_t imageCount)
+VkImage *create_swapchain_images(VkDevice device, VkSwapchainKHR swapChain, uint32_t imageCount)
 {
 	vkGetSwapchainImagesKHR(device, swapChain, &imageCount, NULL);
 
 	VkImage *swapChainImages = malloc(imageCount * sizeof(VkImage));
 	vkGetSwapchainImagesKHR(device, swapChain, &imageCount, swapChainImages);
 
+	return swapChainImages;
+}
+
+VkImageView *create_swapchain_image_views(VkDevice device, VkSwapchainKHR swapChain, VkFormat swapChainImageFormat, uint32_t imageCount)
+{
+	VkImage *swapChainImages = create_swapchain_images(device, swapChain, imageCount);
+
 	VkImageView *swapChainImageViews = malloc(imageCount * sizeof(VkImageView));
 
-	for (size_t i = 0; i < imageCount; i++)
+	VkResult result = try_create_image_views(device, swapChainImages, imageCount, swapChainImageFormat, swapChainImageViews);
+	if (result != VK_SUCCESS) printf("failed to create image views: %s\n", get_result_string(result));
+
+	free(swapChainImages);
+
+	return swapChainImageViews;
+}
+
+VkResult try_create_image_views(VkDevice device, const VkImage *images, uint32_t image_count, VkFormat format, VkImageView *views)
+{
+	for (uint32_t i = 0; i < image_count; i++) views[i] = VK_NULL_HANDLE;
+
+	for (uint32_t i = 0; i < image_count; i++)
+	{
+		VkImageViewCreateInfo view_info = {
+			.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+			.pNext = NULL,
+			.flags = 0,
+			.image = images[i],
+			.viewType = VK_IMAGE_VIEW_TYPE_2D,
+			.format = format,
+			.components = {VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY},
+			.subresourceRange = {
+				.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+				.baseMipLevel = 0,
+				.levelCount = 1,
+				.baseArrayLayer = 0,
+				.layerCount = 1,
+			},
+		};
+
+		VkResult result = vkCreateImageView(device, &view_info, NULL, &views[i]);
+
+		if (result != VK_SUCCESS) {
+			// the views made so far go again, the caller has nothing to clean up
+			views[i] = VK_NULL_HANDLE;
+
+			for (uint32_t j = 0; j < i; j++)
+			{
+				untrack_resource(RESOURCE_IMAGE_VIEW, views[j]);
+				vkDestroyImageView(device, views[j], NULL);
+				views[j] = VK_NULL_HANDLE;
+			}
+
+			return result;
+		}
+
+		track_resource(RESOURCE_IMAGE_VIEW, views[i], 0);
+	}
+
+	return VK_SUCCESS;
+}
+
+void begin_dynamic_rendering(const struct DeviceFeatures *features, VkCommandBuffer command_buffer, VkImageView view, VkImageView stencil_view, VkExtent2D extent, VkClearColorValue clear_color)
+{
+	VkRenderingAttachmentInfo color_attachment = {
+		.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
+		.pNext = NULL,
+		.imageView = view,
+		.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+		.resolveMode = VK_RESOLVE_MODE_NONE,
+		.resolveImageView = VK_NULL_HANDLE,
+		.resolveImageLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+		.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+		.storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+		.clearValue = {.color = clear_color},
+	};
+
+	// clip depths start at 0 every pass and are not needed afterwards
+	VkRenderingAttachmentInfo stencil_attachment = {
+		.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
+		.pNext = NULL,
+		.imageView = stencil_view,
+		.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+		.resolveMode = VK_RESOLVE_MODE_NONE,
+		.resolveImageView = VK_NULL_HANDLE,
+		.resolveImageLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+		.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+		.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+		.clearValue = {.depthStencil = {1.0f, 0}},
+	};
+
+	VkRenderingInfo rendering_info = {
+		.sType = VK_STRUCTURE_TYPE_RENDERING_INFO,
+		.pNext = NULL,
+		.flags = 0,
+		.renderArea = {
+			.offset = {0, 0},
+			.extent = extent,
+		},
+		.layerCount = 1,
+		.viewMask = 0,
+		.colorAttachmentCount = 1,
+		.pColorAttachments = &color_attachment,
+		.pDepthAttachment = NULL,
+		.pStencilAttachment = stencil_view != VK_NULL_HANDLE ? &stencil_attachment : NULL,
+	};
+
+	features->cmd_begin_rendering(command_buffer, &rendering_info);
+}
+
+void end_dynamic_rendering(const struct DeviceFeatures *features, VkCommandBuffer command_buffer)
+{
+	features->cmd_end_rendering(command_buffer);
+}
+
+VkImageAspectFlags format_aspect_flags(VkFormat format)
+{
+	switch (format)
 	{
-        	VkImageViewCreateInfo createInfo = {0};
-        	createInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-        	createInfo.image = swapChainImages[i];
-        	createInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-        	createInfo.format = swapChainImageFormat;
-        	createInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
-        	createInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
-        	createInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
-        	createInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
-        	createInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        	createInfo.subresourceRange.baseMipLevel = 0;
-        	createInfo.subresourceRange.levelCount = 1;
-        	createInfo.subresourceRange.baseArrayLayer = 0;
-        	createInfo.subresourceRange.layerCount = 1;
-
-        	VkResult result = vkCreateImageView(device, &createInfo, NULL, &swapChainImageViews[i]);
-        	if (result != VK_SUCCESS) printf("failed to create image views!");
+		case VK_FORMAT_D16_UNORM:
+		case VK_FORMAT_X8_D24_UNORM_PACK32:
+		case VK_FORMAT_D32_SFLOAT:
+			return VK_IMAGE_ASPECT_DEPTH_BIT;
+		case VK_FORMAT_S8_UINT:
+			return VK_IMAGE_ASPECT_STENCIL_BIT;
+		case VK_FORMAT_D16_UNORM_S8_UINT:
+		case VK_FORMAT_D24_UNORM_S8_UINT:
+		case VK_FORMAT_D32_SFLOAT_S8_UINT:
+			return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+		default:
+			return VK_IMAGE_ASPECT_COLOR_BIT;
 	}
+}
 
-	return swapChainImageViews;
+uint32_t vertex_layout_stride(enum VertexLayout layout)
+{
+	switch (layout)
+	{
+		case VERTEX_LAYOUT_FLOAT:
+			return sizeof(struct Vertex);
+		case VERTEX_LAYOUT_COMPACT:
+			return sizeof(struct CompactVertex);
+		default:
+			return 0;
+	}
+}
+
+// the attribute formats are all in the mandatory vertex buffer format set
+static const VkVertexInputAttributeDescription vertex_layout_attributes[VERTEX_LAYOUT_COUNT][3] = {
+	[VERTEX_LAYOUT_FLOAT] = {
+		{.location = 0, .binding = 0, .format = VK_FORMAT_R32G32_SFLOAT, .offset = offsetof(struct Vertex, position)},
+		{.location = 1, .binding = 0, .format = VK_FORMAT_R32G32_SFLOAT, .offset = offsetof(struct Vertex, uv)},
+		{.location = 2, .binding = 0, .format = VK_FORMAT_R32G32B32A32_SFLOAT, .offset = offsetof(struct Vertex, color)},
+	},
+	[VERTEX_LAYOUT_COMPACT] = {
+		{.location = 0, .binding = 0, .format = VK_FORMAT_R16G16_SNORM, .offset = offsetof(struct CompactVertex, position)},
+		{.location = 1, .binding = 0, .format = VK_FORMAT_R16G16_UNORM, .offset = offsetof(struct CompactVertex, uv)},
+		{.location = 2, .binding = 0, .format = VK_FORMAT_R8G8B8A8_UNORM, .offset = offsetof(struct CompactVertex, color)},
+	},
+};
+
+VkRenderPass create_render_pass(VkDevice device, VkFormat swapChainImageFormat, VkFormat stencil_format)
+{
+	VkRenderPass render_pass;
+	VkResult result = try_create_render_pass(device, swapChainImageFormat, stencil_format, &render_pass);
+	if (result != VK_SUCCESS) report_render_failure(result, "create render pass");
+
+	return render_pass;
 }
 
-VkRenderPass create_render_pass(VkDevice device, VkFormat swapChainImageFormat)
+VkResult try_create_render_pass(VkDevice device, VkFormat swapChainImageFormat, VkFormat stencil_format, VkRenderPass *render_pass)
 {
-	VkAttachmentDescription colorAttachment = {
+	bool has_stencil = stencil_format != VK_FORMAT_UNDEFINED;
+
+	VkAttachmentDescription attachments[2];
+
+	attachments[0] = (VkAttachmentDescription) {
 		.flags = 0,
 		.format = swapChainImageFormat,
 		.samples = VK_SAMPLE_COUNT_1_BIT,
@@ -465,8 +814,22 @@ VkRenderPass create_render_pass(VkDevice device, VkFormat swapChainImageFormat)
 		.storeOp = VK_ATTACHMENT_STORE_OP_STORE,
 		.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
 		.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
-		.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-		.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+		// layout transitions and the acquire dependency are left to the frame graph
+		.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+		.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+	};
+
+	// clip depths, cleared on load and thrown away
+	attachments[1] = (VkAttachmentDescription) {
+		.flags = 0,
+		.format = stencil_format,
+		.samples = VK_SAMPLE_COUNT_1_BIT,
+		.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+		.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+		.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+		.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+		.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+		.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
 	};
 
 	VkAttachmentReference colorAttachmentRef = {
@@ -474,6 +837,11 @@ VkRenderPass create_render_pass(VkDevice device, VkFormat swapChainImageFormat)
 		.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
 	};
 
+	VkAttachmentReference stencilAttachmentRef = {
+		.attachment = 1,
+		.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+	};
+
 	VkSubpassDescription subpass = {
 		.flags = 0,
 		.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
@@ -482,68 +850,180 @@ VkRenderPass create_render_pass(VkDevice device, VkFormat swapChainImageFormat)
 		.colorAttachmentCount = 1,
 		.pColorAttachments = &colorAttachmentRef,
 		.pResolveAttachments = NULL,
-		.pDepthStencilAttachment = NULL,
+		.pDepthStencilAttachment = has_stencil ? &stencilAttachmentRef : NULL,
 		.preserveAttachmentCount = 0,
 		.pPreserveAttachments = NULL,
 	};
 
-	VkSubpassDependency dependency = {
-		.srcSubpass = VK_SUBPASS_EXTERNAL,
-		.dstSubpass = 0,
-		.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-		.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-		.srcAccessMask = 0,
-		.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
-		.dependencyFlags = 0,
-	};
-
 	VkRenderPassCreateInfo renderPassInfo = {
 		.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
 		.pNext = NULL,
 		.flags = 0,
-		.attachmentCount = 1,
-		.pAttachments = &colorAttachment,
+		.attachmentCount = has_stencil ? 2 : 1,
+		.pAttachments = attachments,
 		.subpassCount = 1,
 		.pSubpasses = &subpass,
-		.dependencyCount = 1,
-		.pDependencies = &dependency,
+		.dependencyCount = 0,
+		.pDependencies = NULL,
 	};
 
-	VkRenderPass renderPass;
-	VkResult result = vkCreateRenderPass(device, &renderPassInfo, NULL, &renderPass);
-	if (result != VK_SUCCESS) printf("failed to create render pass!");
+	VkResult result = vkCreateRenderPass(device, &renderPassInfo, NULL, render_pass);
 
-	return renderPass;
+	if (result != VK_SUCCESS) {
+		*render_pass = VK_NULL_HANDLE;
+		return result;
+	}
+
+	track_resource(RESOURCE_RENDER_PASS, *render_pass, 0);
+
+	return VK_SUCCESS;
 }
 
-VkPipelineLayout create_pipeline_layout(VkDevice device)
+// push constants carry small per-draw data, descriptor sets (like the uniform ring) everything bigger
+VkPipelineLayout create_pipeline_layout(VkDevice device, uint32_t set_layout_count, const VkDescriptorSetLayout *set_layouts, VkShaderStageFlags push_stages, uint32_t push_size)
 {
+	VkPipelineLayout layout;
+	VkResult result = try_create_pipeline_layout(device, set_layout_count, set_layouts, push_stages, push_size, &layout);
+	if (result != VK_SUCCESS) report_render_failure(result, "create pipeline layout");
+
+	return layout;
+}
+
+VkResult try_create_pipeline_layout(VkDevice device, uint32_t set_layout_count, const VkDescriptorSetLayout *set_layouts, VkShaderStageFlags push_stages, uint32_t push_size, VkPipelineLayout *layout)
+{
+	VkPushConstantRange pushConstantRange = {
+		.stageFlags = push_stages,
+		.offset = 0,
+		.size = push_size,
+	};
+
 	VkPipelineLayoutCreateInfo pipelineLayoutInfo = {
 		.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
 		.pNext = NULL,
 		.flags = 0,
-		.setLayoutCount = 0,
-		.pSetLayouts = NULL,
-		.pushConstantRangeCount = 0,
-		.pPushConstantRanges = NULL,
+		.setLayoutCount = set_layout_count,
+		.pSetLayouts = set_layouts,
+		.pushConstantRangeCount = push_size > 0 ? 1 : 0,
+		.pPushConstantRanges = push_size > 0 ? &pushConstantRange : NULL,
 	};
 
-	VkPipelineLayout pipelineLayout;
-	VkResult result = vkCreatePipelineLayout(device, &pipelineLayoutInfo, NULL, &pipelineLayout);
-	if (result != VK_SUCCESS) printf("failed to create pipeline layout!");
+	VkResult result = vkCreatePipelineLayout(device, &pipelineLayoutInfo, NULL, layout);
+
+	if (result != VK_SUCCESS) {
+		*layout = VK_NULL_HANDLE;
+		return result;
+	}
 
-	return pipelineLayout;
+	track_resource(RESOURCE_PIPELINE_LAYOUT, *layout, 0);
+
+	return VK_SUCCESS;
+}
+
+// with a stencil format the pipeline is clipped like everything else drawn into the target
+VkPipeline create_graphics_pipeline(VkDevice device, VkExtent2D swapChainExtent, VkRenderPass renderPass, VkFormat colorFormat, VkFormat stencilFormat, VkPipelineLayout pipelineLayout, const char *vert_path, const char *frag_path, bool blend_enabled)
+{
+	struct PipelineState state = {
+		.render_pass = renderPass,
+		.color_format = colorFormat,
+		.stencil_format = stencilFormat,
+		.stencil = STENCIL_MODE_CLIP_TEST,
+		.blend = blend_enabled ? BLEND_MODE_PREMULTIPLIED : BLEND_MODE_NONE,
+		.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+		.samples = VK_SAMPLE_COUNT_1_BIT,
+	};
+
+	return create_graphics_pipeline_state(device, VK_NULL_HANDLE, swapChainExtent, pipelineLayout, vert_path, frag_path, &state);
 }
 
-VkPipeline create_graphics_pipeline(VkDevice device, VkExtent2D swapChainExtent, VkRenderPass renderPass, VkPipelineLayout pipelineLayout)
+// blend factors for color and alpha, everything expects premultiplied alpha
+static void blend_mode_factors(enum BlendMode blend, VkPipelineColorBlendAttachmentState *attachment)
 {
+	attachment->blendEnable = blend == BLEND_MODE_NONE ? VK_FALSE : VK_TRUE;
+	attachment->srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+	attachment->dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+	attachment->srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+	attachment->dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+
+	switch (blend)
+	{
+		case BLEND_MODE_ADDITIVE:
+			attachment->dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+			attachment->srcAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+			attachment->dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+			break;
+		case BLEND_MODE_MULTIPLY:
+			attachment->srcColorBlendFactor = VK_BLEND_FACTOR_DST_COLOR;
+			break;
+		default:
+			break;
+	}
+}
+
+// every mode compares against the dynamic reference, the clip depth of whatever is drawn
+static VkStencilOpState stencil_mode_op(enum StencilMode mode)
+{
+	VkStencilOpState op = {
+		.failOp = VK_STENCIL_OP_KEEP,
+		.passOp = VK_STENCIL_OP_KEEP,
+		.depthFailOp = VK_STENCIL_OP_KEEP,
+		.compareOp = VK_COMPARE_OP_EQUAL,
+		.compareMask = 0xff,
+		.writeMask = 0,
+		.reference = 0,
+	};
+
+	switch (mode)
+	{
+		case STENCIL_MODE_CLIP_PUSH:
+			op.passOp = VK_STENCIL_OP_INCREMENT_AND_CLAMP;
+			op.writeMask = 0xff;
+			break;
+		case STENCIL_MODE_CLIP_POP:
+			op.passOp = VK_STENCIL_OP_REPLACE;
+			op.compareOp = VK_COMPARE_OP_LESS; // reference < stencil
+			op.writeMask = 0xff;
+			break;
+		default:
+			break;
+	}
+
+	return op;
+}
+
+VkPipeline create_graphics_pipeline_state(VkDevice device, VkPipelineCache cache, VkExtent2D swapChainExtent, VkPipelineLayout pipelineLayout, const char *vert_path, const char *frag_path, const struct PipelineState *state)
+{
+	VkPipeline pipeline;
+	VkResult result = try_create_graphics_pipeline_state(device, cache, swapChainExtent, pipelineLayout, vert_path, frag_path, state, &pipeline);
+	if (result != VK_SUCCESS) report_render_failure(result, "create graphics pipeline");
+
+	return pipeline;
+}
+
+VkResult try_create_graphics_pipeline_state(VkDevice device, VkPipelineCache cache, VkExtent2D swapChainExtent, VkPipelineLayout pipelineLayout, const char *vert_path, const char *frag_path, const struct PipelineState *state, VkPipeline *pipeline)
+{
+	VkRenderPass renderPass = state->render_pass;
+	VkFormat colorFormat = state->color_format;
+	VkFormat stencilFormat = state->stencil_format;
+	enum StencilMode stencil = stencilFormat != VK_FORMAT_UNDEFINED ? state->stencil : STENCIL_MODE_NONE;
+
 	int vert_size, frag_size;
 
-	char *vertShaderCode = readFile("../assets/shaders/vert.spv", &vert_size);
-	char *fragShaderCode = readFile("../assets/shaders/frag.spv", &frag_size);
+	char *vertShaderCode = readFile(vert_path, &vert_size);
+	char *fragShaderCode = readFile(frag_path, &frag_size);
 
-	VkShaderModule vertShaderModule = createShaderModule(vertShaderCode, vert_size, device);
-	VkShaderModule fragShaderModule = createShaderModule(fragShaderCode, frag_size, device);
+	VkShaderModule vertShaderModule, fragShaderModule;
+	VkResult result = try_create_shader_module(device, vertShaderCode, vert_size, &vertShaderModule);
+	if (result == VK_SUCCESS) result = try_create_shader_module(device, fragShaderCode, frag_size, &fragShaderModule);
+	else fragShaderModule = VK_NULL_HANDLE;
+
+	free(fragShaderCode);
+	free(vertShaderCode);
+
+	if (result != VK_SUCCESS) {
+		vkDestroyShaderModule(device, vertShaderModule, NULL);
+		*pipeline = VK_NULL_HANDLE;
+		return result;
+	}
 
 	VkPipelineShaderStageCreateInfo vertShaderStageInfo = {
 		.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
@@ -567,21 +1047,29 @@ VkPipeline create_graphics_pipeline(VkDevice device, VkExtent2D swapChainExtent,
 
 	VkPipelineShaderStageCreateInfo shaderStages[] = {vertShaderStageInfo, fragShaderStageInfo};
 
+	bool has_vertices = state->vertex_layout != VERTEX_LAYOUT_NONE && state->vertex_layout < VERTEX_LAYOUT_COUNT;
+
+	VkVertexInputBindingDescription vertexBinding = {
+		.binding = 0,
+		.stride = vertex_layout_stride(state->vertex_layout),
+		.inputRate = VK_VERTEX_INPUT_RATE_VERTEX,
+	};
+
 	VkPipelineVertexInputStateCreateInfo vertexInputInfo = {
 		.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
 		.pNext= NULL,
 		.flags = 0,
-		.vertexBindingDescriptionCount = 0,
-		.pVertexBindingDescriptions = NULL,
-		.vertexAttributeDescriptionCount = 0,
-		.pVertexAttributeDescriptions = NULL,
+		.vertexBindingDescriptionCount = has_vertices ? 1 : 0,
+		.pVertexBindingDescriptions = has_vertices ? &vertexBinding : NULL,
+		.vertexAttributeDescriptionCount = has_vertices ? 3 : 0,
+		.pVertexAttributeDescriptions = has_vertices ? vertex_layout_attributes[state->vertex_layout] : NULL,
 	};
 
 	VkPipelineInputAssemblyStateCreateInfo inputAssembly = {
 		.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
 		.pNext = NULL,
 		.flags = 0,
-		.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+		.topology = state->topology,
 		.primitiveRestartEnable = VK_FALSE,
 	};
 
@@ -594,14 +1082,7 @@ VkPipeline create_graphics_pipeline(VkDevice device, VkExtent2D swapChainExtent,
 		.maxDepth = 1.0f,
 	};
 
-	VkRect2D scissor = {
-		.offset = {
-			.x = 0,
-			.y = 0,
-		},
-		.extent = swapChainExtent,
-	};
-
+	// the scissor is set by whoever records, rect clips only ever change the scissor
 	VkPipelineViewportStateCreateInfo viewportState = {
 		.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
 		.pNext = NULL,
@@ -609,7 +1090,17 @@ VkPipeline create_graphics_pipeline(VkDevice device, VkExtent2D swapChainExtent,
 		.viewportCount = 1,
 		.pViewports = &viewport,
 		.scissorCount = 1,
-		.pScissors = &scissor,
+		.pScissors = NULL,
+	};
+
+	VkDynamicState dynamicStates[] = {VK_DYNAMIC_STATE_SCISSOR, VK_DYNAMIC_STATE_STENCIL_REFERENCE};
+
+	VkPipelineDynamicStateCreateInfo dynamicState = {
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+		.pNext = NULL,
+		.flags = 0,
+		.dynamicStateCount = 2,
+		.pDynamicStates = dynamicStates,
 	};
 
 	VkPipelineRasterizationStateCreateInfo rasterizer = {
@@ -632,7 +1123,7 @@ VkPipeline create_graphics_pipeline(VkDevice device, VkExtent2D swapChainExtent,
 		.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
 		.pNext = NULL,
 		.flags = 0,
-		.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT,
+		.rasterizationSamples = state->samples,
 		.sampleShadingEnable = VK_FALSE,
 		.minSampleShading = 0,
 		.pSampleMask = NULL,
@@ -640,20 +1131,33 @@ VkPipeline create_graphics_pipeline(VkDevice device, VkExtent2D swapChainExtent,
 		.alphaToOneEnable = VK_FALSE,
 	};
 
+	VkPipelineDepthStencilStateCreateInfo depthStencil = {
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
+		.pNext = NULL,
+		.flags = 0,
+		.depthTestEnable = VK_FALSE,
+		.depthWriteEnable = VK_FALSE,
+		.depthCompareOp = VK_COMPARE_OP_ALWAYS,
+		.depthBoundsTestEnable = VK_FALSE,
+		.stencilTestEnable = stencil != STENCIL_MODE_NONE ? VK_TRUE : VK_FALSE,
+		.front = stencil_mode_op(stencil),
+		.back = stencil_mode_op(stencil),
+		.minDepthBounds = 0.0f,
+		.maxDepthBounds = 1.0f,
+	};
+
+	bool writes_color = stencil != STENCIL_MODE_CLIP_PUSH && stencil != STENCIL_MODE_CLIP_POP;
+
 	VkPipelineColorBlendAttachmentState colorBlendAttachment = {
-		.blendEnable = VK_FALSE,
-		.srcColorBlendFactor = VK_BLEND_FACTOR_ZERO,
-		.dstColorBlendFactor = VK_BLEND_FACTOR_ZERO,
 		.colorBlendOp = VK_BLEND_OP_ADD,
-		.srcAlphaBlendFactor = VK_BLEND_FACTOR_ZERO,
-		.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO,
 		.alphaBlendOp = VK_BLEND_OP_ADD,
-		.colorWriteMask = VK_COLOR_COMPONENT_R_BIT |
+		.colorWriteMask = writes_color ? VK_COLOR_COMPONENT_R_BIT |
 						  VK_COLOR_COMPONENT_G_BIT |
 						  VK_COLOR_COMPONENT_B_BIT |
-						  VK_COLOR_COMPONENT_A_BIT,
+						  VK_COLOR_COMPONENT_A_BIT : 0,
 
 	};
+	blend_mode_factors(state->blend, &colorBlendAttachment);
 
 	VkPipelineColorBlendStateCreateInfo colorBlending = {
 		.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
@@ -669,9 +1173,20 @@ VkPipeline create_graphics_pipeline(VkDevice device, VkExtent2D swapChainExtent,
 		.blendConstants[3] = 0.0f,
 	};
 
+	// without a render pass the pipeline is built for dynamic rendering into colorFormat and stencilFormat
+	VkPipelineRenderingCreateInfo renderingInfo = {
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO,
+		.pNext = NULL,
+		.viewMask = 0,
+		.colorAttachmentCount = 1,
+		.pColorAttachmentFormats = &colorFormat,
+		.depthAttachmentFormat = VK_FORMAT_UNDEFINED,
+		.stencilAttachmentFormat = stencilFormat,
+	};
+
 	VkGraphicsPipelineCreateInfo pipelineInfo = {
 		.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
-		.pNext = NULL,
+		.pNext = renderPass == VK_NULL_HANDLE ? &renderingInfo : NULL,
 		.flags = 0,
 		.stageCount = 2,
 		.pStages = shaderStages,
@@ -681,9 +1196,9 @@ VkPipeline create_graphics_pipeline(VkDevice device, VkExtent2D swapChainExtent,
 		.pViewportState = &viewportState,
 		.pRasterizationState = &rasterizer,
 		.pMultisampleState = &multisampling,
-		.pDepthStencilState = NULL,
+		.pDepthStencilState = stencilFormat != VK_FORMAT_UNDEFINED ? &depthStencil : NULL,
 		.pColorBlendState = &colorBlending,
-		.pDynamicState = NULL,
+		.pDynamicState = &dynamicState,
 		.layout = pipelineLayout,
 		.renderPass = renderPass,
 		.subpass = 0,
@@ -691,24 +1206,31 @@ VkPipeline create_graphics_pipeline(VkDevice device, VkExtent2D swapChainExtent,
 		.basePipelineIndex = 0,
 	};
 
-	VkPipeline graphicsPipeline;
-	VkResult result = vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, NULL, &graphicsPipeline);
-	if (result != VK_SUCCESS) printf("failed to create graphics pipeline!");
+	result = vkCreateGraphicsPipelines(device, cache, 1, &pipelineInfo, NULL, pipeline);
 
 	vkDestroyShaderModule(device, fragShaderModule, NULL);
 	vkDestroyShaderModule(device, vertShaderModule, NULL);
 
-	return graphicsPipeline;
+	if (result != VK_SUCCESS) {
+		*pipeline = VK_NULL_HANDLE;
+		return result;
+	}
+
+	track_resource(RESOURCE_PIPELINE, *pipeline, 0);
+
+	return VK_SUCCESS;
 }
 
-VkFramebuffer *create_swapchain_framebuffer(VkDevice device, VkImageView *swapChainImageViews, uint32_t image_count, VkRenderPass renderPass, VkExtent2D swapChainExtent)
+// stencil_view is shared by every framebuffer, VK_NULL_HANDLE when the render pass has no stencil
+VkFramebuffer *create_swapchain_framebuffer(VkDevice device, VkImageView *swapChainImageViews, uint32_t image_count, VkImageView stencil_view, VkRenderPass renderPass, VkExtent2D swapChainExtent)
 {
 	VkFramebuffer *swapchain_framebuffers = malloc(image_count * sizeof(VkFramebuffer));
 
 	for (size_t i = 0; i < image_count; i++)
 	{
         	VkImageView attachments[] = {
-			swapChainImageViews[i]
+			swapChainImageViews[i],
+			stencil_view,
 		};
 
 		VkFramebufferCreateInfo framebuffer_info = {
@@ -716,7 +1238,7 @@ VkFramebuffer *create_swapchain_framebuffer(VkDevice device, VkImageView *swapCh
 			.pNext = NULL,
 			.flags = 0,
 			.renderPass = renderPass,
-			.attachmentCount = 1,
+			.attachmentCount = stencil_view != VK_NULL_HANDLE ? 2 : 1,
 			.pAttachments = attachments,
 			.width = swapChainExtent.width,
 			.height = swapChainExtent.height,
@@ -724,7 +1246,9 @@ VkFramebuffer *create_swapchain_framebuffer(VkDevice device, VkImageView *swapCh
 		};
 
 		VkResult result = vkCreateFramebuffer(device, &framebuffer_info, NULL, &swapchain_framebuffers[i]);
-		if (result != VK_SUCCESS) printf("failed to create framebuffer!");
+		if (result != VK_SUCCESS) swapchain_framebuffers[i] = VK_NULL_HANDLE;
+		if (result != VK_SUCCESS) report_render_failure(result, "create framebuffer");
+		if (result == VK_SUCCESS) track_resource(RESOURCE_FRAMEBUFFER, swapchain_framebuffers[i], 0);
 	}
 
 	return swapchain_framebuffers;
@@ -741,7 +1265,9 @@ VkCommandPool create_command_pool(VkDevice device, struct QueueFamilyIndices ind
 
 	VkCommandPool command_pool;
 	VkResult result = vkCreateCommandPool(device, &command_pool_info, NULL, &command_pool);
-	if (result != VK_SUCCESS) printf("failed to create command pool!");
+	if (result != VK_SUCCESS) printf("failed to create command pool: %s\n", get_result_string(result));
+	if (result != VK_SUCCESS) command_pool = VK_NULL_HANDLE;
+	if (result == VK_SUCCESS) track_resource(RESOURCE_COMMAND_POOL, command_pool, 0);
 
 	return command_pool;
 }
@@ -758,7 +1284,8 @@ VkCommandBuffer create_command_buffer(VkDevice device, VkCommandPool command_poo
 
 	VkCommandBuffer command_buffer;
 	VkResult result = vkAllocateCommandBuffers(device, &command_buffer_info, &command_buffer);
-	if (result != VK_SUCCESS) printf("failed to allocate command buffers!");
+	if (result != VK_SUCCESS) printf("failed to allocate command buffers: %s\n", get_result_string(result));
+	if (result != VK_SUCCESS) command_buffer = VK_NULL_HANDLE;
 
 	return command_buffer;
 }
@@ -773,7 +1300,9 @@ VkSemaphore create_semaphore(VkDevice device)
 
 	VkSemaphore semaphore;
 	VkResult result = vkCreateSemaphore(device, &semaphore_info, NULL, &semaphore);
-	if (result != VK_SUCCESS) printf("failed to create synchronization semaphore for a frame!");
+	if (result != VK_SUCCESS) printf("failed to create synchronization semaphore for a frame: %s\n", get_result_string(result));
+	if (result != VK_SUCCESS) semaphore = VK_NULL_HANDLE;
+	if (result == VK_SUCCESS) track_resource(RESOURCE_SEMAPHORE, semaphore, 0);
 
 	return semaphore;
 }
@@ -789,7 +1318,9 @@ VkFence create_fence(VkDevice device)
 	};
 
 	VkResult result = vkCreateFence(device, &fence_info, NULL, &in_flight_fence);
-	if (result != VK_SUCCESS) printf("failed to create synchronization fence for a frame!");
+	if (result != VK_SUCCESS) printf("failed to create synchronization fence for a frame: %s\n", get_result_string(result));
+	if (result != VK_SUCCESS) in_flight_fence = VK_NULL_HANDLE;
+	if (result == VK_SUCCESS) track_resource(RESOURCE_FENCE, in_flight_fence, 0);
 
 	return in_flight_fence;
 }
@@ -797,7 +1328,11 @@ VkFence create_fence(VkDevice device)
 char *readFile(const char *filename, int *file_size)
 {
 	FILE *fp = fopen(filename, "rb");
-	if (!fp) printf("failed to open file\n");
+	if (!fp) {
+		printf("failed to open %s\n", filename);
+		*file_size = 0;
+		return NULL;
+	}
 
 	fseek(fp, 0, SEEK_END);
 	*file_size = ftell(fp);
@@ -814,6 +1349,18 @@ char *readFile(const char *filename, int *file_size)
 
 VkShaderModule createShaderModule(char *code, int size, VkDevice device)
 {
+	VkShaderModule shader_module;
+	VkResult result = try_create_shader_module(device, code, size, &shader_module);
+	if (result != VK_SUCCESS) report_render_failure(result, "create shader module");
+
+	return shader_module;
+}
+
+VkResult try_create_shader_module(VkDevice device, const char *code, int size, VkShaderModule *shader_module)
+{
+	*shader_module = VK_NULL_HANDLE;
+	if (code == NULL) return VK_ERROR_INITIALIZATION_FAILED;
+
 	VkShaderModuleCreateInfo shader_module_info = {
 		.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
 		.pNext = NULL,
@@ -822,23 +1369,509 @@ VkShaderModule createShaderModule(char *code, int size, VkDevice device)
 		.pCode = (const uint32_t*)code,
 	};
 
-	VkShaderModule shader_module;
-	VkResult result = vkCreateShaderModule(device, &shader_module_info, NULL, &shader_module);
-	if (result != VK_SUCCESS) printf("failed to create shader module!");
+	VkResult result = vkCreateShaderModule(device, &shader_module_info, NULL, shader_module);
+	if (result != VK_SUCCESS) *shader_module = VK_NULL_HANDLE;
 
-	return shader_module;
+	return result;
 }
 
-char **get_required_instance_extensions(bool validation_layers_enabled, uint32_t *instance_extension_count)
+VkPipeline create_compute_pipeline(VkDevice device, VkPipelineLayout pipelineLayout, const char *comp_path)
 {
-	char **instance_extensions = (char **) glfwGetRequiredInstanceExtensions(instance_extension_count);
+	VkPipeline pipeline;
+	VkResult result = try_create_compute_pipeline(device, pipelineLayout, comp_path, &pipeline);
+	if (result != VK_SUCCESS) report_render_failure(result, "create compute pipeline");
 
-	if (validation_layers_enabled) {
-		*instance_extension_count += 1;
-		instance_extensions = realloc(instance_extensions, (*instance_extension_count) * sizeof(*instance_extensions));
-		instance_extensions[(*instance_extension_count)-1] = VK_EXT_DEBUG_UTILS_EXTENSION_NAME;
+	return pipeline;
+}
+
+VkResult try_create_compute_pipeline(VkDevice device, VkPipelineLayout pipelineLayout, const char *comp_path, VkPipeline *pipeline)
+{
+	int comp_size;
+
+	char *compShaderCode = readFile(comp_path, &comp_size);
+
+	VkShaderModule compShaderModule;
+	VkResult result = try_create_shader_module(device, compShaderCode, comp_size, &compShaderModule);
+
+	free(compShaderCode);
+
+	if (result != VK_SUCCESS) {
+		*pipeline = VK_NULL_HANDLE;
+		return result;
+	}
+
+	VkComputePipelineCreateInfo pipelineInfo = {
+		.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+		.pNext = NULL,
+		.flags = 0,
+		.stage = {
+			.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+			.pNext = NULL,
+			.flags = 0,
+			.stage = VK_SHADER_STAGE_COMPUTE_BIT,
+			.module = compShaderModule,
+			.pName = "main",
+			.pSpecializationInfo = NULL,
+		},
+		.layout = pipelineLayout,
+		.basePipelineHandle = VK_NULL_HANDLE,
+		.basePipelineIndex = 0,
+	};
+
+	result = vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, NULL, pipeline);
+
+	vkDestroyShaderModule(device, compShaderModule, NULL);
+
+	if (result != VK_SUCCESS) {
+		*pipeline = VK_NULL_HANDLE;
+		return result;
+	}
+
+	track_resource(RESOURCE_PIPELINE, *pipeline, 0);
+
+	return VK_SUCCESS;
+}
+
+uint32_t find_memory_type(VkPhysicalDevice physical_device, uint32_t type_filter, VkMemoryPropertyFlags properties)
+{
+	VkPhysicalDeviceMemoryProperties memory_properties;
+	vkGetPhysicalDeviceMemoryProperties(physical_device, &memory_properties);
+
+	for (uint32_t i = 0; i < memory_properties.memoryTypeCount; i++)
+	{
+		if ((type_filter & (1 << i)) && (memory_properties.memoryTypes[i].propertyFlags & properties) == properties) {
+			return i;
+		}
 	}
 
+	printf("failed to find suitable memory type\n");
+
+	return 0;
+}
+
+struct Buffer create_buffer_at(VkPhysicalDevice physical_device, VkDevice device, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, const char *file, int line)
+{
+	struct Buffer buffer;
+	VkResult result = try_create_buffer_at(physical_device, device, size, usage, properties, &buffer, file, line);
+	if (result != VK_SUCCESS) report_render_error(result, "create buffer", file, line);
+
+	return buffer;
+}
+
+VkResult try_create_buffer_at(VkPhysicalDevice physical_device, VkDevice device, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, struct Buffer *buffer, const char *file, int line)
+{
+	*buffer = (struct Buffer) {
+		.buffer = VK_NULL_HANDLE,
+		.memory = VK_NULL_HANDLE,
+		.size = size,
+		.mapped = NULL,
+	};
+
+	VkBufferCreateInfo buffer_info = {
+		.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+		.pNext = NULL,
+		.flags = 0,
+		.size = size,
+		.usage = usage,
+		.sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+		.queueFamilyIndexCount = 0,
+		.pQueueFamilyIndices = NULL,
+	};
+
+	VkResult result = vkCreateBuffer(device, &buffer_info, NULL, &buffer->buffer);
+
+	if (result != VK_SUCCESS) {
+		buffer->buffer = VK_NULL_HANDLE;
+		return result;
+	}
+
+	track_resource_at(RESOURCE_BUFFER, (uint64_t) buffer->buffer, buffer_info.size, file, line);
+
+	VkMemoryRequirements requirements;
+	vkGetBufferMemoryRequirements(device, buffer->buffer, &requirements);
+
+	VkMemoryAllocateInfo allocate_info = {
+		.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+		.pNext = NULL,
+		.allocationSize = requirements.size,
+		.memoryTypeIndex = find_memory_type(physical_device, requirements.memoryTypeBits, properties),
+	};
+
+	result = vkAllocateMemory(device, &allocate_info, NULL, &buffer->memory);
+	if (result != VK_SUCCESS) buffer->memory = VK_NULL_HANDLE;
+	if (result == VK_SUCCESS) track_resource_at(RESOURCE_MEMORY, (uint64_t) buffer->memory, allocate_info.allocationSize, file, line);
+
+	if (result == VK_SUCCESS) result = vkBindBufferMemory(device, buffer->buffer, buffer->memory, 0);
+
+	// host visible buffers stay mapped for their whole lifetime
+
+	if (result == VK_SUCCESS && (properties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)) {
+		result = vkMapMemory(device, buffer->memory, 0, size, 0, &buffer->mapped);
+		if (result != VK_SUCCESS) buffer->mapped = NULL;
+	}
+
+	if (result != VK_SUCCESS) destroy_buffer(device, buffer);
+
+	return result;
+}
+
+void destroy_buffer(VkDevice device, struct Buffer *buffer)
+{
+	if (buffer->mapped != NULL) vkUnmapMemory(device, buffer->memory);
+
+	untrack_resource(RESOURCE_BUFFER, buffer->buffer);
+	vkDestroyBuffer(device, buffer->buffer, NULL);
+	untrack_resource(RESOURCE_MEMORY, buffer->memory);
+	vkFreeMemory(device, buffer->memory, NULL);
+
+	buffer->buffer = VK_NULL_HANDLE;
+	buffer->memory = VK_NULL_HANDLE;
+	buffer->mapped = NULL;
+}
+
+struct Image create_image_levels_at(VkPhysicalDevice physical_device, VkDevice device, VkExtent2D extent, VkFormat format, uint32_t level_count, VkImageUsageFlags usage, const char *file, int line)
+{
+	struct Image image;
+	VkResult result = try_create_image_levels_at(physical_device, device, extent, format, level_count, usage, &image, file, line);
+	if (result != VK_SUCCESS) report_render_error(result, "create image", file, line);
+
+	return image;
+}
+
+VkResult try_create_image_levels_at(VkPhysicalDevice physical_device, VkDevice device, VkExtent2D extent, VkFormat format, uint32_t level_count, VkImageUsageFlags usage, struct Image *image, const char *file, int line)
+{
+	*image = (struct Image) {
+		.image = VK_NULL_HANDLE,
+		.memory = VK_NULL_HANDLE,
+		.view = VK_NULL_HANDLE,
+		.format = format,
+		.extent = extent,
+		.level_count = level_count,
+	};
+
+	VkImageCreateInfo image_info = {
+		.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+		.pNext = NULL,
+		.flags = 0,
+		.imageType = VK_IMAGE_TYPE_2D,
+		.format = format,
+		.extent = {extent.width, extent.height, 1},
+		.mipLevels = level_count,
+		.arrayLayers = 1,
+		.samples = VK_SAMPLE_COUNT_1_BIT,
+		.tiling = VK_IMAGE_TILING_OPTIMAL,
+		.usage = usage,
+		.sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+		.queueFamilyIndexCount = 0,
+		.pQueueFamilyIndices = NULL,
+		.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+	};
+
+	VkResult result = vkCreateImage(device, &image_info, NULL, &image->image);
+
+	if (result != VK_SUCCESS) {
+		image->image = VK_NULL_HANDLE;
+		return result;
+	}
+
+	track_resource_at(RESOURCE_IMAGE, (uint64_t) image->image, 0, file, line);
+
+	VkMemoryRequirements requirements;
+	vkGetImageMemoryRequirements(device, image->image, &requirements);
+
+	VkMemoryAllocateInfo allocate_info = {
+		.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+		.pNext = NULL,
+		.allocationSize = requirements.size,
+		.memoryTypeIndex = find_memory_type(physical_device, requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT),
+	};
+
+	result = vkAllocateMemory(device, &allocate_info, NULL, &image->memory);
+	if (result != VK_SUCCESS) image->memory = VK_NULL_HANDLE;
+	if (result == VK_SUCCESS) track_resource_at(RESOURCE_MEMORY, (uint64_t) image->memory, allocate_info.allocationSize, file, line);
+
+	if (result == VK_SUCCESS) result = vkBindImageMemory(device, image->image, image->memory, 0);
+
+	VkImageViewCreateInfo view_info = {
+		.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+		.pNext = NULL,
+		.flags = 0,
+		.image = image->image,
+		.viewType = VK_IMAGE_VIEW_TYPE_2D,
+		.format = format,
+		.components = {
+			VK_COMPONENT_SWIZZLE_IDENTITY,
+			VK_COMPONENT_SWIZZLE_IDENTITY,
+			VK_COMPONENT_SWIZZLE_IDENTITY,
+			VK_COMPONENT_SWIZZLE_IDENTITY,
+		},
+		.subresourceRange = {
+			.aspectMask = format_aspect_flags(format),
+			.baseMipLevel = 0,
+			.levelCount = level_count,
+			.baseArrayLayer = 0,
+			.layerCount = 1,
+		},
+	};
+
+	if (result == VK_SUCCESS) {
+		result = vkCreateImageView(device, &view_info, NULL, &image->view);
+		if (result != VK_SUCCESS) image->view = VK_NULL_HANDLE;
+		if (result == VK_SUCCESS) track_resource_at(RESOURCE_IMAGE_VIEW, (uint64_t) image->view, 0, file, line);
+	}
+
+	if (result != VK_SUCCESS) destroy_image(device, image);
+
+	return result;
+}
+
+void destroy_image(VkDevice device, struct Image *image)
+{
+	untrack_resource(RESOURCE_IMAGE_VIEW, image->view);
+	vkDestroyImageView(device, image->view, NULL);
+	untrack_resource(RESOURCE_IMAGE, image->image);
+	vkDestroyImage(device, image->image, NULL);
+	untrack_resource(RESOURCE_MEMORY, image->memory);
+	vkFreeMemory(device, image->memory, NULL);
+
+	image->view = VK_NULL_HANDLE;
+	image->image = VK_NULL_HANDLE;
+	image->memory = VK_NULL_HANDLE;
+}
+
+VkSampler create_sampler(VkDevice device, VkFilter filter, VkSamplerAddressMode address_mode)
+{
+	VkSampler sampler;
+	VkResult result = try_create_sampler(device, filter, address_mode, &sampler);
+	if (result != VK_SUCCESS) report_render_failure(result, "create sampler");
+
+	return sampler;
+}
+
+VkResult try_create_sampler(VkDevice device, VkFilter filter, VkSamplerAddressMode address_mode, VkSampler *sampler)
+{
+	VkSamplerCreateInfo sampler_info = {
+		.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+		.pNext = NULL,
+		.flags = 0,
+		.magFilter = filter,
+		.minFilter = filter,
+		.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+		.addressModeU = address_mode,
+		.addressModeV = address_mode,
+		.addressModeW = address_mode,
+		.mipLodBias = 0.0f,
+		.anisotropyEnable = VK_FALSE,
+		.maxAnisotropy = 1.0f,
+		.compareEnable = VK_FALSE,
+		.compareOp = VK_COMPARE_OP_ALWAYS,
+		.minLod = 0.0f,
+		.maxLod = 0.0f,
+		.borderColor = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK,
+		.unnormalizedCoordinates = VK_FALSE,
+	};
+
+	VkResult result = vkCreateSampler(device, &sampler_info, NULL, sampler);
+
+	if (result != VK_SUCCESS) {
+		*sampler = VK_NULL_HANDLE;
+		return result;
+	}
+
+	track_resource(RESOURCE_SAMPLER, *sampler, 0);
+
+	return VK_SUCCESS;
+}
+
+// trilinear, every level of the image; a positive bias picks smaller levels
+VkSampler create_mip_sampler(VkDevice device, VkFilter filter, VkSamplerAddressMode address_mode, float lod_bias)
+{
+	VkSampler sampler;
+	VkResult result = try_create_mip_sampler(device, filter, address_mode, lod_bias, &sampler);
+	if (result != VK_SUCCESS) report_render_failure(result, "create sampler");
+
+	return sampler;
+}
+
+VkResult try_create_mip_sampler(VkDevice device, VkFilter filter, VkSamplerAddressMode address_mode, float lod_bias, VkSampler *sampler)
+{
+	VkSamplerCreateInfo sampler_info = {
+		.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+		.pNext = NULL,
+		.flags = 0,
+		.magFilter = filter,
+		.minFilter = filter,
+		.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR,
+		.addressModeU = address_mode,
+		.addressModeV = address_mode,
+		.addressModeW = address_mode,
+		.mipLodBias = lod_bias,
+		.anisotropyEnable = VK_FALSE,
+		.maxAnisotropy = 1.0f,
+		.compareEnable = VK_FALSE,
+		.compareOp = VK_COMPARE_OP_ALWAYS,
+		.minLod = 0.0f,
+		.maxLod = VK_LOD_CLAMP_NONE,
+		.borderColor = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK,
+		.unnormalizedCoordinates = VK_FALSE,
+	};
+
+	VkResult result = vkCreateSampler(device, &sampler_info, NULL, sampler);
+
+	if (result != VK_SUCCESS) {
+		*sampler = VK_NULL_HANDLE;
+		return result;
+	}
+
+	track_resource(RESOURCE_SAMPLER, *sampler, 0);
+
+	return VK_SUCCESS;
+}
+
+uint32_t mip_level_count(VkExtent2D extent)
+{
+	uint32_t size = extent.width > extent.height ? extent.width : extent.height;
+	uint32_t level_count = 1;
+
+	while (size > 1)
+	{
+		size >>= 1;
+		level_count++;
+	}
+
+	return level_count;
+}
+
+static void mip_barrier(VkCommandBuffer command_buffer, VkImage image, uint32_t level, VkImageLayout old_layout, VkImageLayout new_layout, VkAccessFlags src_access, VkAccessFlags dst_access, VkPipelineStageFlags src_stage, VkPipelineStageFlags dst_stage)
+{
+	VkImageMemoryBarrier barrier = {
+		.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+		.pNext = NULL,
+		.srcAccessMask = src_access,
+		.dstAccessMask = dst_access,
+		.oldLayout = old_layout,
+		.newLayout = new_layout,
+		.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.image = image,
+		.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, level, 1, 0, 1},
+	};
+
+	vkCmdPipelineBarrier(command_buffer, src_stage, dst_stage, 0, 0, NULL, 0, NULL, 1, &barrier);
+}
+
+// every level starts in TRANSFER_DST_OPTIMAL with level 0 written; each level is blitted
+// from the one above it and every level ends up SHADER_READ_ONLY_OPTIMAL for dst_stage
+void record_generate_mips(VkCommandBuffer command_buffer, const struct Image *image, VkPipelineStageFlags dst_stage)
+{
+	int32_t width = (int32_t) image->extent.width;
+	int32_t height = (int32_t) image->extent.height;
+
+	for (uint32_t level = 1; level < image->level_count; level++)
+	{
+		mip_barrier(command_buffer, image->image, level - 1, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+		int32_t next_width = width > 1 ? width / 2 : 1;
+		int32_t next_height = height > 1 ? height / 2 : 1;
+
+		VkImageBlit blit = {
+			.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level - 1, 0, 1},
+			.srcOffsets = {{0, 0, 0}, {width, height, 1}},
+			.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1},
+			.dstOffsets = {{0, 0, 0}, {next_width, next_height, 1}},
+		};
+
+		vkCmdBlitImage(command_buffer, image->image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+
+		mip_barrier(command_buffer, image->image, level - 1, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, dst_stage);
+
+		width = next_width;
+		height = next_height;
+	}
+
+	mip_barrier(command_buffer, image->image, image->level_count - 1, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, dst_stage);
+}
+
+VkCommandBuffer begin_single_time_commands(VkDevice device, VkCommandPool command_pool)
+{
+	VkCommandBuffer command_buffer = create_command_buffer(device, command_pool);
+
+	VkCommandBufferBeginInfo begin_info = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+		.pNext = NULL,
+		.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+		.pInheritanceInfo = NULL,
+	};
+
+	VkResult result = vkBeginCommandBuffer(command_buffer, &begin_info);
+	if (result != VK_SUCCESS) printf("failed to begin recording single time command buffer\n");
+
+	return command_buffer;
+}
+
+void end_single_time_commands(VkDevice device, VkCommandPool command_pool, VkQueue queue, VkCommandBuffer command_buffer)
+{
+	VkResult result = vkEndCommandBuffer(command_buffer);
+	if (result != VK_SUCCESS) printf("failed to record single time command buffer\n");
+
+	VkSubmitInfo submit_info = {
+		.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+		.pNext = NULL,
+		.waitSemaphoreCount = 0,
+		.pWaitSemaphores = NULL,
+		.pWaitDstStageMask = NULL,
+		.commandBufferCount = 1,
+		.pCommandBuffers = &command_buffer,
+		.signalSemaphoreCount = 0,
+		.pSignalSemaphores = NULL,
+	};
+
+	result = vkQueueSubmit(queue, 1, &submit_info, VK_NULL_HANDLE);
+	if (result == VK_SUCCESS) result = vkQueueWaitIdle(queue);
+	if (result != VK_SUCCESS) report_render_failure(result, "submit single time command buffer");
+
+	vkFreeCommandBuffers(device, command_pool, 1, &command_buffer);
+}
+
+void upload_buffer(VkPhysicalDevice physical_device, VkDevice device, VkCommandPool command_pool, VkQueue queue, struct Buffer *dst, const void *data, VkDeviceSize size)
+{
+	struct Buffer staging = create_buffer(physical_device, device, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+	// either failure was reported when the buffer was made
+	if (staging.mapped == NULL || dst->buffer == VK_NULL_HANDLE) {
+		destroy_buffer(device, &staging);
+		return;
+	}
+
+	memcpy(staging.mapped, data, size);
+
+	VkCommandBuffer command_buffer = begin_single_time_commands(device, command_pool);
+
+	VkBufferCopy region = {
+		.srcOffset = 0,
+		.dstOffset = 0,
+		.size = size,
+	};
+
+	vkCmdCopyBuffer(command_buffer, staging.buffer, dst->buffer, 1, &region);
+
+	end_single_time_commands(device, command_pool, queue, command_buffer);
+
+	destroy_buffer(device, &staging);
+}
+
+char **get_required_instance_extensions(bool validation_layers_enabled, uint32_t *instance_extension_count)
+{
+	uint32_t glfw_extension_count = 0;
+	const char **glfw_extensions = glfwGetRequiredInstanceExtensions(&glfw_extension_count);
+
+	// glfw owns its array, the copy has room for the debug extension and is the caller's to free
+	*instance_extension_count = glfw_extension_count + (validation_layers_enabled ? 1 : 0);
+	char **instance_extensions = malloc((*instance_extension_count > 0 ? *instance_extension_count : 1) * sizeof(*instance_extensions));
+
+	for (uint32_t i = 0; i < glfw_extension_count; i++) instance_extensions[i] = (char *) glfw_extensions[i];
+	if (validation_layers_enabled) instance_extensions[glfw_extension_count] = VK_EXT_DEBUG_UTILS_EXTENSION_NAME;
+
 	return instance_extensions;
 }
 
@@ -975,6 +2008,8 @@ void print_physical_device_info(VkInstance instance, VkSurfaceKHR surface, uint3
 
 		printf("swapchain support = %s\n", extensions_supported ? "true" : "false" );
 
+		free(available_device_extensions);
+
 		// get memory heap properties
 
 		VkPhysicalDeviceMemoryProperties memory_properties;
@@ -1027,6 +2062,8 @@ void print_physical_device_info(VkInstance instance, VkSurfaceKHR surface, uint3
 			print_queue_family_info(devices[i], surface, &queue_families[j], j);
 		}
 
+		free(queue_families);
+
 		// color formats
 
 		uint32_t format_count = 0;
@@ -1043,6 +2080,8 @@ void print_physical_device_info(VkInstance instance, VkSurfaceKHR surface, uint3
 			printf("\tformat[%d]: format = %s, color space = %s\n", j, color_format_string, color_space_string);
 		}
 
+		free(formats);
+
 		// present mode
 
 		uint32_t present_mode_count = 0;
@@ -1058,6 +2097,8 @@ void print_physical_device_info(VkInstance instance, VkSurfaceKHR surface, uint3
 			printf("\tmode[%d] = %s\n", j, present_string);
 		}
 
+		free(present_modes);
+
 		// device capabilities
 
 		VkSurfaceCapabilitiesKHR capabilities;
@@ -1097,6 +2138,8 @@ void print_physical_device_info(VkInstance instance, VkSurfaceKHR surface, uint3
 		printf("\n");
 
 	}
+
+	free(devices);
 }
 
 void print_queue_family_info(VkPhysicalDevice device, VkSurfaceKHR surface, VkQueueFamilyProperties *queue_family, uint32_t queue_family_index)
@@ -1145,6 +2188,71 @@ char *get_device_type_string(enum VkPhysicalDeviceType device_type)
 	return device_string;
 }
 
+char *get_result_string(VkResult result)
+{
+	char *result_string;
+
+	switch (result)
+	{
+		case VK_SUCCESS:
+			result_string = (char *)"success";
+			break;
+		case VK_NOT_READY:
+			result_string = (char *)"not ready";
+			break;
+		case VK_TIMEOUT:
+			result_string = (char *)"timeout";
+			break;
+		case VK_SUBOPTIMAL_KHR:
+			result_string = (char *)"suboptimal";
+			break;
+		case VK_ERROR_OUT_OF_HOST_MEMORY:
+			result_string = (char *)"out of host memory";
+			break;
+		case VK_ERROR_OUT_OF_DEVICE_MEMORY:
+			result_string = (char *)"out of device memory";
+			break;
+		case VK_ERROR_INITIALIZATION_FAILED:
+			result_string = (char *)"initialization failed";
+			break;
+		case VK_ERROR_DEVICE_LOST:
+			result_string = (char *)"device lost";
+			break;
+		case VK_ERROR_MEMORY_MAP_FAILED:
+			result_string = (char *)"memory map failed";
+			break;
+		case VK_ERROR_LAYER_NOT_PRESENT:
+			result_string = (char *)"layer not present";
+			break;
+		case VK_ERROR_EXTENSION_NOT_PRESENT:
+			result_string = (char *)"extension not present";
+			break;
+		case VK_ERROR_FEATURE_NOT_PRESENT:
+			result_string = (char *)"feature not present";
+			break;
+		case VK_ERROR_INCOMPATIBLE_DRIVER:
+			result_string = (char *)"incompatible driver";
+			break;
+		case VK_ERROR_TOO_MANY_OBJECTS:
+			result_string = (char *)"too many objects";
+			break;
+		case VK_ERROR_SURFACE_LOST_KHR:
+			result_string = (char *)"surface lost";
+			break;
+		case VK_ERROR_NATIVE_WINDOW_IN_USE_KHR:
+			result_string = (char *)"native window in use";
+			break;
+		case VK_ERROR_OUT_OF_DATE_KHR:
+			result_string = (char *)"out of date";
+			break;
+		default:
+			result_string = (char *)"unknown error";
+			break;
+	}
+
+	return result_string;
+}
+
 char *get_present_mode_string(enum VkPresentModeKHR present_mode)
 {
 	char *present_string;
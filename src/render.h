@@ -16,32 +16,177 @@ struct QueueFamilyIndices {
 	uint32_t presentFamily;
 };
 
-GLFWwindow *create_window();
+// optional device features, requested before create_device and filled in with what was enabled
+struct DeviceFeatures {
+	bool dynamic_rendering;
+	PFN_vkCmdBeginRendering cmd_begin_rendering;
+	PFN_vkCmdEndRendering cmd_end_rendering;
+};
+
+enum BlendMode {
+	BLEND_MODE_NONE,
+	BLEND_MODE_PREMULTIPLIED,
+	BLEND_MODE_ADDITIVE,
+	BLEND_MODE_MULTIPLY,
+	BLEND_MODE_COUNT,
+};
+
+// vertex buffer layouts, the vertex shader sees the same inputs for every one of them:
+// location 0 vec2 position, location 1 vec2 uv, location 2 vec4 color
+enum VertexLayout {
+	VERTEX_LAYOUT_NONE,    // no vertex buffer, the shader builds its vertices
+	VERTEX_LAYOUT_FLOAT,   // struct Vertex, 32 bytes
+	VERTEX_LAYOUT_COMPACT, // struct CompactVertex, 12 bytes
+	VERTEX_LAYOUT_COUNT,
+};
+
+struct Vertex {
+	float position[2];
+	float uv[2];
+	float color[4];
+};
+
+// positions are snorm16 relative to a tile, origin + position * half extent, which the
+// draw pushes; uvs are unorm16 and colors rgba8
+struct CompactVertex {
+	int16_t position[2];
+	uint16_t uv[2];
+	uint8_t color[4];
+};
+
+// how a pipeline uses the stencil, which holds the depth of nested clips (see clip.h);
+// the reference is dynamic state, set by the clip stack
+enum StencilMode {
+	STENCIL_MODE_NONE,
+	STENCIL_MODE_CLIP_TEST, // draws where the stencil equals the reference
+	STENCIL_MODE_CLIP_PUSH, // no color, increments where the stencil equals the reference
+	STENCIL_MODE_CLIP_POP,  // no color, lowers to the reference where the stencil is above it
+	STENCIL_MODE_COUNT,
+};
+
+// the parts of a graphics pipeline that vary between draws; scissor and stencil reference are always dynamic
+struct PipelineState {
+	VkRenderPass render_pass; // VK_NULL_HANDLE for dynamic rendering into color_format
+	VkFormat color_format;
+	VkFormat stencil_format;  // VK_FORMAT_UNDEFINED when the target has no stencil
+	enum StencilMode stencil; // ignored without a stencil_format
+	enum BlendMode blend;
+	VkPrimitiveTopology topology;
+	VkSampleCountFlagBits samples;
+	enum VertexLayout vertex_layout;
+};
+
+struct Buffer {
+	VkBuffer buffer;
+	VkDeviceMemory memory;
+	VkDeviceSize size;
+	void *mapped; // non-NULL for host visible buffers
+};
+
+struct Image {
+	VkImage image;
+	VkDeviceMemory memory;
+	VkImageView view;
+	VkFormat format;
+	VkExtent2D extent;
+	uint32_t level_count;
+};
+
+struct RenderError {
+	VkResult result;  // VK_SUCCESS while nothing failed
+	const char *call; // the vulkan call or step that failed
+	const char *file;
+	int line;
+};
+
+// keeps the first failure, later ones are usually its consequences; returns result
+#define fail_render(error, result, call) record_render_error((error), (result), (call), __FILE__, __LINE__)
+
+VkResult record_render_error(struct RenderError *error, VkResult result, const char *call, const char *file, int line);
+void print_render_error(const struct RenderError *error);
+
+// the create_* helpers also record their failures into the error the calling thread watches,
+// so code making many objects checks once at the end; returns the error watched before, NULL
+// stops watching
+struct RenderError *watch_render_errors(struct RenderError *error);
+
+// what the printing helpers do with a failure: print it and record it into the watched error
+#define report_render_failure(result, call) report_render_error((result), (call), __FILE__, __LINE__)
+void report_render_error(VkResult result, const char *call, const char *file, int line);
+
+// the try_ variants return what failed and leave VK_NULL_HANDLE behind, without printing;
+// the others print the failure and hand back whatever the try_ variant left
+GLFWwindow *create_window(uint32_t width, uint32_t height, const char *title);
 VkInstance create_instance(bool validation_layers_enabled, uint32_t validation_layer_count, const char **validation_layers, uint32_t instance_extension_count, char **instance_extensions);
+VkResult try_create_instance(bool validation_layers_enabled, uint32_t validation_layer_count, const char **validation_layers, uint32_t instance_extension_count, char **instance_extensions, VkInstance *instance);
 VkDebugUtilsMessengerEXT create_debug_messenger(bool validation_layers_enabled, VkInstance instance);
 VkSurfaceKHR create_surface(GLFWwindow *window, VkInstance instance);
 VkPhysicalDevice create_physical_device(VkInstance instance, VkSurfaceKHR surface, uint32_t device_extension_count, const char **device_extensions);
-VkDevice create_device(bool validation_layers_enabled, const char **validation_layers, uint32_t validation_layer_count, VkPhysicalDevice physicalDevice, struct QueueFamilyIndices indices, uint32_t device_extension_count, const char **device_extensions);
+uint32_t get_instance_version(void);
+VkDevice create_device(bool validation_layers_enabled, const char **validation_layers, uint32_t validation_layer_count, VkPhysicalDevice physicalDevice, struct QueueFamilyIndices indices, uint32_t device_extension_count, const char **device_extensions, struct DeviceFeatures *features);
+VkResult try_create_device(bool validation_layers_enabled, const char **validation_layers, uint32_t validation_layer_count, VkPhysicalDevice physicalDevice, struct QueueFamilyIndices indices, uint32_t device_extension_count, const char **device_extensions, struct DeviceFeatures *features, VkDevice *device);
 VkQueue create_device_queue(VkDevice device, uint32_t queue_family_index, uint32_t queue_index);
 VkSurfaceFormatKHR create_format(VkPhysicalDevice physical_device, VkSurfaceKHR surface);
+bool format_supported(VkPhysicalDevice physical_device, VkFormat format, VkFormatFeatureFlags features);
+VkFormat find_stencil_format(VkPhysicalDevice physical_device);
 VkPresentModeKHR create_present_mode(VkPhysicalDevice physical_device, VkSurfaceKHR surface);
 VkSurfaceCapabilitiesKHR create_capabilities(VkPhysicalDevice physical_device, VkSurfaceKHR surface);
 VkExtent2D create_swap_extent(GLFWwindow *window, VkSurfaceCapabilitiesKHR capabilities);
 uint32_t create_image_count(VkSurfaceCapabilitiesKHR capabilities);
 VkSwapchainKHR create_swapchain(VkDevice device, VkSurfaceKHR surface, uint32_t imageCount, VkSurfaceFormatKHR surfaceFormat, VkExtent2D extent, struct QueueFamilyIndices indices, VkSurfaceCapabilitiesKHR capabilities, VkPresentModeKHR presentMode);
+VkResult try_create_swapchain(VkDevice device, VkSurfaceKHR surface, uint32_t imageCount, VkSurfaceFormatKHR surfaceFormat, VkExtent2D extent, struct QueueFamilyIndices indices, VkSurfaceCapabilitiesKHR capabilities, VkPresentModeKHR presentMode, VkSwapchainKHR *swapchain);
+VkImage *create_swapchain_images(VkDevice device, VkSwapchainKHR swapChain, uint32_t imageCount);
 VkImageView *create_swapchain_image_views(VkDevice device, VkSwapchainKHR swapChain, VkFormat swapChainImageFormat, uint32_t imageCount);
-VkRenderPass create_render_pass(VkDevice device, VkFormat swapChainImageFormat);
-VkPipelineLayout create_pipeline_layout(VkDevice device);
-VkPipeline create_graphics_pipeline(VkDevice device, VkExtent2D swapChainExtent, VkRenderPass renderPass, VkPipelineLayout pipelineLayout);
-VkFramebuffer *create_swapchain_framebuffer(VkDevice device, VkImageView *swapChainImageViews, uint32_t image_count, VkRenderPass renderPass, VkExtent2D swapChainExtent);
+VkResult try_create_image_views(VkDevice device, const VkImage *images, uint32_t image_count, VkFormat format, VkImageView *views);
+void begin_dynamic_rendering(const struct DeviceFeatures *features, VkCommandBuffer command_buffer, VkImageView view, VkImageView stencil_view, VkExtent2D extent, VkClearColorValue clear_color);
+void end_dynamic_rendering(const struct DeviceFeatures *features, VkCommandBuffer command_buffer);
+VkImageAspectFlags format_aspect_flags(VkFormat format);
+uint32_t vertex_layout_stride(enum VertexLayout layout);
+VkRenderPass create_render_pass(VkDevice device, VkFormat swapChainImageFormat, VkFormat stencil_format);
+VkResult try_create_render_pass(VkDevice device, VkFormat color_format, VkFormat stencil_format, VkRenderPass *render_pass);
+VkPipelineLayout create_pipeline_layout(VkDevice device, uint32_t set_layout_count, const VkDescriptorSetLayout *set_layouts, VkShaderStageFlags push_stages, uint32_t push_size);
+VkResult try_create_pipeline_layout(VkDevice device, uint32_t set_layout_count, const VkDescriptorSetLayout *set_layouts, VkShaderStageFlags push_stages, uint32_t push_size, VkPipelineLayout *layout);
+VkPipeline create_graphics_pipeline(VkDevice device, VkExtent2D swapChainExtent, VkRenderPass renderPass, VkFormat colorFormat, VkFormat stencilFormat, VkPipelineLayout pipelineLayout, const char *vert_path, const char *frag_path, bool blend_enabled);
+VkPipeline create_graphics_pipeline_state(VkDevice device, VkPipelineCache cache, VkExtent2D swapChainExtent, VkPipelineLayout pipelineLayout, const char *vert_path, const char *frag_path, const struct PipelineState *state);
+VkResult try_create_graphics_pipeline_state(VkDevice device, VkPipelineCache cache, VkExtent2D extent, VkPipelineLayout layout, const char *vert_path, const char *frag_path, const struct PipelineState *state, VkPipeline *pipeline);
+VkPipeline create_compute_pipeline(VkDevice device, VkPipelineLayout pipelineLayout, const char *comp_path);
+VkResult try_create_compute_pipeline(VkDevice device, VkPipelineLayout layout, const char *comp_path, VkPipeline *pipeline);
+VkFramebuffer *create_swapchain_framebuffer(VkDevice device, VkImageView *swapChainImageViews, uint32_t image_count, VkImageView stencil_view, VkRenderPass renderPass, VkExtent2D swapChainExtent);
 VkCommandPool create_command_pool(VkDevice device, struct QueueFamilyIndices indices);
 VkCommandBuffer create_command_buffer(VkDevice device, VkCommandPool commandPool);
 VkSemaphore create_semaphore(VkDevice device);
 VkFence create_fence(VkDevice device);
 char *readFile(const char *filename, int *file_size);
 VkShaderModule createShaderModule(char *code, int size, VkDevice device);
+VkResult try_create_shader_module(VkDevice device, const char *code, int size, VkShaderModule *module); // NULL code, a file that failed to read, fails too
 struct QueueFamilyIndices create_queue_families(VkPhysicalDevice device, VkSurfaceKHR surface);
 
+uint32_t find_memory_type(VkPhysicalDevice physical_device, uint32_t type_filter, VkMemoryPropertyFlags properties);
+
+// buffers and images are tracked under the caller's file and line, not these helpers'
+#define create_buffer(...) create_buffer_at(__VA_ARGS__, __FILE__, __LINE__)
+#define create_image(physical_device, device, extent, format, usage) create_image_levels_at((physical_device), (device), (extent), (format), 1, (usage), __FILE__, __LINE__)
+#define create_image_levels(...) create_image_levels_at(__VA_ARGS__, __FILE__, __LINE__)
+#define try_create_buffer(...) try_create_buffer_at(__VA_ARGS__, __FILE__, __LINE__)
+#define try_create_image(physical_device, device, extent, format, usage, image) try_create_image_levels_at((physical_device), (device), (extent), (format), 1, (usage), (image), __FILE__, __LINE__)
+#define try_create_image_levels(...) try_create_image_levels_at(__VA_ARGS__, __FILE__, __LINE__)
+
+struct Buffer create_buffer_at(VkPhysicalDevice physical_device, VkDevice device, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, const char *file, int line);
+VkResult try_create_buffer_at(VkPhysicalDevice physical_device, VkDevice device, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, struct Buffer *buffer, const char *file, int line);
+void destroy_buffer(VkDevice device, struct Buffer *buffer);
+struct Image create_image_levels_at(VkPhysicalDevice physical_device, VkDevice device, VkExtent2D extent, VkFormat format, uint32_t level_count, VkImageUsageFlags usage, const char *file, int line);
+VkResult try_create_image_levels_at(VkPhysicalDevice physical_device, VkDevice device, VkExtent2D extent, VkFormat format, uint32_t level_count, VkImageUsageFlags usage, struct Image *image, const char *file, int line);
+void destroy_image(VkDevice device, struct Image *image);
+VkSampler create_sampler(VkDevice device, VkFilter filter, VkSamplerAddressMode address_mode);
+VkResult try_create_sampler(VkDevice device, VkFilter filter, VkSamplerAddressMode address_mode, VkSampler *sampler);
+VkSampler create_mip_sampler(VkDevice device, VkFilter filter, VkSamplerAddressMode address_mode, float lod_bias);
+VkResult try_create_mip_sampler(VkDevice device, VkFilter filter, VkSamplerAddressMode address_mode, float lod_bias, VkSampler *sampler);
+uint32_t mip_level_count(VkExtent2D extent);
+void record_generate_mips(VkCommandBuffer command_buffer, const struct Image *image, VkPipelineStageFlags dst_stage);
+VkCommandBuffer begin_single_time_commands(VkDevice device, VkCommandPool command_pool);
+void end_single_time_commands(VkDevice device, VkCommandPool command_pool, VkQueue queue, VkCommandBuffer command_buffer);
+void upload_buffer(VkPhysicalDevice physical_device, VkDevice device, VkCommandPool command_pool, VkQueue queue, struct Buffer *dst, const void *data, VkDeviceSize size);
+
 char **get_required_instance_extensions(bool validation_layers_enabled, uint32_t *instance_extension_count);
 void check_validation_layer_support(bool validation_layers_enabled, const char **validation_layers, uint32_t validation_layer_count);
 void check_instance_extension_support(char **required_extensions, uint32_t required_extension_count);
@@ -52,6 +197,7 @@ bool check_layer_support(const char **required_layers, uint32_t required_count,
 void print_physical_device_info(VkInstance instance, VkSurfaceKHR surface, uint32_t device_extension_count, const char **device_extensions);
 void print_queue_family_info(VkPhysicalDevice device, VkSurfaceKHR surface, VkQueueFamilyProperties *queue_family, uint32_t queue_family_index);
 char *get_device_type_string(enum VkPhysicalDeviceType device_type);
+char *get_result_string(VkResult result);
 char *get_present_mode_string(enum VkPresentModeKHR present_mode);
 char *get_color_format_string(VkFormat color_format);
 char *get_color_space_string(VkColorSpaceKHR color_space);
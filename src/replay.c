@@ -0,0 +1,271 @@
+// vg_replay: replays a scene trace headlessly, as fast as the gpu allows,
+// and reports cpu recording and gpu execution time for every frame.
+//
+//   vg_replay trace.vgt [--repeat n] [--capture out.y4m] [--render-pass] [--cpu-cull] [--float-vertices] [--lod-bias x]
+
+#define _POSIX_C_SOURCE 200809L // clock_gettime
+
+#include <vulkan/vulkan.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+
+#include "render.h"
+#include "scene.h"
+#include "trace.h"
+#include "capture.h"
+#include "timer.h"
+#include "track.h"
+#include "context.h"
+
+#define REPLAY_FORMAT VK_FORMAT_R8G8B8A8_UNORM
+
+static double now_ms(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static int compare_double(const void *a, const void *b)
+{
+	double x = *(const double *) a;
+	double y = *(const double *) b;
+
+	return (x > y) - (x < y);
+}
+
+static void print_timings(const char *name, double *times, uint32_t count)
+{
+	if (count == 0 || times[0] < 0.0) return;
+
+	double sum = 0.0;
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		sum += times[i];
+	}
+
+	qsort(times, count, sizeof(double), compare_double);
+
+	printf("%s ms: min %.3f, avg %.3f, p50 %.3f, p95 %.3f, max %.3f\n", name, times[0], sum / count, times[count / 2], times[(uint32_t) (count * 0.95)], times[count - 1]);
+}
+
+int main(int argc, char **argv)
+{
+	const char *trace_path = NULL;
+	const char *capture_path = NULL;
+	uint32_t repeat = 1;
+	bool dynamic_rendering_enabled = true;
+	bool gpu_driven_enabled = true;
+	enum VertexLayout vertex_layout = VERTEX_LAYOUT_COMPACT;
+	float lod_bias = 0.0f;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) repeat = (uint32_t) atoi(argv[++i]);
+		else if (strcmp(argv[i], "--capture") == 0 && i + 1 < argc) capture_path = argv[++i];
+		else if (strcmp(argv[i], "--render-pass") == 0) dynamic_rendering_enabled = false;
+		else if (strcmp(argv[i], "--cpu-cull") == 0) gpu_driven_enabled = false;
+		else if (strcmp(argv[i], "--float-vertices") == 0) vertex_layout = VERTEX_LAYOUT_FLOAT;
+		else if (strcmp(argv[i], "--lod-bias") == 0 && i + 1 < argc) lod_bias = (float) atof(argv[++i]);
+		else trace_path = argv[i];
+	}
+
+	if (trace_path == NULL) {
+		printf("usage: vg_replay trace.vgt [--repeat n] [--capture out.y4m] [--render-pass] [--cpu-cull] [--float-vertices] [--lod-bias x]\n");
+		return EXIT_FAILURE;
+	}
+
+	struct TraceReader reader;
+	if (!open_trace_reader(trace_path, &reader)) return EXIT_FAILURE;
+
+	VkExtent2D extent = {reader.header->width, reader.header->height};
+	uint32_t frame_count = reader.header->frame_count;
+
+	// headless, no window, surface or swapchain; the graphics queue does everything
+
+	struct RenderContextInfo contextInfo = {
+		.presentable = false,
+		.validation_layers_enabled = false,
+		.dynamic_rendering_enabled = dynamic_rendering_enabled,
+		.cpu_fallback_enabled = true, // slow, but still a check that the trace replays
+		.device_pinned = false,
+		.device_index = 0,
+		.validation_layer_count = 0,
+		.validation_layers = NULL,
+		.device_extension_count = 0,
+		.device_extensions = NULL,
+	};
+
+	struct RenderContext context;
+
+	if (create_render_context(&context, &contextInfo) != VK_SUCCESS) {
+		print_render_error(&context.error);
+		close_trace_reader(&reader);
+		return EXIT_FAILURE;
+	}
+
+	VkPhysicalDevice physicalDevice = context.physical_device;
+	struct QueueFamilyIndices indices = context.indices;
+	struct DeviceFeatures deviceFeatures = context.features;
+	VkDevice device = context.device;
+	VkQueue graphicsQueue = context.graphics_queue;
+
+	// the first failure of a helper stops the replay, timings with a piece missing are worthless
+	struct RenderError error = {0};
+	watch_render_errors(&error);
+
+	VkCommandPool commandPool = create_command_pool(device, indices);
+	VkCommandBuffer commandBuffer = create_command_buffer(device, commandPool);
+	VkFence fence = create_fence(device);
+
+	struct Image target = create_image(physicalDevice, device, extent, REPLAY_FORMAT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+
+	struct FrameCapture frameCapture = {0};
+
+	if (capture_path != NULL) {
+		frameCapture = create_frame_capture(physicalDevice, device, extent, REPLAY_FORMAT, CAPTURE_FORMAT_Y4M, capture_path, 60, 3);
+	}
+
+	struct SceneSetup setup = trace_setup(&reader);
+	setup.vertex_layout = vertex_layout;
+	setup.image_lod_bias = lod_bias;
+	struct SceneRenderer *scene = create_scene_renderer(physicalDevice, device, commandPool, graphicsQueue, context.pipeline_cache, &deviceFeatures, extent, REPLAY_FORMAT, GRAPH_ACCESS_NONE, GRAPH_ACCESS_COLOR_ATTACHMENT, gpu_driven_enabled, &setup, capture_path != NULL ? &frameCapture : NULL);
+
+	VkFramebuffer *framebuffer = NULL;
+	if (scene->render_pass != VK_NULL_HANDLE) framebuffer = create_swapchain_framebuffer(device, &target.view, 1, scene->stencil_view, scene->render_pass, extent);
+
+	struct GpuTimer timer = create_gpu_timer(physicalDevice, device, 2);
+
+	uint32_t total = frame_count * repeat;
+	double *cpuTimes = malloc(total * sizeof(double));
+	double *gpuTimes = malloc(total * sizeof(double));
+
+	struct SceneFrame *frame = malloc(sizeof(struct SceneFrame));
+
+	printf("frame,cpu_ms,gpu_ms\n");
+
+	double start = now_ms();
+	uint32_t replayed = 0;
+
+	for (uint32_t n = 0; n < total && error.result == VK_SUCCESS; n++)
+	{
+		if (!read_trace_frame(&reader, n % frame_count, frame)) break;
+
+		vkResetFences(device, 1, &fence);
+		vkResetCommandBuffer(commandBuffer, 0);
+
+		double record_start = now_ms();
+
+		VkCommandBufferBeginInfo beginInfo = {
+			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+			.pNext = NULL,
+			.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+			.pInheritanceInfo = NULL,
+		};
+
+		VkResult result = vkBeginCommandBuffer(commandBuffer, &beginInfo);
+		if (result != VK_SUCCESS) report_render_failure(result, "begin recording command buffer");
+
+		reset_gpu_timer(commandBuffer, &timer, 0, 2);
+		write_gpu_timestamp(commandBuffer, &timer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0);
+
+		record_scene_frame(commandBuffer, scene, frame, n, target.image, target.view, framebuffer != NULL ? framebuffer[0] : VK_NULL_HANDLE);
+
+		write_gpu_timestamp(commandBuffer, &timer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 1);
+
+		result = vkEndCommandBuffer(commandBuffer);
+		if (result != VK_SUCCESS) report_render_failure(result, "record command buffer");
+
+		cpuTimes[n] = now_ms() - record_start;
+
+		if (error.result != VK_SUCCESS) break;
+
+		VkSubmitInfo submitInfo = {
+			.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+			.pNext = NULL,
+			.waitSemaphoreCount = 0,
+			.pWaitSemaphores = NULL,
+			.pWaitDstStageMask = NULL,
+			.commandBufferCount = 1,
+			.pCommandBuffers = &commandBuffer,
+			.signalSemaphoreCount = 0,
+			.pSignalSemaphores = NULL,
+		};
+
+		// a failed submit never signals the fence, the replay stops with the error instead of waiting on it
+		result = vkQueueSubmit(graphicsQueue, 1, &submitInfo, fence);
+		if (result != VK_SUCCESS) {
+			report_render_failure(result, "submit replay command buffer");
+			break;
+		}
+
+		if (capture_path != NULL) confirm_frame_capture(&frameCapture);
+
+		// one frame in flight, the uniform ring slot and culling buffers are reused next frame
+		result = vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
+		if (result != VK_SUCCESS) {
+			report_render_failure(result, "wait for replay frame");
+			break;
+		}
+
+		gpuTimes[n] = read_gpu_elapsed(device, &timer, 0);
+		if (capture_path != NULL) poll_frame_capture(device, &frameCapture);
+
+		printf("%u,%.3f,%.3f\n", n, cpuTimes[n], gpuTimes[n]);
+		replayed++;
+	}
+
+	double elapsed = now_ms() - start;
+
+	watch_render_errors(NULL);
+	print_render_error(&error);
+
+	vkDeviceWaitIdle(device);
+
+	printf("replayed %u frames in %.1f ms, %.1f fps\n", replayed, elapsed, replayed > 0 ? replayed * 1000.0 / elapsed : 0.0);
+	print_timings("cpu", cpuTimes, replayed);
+	print_timings("gpu", gpuTimes, replayed);
+	print_scene_stats(scene);
+
+	// cleanup
+
+	if (capture_path != NULL) {
+		finish_frame_capture(device, &frameCapture);
+		destroy_frame_capture(device, &frameCapture);
+	}
+
+	free(frame);
+	free(gpuTimes);
+	free(cpuTimes);
+
+	destroy_gpu_timer(device, &timer);
+
+	if (framebuffer != NULL) {
+		untrack_resource(RESOURCE_FRAMEBUFFER, framebuffer[0]);
+		vkDestroyFramebuffer(device, framebuffer[0], NULL);
+		free(framebuffer);
+	}
+
+	destroy_scene_renderer(scene);
+	destroy_image(device, &target);
+
+	untrack_resource(RESOURCE_FENCE, fence);
+	vkDestroyFence(device, fence, NULL);
+	untrack_resource(RESOURCE_COMMAND_POOL, commandPool);
+	vkDestroyCommandPool(device, commandPool, NULL);
+
+	destroy_render_context(&context);
+
+	report_resource_leaks();
+
+	close_trace_reader(&reader);
+
+	return error.result == VK_SUCCESS ? EXIT_SUCCESS : EXIT_FAILURE;
+}
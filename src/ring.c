@@ -0,0 +1,142 @@
+#include <vulkan/vulkan.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "render.h"
+#include "ring.h"
+#include "track.h"
+
+static VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment)
+{
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+struct UniformRing create_uniform_ring(VkPhysicalDevice physical_device, VkDevice device, VkDeviceSize frame_size, VkDeviceSize block_size, VkShaderStageFlags stages)
+{
+	struct UniformRing ring = {0};
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physical_device, &properties);
+
+	ring.alignment = properties.limits.minUniformBufferOffsetAlignment;
+	if (ring.alignment == 0) ring.alignment = 1;
+
+	ring.block_size = align_up(block_size, ring.alignment);
+	ring.frame_size = align_up(frame_size > ring.block_size ? frame_size : ring.block_size, ring.alignment);
+	ring.frame = 0;
+	ring.head = 0;
+
+	if (ring.block_size > properties.limits.maxUniformBufferRange) printf("uniform ring block larger than maxUniformBufferRange\n");
+
+	ring.buffer = create_buffer(physical_device, device, ring.frame_size * UNIFORM_RING_FRAMES, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+	VkDescriptorSetLayoutBinding binding = {
+		.binding = 0,
+		.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+		.descriptorCount = 1,
+		.stageFlags = stages,
+		.pImmutableSamplers = NULL,
+	};
+
+	VkDescriptorSetLayoutCreateInfo set_layout_info = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+		.pNext = NULL,
+		.flags = 0,
+		.bindingCount = 1,
+		.pBindings = &binding,
+	};
+
+	VkResult result = vkCreateDescriptorSetLayout(device, &set_layout_info, NULL, &ring.set_layout);
+	if (result != VK_SUCCESS) printf("failed to create uniform ring descriptor set layout\n");
+	if (result == VK_SUCCESS) track_resource(RESOURCE_DESCRIPTOR_SET_LAYOUT, ring.set_layout, 0);
+
+	VkDescriptorPoolSize pool_size = {
+		.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+		.descriptorCount = 1,
+	};
+
+	VkDescriptorPoolCreateInfo pool_info = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+		.pNext = NULL,
+		.flags = 0,
+		.maxSets = 1,
+		.poolSizeCount = 1,
+		.pPoolSizes = &pool_size,
+	};
+
+	result = vkCreateDescriptorPool(device, &pool_info, NULL, &ring.descriptor_pool);
+	if (result != VK_SUCCESS) printf("failed to create uniform ring descriptor pool\n");
+	if (result == VK_SUCCESS) track_resource(RESOURCE_DESCRIPTOR_POOL, ring.descriptor_pool, 0);
+
+	VkDescriptorSetAllocateInfo allocate_info = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+		.pNext = NULL,
+		.descriptorPool = ring.descriptor_pool,
+		.descriptorSetCount = 1,
+		.pSetLayouts = &ring.set_layout,
+	};
+
+	result = vkAllocateDescriptorSets(device, &allocate_info, &ring.descriptor_set);
+	if (result != VK_SUCCESS) printf("failed to allocate uniform ring descriptor set\n");
+
+	// written once, the dynamic offset picks the block at bind time
+
+	VkDescriptorBufferInfo buffer_info = {
+		.buffer = ring.buffer.buffer,
+		.offset = 0,
+		.range = ring.block_size,
+	};
+
+	VkWriteDescriptorSet write = {
+		.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+		.pNext = NULL,
+		.dstSet = ring.descriptor_set,
+		.dstBinding = 0,
+		.dstArrayElement = 0,
+		.descriptorCount = 1,
+		.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+		.pImageInfo = NULL,
+		.pBufferInfo = &buffer_info,
+		.pTexelBufferView = NULL,
+	};
+
+	vkUpdateDescriptorSets(device, 1, &write, 0, NULL);
+
+	return ring;
+}
+
+void destroy_uniform_ring(VkDevice device, struct UniformRing *ring)
+{
+	untrack_resource(RESOURCE_DESCRIPTOR_POOL, ring->descriptor_pool);
+	vkDestroyDescriptorPool(device, ring->descriptor_pool, NULL);
+	untrack_resource(RESOURCE_DESCRIPTOR_SET_LAYOUT, ring->set_layout);
+	vkDestroyDescriptorSetLayout(device, ring->set_layout, NULL);
+
+	destroy_buffer(device, &ring->buffer);
+}
+
+void begin_uniform_ring_frame(struct UniformRing *ring, uint64_t frame_index)
+{
+	ring->frame = (uint32_t) (frame_index % UNIFORM_RING_FRAMES);
+	ring->head = 0;
+}
+
+uint32_t push_uniforms(struct UniformRing *ring, const void *data, VkDeviceSize size)
+{
+	if (size > ring->block_size || ring->head + ring->block_size > ring->frame_size) {
+		printf("uniform ring frame is full\n");
+		return UNIFORM_RING_FULL;
+	}
+
+	VkDeviceSize offset = ring->frame * ring->frame_size + ring->head;
+
+	memcpy((char *) ring->buffer.mapped + offset, data, size);
+
+	ring->head += align_up(size, ring->alignment);
+
+	return (uint32_t) offset;
+}
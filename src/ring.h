@@ -0,0 +1,35 @@
+#pragma once
+
+#include "render.h"
+
+// Per-frame uniform data in one persistently mapped buffer. Each frame slot
+// owns a fixed sub-range that is filled front to back; a single descriptor set
+// with a UNIFORM_BUFFER_DYNAMIC binding covers every block, so drawing with
+// new data is one memcpy and a dynamic offset, never a descriptor update.
+
+// more slots than frames in flight, a slot is only rewritten once the gpu is done with it
+#define UNIFORM_RING_FRAMES 2
+#define UNIFORM_RING_FULL UINT32_MAX
+
+struct UniformRing {
+	struct Buffer buffer;
+
+	VkDeviceSize alignment;   // minUniformBufferOffsetAlignment
+	VkDeviceSize block_size;  // largest block one push may write, the descriptor range
+	VkDeviceSize frame_size;  // bytes per frame slot
+	uint32_t frame;           // current slot
+	VkDeviceSize head;        // bytes used in the current slot
+
+	VkDescriptorSetLayout set_layout;
+	VkDescriptorPool descriptor_pool;
+	VkDescriptorSet descriptor_set;
+};
+
+struct UniformRing create_uniform_ring(VkPhysicalDevice physical_device, VkDevice device, VkDeviceSize frame_size, VkDeviceSize block_size, VkShaderStageFlags stages);
+void destroy_uniform_ring(VkDevice device, struct UniformRing *ring);
+
+// moves to the slot for frame_index and forgets what it held
+void begin_uniform_ring_frame(struct UniformRing *ring, uint64_t frame_index);
+
+// copies data into the current slot, returns the dynamic offset or UNIFORM_RING_FULL
+uint32_t push_uniforms(struct UniformRing *ring, const void *data, VkDeviceSize size);
@@ -0,0 +1,850 @@
+#include <vulkan/vulkan.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+#include <math.h>
+
+#include "render.h"
+#include "scene.h"
+#include "context.h"
+#include "track.h"
+
+static int compare_uint32(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t *) a;
+	uint32_t y = *(const uint32_t *) b;
+
+	return (x > y) - (x < y);
+}
+
+static void record_capture_pass(VkCommandBuffer command_buffer, void *user_data)
+{
+	struct SceneRenderer *scene = user_data;
+
+	record_frame_capture(command_buffer, scene->device, scene->capture, scene->target_view);
+}
+
+static void record_upload_pass(VkCommandBuffer command_buffer, void *user_data)
+{
+	struct SceneRenderer *scene = user_data;
+
+	record_texture_uploads(command_buffer, scene->loader, scene->frame_index);
+	record_paint_uploads(command_buffer, scene->paint);
+}
+
+static void record_filter_pass(VkCommandBuffer command_buffer, void *user_data)
+{
+	struct SceneRenderer *scene = user_data;
+
+	// a layer that failed is drawn without, the panel goes without its shadow
+	if (!scene->shadow_layer.usable) return;
+
+	// the panel shape only has to be drawn when it changes, the blur is cached with it
+
+	if (!scene->shadow_drawn) {
+		begin_filter_layer(command_buffer, &scene->filter_system, &scene->shadow_layer);
+
+		VkClearAttachment shape = {
+			.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+			.colorAttachment = 0,
+			.clearValue = {{{1.0f, 1.0f, 1.0f, 1.0f}}},
+		};
+
+		VkClearRect shape_rect = {
+			.rect = {
+				.offset = {SCENE_SHADOW_PADDING, SCENE_SHADOW_PADDING},
+				.extent = {(uint32_t) scene->panel_size[0], (uint32_t) scene->panel_size[1]},
+			},
+			.baseArrayLayer = 0,
+			.layerCount = 1,
+		};
+
+		vkCmdClearAttachments(command_buffer, 1, &shape, 1, &shape_rect);
+
+		end_filter_layer(command_buffer, &scene->filter_system, &scene->shadow_layer);
+
+		scene->shadow_drawn = true;
+	}
+
+	record_filter_layer(command_buffer, &scene->filter_system, &scene->shadow_layer);
+}
+
+static void record_lines_pass(VkCommandBuffer command_buffer, void *user_data)
+{
+	struct SceneRenderer *scene = user_data;
+
+	record_lines(command_buffer, scene->lines);
+}
+
+static void record_cull_pass(VkCommandBuffer command_buffer, void *user_data)
+{
+	struct SceneRenderer *scene = user_data;
+
+	if (scene->gpu_driven) {
+		record_indirect_cull(command_buffer, &scene->indirect_renderer, scene->frame->view);
+		return;
+	}
+
+	struct ClipRect view = scene->frame->view;
+	struct Aabb box = {view.x0, view.y0, view.x1, view.y1};
+
+	// the tree narrows the sprites down to those near the view, by their fattened boxes; the clip
+	// kernel then tests the exact bounds of those few at once
+
+	uint32_t count = scene->sprite_count;
+	uint32_t *candidates = scene->visible_sprites;
+
+	uint32_t candidate_count = spatial_query_candidates(&scene->sprite_tree, box, candidates, count);
+	if (candidate_count > count) candidate_count = count;
+
+	// the tree returns hits in arbitrary order, painter's order needs them sorted
+	qsort(candidates, candidate_count, sizeof(uint32_t), compare_uint32);
+
+	const float *bounds = scene->sprite_bounds;
+	float *gathered = scene->candidate_bounds;
+
+	for (uint32_t i = 0; i < candidate_count; i++)
+	{
+		uint32_t sprite = candidates[i];
+
+		gathered[i] = bounds[sprite];
+		gathered[count + i] = bounds[count + sprite];
+		gathered[2 * count + i] = bounds[2 * count + sprite];
+		gathered[3 * count + i] = bounds[3 * count + sprite];
+	}
+
+	uint32_t *hits = scene->candidate_hits;
+	uint32_t visible_count = get_geometry_kernels()->clip(gathered, gathered + count, gathered + 2 * count, gathered + 3 * count, candidate_count, box, hits);
+
+	// sprite indices go straight into the upload buffer, written in order
+	uint32_t *visible = scene->indirect_renderer.host_visible_buffer.mapped;
+
+	for (uint32_t i = 0; i < visible_count; i++)
+	{
+		visible[i] = candidates[hits[i]];
+	}
+
+	record_indirect_visible(command_buffer, &scene->indirect_renderer, visible, visible_count);
+}
+
+// a ring of SCENE_RING_SEGMENTS quads with the hue going once around it
+static struct Mesh create_ring_mesh(VkPhysicalDevice physical_device, VkDevice device, VkCommandPool command_pool, VkQueue queue, enum VertexLayout layout, float center_x, float center_y, float inner, float outer)
+{
+	uint32_t vertex_count = 2 * (SCENE_RING_SEGMENTS + 1);
+	uint32_t index_count = 6 * SCENE_RING_SEGMENTS;
+
+	struct Vertex *vertices = malloc(vertex_count * sizeof(struct Vertex));
+	uint32_t *indices = malloc(index_count * sizeof(uint32_t));
+
+	for (uint32_t i = 0; i <= SCENE_RING_SEGMENTS; i++)
+	{
+		float u = (float) i / SCENE_RING_SEGMENTS;
+		float angle = 6.2831853f * u;
+		float c = cosf(angle);
+		float s = sinf(angle);
+
+		float color[4] = {
+			0.5f + 0.5f * cosf(angle),
+			0.5f + 0.5f * cosf(angle - 2.0943951f),
+			0.5f + 0.5f * cosf(angle + 2.0943951f),
+			1.0f,
+		};
+
+		vertices[2 * i] = (struct Vertex) {
+			.position = {center_x + c * inner, center_y + s * inner},
+			.uv = {u, 0.0f},
+			.color = {color[0], color[1], color[2], color[3]},
+		};
+
+		vertices[2 * i + 1] = (struct Vertex) {
+			.position = {center_x + c * outer, center_y + s * outer},
+			.uv = {u, 1.0f},
+			.color = {color[0], color[1], color[2], color[3]},
+		};
+	}
+
+	for (uint32_t i = 0; i < SCENE_RING_SEGMENTS; i++)
+	{
+		uint32_t v = 2 * i;
+		uint32_t quad[6] = {v, v + 1, v + 2, v + 2, v + 1, v + 3};
+
+		memcpy(&indices[6 * i], quad, sizeof(quad));
+	}
+
+	struct Mesh mesh = create_mesh(physical_device, device, command_pool, queue, layout, vertices, vertex_count, indices, index_count);
+
+	free(indices);
+	free(vertices);
+
+	return mesh;
+}
+
+// clear rects have to stay inside the render area
+static bool clip_rect(VkExtent2D extent, float x, float y, float width, float height, VkRect2D *rect)
+{
+	float x0 = x < 0.0f ? 0.0f : x;
+	float y0 = y < 0.0f ? 0.0f : y;
+	float x1 = x + width > extent.width ? extent.width : x + width;
+	float y1 = y + height > extent.height ? extent.height : y + height;
+
+	if (x1 <= x0 || y1 <= y0) return false;
+
+	rect->offset = (VkOffset2D) {(int32_t) x0, (int32_t) y0};
+	rect->extent = (VkExtent2D) {(uint32_t) (x1 - x0), (uint32_t) (y1 - y0)};
+
+	return true;
+}
+
+static void record_panel_image(VkCommandBuffer command_buffer, struct SceneRenderer *scene)
+{
+	const struct SceneFrame *frame = scene->frame;
+
+	struct PipelineState state = {
+		.render_pass = scene->render_pass,
+		.color_format = scene->color_format,
+		.stencil_format = scene->stencil_format,
+		.stencil = STENCIL_MODE_CLIP_TEST,
+		.blend = BLEND_MODE_PREMULTIPLIED,
+		.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP,
+		.samples = VK_SAMPLE_COUNT_1_BIT,
+		.vertex_layout = VERTEX_LAYOUT_NONE,
+	};
+
+	struct PipelineKey key = make_pipeline_key(scene->image_program, &state);
+	VkDescriptorSet set = get_texture_set(scene->loader, scene->panel_image);
+
+	float x0 = frame->panel_position[0] + SCENE_IMAGE_INSET;
+	float y0 = frame->panel_position[1] + SCENE_IMAGE_INSET;
+	float x1 = frame->panel_position[0] + scene->panel_size[0] - SCENE_IMAGE_INSET;
+	float y1 = frame->panel_position[1] + scene->panel_size[1] - SCENE_IMAGE_INSET;
+
+	if (x1 <= x0 || y1 <= y0) return;
+
+	// only the levels the image is drawn at stay resident
+	request_texture_size(scene->loader, scene->panel_image, x1 - x0, y1 - y0);
+
+	float push[8] = {
+		2.0f * x0 / scene->extent.width - 1.0f,
+		2.0f * y0 / scene->extent.height - 1.0f,
+		2.0f * x1 / scene->extent.width - 1.0f,
+		2.0f * y1 / scene->extent.height - 1.0f,
+		1.0f, 1.0f, 1.0f, 1.0f,
+	};
+
+	VkPipeline pipeline = get_pipeline(scene->pipelines, &key);
+	if (pipeline == VK_NULL_HANDLE) return;
+
+	vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+	vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, scene->image_layout, 0, 1, &set, 0, NULL);
+	vkCmdPushConstants(command_buffer, scene->image_layout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(push), push);
+	vkCmdDraw(command_buffer, 4, 1, 0, 0);
+}
+
+// moves the clip stack to the chain of clips from the outermost down to clip, keeping what the
+// current chain shares with it; rect clips on the way only cut the scissor for the stencil shapes
+static void enter_scene_clip(VkCommandBuffer command_buffer, struct SceneRenderer *scene, uint32_t clip)
+{
+	const struct SceneFrame *frame = scene->frame;
+
+	uint32_t chain[CLIP_MAX_DEPTH];
+	uint32_t length = 0;
+
+	for (uint32_t i = clip; i < frame->clip_count && i < SCENE_MAX_CLIPS && length < CLIP_MAX_DEPTH; i = frame->clips[i].parent < i ? frame->clips[i].parent : SCENE_NO_CLIP)
+	{
+		chain[length++] = i;
+	}
+
+	// outermost first
+	for (uint32_t i = 0; i < length / 2; i++)
+	{
+		uint32_t swap = chain[i];
+		chain[i] = chain[length - 1 - i];
+		chain[length - 1 - i] = swap;
+	}
+
+	uint32_t shared = 0;
+	while (shared < length && shared < scene->clip_path_length && chain[shared] == scene->clip_path[shared]) shared++;
+
+	pop_clips_to(command_buffer, scene->clips, shared);
+
+	for (uint32_t i = shared; i < length; i++)
+	{
+		const struct SceneClip *entry = &frame->clips[chain[i]];
+
+		push_clip_rounded_rect(command_buffer, scene->clips, entry->rect, entry->radius);
+		scene->clip_path[i] = chain[i];
+	}
+
+	scene->clip_path_length = length;
+
+	apply_clip(command_buffer, scene->clips);
+}
+
+static void record_main_pass(VkCommandBuffer command_buffer, void *user_data)
+{
+	struct SceneRenderer *scene = user_data;
+	const struct SceneFrame *frame = scene->frame;
+
+	VkClearColorValue clear_color = {{0.0f, 0.0f, 0.0f, 1.0f}};
+
+	if (scene->features->dynamic_rendering) {
+		begin_dynamic_rendering(scene->features, command_buffer, scene->target_view, scene->stencil_view, scene->extent, clear_color);
+	}
+	else {
+		VkOffset2D offset = {
+			.x = 0,
+			.y = 0,
+		};
+
+		VkRect2D renderArea = {
+			.offset = offset,
+			.extent = scene->extent,
+		};
+
+		VkClearValue clear_values[2] = {
+			{.color = clear_color},
+			{.depthStencil = {1.0f, 0}},
+		};
+
+		VkRenderPassBeginInfo renderPassInfo = {
+			.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+			.pNext = NULL,
+			.renderPass = scene->render_pass,
+			.framebuffer = scene->framebuffer,
+			.renderArea = renderArea,
+			.clearValueCount = scene->stencil_format != VK_FORMAT_UNDEFINED ? 2 : 1,
+			.pClearValues = clear_values,
+		};
+
+		vkCmdBeginRenderPass(command_buffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+	}
+
+	// every pipeline tests the clip depth in the stencil and takes its scissor from the clip stack
+	struct PipelineState state = {
+		.render_pass = scene->render_pass,
+		.color_format = scene->color_format,
+		.stencil_format = scene->stencil_format,
+		.stencil = STENCIL_MODE_CLIP_TEST,
+		.blend = BLEND_MODE_NONE,
+		.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+		.samples = VK_SAMPLE_COUNT_1_BIT,
+		.vertex_layout = VERTEX_LAYOUT_NONE,
+	};
+
+	float view[4] = {frame->view.x0, frame->view.y0, 2.0f / scene->extent.width, 2.0f / scene->extent.height};
+
+	begin_clip_pass(command_buffer, scene->clips, scene->frame_index, &state, scene->extent, view);
+	scene->clip_path_length = 0;
+
+	record_indirect_draw(command_buffer, &scene->indirect_renderer, frame->view);
+
+	// camera and time come from the ring at a dynamic offset, each triangle only pushes its transform;
+	// the draw list groups them by pipeline and skips binds that would not change anything
+
+	reset_draw_list(&scene->draw_list);
+
+	// the ring mesh goes under the triangles, its vertices are fetched in the scene's vertex layout
+
+	struct PipelineState ring_state = state;
+	ring_state.vertex_layout = scene->ring.layout;
+	struct PipelineKey ring_key = make_pipeline_key(scene->mesh_program, &ring_state);
+
+	struct DrawCommand ring = {
+		.layer = 0,
+		.blended = false,
+		.depth = 0,
+		.pipeline = get_pipeline(scene->pipelines, &ring_key),
+		.layout = scene->triangle_layout,
+		.set = scene->uniform_ring.descriptor_set,
+		.dynamic_offset_count = 1,
+		.dynamic_offset = scene->uniforms_offset,
+		.vertex_buffer = scene->ring.vertex_buffer.buffer,
+		.vertex_offset = 0,
+		.index_buffer = scene->ring.index_buffer.buffer,
+		.index_offset = 0,
+		.index_type = scene->ring.index_type,
+		.vertex_count = 0,
+		.first_vertex = 0,
+		.index_count = scene->ring.index_count,
+		.first_index = 0,
+		.base_vertex = 0,
+		.instance_count = 1,
+		.first_instance = 0,
+		.vertex_mergeable = true,
+		.push_stages = VK_SHADER_STAGE_VERTEX_BIT,
+		.push_size = sizeof(scene->ring.tile),
+	};
+	memcpy(ring.push, scene->ring.tile, sizeof(scene->ring.tile));
+
+	push_draw(&scene->draw_list, &ring);
+
+	// the live feed, one draw per segment of its buffer
+	struct PipelineState stream_state = state;
+	stream_state.topology = VK_PRIMITIVE_TOPOLOGY_LINE_STRIP;
+	stream_state.vertex_layout = VERTEX_LAYOUT_FLOAT;
+	struct PipelineKey stream_key = make_pipeline_key(scene->mesh_program, &stream_state);
+
+	struct DrawCommand stream = {
+		.layer = 0,
+		.blended = false,
+		.depth = 0,
+		.pipeline = get_pipeline(scene->pipelines, &stream_key),
+		.layout = scene->triangle_layout,
+		.set = scene->uniform_ring.descriptor_set,
+		.dynamic_offset_count = 1,
+		.dynamic_offset = scene->uniforms_offset,
+		.vertex_buffer = VK_NULL_HANDLE,
+		.vertex_offset = 0,
+		.index_buffer = VK_NULL_HANDLE,
+		.index_offset = 0,
+		.index_type = VK_INDEX_TYPE_UINT16,
+		.vertex_count = 0,
+		.first_vertex = 0,
+		.index_count = 0,
+		.first_index = 0,
+		.base_vertex = 0,
+		.instance_count = 1,
+		.first_instance = 0,
+		.vertex_mergeable = false,
+		.push_stages = VK_SHADER_STAGE_VERTEX_BIT,
+		.push_size = sizeof(frame->stream_tile),
+	};
+	memcpy(stream.push, frame->stream_tile, sizeof(frame->stream_tile));
+
+	push_stream_draws(scene->stream, &scene->draw_list, &stream);
+
+	for (uint32_t i = 0; i < frame->triangle_count && i < SCENE_MAX_TRIANGLES; i++)
+	{
+		const struct SceneTriangle *triangle = &frame->triangles[i];
+
+		state.blend = triangle->blend < BLEND_MODE_COUNT ? (enum BlendMode) triangle->blend : BLEND_MODE_NONE;
+		struct PipelineKey key = make_pipeline_key(scene->triangle_program, &state);
+
+		struct DrawCommand draw = {
+			.layer = 1,
+			.blended = state.blend != BLEND_MODE_NONE,
+			.depth = 0,
+			.pipeline = get_pipeline(scene->pipelines, &key),
+			.layout = scene->triangle_layout,
+			.set = scene->uniform_ring.descriptor_set,
+			.dynamic_offset_count = 1,
+			.dynamic_offset = scene->uniforms_offset,
+			.vertex_buffer = VK_NULL_HANDLE,
+			.vertex_offset = 0,
+			.index_buffer = VK_NULL_HANDLE,
+			.index_offset = 0,
+			.index_type = VK_INDEX_TYPE_UINT16,
+			.vertex_count = 3,
+			.first_vertex = 0,
+			.index_count = 0,
+			.first_index = 0,
+			.base_vertex = 0,
+			.instance_count = 1,
+			.first_instance = 0,
+			.vertex_mergeable = true,
+			.push_stages = VK_SHADER_STAGE_VERTEX_BIT,
+			.push_size = sizeof(triangle->transform),
+		};
+		memcpy(draw.push, triangle->transform, sizeof(triangle->transform));
+
+		push_draw(&scene->draw_list, &draw);
+	}
+
+	record_draw_list(command_buffer, &scene->draw_list);
+
+	// gradient and pattern shapes, instanced in a few draws; only a change of rounded clip splits them,
+	// and leaves the stencil alone where consecutive runs share clips
+
+	struct PipelineState paint_state = state;
+	paint_state.blend = BLEND_MODE_PREMULTIPLIED;
+	paint_state.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP;
+	struct PipelineKey paint_key = make_pipeline_key(scene->paint_program, &paint_state);
+	VkPipeline paint_pipeline = get_pipeline(scene->pipelines, &paint_key);
+
+	for (uint32_t i = 0; i < scene->clip_run_count; i++)
+	{
+		const struct SceneClipRun *run = &scene->clip_runs[i];
+
+		enter_scene_clip(command_buffer, scene, run->clip);
+		record_paints(command_buffer, scene->paint, paint_pipeline, scene->loader, view, run->first, run->count);
+	}
+
+	enter_scene_clip(command_buffer, scene, SCENE_NO_CLIP);
+
+	// polylines over the shapes, already rasterized by the lines pass
+	record_line_composite(command_buffer, scene->lines, &state);
+
+	// drop shadow under the panel, then the panel itself
+
+	float shadow_rect[4] = {
+		frame->panel_position[0] - SCENE_SHADOW_PADDING + 8.0f,
+		frame->panel_position[1] - SCENE_SHADOW_PADDING + 8.0f,
+		scene->panel_size[0] + 2.0f * SCENE_SHADOW_PADDING,
+		scene->panel_size[1] + 2.0f * SCENE_SHADOW_PADDING,
+	};
+	float shadow_color[4] = {0.0f, 0.0f, 0.0f, 0.6f};
+
+	record_filter_composite(command_buffer, &scene->filter_system, &scene->shadow_layer, scene->extent, shadow_rect, shadow_color);
+
+	VkClearAttachment panel = {
+		.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+		.colorAttachment = 0,
+		.clearValue = {{{frame->panel_color[0], frame->panel_color[1], frame->panel_color[2], frame->panel_color[3]}}},
+	};
+
+	VkClearRect panel_rect = {
+		.baseArrayLayer = 0,
+		.layerCount = 1,
+	};
+
+	if (clip_rect(scene->extent, frame->panel_position[0], frame->panel_position[1], scene->panel_size[0], scene->panel_size[1], &panel_rect.rect)) {
+		vkCmdClearAttachments(command_buffer, 1, &panel, 1, &panel_rect);
+	}
+
+	// the panel image, a placeholder until the loader has it
+	if (scene->panel_image != LOADER_NO_TEXTURE) {
+		record_panel_image(command_buffer, scene);
+	}
+
+	if (scene->features->dynamic_rendering) {
+		end_dynamic_rendering(scene->features, command_buffer);
+	}
+	else {
+		vkCmdEndRenderPass(command_buffer);
+	}
+}
+
+struct SceneRenderer *create_scene_renderer(VkPhysicalDevice physical_device, VkDevice device, VkCommandPool command_pool, VkQueue queue, VkPipelineCache pipeline_cache, const struct DeviceFeatures *features, VkExtent2D extent, VkFormat color_format, enum GraphAccess target_initial, enum GraphAccess target_final, bool gpu_driven, const struct SceneSetup *setup, struct FrameCapture *capture)
+{
+	struct SceneRenderer *scene = calloc(1, sizeof(struct SceneRenderer));
+
+	scene->device = device;
+	scene->features = features;
+	scene->gpu_driven = gpu_driven;
+	scene->extent = extent;
+	scene->color_format = color_format;
+	scene->capture = capture;
+
+	// rounded clips count their nesting in the stencil
+	scene->stencil_format = find_stencil_format(physical_device);
+	if (scene->stencil_format == VK_FORMAT_UNDEFINED) printf("failed to find a stencil format, rounded clips stop at their bounds\n");
+
+	// dynamic rendering records straight against the image views, no render pass or framebuffers
+	scene->render_pass = features->dynamic_rendering ? VK_NULL_HANDLE : create_render_pass(device, color_format, scene->stencil_format);
+
+	scene->uniform_ring = create_uniform_ring(physical_device, device, 4096, sizeof(struct SceneUniforms), VK_SHADER_STAGE_VERTEX_BIT);
+	scene->triangle_layout = create_pipeline_layout(device, 1, &scene->uniform_ring.set_layout, VK_SHADER_STAGE_VERTEX_BIT, 4 * sizeof(float));
+
+	// pipelines are built on first use from the render state of each draw
+	scene->pipelines = create_pipeline_registry(device, pipeline_cache, extent);
+	scene->triangle_program = register_pipeline_program(scene->pipelines, "../assets/shaders/shader_vert.spv", "../assets/shaders/shader_frag.spv", scene->triangle_layout);
+	scene->mesh_program = register_pipeline_program(scene->pipelines, "../assets/shaders/mesh_vert.spv", "../assets/shaders/mesh_frag.spv", scene->triangle_layout);
+	scene->draw_list = create_draw_list(1024);
+
+	// images are decoded on worker threads and copied in by the upload pass, one frame in flight
+	scene->loader = create_asset_loader(physical_device, device, command_pool, queue, 2, 16 * 1024 * 1024, 1, setup->image_lod_bias, true);
+	scene->image_layout = create_pipeline_layout(device, 1, &scene->loader->set_layout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 8 * sizeof(float));
+	scene->image_program = register_pipeline_program(scene->pipelines, "../assets/shaders/image_vert.spv", "../assets/shaders/image_frag.spv", scene->image_layout);
+	scene->panel_image = setup->panel_image != NULL ? load_texture(scene->loader, setup->panel_image, LOAD_PRIORITY_HIGH) : LOADER_NO_TEXTURE;
+
+	// gradient ramps are baked on first use, patterns sample loader textures at set 1
+	scene->paint = create_paint_system(physical_device, device, command_pool, queue, scene->loader->set_layout, 1);
+	scene->paint_program = register_pipeline_program(scene->pipelines, "../assets/shaders/paint_vert.spv", "../assets/shaders/paint_frag.spv", scene->paint->layout);
+	scene->clips = create_clip_stack(physical_device, device, scene->pipelines, 1);
+
+	// the setup's line points are uploaded once, frames only say which stretches to draw and how and
+	// bring a few of their own
+	scene->line_point_base = setup->line_point_count;
+	scene->lines = create_line_renderer(physical_device, device, scene->pipelines, extent, setup->line_point_count + SCENE_MAX_FRAME_POINTS, 1);
+	if (setup->line_point_count > 0) write_line_points(scene->lines, 0, setup->line_points, setup->line_point_count);
+
+	// samples of the live feed are appended in place, segments recycle as the feed runs on
+	scene->stream = create_stream_buffer(physical_device, device, sizeof(struct Vertex), SCENE_STREAM_SEGMENT_VERTICES, SCENE_STREAM_SEGMENTS, 1, true);
+
+	enum VertexLayout vertex_layout = setup->vertex_layout != VERTEX_LAYOUT_NONE ? setup->vertex_layout : VERTEX_LAYOUT_COMPACT;
+	scene->ring = create_ring_mesh(physical_device, device, command_pool, queue, vertex_layout, 640.0f, 480.0f, 200.0f, 260.0f);
+
+	// sprites, uploaded once and culled every frame, on the gpu when gpu driven
+	// and otherwise against the spatial tree, then exactly by the clip kernel
+
+	uint32_t count = setup->sprite_count;
+
+	scene->sprite_count = count;
+	scene->sprite_tree = create_spatial_tree(4.0f); // sprites never move, the margin hardly matters
+	scene->sprite_bounds = malloc(4 * count * sizeof(float));
+	scene->candidate_bounds = malloc(4 * count * sizeof(float));
+	scene->visible_sprites = malloc(count * sizeof(uint32_t));
+	scene->candidate_hits = malloc(count * sizeof(uint32_t));
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		const struct SpriteInstance *sprite = &setup->sprites[i];
+
+		struct Aabb box = {
+			.x0 = sprite->rect[0],
+			.y0 = sprite->rect[1],
+			.x1 = sprite->rect[0] + sprite->rect[2],
+			.y1 = sprite->rect[1] + sprite->rect[3],
+		};
+
+		spatial_insert(&scene->sprite_tree, box, i);
+
+		scene->sprite_bounds[i] = box.x0;
+		scene->sprite_bounds[count + i] = box.y0;
+		scene->sprite_bounds[2 * count + i] = box.x1;
+		scene->sprite_bounds[3 * count + i] = box.y1;
+	}
+
+	scene->indirect_renderer = create_indirect_renderer(physical_device, device, command_pool, queue, extent, scene->render_pass, color_format, scene->stencil_format, setup->sprites, setup->sprite_count, setup->clips, setup->clip_count);
+
+	// panel with a blurred drop shadow, the layer leaves room for the blur to spread
+
+	scene->panel_size[0] = setup->panel_size[0];
+	scene->panel_size[1] = setup->panel_size[1];
+	scene->filter_system = create_filter_system(device, features, extent, scene->render_pass, color_format, scene->stencil_format);
+
+	VkExtent2D shadow_extent = {
+		.width = (uint32_t) setup->panel_size[0] + 2 * SCENE_SHADOW_PADDING,
+		.height = (uint32_t) setup->panel_size[1] + 2 * SCENE_SHADOW_PADDING,
+	};
+	// out of memory or a lost device fails the scene like any other object, anything else only costs the shadow
+	VkResult result = create_filter_layer(physical_device, device, &scene->filter_system, shadow_extent, setup->shadow_radius, &scene->shadow_layer);
+	if (render_recovery(result) != RENDER_RECOVERY_NONE) report_render_failure(result, "create shadow layer");
+	else if (result != VK_SUCCESS) printf("failed to create shadow layer, the panel is drawn without it: %s\n", get_result_string(result));
+
+	// frame graph, built once, the target image is rebound every frame
+
+	struct FrameGraph *graph = create_frame_graph();
+	scene->graph = graph;
+
+	scene->target = graph_import_image(graph, "target", color_format, extent, target_initial, target_final);
+	uint32_t visible_buffer = graph_import_buffer(graph, "visible", scene->indirect_renderer.visible_buffer.buffer);
+	uint32_t indirect_buffer = graph_import_buffer(graph, "indirect", scene->indirect_renderer.indirect_buffer.buffer);
+	scene->stencil = scene->stencil_format != VK_FORMAT_UNDEFINED ? graph_create_image(graph, "stencil", scene->stencil_format, extent) : GRAPH_NONE;
+
+	// texture and ramp uploads synchronize themselves, sampling waits for the copy with its own barrier
+	uint32_t upload_pass = graph_add_pass(graph, "upload", record_upload_pass, scene);
+	graph_set_side_effects(graph, upload_pass);
+
+	enum GraphAccess cull_access = gpu_driven ? GRAPH_ACCESS_COMPUTE_WRITE : GRAPH_ACCESS_TRANSFER_WRITE;
+
+	uint32_t cull_pass = graph_add_pass(graph, "cull", record_cull_pass, scene);
+	graph_write(graph, cull_pass, visible_buffer, cull_access);
+	graph_write(graph, cull_pass, indirect_buffer, cull_access);
+
+	// filter layers keep their blurred results across frames, so they synchronize themselves
+	uint32_t filter_pass = graph_add_pass(graph, "filter", record_filter_pass, scene);
+	graph_set_side_effects(graph, filter_pass);
+
+	// the line image is only written here and sampled by the main pass, the pass synchronizes it itself
+	uint32_t lines_pass = graph_add_pass(graph, "lines", record_lines_pass, scene);
+	graph_set_side_effects(graph, lines_pass);
+
+	uint32_t main_pass = graph_add_pass(graph, "main", record_main_pass, scene);
+	graph_read(graph, main_pass, visible_buffer, GRAPH_ACCESS_VERTEX_READ);
+	graph_read(graph, main_pass, indirect_buffer, GRAPH_ACCESS_INDIRECT_READ);
+	graph_write(graph, main_pass, scene->target, GRAPH_ACCESS_COLOR_ATTACHMENT);
+	if (scene->stencil != GRAPH_NONE) graph_write(graph, main_pass, scene->stencil, GRAPH_ACCESS_STENCIL_ATTACHMENT);
+
+	// reads the finished frame back before it is handed on
+	if (capture != NULL) {
+		uint32_t capture_pass = graph_add_pass(graph, "capture", record_capture_pass, scene);
+		graph_read(graph, capture_pass, scene->target, GRAPH_ACCESS_COMPUTE_SAMPLED);
+		graph_set_side_effects(graph, capture_pass);
+	}
+
+	graph_compile(graph, physical_device, device);
+
+	scene->stencil_view = scene->stencil != GRAPH_NONE ? graph_image_view(graph, scene->stencil) : VK_NULL_HANDLE;
+
+	return scene;
+}
+
+void destroy_scene_renderer(struct SceneRenderer *scene)
+{
+	VkDevice device = scene->device;
+
+	destroy_frame_graph(device, scene->graph);
+	destroy_filter_layer(device, &scene->filter_system, &scene->shadow_layer);
+	destroy_filter_system(device, &scene->filter_system);
+	free(scene->candidate_hits);
+	free(scene->visible_sprites);
+	free(scene->candidate_bounds);
+	free(scene->sprite_bounds);
+	destroy_spatial_tree(&scene->sprite_tree);
+	destroy_indirect_renderer(device, &scene->indirect_renderer);
+
+	destroy_draw_list(&scene->draw_list);
+	destroy_stream_buffer(scene->stream);
+	destroy_line_renderer(scene->lines);
+	destroy_clip_stack(scene->clips);
+	destroy_paint_system(scene->paint);
+	destroy_asset_loader(scene->loader);
+	untrack_resource(RESOURCE_PIPELINE_LAYOUT, scene->image_layout);
+	vkDestroyPipelineLayout(device, scene->image_layout, NULL);
+	destroy_mesh(device, &scene->ring);
+	destroy_pipeline_registry(scene->pipelines);
+	untrack_resource(RESOURCE_PIPELINE_LAYOUT, scene->triangle_layout);
+	vkDestroyPipelineLayout(device, scene->triangle_layout, NULL);
+	destroy_uniform_ring(device, &scene->uniform_ring);
+	untrack_resource(RESOURCE_RENDER_PASS, scene->render_pass);
+	if (scene->render_pass != VK_NULL_HANDLE) vkDestroyRenderPass(device, scene->render_pass, NULL);
+
+	free(scene);
+}
+
+// x, y, width, height rects, false when nothing of them overlaps
+static bool intersect_rect(const float a[4], const float b[4], float out[4])
+{
+	float x0 = fmaxf(a[0], b[0]);
+	float y0 = fmaxf(a[1], b[1]);
+	float x1 = fminf(a[0] + a[2], b[0] + b[2]);
+	float y1 = fminf(a[1] + a[3], b[1] + b[3]);
+
+	if (x1 <= x0 || y1 <= y0) return false;
+
+	out[0] = x0;
+	out[1] = y0;
+	out[2] = x1 - x0;
+	out[3] = y1 - y0;
+
+	return true;
+}
+
+// parents come first, so one pass cuts every clip by its parents and finds the rounded clip around it
+static void resolve_scene_clips(struct SceneRenderer *scene, const struct SceneFrame *frame)
+{
+	uint32_t count = frame->clip_count < SCENE_MAX_CLIPS ? frame->clip_count : SCENE_MAX_CLIPS;
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		const struct SceneClip *clip = &frame->clips[i];
+		float *bounds = scene->clip_bounds[i];
+
+		memcpy(bounds, clip->rect, sizeof(clip->rect));
+		scene->clip_stencil[i] = clip->radius > 0.0f ? i : SCENE_NO_CLIP;
+
+		if (clip->parent >= i) continue;
+
+		if (!intersect_rect(bounds, scene->clip_bounds[clip->parent], bounds)) bounds[2] = bounds[3] = 0.0f;
+		if (clip->radius <= 0.0f) scene->clip_stencil[i] = scene->clip_stencil[clip->parent];
+	}
+}
+
+// ramps have to be known before the upload pass, so shapes are pushed before the graph runs;
+// rect clips are applied here, so they never split a draw
+static void push_scene_shapes(struct SceneRenderer *scene, const struct SceneFrame *frame)
+{
+	begin_paint_frame(scene->paint, scene->frame_index);
+	resolve_scene_clips(scene, frame);
+
+	uint32_t clip_count = frame->clip_count < SCENE_MAX_CLIPS ? frame->clip_count : SCENE_MAX_CLIPS;
+
+	scene->clip_run_count = 0;
+
+	for (uint32_t i = 0; i < frame->shape_count && i < SCENE_MAX_SHAPES; i++)
+	{
+		const struct SceneShape *shape = &frame->shapes[i];
+		const struct Gradient *gradient = shape->gradient < frame->gradient_count && shape->gradient < SCENE_MAX_GRADIENTS ? &frame->gradients[shape->gradient] : NULL;
+
+		float rect[4] = {shape->rect[0], shape->rect[1], shape->rect[2], shape->rect[3]};
+		uint32_t stencil = SCENE_NO_CLIP;
+
+		if (shape->clip < clip_count) {
+			if (!intersect_rect(rect, scene->clip_bounds[shape->clip], rect)) continue;
+			stencil = scene->clip_stencil[shape->clip];
+		}
+
+		uint32_t first = scene->paint->instance_count;
+		if (!push_paint_rect(scene->paint, rect, &shape->paint, gradient, scene->panel_image)) break;
+
+		if (scene->clip_run_count == 0 || scene->clip_runs[scene->clip_run_count - 1].clip != stencil) {
+			scene->clip_runs[scene->clip_run_count++] = (struct SceneClipRun) {stencil, first, 0};
+		}
+
+		scene->clip_runs[scene->clip_run_count - 1].count += scene->paint->instance_count - first;
+	}
+}
+
+// lines are mapped straight to target pixels, the view only shifts them
+static void push_scene_lines(struct SceneRenderer *scene, const struct SceneFrame *frame)
+{
+	begin_line_frame(scene->lines, scene->frame_index);
+
+	// the one frame in flight before this has finished, its points can be overwritten
+	uint32_t point_count = frame->line_point_count < SCENE_MAX_FRAME_POINTS ? frame->line_point_count : SCENE_MAX_FRAME_POINTS;
+	if (point_count > 0) write_line_points(scene->lines, scene->line_point_base, frame->line_points, point_count);
+
+	for (uint32_t i = 0; i < frame->line_count && i < SCENE_MAX_LINES; i++)
+	{
+		const struct SceneLine *line = &frame->lines[i];
+
+		struct Polyline polyline = {
+			.first_point = line->first_point,
+			.point_count = line->point_count,
+			.transform = {line->transform[0], line->transform[1], line->transform[2] - frame->view.x0, line->transform[3] - frame->view.y0},
+			.color = {line->color[0], line->color[1], line->color[2], line->color[3]},
+			.width = line->width,
+			.series = line->series != 0,
+		};
+
+		if (!push_polyline(scene->lines, &polyline)) break;
+	}
+}
+
+// new samples of the live feed are written in place and flushed before the frame is submitted
+static void push_scene_stream(struct SceneRenderer *scene, const struct SceneFrame *frame)
+{
+	begin_stream_frame(scene->stream, scene->frame_index);
+
+	uint32_t count = frame->stream_count < SCENE_MAX_STREAM_VERTICES ? frame->stream_count : SCENE_MAX_STREAM_VERTICES;
+	append_stream_vertices(scene->stream, frame->stream_vertices, count);
+	flush_stream(scene->stream);
+}
+
+void reset_scene_stream(struct SceneRenderer *scene)
+{
+	reset_stream(scene->stream);
+}
+
+void record_scene_frame(VkCommandBuffer command_buffer, struct SceneRenderer *scene, const struct SceneFrame *frame, uint64_t frame_index, VkImage target, VkImageView target_view, VkFramebuffer framebuffer)
+{
+	struct SceneUniforms uniforms = {
+		.view = {frame->view.x0, frame->view.y0, 2.0f / scene->extent.width, 2.0f / scene->extent.height},
+		.time = frame->time,
+	};
+
+	begin_uniform_ring_frame(&scene->uniform_ring, frame_index);
+
+	scene->frame = frame;
+	scene->frame_index = frame_index;
+	scene->uniforms_offset = push_uniforms(&scene->uniform_ring, &uniforms, sizeof(uniforms));
+	scene->framebuffer = framebuffer;
+	scene->target_view = target_view;
+
+	push_scene_shapes(scene, frame);
+	push_scene_lines(scene, frame);
+	push_scene_stream(scene, frame);
+
+	graph_bind_image(scene->graph, scene->target, target, target_view);
+	graph_execute(scene->graph, command_buffer);
+
+	scene->frame = NULL;
+}
+
+void print_scene_stats(struct SceneRenderer *scene)
+{
+	print_frame_graph(scene->graph);
+	print_pipeline_registry(scene->pipelines);
+	print_draw_list_stats(&scene->draw_list);
+	print_mesh_info("ring", &scene->ring);
+	print_asset_loader_stats(scene->loader);
+	print_paint_stats(scene->paint);
+	print_clip_stats(scene->clips);
+	print_line_stats(scene->lines);
+	print_stream_stats(scene->stream);
+	printf("geometry kernels: %s\n", get_geometry_kernels()->name);
+}
@@ -0,0 +1,218 @@
+#pragma once
+
+#include "render.h"
+#include "indirect.h"
+#include "spatial.h"
+#include "graph.h"
+#include "filter.h"
+#include "ring.h"
+#include "pipeline.h"
+#include "drawlist.h"
+#include "capture.h"
+#include "mesh.h"
+#include "geometry.h"
+#include "loader.h"
+#include "paint.h"
+#include "clip.h"
+#include "lines.h"
+#include "stream.h"
+
+// The high level scene the renderer draws: a sprite world panned by a view,
+// a ring mesh, a handful of triangles, shapes filled with gradients and
+// patterns inside nested clips, polylines rasterized in compute, and a
+// panel with a blurred drop shadow and an image streamed in by the asset
+// loader. Everything that changes per frame is in a SceneFrame, so frames
+// can be produced by the application, written to a trace and replayed
+// without it.
+
+#define SCENE_MAX_TRIANGLES 256
+#define SCENE_SHADOW_PADDING 32
+#define SCENE_RING_SEGMENTS 1024
+#define SCENE_IMAGE_INSET 16.0f
+#define SCENE_MAX_GRADIENTS 64
+#define SCENE_MAX_SHAPES 4096
+#define SCENE_MAX_CLIPS 64
+#define SCENE_NO_CLIP UINT32_MAX
+#define SCENE_MAX_LINES 64
+#define SCENE_MAX_FRAME_POINTS 16384
+#define SCENE_MAX_STREAM_VERTICES 1024    // appended per frame
+#define SCENE_STREAM_SEGMENT_VERTICES 4096
+#define SCENE_STREAM_SEGMENTS 8
+
+// fixed for the lifetime of a renderer
+struct SceneSetup {
+	const struct SpriteInstance *sprites;
+	uint32_t sprite_count;
+	const struct ClipRect *clips;
+	uint32_t clip_count;
+	const float *line_points; // x, y pairs the frames' lines index into
+	uint32_t line_point_count;
+
+	float panel_size[2];
+	float shadow_radius;
+	const char *panel_image; // drawn inside the panel, NULL for none
+
+	enum VertexLayout vertex_layout; // of the scene's meshes, not part of a trace
+	float image_lod_bias;            // for loaded textures, not part of a trace
+};
+
+struct SceneTriangle {
+	float transform[4]; // center x, y, size, spin
+	uint32_t blend;     // enum BlendMode
+};
+
+// pattern shapes repeat the panel image, the only texture a scene loads
+struct SceneShape {
+	float rect[4];     // x, y, width, height in world space
+	struct Paint paint;
+	uint32_t gradient; // into the frame's gradients, for gradient paints
+	uint32_t clip;     // into the frame's clips, SCENE_NO_CLIP or anything past them for none
+};
+
+// clips nest through parent, which has to come earlier in the frame's clips; shapes are cut to
+// rect clips on the cpu, rounded clips go through the stencil when shapes under them are drawn
+struct SceneClip {
+	float rect[4];   // x, y, width, height in world space
+	float radius;    // of the corners, 0 for a plain rect
+	uint32_t parent; // SCENE_NO_CLIP for none
+};
+
+// a polyline over the shapes, points are mapped to world space by transform
+struct SceneLine {
+	uint32_t first_point; // into the setup's line points, then the frame's from line_point_count on
+	uint32_t point_count;
+	float transform[4];   // scale x, y then offset x, y
+	float color[4];       // linear, straight alpha
+	float width;          // in pixels
+	uint32_t series;      // nonzero when x never decreases, dense series are drawn per pixel column
+};
+
+// shapes under the same rounded clip, drawn together
+struct SceneClipRun {
+	uint32_t clip; // innermost rounded clip, SCENE_NO_CLIP for none
+	uint32_t first;
+	uint32_t count;
+};
+
+struct SceneFrame {
+	float time;
+	struct ClipRect view;
+
+	uint32_t triangle_count;
+	struct SceneTriangle triangles[SCENE_MAX_TRIANGLES];
+
+	float panel_position[2];
+	float panel_color[4];
+
+	// drawn over the sprites, under the panel
+	uint32_t gradient_count;
+	struct Gradient gradients[SCENE_MAX_GRADIENTS];
+	uint32_t shape_count;
+	struct SceneShape shapes[SCENE_MAX_SHAPES];
+	uint32_t clip_count;
+	struct SceneClip clips[SCENE_MAX_CLIPS];
+
+	// over the shapes, unclipped
+	uint32_t line_count;
+	struct SceneLine lines[SCENE_MAX_LINES];
+
+	// x, y pairs uploaded every frame, such as the visible part of a long series
+	uint32_t line_point_count;
+	float line_points[2 * SCENE_MAX_FRAME_POINTS];
+
+	// a live feed drawn as one line strip over the ring mesh; the vertices are appended to what
+	// earlier frames brought, the oldest segments drop off as the buffer fills
+	float stream_tile[4]; // origin x, y, scale x, y from vertex positions to world space
+	uint32_t stream_count;
+	struct Vertex stream_vertices[SCENE_MAX_STREAM_VERTICES];
+};
+
+// per frame uniforms, std140
+struct SceneUniforms {
+	float view[4]; // x0, y0, 2 / width, 2 / height
+	float time;
+	float pad[3];
+};
+
+struct SceneRenderer {
+	VkDevice device;
+	const struct DeviceFeatures *features;
+	bool gpu_driven;
+
+	VkExtent2D extent;
+	VkFormat color_format;
+	VkFormat stencil_format;  // VK_FORMAT_UNDEFINED when there is none, rounded clips then stop at their bounds
+	VkRenderPass render_pass; // VK_NULL_HANDLE with dynamic rendering
+	VkImageView stencil_view; // shared by every framebuffer, VK_NULL_HANDLE without a stencil
+
+	struct IndirectRenderer indirect_renderer;
+	struct SpatialTree sprite_tree; // picking and cpu culling
+	float *sprite_bounds;           // x0, y0, x1 and y1 streams of sprite_count each
+	uint32_t *visible_sprites;      // the tree's candidates for the view, then sorted
+	float *candidate_bounds;        // their bounds gathered into streams like sprite_bounds
+	uint32_t *candidate_hits;       // which candidates the clip kernel kept
+	uint32_t sprite_count;
+
+	struct UniformRing uniform_ring;
+	VkPipelineLayout triangle_layout;
+	struct PipelineRegistry *pipelines;
+	uint32_t triangle_program;
+	uint32_t mesh_program;
+	struct Mesh ring;
+	struct DrawList draw_list;
+
+	struct FilterSystem filter_system;
+	struct FilterLayer shadow_layer;
+	bool shadow_drawn;
+	float panel_size[2];
+
+	struct AssetLoader *loader;
+	VkPipelineLayout image_layout;
+	uint32_t image_program;
+	uint32_t panel_image; // LOADER_NO_TEXTURE for none
+
+	struct PaintSystem *paint;
+	uint32_t paint_program;
+
+	struct ClipStack *clips;
+	float clip_bounds[SCENE_MAX_CLIPS][4];   // this frame's clips cut by their parents
+	uint32_t clip_stencil[SCENE_MAX_CLIPS];  // innermost rounded clip around each, SCENE_NO_CLIP for none
+	uint32_t clip_path[CLIP_MAX_DEPTH];      // scene clips on the clip stack, outermost first
+	uint32_t clip_path_length;
+	struct SceneClipRun clip_runs[SCENE_MAX_SHAPES];
+	uint32_t clip_run_count;
+
+	struct LineRenderer *lines;
+	uint32_t line_point_base; // the setup's points, the frame's follow
+
+	struct StreamBuffer *stream;
+
+	struct FrameCapture *capture; // NULL when not capturing
+
+	struct FrameGraph *graph;
+	uint32_t target;
+	uint32_t stencil; // GRAPH_NONE without a stencil
+
+	// the frame being recorded
+	const struct SceneFrame *frame;
+	uint64_t frame_index;
+	uint32_t uniforms_offset;
+	VkFramebuffer framebuffer; // render pass path
+	VkImageView target_view;
+};
+
+// target_initial and target_final are the states the target image arrives in and is left in,
+// ACQUIRE and PRESENT for a swapchain; pipeline_cache can be shared by the scenes of one device,
+// VK_NULL_HANDLE gives the scene a cache of its own
+struct SceneRenderer *create_scene_renderer(VkPhysicalDevice physical_device, VkDevice device, VkCommandPool command_pool, VkQueue queue, VkPipelineCache pipeline_cache, const struct DeviceFeatures *features, VkExtent2D extent, VkFormat color_format, enum GraphAccess target_initial, enum GraphAccess target_final, bool gpu_driven, const struct SceneSetup *setup, struct FrameCapture *capture);
+void destroy_scene_renderer(struct SceneRenderer *scene);
+
+// records frame into target; framebuffer is only used without dynamic rendering, its attachments
+// are the target and stencil_view.
+// frame_index picks the uniform ring slot, the previous use of that slot has to be finished
+void record_scene_frame(VkCommandBuffer command_buffer, struct SceneRenderer *scene, const struct SceneFrame *frame, uint64_t frame_index, VkImage target, VkImageView target_view, VkFramebuffer framebuffer);
+
+// drops the live feed's vertices, for frames that do not follow on from the one recorded before
+void reset_scene_stream(struct SceneRenderer *scene);
+
+void print_scene_stats(struct SceneRenderer *scene);
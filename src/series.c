@@ -0,0 +1,278 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+#include <math.h>
+
+#include "series.h"
+
+static uint32_t level_buckets(uint32_t capacity, uint32_t level)
+{
+	return (uint32_t) (((uint64_t) capacity + (1ull << level) - 1) >> level);
+}
+
+// summarizes the samples there already are at a level added by growing, from the level below
+static void build_level(struct SeriesPyramid *series, uint32_t level)
+{
+	uint32_t *buckets = series->levels[level];
+	uint32_t count = level_buckets(series->count, level);
+
+	for (uint32_t b = 0; b < count; b++)
+	{
+		uint32_t low;
+		uint32_t high;
+
+		if (level == 1) {
+			low = high = 2 * b;
+			uint32_t next = 2 * b + 1;
+
+			if (next < series->count) {
+				if (series->y[next] < series->y[low]) low = next;
+				if (series->y[next] > series->y[high]) high = next;
+			}
+		}
+		else {
+			const uint32_t *below = series->levels[level - 1];
+			low = below[4 * b];
+			high = below[4 * b + 1];
+
+			// the second half only exists when samples reach into it
+			if ((2 * b + 1) << (level - 1) < series->count) {
+				if (series->y[below[4 * b + 2]] < series->y[low]) low = below[4 * b + 2];
+				if (series->y[below[4 * b + 3]] > series->y[high]) high = below[4 * b + 3];
+			}
+		}
+
+		buckets[2 * b] = low;
+		buckets[2 * b + 1] = high;
+	}
+}
+
+// every level gets room for capacity samples; levels a larger capacity adds are built from what
+// is there
+static bool reserve_series(struct SeriesPyramid *series, uint32_t capacity)
+{
+	if (capacity <= series->capacity) return true;
+
+	double *x = realloc(series->x, (size_t) capacity * sizeof(double));
+	if (x == NULL) return false;
+	series->x = x;
+
+	float *y = realloc(series->y, (size_t) capacity * sizeof(float));
+	if (y == NULL) return false;
+	series->y = y;
+
+	uint32_t level_count = 1;
+	while (level_count < SERIES_MAX_LEVELS && (1ull << level_count) < capacity) level_count++;
+
+	for (uint32_t k = 1; k < level_count; k++)
+	{
+		uint32_t *level = realloc(series->levels[k], (size_t) level_buckets(capacity, k) * 2 * sizeof(uint32_t));
+		if (level == NULL) return false;
+		series->levels[k] = level;
+	}
+
+	for (uint32_t k = series->level_count; k < level_count; k++)
+	{
+		series->level_count = k + 1;
+		build_level(series, k);
+	}
+
+	series->capacity = capacity;
+	series->level_count = level_count;
+
+	return true;
+}
+
+struct SeriesPyramid *create_series_pyramid(uint32_t capacity)
+{
+	struct SeriesPyramid *series = calloc(1, sizeof(struct SeriesPyramid));
+
+	series->level_count = 1;
+
+	if (!reserve_series(series, capacity > 0 ? capacity : 1024)) {
+		printf("failed to allocate series of %u samples\n", capacity);
+	}
+
+	return series;
+}
+
+void destroy_series_pyramid(struct SeriesPyramid *series)
+{
+	for (uint32_t k = 1; k < SERIES_MAX_LEVELS; k++) free(series->levels[k]);
+
+	free(series->y);
+	free(series->x);
+	free(series);
+}
+
+bool append_series(struct SeriesPyramid *series, const double *x, const float *y, uint32_t count)
+{
+	if (count > UINT32_MAX - series->count) return false;
+
+	uint32_t needed = series->count + count;
+
+	if (needed > series->capacity) {
+		uint64_t capacity = (uint64_t) series->capacity * 2;
+		if (capacity < needed) capacity = needed;
+		if (capacity > UINT32_MAX) capacity = UINT32_MAX;
+
+		if (!reserve_series(series, (uint32_t) capacity)) {
+			printf("failed to grow series to %llu samples\n", (unsigned long long) capacity);
+			return false;
+		}
+	}
+
+	memcpy(series->x + series->count, x, (size_t) count * sizeof(double));
+	memcpy(series->y + series->count, y, (size_t) count * sizeof(float));
+
+	// each sample opens or widens the last bucket of every level, ties keep the earlier sample
+
+	for (uint32_t i = series->count; i < needed; i++)
+	{
+		float value = series->y[i];
+
+		for (uint32_t k = 1; k < series->level_count; k++)
+		{
+			uint32_t *bucket = &series->levels[k][2 * (i >> k)];
+
+			if ((i & ((1u << k) - 1)) == 0) {
+				bucket[0] = i;
+				bucket[1] = i;
+				continue;
+			}
+
+			if (value < series->y[bucket[0]]) bucket[0] = i;
+			if (value > series->y[bucket[1]]) bucket[1] = i;
+		}
+	}
+
+	series->count = needed;
+	series->stats.appended += count;
+
+	return true;
+}
+
+// first sample with x >= value
+static uint32_t lower_bound(const struct SeriesPyramid *series, double value)
+{
+	uint32_t low = 0;
+	uint32_t high = series->count;
+
+	while (low < high)
+	{
+		uint32_t middle = low + (high - low) / 2;
+
+		if (series->x[middle] < value) low = middle + 1;
+		else high = middle;
+	}
+
+	return low;
+}
+
+// first and one past the last sample to draw, one either side of the range included
+static void visible_samples(const struct SeriesPyramid *series, double x0, double x1, uint32_t *first, uint32_t *end)
+{
+	uint32_t begin = lower_bound(series, x0);
+	uint32_t finish = lower_bound(series, x1);
+
+	if (begin > 0) begin--;
+	if (finish < series->count) finish++;
+
+	*first = begin;
+	*end = finish > begin ? finish : begin;
+}
+
+static uint32_t level_for_samples(const struct SeriesPyramid *series, uint32_t samples, float pixels)
+{
+	double budget = fmax((double) pixels, 1.0) * SERIES_POINTS_PER_PIXEL;
+	uint32_t level = 0;
+
+	// raw samples while they fit the budget, then every level halves the points and emits two per bucket
+	if (samples > budget) {
+		while (level + 1 < series->level_count && 2.0 * (double) (samples >> level) > budget) level++;
+	}
+
+	return level;
+}
+
+uint32_t series_level(const struct SeriesPyramid *series, double x0, double x1, float pixels)
+{
+	uint32_t first;
+	uint32_t end;
+	visible_samples(series, x0, x1, &first, &end);
+
+	return level_for_samples(series, end - first, pixels);
+}
+
+static uint32_t write_point(float *points, uint32_t count, uint32_t capacity, const struct SeriesPyramid *series, uint32_t sample, double origin)
+{
+	if (count == capacity) return count;
+
+	points[2 * count] = (float) (series->x[sample] - origin);
+	points[2 * count + 1] = series->y[sample];
+
+	return count + 1;
+}
+
+uint32_t extract_series(struct SeriesPyramid *series, double x0, double x1, float pixels, double origin, float *points, uint32_t capacity)
+{
+	uint32_t first;
+	uint32_t end;
+	visible_samples(series, x0, x1, &first, &end);
+
+	uint32_t level = level_for_samples(series, end - first, pixels);
+	uint32_t count = 0;
+
+	if (end == first) level = 0;
+
+	if (level == 0) {
+		// raw samples, unless they do not fit
+		if (end - first > capacity) level = 1;
+	}
+
+	if (level > 0 && end > first) {
+		// two points per bucket at most
+		while (level + 1 < series->level_count && 2ull * (((end - 1) >> level) - (first >> level) + 1) > capacity) level++;
+	}
+
+	if (level == 0) {
+		for (uint32_t i = first; i < end; i++) count = write_point(points, count, capacity, series, i, origin);
+	}
+	else {
+		const uint32_t *buckets = series->levels[level];
+
+		for (uint32_t b = first >> level; end > first && b <= (end - 1) >> level; b++)
+		{
+			uint32_t low = buckets[2 * b];
+			uint32_t high = buckets[2 * b + 1];
+
+			// in sample order, so x never decreases and the line can be drawn as a series
+			uint32_t a = low < high ? low : high;
+			uint32_t c = low < high ? high : low;
+
+			count = write_point(points, count, capacity, series, a, origin);
+			if (c != a) count = write_point(points, count, capacity, series, c, origin);
+		}
+	}
+
+	series->stats.extracted_level = level;
+	series->stats.extracted_first = first;
+	series->stats.extracted_count = end - first;
+	series->stats.extracted_points = count;
+
+	return count;
+}
+
+void print_series_stats(const struct SeriesPyramid *series)
+{
+	const struct SeriesStats *stats = &series->stats;
+
+	size_t bytes = (size_t) series->capacity * (sizeof(double) + sizeof(float));
+	for (uint32_t k = 1; k < series->level_count; k++) bytes += (size_t) level_buckets(series->capacity, k) * 2 * sizeof(uint32_t);
+
+	printf("series:\n");
+	printf("\tsamples: %u, %u levels, %.1f MiB\n", series->count, series->level_count, bytes / (1024.0 * 1024.0));
+	printf("\tlast extraction: %u of %u samples from %u as %u points at level %u\n", stats->extracted_count, series->count, stats->extracted_first, stats->extracted_points, stats->extracted_level);
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Level of detail for long time series. Samples are kept once on the host
+// and summarized by a pyramid of min/max envelopes: level k holds, for every
+// bucket of 2^k consecutive samples, which sample is the lowest and which
+// the highest. Buckets only store two 32 bit sample indices and halve in
+// number every level, so the whole pyramid costs about 8 bytes per sample,
+// twice the float y values.
+//
+// Appending updates the last bucket of every level, so the pyramid is always
+// complete. extract_series picks the coarsest level that still gives every
+// pixel column a couple of points, finds the visible samples by binary search
+// and writes out each bucket's min and max in sample order. What reaches the
+// gpu is bounded by the width in pixels, not by how many samples there are.
+//
+// x is kept in double precision and points come out relative to an origin,
+// so series far longer than a float can count stay exact on screen.
+
+#define SERIES_MAX_LEVELS 32
+#define SERIES_POINTS_PER_PIXEL 2.0f // min and max of one bucket per column
+
+struct SeriesStats {
+	uint32_t appended;        // samples, since creation
+	uint32_t extracted_level; // last extraction
+	uint32_t extracted_first; // visible samples of the last extraction
+	uint32_t extracted_count;
+	uint32_t extracted_points;
+};
+
+struct SeriesPyramid {
+	double *x; // non-decreasing
+	float *y;
+	uint32_t count;
+	uint32_t capacity;
+
+	// level k >= 1, min and max sample index of each bucket; levels[0] is unused
+	uint32_t *levels[SERIES_MAX_LEVELS];
+	uint32_t level_count;
+
+	struct SeriesStats stats;
+};
+
+// capacity is a first guess, the pyramid grows as samples are appended
+struct SeriesPyramid *create_series_pyramid(uint32_t capacity);
+void destroy_series_pyramid(struct SeriesPyramid *series);
+
+// x has to continue from where the series ends and never decrease; false when out of memory
+bool append_series(struct SeriesPyramid *series, const double *x, const float *y, uint32_t count);
+
+// the level extract_series would use for x0 to x1 drawn across pixels columns
+uint32_t series_level(const struct SeriesPyramid *series, double x0, double x1, float pixels);
+
+// writes the samples between x0 and x1 at the level the zoom calls for as x, y pairs with x made
+// relative to origin, plus one sample either side so the line runs to the edges; moves to
+// coarser levels until the result fits capacity points. Returns how many points were written
+uint32_t extract_series(struct SeriesPyramid *series, double x0, double x1, float pixels, double origin, float *points, uint32_t capacity);
+
+void print_series_stats(const struct SeriesPyramid *series);
@@ -0,0 +1,522 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "spatial.h"
+
+// deep enough for any AVL balanced tree that fits in memory
+#define SPATIAL_STACK_SIZE 256
+
+static struct Aabb aabb_union(struct Aabb a, struct Aabb b)
+{
+	struct Aabb c = {
+		.x0 = (a.x0 < b.x0) ? a.x0 : b.x0,
+		.y0 = (a.y0 < b.y0) ? a.y0 : b.y0,
+		.x1 = (a.x1 > b.x1) ? a.x1 : b.x1,
+		.y1 = (a.y1 > b.y1) ? a.y1 : b.y1,
+	};
+
+	return c;
+}
+
+static float aabb_perimeter(struct Aabb a)
+{
+	return 2.0f * ((a.x1 - a.x0) + (a.y1 - a.y0));
+}
+
+static bool aabb_overlaps(struct Aabb a, struct Aabb b)
+{
+	return a.x0 <= b.x1 && a.x1 >= b.x0 && a.y0 <= b.y1 && a.y1 >= b.y0;
+}
+
+static bool aabb_contains(struct Aabb outer, struct Aabb inner)
+{
+	return outer.x0 <= inner.x0 && outer.y0 <= inner.y0 && outer.x1 >= inner.x1 && outer.y1 >= inner.y1;
+}
+
+static bool aabb_contains_point(struct Aabb a, float x, float y)
+{
+	return a.x0 <= x && x <= a.x1 && a.y0 <= y && y <= a.y1;
+}
+
+static int32_t max_height(int32_t a, int32_t b)
+{
+	return (a > b) ? a : b;
+}
+
+static bool is_leaf(const struct SpatialNode *node)
+{
+	return node->left == SPATIAL_NULL_NODE;
+}
+
+struct SpatialTree create_spatial_tree(float margin)
+{
+	struct SpatialTree tree = {
+		.nodes = NULL,
+		.capacity = 0,
+		.node_count = 0,
+		.leaf_count = 0,
+		.root = SPATIAL_NULL_NODE,
+		.free_list = SPATIAL_NULL_NODE,
+		.margin = margin,
+	};
+
+	return tree;
+}
+
+void destroy_spatial_tree(struct SpatialTree *tree)
+{
+	free(tree->nodes);
+
+	*tree = create_spatial_tree(tree->margin);
+}
+
+static int32_t allocate_node(struct SpatialTree *tree)
+{
+	if (tree->free_list == SPATIAL_NULL_NODE) {
+		int32_t old_capacity = tree->capacity;
+		int32_t new_capacity = (old_capacity) ? old_capacity * 2 : 64;
+
+		struct SpatialNode *nodes = realloc(tree->nodes, new_capacity * sizeof(struct SpatialNode));
+		if (nodes == NULL) {
+			printf("failed to grow spatial tree\n");
+			return SPATIAL_NULL_NODE;
+		}
+
+		tree->nodes = nodes;
+		tree->capacity = new_capacity;
+
+		for (int32_t i = old_capacity; i < new_capacity; i++)
+		{
+			tree->nodes[i].parent = (i + 1 < new_capacity) ? i + 1 : SPATIAL_NULL_NODE;
+			tree->nodes[i].height = -1;
+		}
+
+		tree->free_list = old_capacity;
+	}
+
+	int32_t index = tree->free_list;
+	struct SpatialNode *node = &tree->nodes[index];
+
+	tree->free_list = node->parent;
+
+	node->parent = SPATIAL_NULL_NODE;
+	node->left = SPATIAL_NULL_NODE;
+	node->right = SPATIAL_NULL_NODE;
+	node->height = 0;
+	node->item = SPATIAL_NO_ITEM;
+
+	tree->node_count++;
+
+	return index;
+}
+
+static void free_node(struct SpatialTree *tree, int32_t index)
+{
+	tree->nodes[index].parent = tree->free_list;
+	tree->nodes[index].height = -1;
+	tree->free_list = index;
+
+	tree->node_count--;
+}
+
+static void replace_child(struct SpatialTree *tree, int32_t parent, int32_t old_child, int32_t new_child)
+{
+	if (parent == SPATIAL_NULL_NODE) {
+		tree->root = new_child;
+	}
+	else if (tree->nodes[parent].left == old_child) {
+		tree->nodes[parent].left = new_child;
+	}
+	else {
+		tree->nodes[parent].right = new_child;
+	}
+}
+
+// rotates the taller child of a up if a is imbalanced, returns the new subtree root
+static int32_t balance(struct SpatialTree *tree, int32_t ia)
+{
+	struct SpatialNode *nodes = tree->nodes;
+	struct SpatialNode *a = &nodes[ia];
+
+	if (is_leaf(a) || a->height < 2) return ia;
+
+	int32_t ib = a->left;
+	int32_t ic = a->right;
+	struct SpatialNode *b = &nodes[ib];
+	struct SpatialNode *c = &nodes[ic];
+
+	int32_t difference = c->height - b->height;
+
+	if (difference > 1) {
+		int32_t i_f = c->left;
+		int32_t i_g = c->right;
+		struct SpatialNode *f = &nodes[i_f];
+		struct SpatialNode *g = &nodes[i_g];
+
+		c->left = ia;
+		c->parent = a->parent;
+		a->parent = ic;
+		replace_child(tree, c->parent, ia, ic);
+
+		if (f->height > g->height) {
+			c->right = i_f;
+			a->right = i_g;
+			g->parent = ia;
+			a->box = aabb_union(b->box, g->box);
+			c->box = aabb_union(a->box, f->box);
+			a->height = 1 + max_height(b->height, g->height);
+			c->height = 1 + max_height(a->height, f->height);
+		}
+		else {
+			c->right = i_g;
+			a->right = i_f;
+			f->parent = ia;
+			a->box = aabb_union(b->box, f->box);
+			c->box = aabb_union(a->box, g->box);
+			a->height = 1 + max_height(b->height, f->height);
+			c->height = 1 + max_height(a->height, g->height);
+		}
+
+		return ic;
+	}
+
+	if (difference < -1) {
+		int32_t i_d = b->left;
+		int32_t i_e = b->right;
+		struct SpatialNode *d = &nodes[i_d];
+		struct SpatialNode *e = &nodes[i_e];
+
+		b->left = ia;
+		b->parent = a->parent;
+		a->parent = ib;
+		replace_child(tree, b->parent, ia, ib);
+
+		if (d->height > e->height) {
+			b->right = i_d;
+			a->left = i_e;
+			e->parent = ia;
+			a->box = aabb_union(c->box, e->box);
+			b->box = aabb_union(a->box, d->box);
+			a->height = 1 + max_height(c->height, e->height);
+			b->height = 1 + max_height(a->height, d->height);
+		}
+		else {
+			b->right = i_e;
+			a->left = i_d;
+			d->parent = ia;
+			a->box = aabb_union(c->box, d->box);
+			b->box = aabb_union(a->box, e->box);
+			a->height = 1 + max_height(c->height, d->height);
+			b->height = 1 + max_height(a->height, e->height);
+		}
+
+		return ib;
+	}
+
+	return ia;
+}
+
+// walks from index to the root, rebalancing and refitting every ancestor
+static void refit(struct SpatialTree *tree, int32_t index)
+{
+	while (index != SPATIAL_NULL_NODE)
+	{
+		index = balance(tree, index);
+
+		struct SpatialNode *node = &tree->nodes[index];
+		struct SpatialNode *left = &tree->nodes[node->left];
+		struct SpatialNode *right = &tree->nodes[node->right];
+
+		node->height = 1 + max_height(left->height, right->height);
+		node->box = aabb_union(left->box, right->box);
+
+		index = node->parent;
+	}
+}
+
+static void insert_leaf(struct SpatialTree *tree, int32_t leaf)
+{
+	if (tree->root == SPATIAL_NULL_NODE) {
+		tree->root = leaf;
+		tree->nodes[leaf].parent = SPATIAL_NULL_NODE;
+		return;
+	}
+
+	// find the cheapest sibling by the surface area heuristic
+
+	struct Aabb leaf_box = tree->nodes[leaf].box;
+	int32_t index = tree->root;
+
+	while (!is_leaf(&tree->nodes[index]))
+	{
+		struct SpatialNode *node = &tree->nodes[index];
+		struct SpatialNode *left = &tree->nodes[node->left];
+		struct SpatialNode *right = &tree->nodes[node->right];
+
+		float area = aabb_perimeter(node->box);
+		float combined_area = aabb_perimeter(aabb_union(node->box, leaf_box));
+
+		// cost of making a new parent for this node and the leaf
+		float cost = 2.0f * combined_area;
+
+		// minimum cost of pushing the leaf further down
+		float inheritance_cost = 2.0f * (combined_area - area);
+
+		float left_cost = aabb_perimeter(aabb_union(leaf_box, left->box)) + inheritance_cost;
+		if (!is_leaf(left)) left_cost -= aabb_perimeter(left->box);
+
+		float right_cost = aabb_perimeter(aabb_union(leaf_box, right->box)) + inheritance_cost;
+		if (!is_leaf(right)) right_cost -= aabb_perimeter(right->box);
+
+		if (cost < left_cost && cost < right_cost) break;
+
+		index = (left_cost < right_cost) ? node->left : node->right;
+	}
+
+	int32_t sibling = index;
+
+	int32_t new_parent = allocate_node(tree);
+	if (new_parent == SPATIAL_NULL_NODE) return;
+
+	struct SpatialNode *nodes = tree->nodes; // allocate_node may have moved the array
+	int32_t old_parent = nodes[sibling].parent;
+
+	nodes[new_parent].parent = old_parent;
+	nodes[new_parent].box = aabb_union(leaf_box, nodes[sibling].box);
+	nodes[new_parent].height = nodes[sibling].height + 1;
+	nodes[new_parent].left = sibling;
+	nodes[new_parent].right = leaf;
+
+	replace_child(tree, old_parent, sibling, new_parent);
+
+	nodes[sibling].parent = new_parent;
+	nodes[leaf].parent = new_parent;
+
+	refit(tree, new_parent);
+}
+
+static void remove_leaf(struct SpatialTree *tree, int32_t leaf)
+{
+	if (leaf == tree->root) {
+		tree->root = SPATIAL_NULL_NODE;
+		return;
+	}
+
+	struct SpatialNode *nodes = tree->nodes;
+
+	int32_t parent = nodes[leaf].parent;
+	int32_t grand_parent = nodes[parent].parent;
+	int32_t sibling = (nodes[parent].left == leaf) ? nodes[parent].right : nodes[parent].left;
+
+	replace_child(tree, grand_parent, parent, sibling);
+	nodes[sibling].parent = grand_parent;
+
+	free_node(tree, parent);
+
+	refit(tree, grand_parent);
+}
+
+static struct Aabb fatten(const struct SpatialTree *tree, struct Aabb box)
+{
+	struct Aabb fat = {
+		.x0 = box.x0 - tree->margin,
+		.y0 = box.y0 - tree->margin,
+		.x1 = box.x1 + tree->margin,
+		.y1 = box.y1 + tree->margin,
+	};
+
+	return fat;
+}
+
+int32_t spatial_insert(struct SpatialTree *tree, struct Aabb box, uint32_t item)
+{
+	int32_t proxy = allocate_node(tree);
+	if (proxy == SPATIAL_NULL_NODE) return SPATIAL_NULL_NODE;
+
+	tree->nodes[proxy].box = fatten(tree, box);
+	tree->nodes[proxy].item_box = box;
+	tree->nodes[proxy].item = item;
+
+	insert_leaf(tree, proxy);
+
+	tree->leaf_count++;
+
+	return proxy;
+}
+
+void spatial_remove(struct SpatialTree *tree, int32_t proxy)
+{
+	remove_leaf(tree, proxy);
+	free_node(tree, proxy);
+
+	tree->leaf_count--;
+}
+
+// returns true when the item left its fat box and had to be reinserted
+bool spatial_update(struct SpatialTree *tree, int32_t proxy, struct Aabb box)
+{
+	struct SpatialNode *node = &tree->nodes[proxy];
+
+	node->item_box = box;
+
+	if (aabb_contains(node->box, box)) return false;
+
+	remove_leaf(tree, proxy);
+
+	tree->nodes[proxy].box = fatten(tree, box);
+
+	insert_leaf(tree, proxy);
+
+	return true;
+}
+
+// only a tree that lost its balance gets this deep, what lies below is left out of the result
+static void stack_overflowed(void)
+{
+	printf("failed to query spatial tree, it outgrew a stack of %d nodes\n", SPATIAL_STACK_SIZE);
+}
+
+// writes up to max_items overlapping items, returns how many overlap in total
+uint32_t spatial_query_rect(const struct SpatialTree *tree, struct Aabb rect, uint32_t *items, uint32_t max_items)
+{
+	if (tree->root == SPATIAL_NULL_NODE) return 0;
+
+	int32_t stack[SPATIAL_STACK_SIZE];
+	int32_t stack_count = 0;
+	uint32_t found = 0;
+
+	stack[stack_count++] = tree->root;
+
+	while (stack_count > 0)
+	{
+		const struct SpatialNode *node = &tree->nodes[stack[--stack_count]];
+
+		if (!aabb_overlaps(node->box, rect)) continue;
+
+		if (is_leaf(node)) {
+			if (aabb_overlaps(node->item_box, rect)) {
+				if (found < max_items) items[found] = node->item;
+				found++;
+			}
+		}
+		else if (stack_count + 2 <= SPATIAL_STACK_SIZE) {
+			stack[stack_count++] = node->left;
+			stack[stack_count++] = node->right;
+		}
+		else {
+			stack_overflowed();
+		}
+	}
+
+	return found;
+}
+
+uint32_t spatial_query_candidates(const struct SpatialTree *tree, struct Aabb rect, uint32_t *items, uint32_t max_items)
+{
+	if (tree->root == SPATIAL_NULL_NODE) return 0;
+
+	int32_t stack[SPATIAL_STACK_SIZE];
+	int32_t stack_count = 0;
+	uint32_t found = 0;
+
+	stack[stack_count++] = tree->root;
+
+	while (stack_count > 0)
+	{
+		const struct SpatialNode *node = &tree->nodes[stack[--stack_count]];
+
+		if (!aabb_overlaps(node->box, rect)) continue;
+
+		if (is_leaf(node)) {
+			if (found < max_items) items[found] = node->item;
+			found++;
+		}
+		else if (stack_count + 2 <= SPATIAL_STACK_SIZE) {
+			stack[stack_count++] = node->left;
+			stack[stack_count++] = node->right;
+		}
+		else {
+			stack_overflowed();
+		}
+	}
+
+	return found;
+}
+
+uint32_t spatial_query_point(const struct SpatialTree *tree, float x, float y, uint32_t *items, uint32_t max_items)
+{
+	if (tree->root == SPATIAL_NULL_NODE) return 0;
+
+	int32_t stack[SPATIAL_STACK_SIZE];
+	int32_t stack_count = 0;
+	uint32_t found = 0;
+
+	stack[stack_count++] = tree->root;
+
+	while (stack_count > 0)
+	{
+		const struct SpatialNode *node = &tree->nodes[stack[--stack_count]];
+
+		if (!aabb_contains_point(node->box, x, y)) continue;
+
+		if (is_leaf(node)) {
+			if (aabb_contains_point(node->item_box, x, y)) {
+				if (found < max_items) items[found] = node->item;
+				found++;
+			}
+		}
+		else if (stack_count + 2 <= SPATIAL_STACK_SIZE) {
+			stack[stack_count++] = node->left;
+			stack[stack_count++] = node->right;
+		}
+		else {
+			stack_overflowed();
+		}
+	}
+
+	return found;
+}
+
+// items are drawn in ascending order, so the topmost hit is the largest item
+uint32_t spatial_pick(const struct SpatialTree *tree, float x, float y)
+{
+	if (tree->root == SPATIAL_NULL_NODE) return SPATIAL_NO_ITEM;
+
+	int32_t stack[SPATIAL_STACK_SIZE];
+	int32_t stack_count = 0;
+	uint32_t picked = SPATIAL_NO_ITEM;
+
+	stack[stack_count++] = tree->root;
+
+	while (stack_count > 0)
+	{
+		const struct SpatialNode *node = &tree->nodes[stack[--stack_count]];
+
+		if (!aabb_contains_point(node->box, x, y)) continue;
+
+		if (is_leaf(node)) {
+			if (aabb_contains_point(node->item_box, x, y) && (picked == SPATIAL_NO_ITEM || node->item > picked)) {
+				picked = node->item;
+			}
+		}
+		else if (stack_count + 2 <= SPATIAL_STACK_SIZE) {
+			stack[stack_count++] = node->left;
+			stack[stack_count++] = node->right;
+		}
+		else {
+			stack_overflowed();
+		}
+	}
+
+	return picked;
+}
+
+int32_t spatial_height(const struct SpatialTree *tree)
+{
+	if (tree->root == SPATIAL_NULL_NODE) return 0;
+
+	return tree->nodes[tree->root].height;
+}
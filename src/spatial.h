@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Dynamic AABB tree over renderer items, used for viewport culling and for
+// picking. Leaves store a fattened box so small moves do not touch the tree,
+// and the tree is kept height balanced with AVL style rotations.
+
+#define SPATIAL_NULL_NODE (-1)
+#define SPATIAL_NO_ITEM UINT32_MAX
+
+struct Aabb {
+	float x0, y0, x1, y1;
+};
+
+struct SpatialNode {
+	struct Aabb box;      // fattened for leaves, union of children otherwise
+	struct Aabb item_box; // exact bounds, leaves only
+	int32_t parent;       // next free node while on the free list
+	int32_t left;
+	int32_t right;
+	int32_t height;       // 0 for leaves, -1 while free
+	uint32_t item;
+};
+
+struct SpatialTree {
+	struct SpatialNode *nodes;
+	int32_t capacity;
+	int32_t node_count;
+	int32_t leaf_count;
+	int32_t root;
+	int32_t free_list;
+	float margin;
+};
+
+struct SpatialTree create_spatial_tree(float margin);
+void destroy_spatial_tree(struct SpatialTree *tree);
+
+int32_t spatial_insert(struct SpatialTree *tree, struct Aabb box, uint32_t item);
+void spatial_remove(struct SpatialTree *tree, int32_t proxy);
+bool spatial_update(struct SpatialTree *tree, int32_t proxy, struct Aabb box);
+
+uint32_t spatial_query_rect(const struct SpatialTree *tree, struct Aabb rect, uint32_t *items, uint32_t max_items);
+
+// items whose fattened box overlaps rect, a superset of spatial_query_rect for an exact test to narrow down
+uint32_t spatial_query_candidates(const struct SpatialTree *tree, struct Aabb rect, uint32_t *items, uint32_t max_items);
+uint32_t spatial_query_point(const struct SpatialTree *tree, float x, float y, uint32_t *items, uint32_t max_items);
+uint32_t spatial_pick(const struct SpatialTree *tree, float x, float y);
+
+int32_t spatial_height(const struct SpatialTree *tree);
@@ -0,0 +1,297 @@
+#define _POSIX_C_SOURCE 199309L // clock_gettime
+
+#include <vulkan/vulkan.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+
+#include "render.h"
+#include "stream.h"
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+}
+
+struct StreamBuffer *create_stream_buffer(VkPhysicalDevice physical_device, VkDevice device, uint32_t stride, uint32_t segment_vertices, uint32_t segment_count, uint32_t frames_in_flight, bool strip)
+{
+	struct StreamBuffer *stream = calloc(1, sizeof(struct StreamBuffer));
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physical_device, &properties);
+
+	stream->device = device;
+	stream->stride = stride;
+	stream->segment_vertices = segment_vertices > 2 ? segment_vertices : 2; // room past a carried vertex
+	stream->frames_in_flight = frames_in_flight > 0 ? frames_in_flight : 1;
+	stream->strip = strip;
+	stream->atom_size = properties.limits.nonCoherentAtomSize > 0 ? properties.limits.nonCoherentAtomSize : 1;
+
+	// the oldest segments have to wait out the frames in flight, at least one more stays live
+	stream->segment_count = segment_count > stream->frames_in_flight ? segment_count : stream->frames_in_flight + 1;
+
+	// flushed ranges are rounded out to whole atoms, which have to stay inside the mapping
+	VkDeviceSize size = (VkDeviceSize) stride * stream->segment_vertices * stream->segment_count;
+	size = (size + stream->atom_size - 1) / stream->atom_size * stream->atom_size;
+
+	// any host visible memory, flushes are skipped when it turns out to be coherent
+	stream->buffer = create_buffer(physical_device, device, size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+
+	// a failed buffer was reported, the stream is only destroyed after that
+	stream->coherent = true;
+
+	if (stream->buffer.buffer != VK_NULL_HANDLE) {
+		VkMemoryRequirements requirements;
+		vkGetBufferMemoryRequirements(device, stream->buffer.buffer, &requirements);
+
+		VkPhysicalDeviceMemoryProperties memory_properties;
+		vkGetPhysicalDeviceMemoryProperties(physical_device, &memory_properties);
+
+		uint32_t memory_type = find_memory_type(physical_device, requirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+		stream->coherent = (memory_properties.memoryTypes[memory_type].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+	}
+
+	stream->segments = calloc(stream->segment_count, sizeof(struct StreamSegment));
+	stream->live = calloc(stream->segment_count, sizeof(uint32_t));
+	stream->last_vertex = calloc(1, stride);
+	stream->ranges = calloc(stream->segment_count, sizeof(VkMappedMemoryRange));
+	stream->frame_arrival = calloc(stream->frames_in_flight, sizeof(uint64_t));
+	stream->frame_recorded = calloc(stream->frames_in_flight, sizeof(uint64_t));
+
+	return stream;
+}
+
+void destroy_stream_buffer(struct StreamBuffer *stream)
+{
+	destroy_buffer(stream->device, &stream->buffer);
+
+	free(stream->frame_recorded);
+	free(stream->frame_arrival);
+	free(stream->ranges);
+	free(stream->last_vertex);
+	free(stream->live);
+	free(stream->segments);
+	free(stream);
+}
+
+void begin_stream_frame(struct StreamBuffer *stream, uint64_t frame_index)
+{
+	stream->frame_index = frame_index;
+
+	// the frame that used this slot before has finished
+	uint32_t slot = (uint32_t) (frame_index % stream->frames_in_flight);
+	uint64_t arrival = stream->frame_arrival[slot];
+
+	if (arrival != 0) {
+		struct StreamStats *stats = &stream->stats;
+		// not when the gpu finished, whenever the host came back to the slot after its fence wait
+		uint64_t next_begin = now_ns() - arrival;
+
+		stats->latency_count++;
+		stats->record_ns += stream->frame_recorded[slot] - arrival;
+		stats->next_begin_ns += next_begin;
+		stats->last_next_begin_ns = next_begin;
+		if (next_begin > stats->max_next_begin_ns) stats->max_next_begin_ns = next_begin;
+
+		stream->frame_arrival[slot] = 0;
+	}
+}
+
+void reset_stream(struct StreamBuffer *stream)
+{
+	for (uint32_t i = 0; i < stream->live_count; i++)
+	{
+		stream->segments[stream->live[(stream->live_first + i) % stream->segment_count]].live = false;
+	}
+
+	stream->live_first = 0;
+	stream->live_count = 0;
+	stream->pending_arrival = 0;
+}
+
+static bool segment_free(const struct StreamBuffer *stream, const struct StreamSegment *segment)
+{
+	if (segment->live) return false;
+
+	return !segment->drawn || segment->last_frame + stream->frames_in_flight <= stream->frame_index;
+}
+
+// starts a new newest segment, retiring the oldest live one when the live segments are at their
+// limit; false when every other segment is still in use by the gpu
+static bool open_segment(struct StreamBuffer *stream)
+{
+	bool carry = stream->strip && stream->live_count > 0;
+
+	if (stream->live_count == stream->segment_count - stream->frames_in_flight) {
+		stream->segments[stream->live[stream->live_first]].live = false;
+		stream->live_first = (stream->live_first + 1) % stream->segment_count;
+		stream->live_count--;
+	}
+
+	for (uint32_t i = 0; i < stream->segment_count; i++)
+	{
+		struct StreamSegment *segment = &stream->segments[i];
+		if (!segment_free(stream, segment)) continue;
+
+		if (segment->drawn) stream->stats.recycled++;
+
+		*segment = (struct StreamSegment) {
+			.count = 0,
+			.flushed = 0,
+			.last_frame = 0,
+			.drawn = false,
+			.live = true,
+		};
+
+		if (carry) {
+			memcpy((char *) stream->buffer.mapped + (VkDeviceSize) i * stream->segment_vertices * stream->stride, stream->last_vertex, stream->stride);
+			segment->count = 1;
+		}
+
+		stream->live[(stream->live_first + stream->live_count) % stream->segment_count] = i;
+		stream->live_count++;
+
+		return true;
+	}
+
+	return false;
+}
+
+uint32_t append_stream_vertices(struct StreamBuffer *stream, const void *vertices, uint32_t count)
+{
+	const char *source = vertices;
+	uint32_t written = 0;
+
+	if (count > 0 && stream->pending_arrival == 0) stream->pending_arrival = now_ns();
+
+	while (written < count)
+	{
+		struct StreamSegment *segment = NULL;
+
+		if (stream->live_count > 0) {
+			uint32_t newest = stream->live[(stream->live_first + stream->live_count - 1) % stream->segment_count];
+			segment = &stream->segments[newest];
+		}
+
+		if (segment == NULL || segment->count == stream->segment_vertices) {
+			if (!open_segment(stream)) break;
+			continue;
+		}
+
+		uint32_t index = (uint32_t) (segment - stream->segments);
+		uint32_t room = stream->segment_vertices - segment->count;
+		uint32_t chunk = count - written < room ? count - written : room;
+
+		VkDeviceSize offset = ((VkDeviceSize) index * stream->segment_vertices + segment->count) * stream->stride;
+		memcpy((char *) stream->buffer.mapped + offset, source + (size_t) written * stream->stride, (size_t) chunk * stream->stride);
+
+		segment->count += chunk;
+		written += chunk;
+
+		memcpy(stream->last_vertex, source + (size_t) (written - 1) * stream->stride, stream->stride);
+	}
+
+	stream->stats.appended += written;
+	stream->stats.dropped += count - written;
+
+	return written;
+}
+
+void flush_stream(struct StreamBuffer *stream)
+{
+	uint32_t range_count = 0;
+
+	for (uint32_t i = 0; i < stream->live_count; i++)
+	{
+		uint32_t index = stream->live[(stream->live_first + i) % stream->segment_count];
+		struct StreamSegment *segment = &stream->segments[index];
+
+		if (segment->flushed == segment->count) continue;
+
+		VkDeviceSize base = (VkDeviceSize) index * stream->segment_vertices * stream->stride;
+		VkDeviceSize begin = base + (VkDeviceSize) segment->flushed * stream->stride;
+		VkDeviceSize end = base + (VkDeviceSize) segment->count * stream->stride;
+
+		stream->stats.flushed_bytes += end - begin;
+		segment->flushed = segment->count;
+
+		if (stream->coherent) continue;
+
+		// whole atoms around the new bytes, the buffer size is a multiple of them
+		begin = begin / stream->atom_size * stream->atom_size;
+		end = (end + stream->atom_size - 1) / stream->atom_size * stream->atom_size;
+		if (end > stream->buffer.size) end = stream->buffer.size;
+
+		stream->ranges[range_count++] = (VkMappedMemoryRange) {
+			.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
+			.pNext = NULL,
+			.memory = stream->buffer.memory,
+			.offset = begin,
+			.size = end - begin,
+		};
+	}
+
+	if (range_count > 0) {
+		VkResult result = vkFlushMappedMemoryRanges(stream->device, range_count, stream->ranges);
+		if (result != VK_SUCCESS) printf("failed to flush stream buffer\n");
+
+		stream->stats.flushes++;
+	}
+}
+
+uint32_t push_stream_draws(struct StreamBuffer *stream, struct DrawList *list, const struct DrawCommand *draw)
+{
+	uint32_t draw_count = 0;
+	uint32_t minimum = stream->strip ? 2 : 1;
+
+	for (uint32_t i = 0; i < stream->live_count; i++)
+	{
+		uint32_t index = stream->live[(stream->live_first + i) % stream->segment_count];
+		struct StreamSegment *segment = &stream->segments[index];
+
+		if (segment->flushed < minimum) continue;
+
+		struct DrawCommand command = *draw;
+		command.vertex_buffer = stream->buffer.buffer;
+		command.vertex_offset = 0;
+		command.vertex_count = segment->flushed;
+		command.first_vertex = index * stream->segment_vertices;
+
+		if (!push_draw(list, &command)) break;
+
+		segment->last_frame = stream->frame_index;
+		segment->drawn = true;
+		draw_count++;
+	}
+
+	// what arrived since the last draw is on screen once this frame finishes
+	if (draw_count > 0 && stream->pending_arrival != 0) {
+		uint32_t slot = (uint32_t) (stream->frame_index % stream->frames_in_flight);
+
+		stream->frame_arrival[slot] = stream->pending_arrival;
+		stream->frame_recorded[slot] = now_ns();
+		stream->pending_arrival = 0;
+	}
+
+	return draw_count;
+}
+
+void print_stream_stats(const struct StreamBuffer *stream)
+{
+	const struct StreamStats *stats = &stream->stats;
+	uint32_t latency_count = stats->latency_count > 0 ? stats->latency_count : 1;
+
+	uint32_t live_vertices = 0;
+	for (uint32_t i = 0; i < stream->live_count; i++) live_vertices += stream->segments[stream->live[(stream->live_first + i) % stream->segment_count]].count;
+
+	printf("stream: %llu vertices appended, %llu dropped, %u live in %u of %u segments, %u segments recycled\n", (unsigned long long) stats->appended, (unsigned long long) stats->dropped, live_vertices, stream->live_count, stream->segment_count, stats->recycled);
+	printf("\t%.1f KiB flushed in %u flushes (%s memory)\n", stats->flushed_bytes / 1024.0, stats->flushes, stream->coherent ? "coherent" : "non-coherent");
+	printf("\tarrival to draw recorded %.2f ms average; to the next begin of its frame slot (host, fence and acquire waits included) %.2f ms average, %.2f ms max, %.2f ms last\n", stats->record_ns / 1e6 / latency_count, stats->next_begin_ns / 1e6 / latency_count, stats->max_next_begin_ns / 1e6, stats->last_next_begin_ns / 1e6);
+}
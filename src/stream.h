@@ -0,0 +1,96 @@
+#pragma once
+
+#include "render.h"
+#include "drawlist.h"
+
+// Append-only vertex data for live feeds. One persistently mapped buffer is
+// cut into fixed segments; new vertices are written in place at the end of
+// the newest segment and only the bytes written since the last flush are
+// flushed, so a sample costs a memcpy however long the feed has been
+// running. Every segment is drawn with its own first vertex out of the one
+// vertex buffer binding, nothing is ever copied or rebound.
+//
+// Once the live segments fill all but frames_in_flight of the buffer, the
+// oldest one stops being drawn; it is written again only after the last
+// frame that drew it has finished. Strips carry their last vertex into the
+// next segment so lines stay connected across segment boundaries.
+//
+// Vertices already handed to a frame are never touched again, so appends can
+// go on while the gpu draws the earlier part of the same segment. Latency is
+// measured on the host from the first append after a draw to the draw being
+// recorded, then to the next begin of the frame slot that drew it. That second
+// span is a host-side frame-to-frame delay: it includes the wait for the
+// slot's fence and the next image, so it is an upper bound on the gpu work.
+
+struct StreamSegment {
+	uint32_t count;      // vertices written
+	uint32_t flushed;    // vertices visible to the gpu
+	uint64_t last_frame; // last frame that drew it
+	bool drawn;          // since it was last reused
+	bool live;
+};
+
+struct StreamStats {
+	uint64_t appended;     // vertices, since creation
+	uint64_t dropped;      // no segment was free to take them
+	uint32_t recycled;     // segments reused
+	uint32_t flushes;      // vkFlushMappedMemoryRanges calls, none on coherent memory
+	uint64_t flushed_bytes;
+
+	// host time from arrival to the draw being recorded, then to the next begin of its frame slot
+	uint32_t latency_count;
+	uint64_t record_ns;
+	uint64_t next_begin_ns;
+	uint64_t max_next_begin_ns;
+	uint64_t last_next_begin_ns;
+};
+
+struct StreamBuffer {
+	VkDevice device;
+	struct Buffer buffer;
+	uint32_t stride;
+	uint32_t segment_vertices;
+	uint32_t segment_count;
+	uint32_t frames_in_flight;
+	bool strip;
+	bool coherent;
+	VkDeviceSize atom_size; // nonCoherentAtomSize
+
+	struct StreamSegment *segments;
+	uint32_t *live;          // segment indices, oldest first from live_first
+	uint32_t live_first;
+	uint32_t live_count;
+	uint8_t *last_vertex;    // carried into the next segment of a strip
+	VkMappedMemoryRange *ranges;
+
+	uint64_t frame_index;
+	uint64_t pending_arrival; // earliest append not drawn yet, 0 for none
+	uint64_t *frame_arrival;  // per frame in flight, 0 for none
+	uint64_t *frame_recorded;
+
+	struct StreamStats stats;
+};
+
+// segment_count segments of segment_vertices vertices of stride bytes; strip when the vertices
+// are drawn as one line or triangle strip
+struct StreamBuffer *create_stream_buffer(VkPhysicalDevice physical_device, VkDevice device, uint32_t stride, uint32_t segment_vertices, uint32_t segment_count, uint32_t frames_in_flight, bool strip);
+void destroy_stream_buffer(struct StreamBuffer *stream);
+
+// the previous use of frame_index's slot has to be finished, its frame-to-frame delay is taken here
+void begin_stream_frame(struct StreamBuffer *stream, uint64_t frame_index);
+
+// forgets every vertex, the next append starts a feed of its own; segments frames in flight
+// drew are only written again once those frames are finished
+void reset_stream(struct StreamBuffer *stream);
+
+// copies count vertices after the last ones, returns how many fit
+uint32_t append_stream_vertices(struct StreamBuffer *stream, const void *vertices, uint32_t count);
+
+// makes everything appended so far visible to the gpu, before the frame is submitted
+void flush_stream(struct StreamBuffer *stream);
+
+// one draw per live segment from draw, which sets everything but the vertex buffer and range;
+// only flushed vertices are drawn. Returns the number of draws
+uint32_t push_stream_draws(struct StreamBuffer *stream, struct DrawList *list, const struct DrawCommand *draw);
+
+void print_stream_stats(const struct StreamBuffer *stream);
@@ -0,0 +1,375 @@
+#include <vulkan/vulkan.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "render.h"
+#include "surface.h"
+#include "track.h"
+
+#define fail_surface(surface, result, call) fail_render(&(surface)->error, (result), (call))
+
+static VkResult create_swapchain_objects(struct RenderSurface *surface, struct RenderContext *context)
+{
+	VkResult result = vkGetPhysicalDeviceSurfaceCapabilitiesKHR(context->physical_device, surface->surface, &surface->capabilities);
+	if (result != VK_SUCCESS) return fail_surface(surface, result, "get surface capabilities");
+
+	surface->format = create_format(context->physical_device, surface->surface);
+	surface->present_mode = create_present_mode(context->physical_device, surface->surface);
+	surface->extent = create_swap_extent(surface->window, surface->capabilities);
+
+	uint32_t image_count = create_image_count(surface->capabilities);
+
+	result = try_create_swapchain(context->device, surface->surface, image_count, surface->format, surface->extent, context->indices, surface->capabilities, surface->present_mode, &surface->swapchain);
+
+	// the spare image is for latency, it can go
+	if ((result == VK_ERROR_OUT_OF_HOST_MEMORY || result == VK_ERROR_OUT_OF_DEVICE_MEMORY) && image_count > surface->capabilities.minImageCount) {
+		printf("swapchain with %u images instead of %u: %s\n", surface->capabilities.minImageCount, image_count, get_result_string(result));
+
+		image_count = surface->capabilities.minImageCount;
+		surface->fallbacks++;
+
+		result = try_create_swapchain(context->device, surface->surface, image_count, surface->format, surface->extent, context->indices, surface->capabilities, surface->present_mode, &surface->swapchain);
+	}
+
+	if (result != VK_SUCCESS) return fail_surface(surface, result, "create swapchain");
+
+	// the implementation may make more images than asked for
+	result = vkGetSwapchainImagesKHR(context->device, surface->swapchain, &surface->image_count, NULL);
+	if (result != VK_SUCCESS) return fail_surface(surface, result, "get swapchain images");
+
+	surface->images = malloc(surface->image_count * sizeof(VkImage));
+	surface->image_views = calloc(surface->image_count, sizeof(VkImageView));
+
+	result = vkGetSwapchainImagesKHR(context->device, surface->swapchain, &surface->image_count, surface->images);
+	if (result != VK_SUCCESS) return fail_surface(surface, result, "get swapchain images");
+
+	result = try_create_image_views(context->device, surface->images, surface->image_count, surface->format.format, surface->image_views);
+	if (result != VK_SUCCESS) return fail_surface(surface, result, "create swapchain image views");
+
+	return VK_SUCCESS;
+}
+
+static VkResult create_frame_objects(struct RenderSurface *surface, struct RenderContext *context)
+{
+	VkCommandPoolCreateInfo pool_info = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+		.pNext = NULL,
+		.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+		.queueFamilyIndex = context->indices.graphicsFamily,
+	};
+
+	VkResult result = vkCreateCommandPool(context->device, &pool_info, NULL, &surface->command_pool);
+
+	if (result != VK_SUCCESS) {
+		surface->command_pool = VK_NULL_HANDLE;
+		return fail_surface(surface, result, "create command pool");
+	}
+
+	track_resource(RESOURCE_COMMAND_POOL, surface->command_pool, 0);
+
+	VkSemaphoreCreateInfo semaphore_info = {
+		.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+		.pNext = NULL,
+		.flags = 0,
+	};
+
+	// signaled, the first wait on every slot goes straight through
+	VkFenceCreateInfo fence_info = {
+		.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+		.pNext = NULL,
+		.flags = VK_FENCE_CREATE_SIGNALED_BIT,
+	};
+
+	for (uint32_t i = 0; i < RENDER_SURFACE_FRAMES; i++)
+	{
+		struct SurfaceFrame *frame = &surface->frames[i];
+
+		VkCommandBufferAllocateInfo command_buffer_info = {
+			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+			.pNext = NULL,
+			.commandPool = surface->command_pool,
+			.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+			.commandBufferCount = 1,
+		};
+
+		result = vkAllocateCommandBuffers(context->device, &command_buffer_info, &frame->command_buffer);
+		if (result != VK_SUCCESS) return fail_surface(surface, result, "allocate frame command buffer");
+
+		result = vkCreateSemaphore(context->device, &semaphore_info, NULL, &frame->image_available);
+		if (result != VK_SUCCESS) {
+			frame->image_available = VK_NULL_HANDLE;
+			return fail_surface(surface, result, "create image available semaphore");
+		}
+		track_resource(RESOURCE_SEMAPHORE, frame->image_available, 0);
+
+		result = vkCreateSemaphore(context->device, &semaphore_info, NULL, &frame->render_finished);
+		if (result != VK_SUCCESS) {
+			frame->render_finished = VK_NULL_HANDLE;
+			return fail_surface(surface, result, "create render finished semaphore");
+		}
+		track_resource(RESOURCE_SEMAPHORE, frame->render_finished, 0);
+
+		result = vkCreateFence(context->device, &fence_info, NULL, &frame->in_flight);
+		if (result != VK_SUCCESS) {
+			frame->in_flight = VK_NULL_HANDLE;
+			return fail_surface(surface, result, "create frame fence");
+		}
+		track_resource(RESOURCE_FENCE, frame->in_flight, 0);
+	}
+
+	return VK_SUCCESS;
+}
+
+VkResult create_render_surface(struct RenderSurface *surface, struct RenderContext *context, GLFWwindow *window)
+{
+	*surface = (struct RenderSurface) {
+		.window = window,
+	};
+
+	VkResult result = glfwCreateWindowSurface(context->instance, window, NULL, &surface->surface);
+
+	if (result != VK_SUCCESS) {
+		surface->surface = VK_NULL_HANDLE;
+		fail_surface(surface, result, "create window surface");
+	}
+
+	// the context picked its present queue before there were windows
+	VkBool32 present_support = VK_FALSE;
+
+	if (result == VK_SUCCESS) {
+		result = vkGetPhysicalDeviceSurfaceSupportKHR(context->physical_device, context->indices.presentFamily, surface->surface, &present_support);
+
+		if (result == VK_SUCCESS && !present_support) result = VK_ERROR_INITIALIZATION_FAILED;
+		if (result != VK_SUCCESS) fail_surface(surface, result, "present to the window from the context's present queue");
+	}
+
+	if (result == VK_SUCCESS) result = create_swapchain_objects(surface, context);
+	if (result == VK_SUCCESS) result = create_frame_objects(surface, context);
+
+	if (result != VK_SUCCESS) destroy_render_surface(surface, context);
+
+	return result;
+}
+
+void destroy_render_surface(struct RenderSurface *surface, struct RenderContext *context)
+{
+	VkDevice device = context->device;
+
+	for (uint32_t i = 0; i < RENDER_SURFACE_FRAMES; i++)
+	{
+		struct SurfaceFrame *frame = &surface->frames[i];
+
+		untrack_resource(RESOURCE_FENCE, frame->in_flight);
+		if (frame->in_flight != VK_NULL_HANDLE) vkDestroyFence(device, frame->in_flight, NULL);
+		untrack_resource(RESOURCE_SEMAPHORE, frame->render_finished);
+		if (frame->render_finished != VK_NULL_HANDLE) vkDestroySemaphore(device, frame->render_finished, NULL);
+		untrack_resource(RESOURCE_SEMAPHORE, frame->image_available);
+		if (frame->image_available != VK_NULL_HANDLE) vkDestroySemaphore(device, frame->image_available, NULL);
+	}
+
+	// frees the command buffers with it
+	untrack_resource(RESOURCE_COMMAND_POOL, surface->command_pool);
+	if (surface->command_pool != VK_NULL_HANDLE) vkDestroyCommandPool(device, surface->command_pool, NULL);
+
+	for (uint32_t i = 0; i < surface->image_count && surface->image_views != NULL; i++)
+	{
+		untrack_resource(RESOURCE_IMAGE_VIEW, surface->image_views[i]);
+		if (surface->image_views[i] != VK_NULL_HANDLE) vkDestroyImageView(device, surface->image_views[i], NULL);
+	}
+
+	if (surface->swapchain != VK_NULL_HANDLE) vkDestroySwapchainKHR(device, surface->swapchain, NULL);
+	if (surface->surface != VK_NULL_HANDLE) vkDestroySurfaceKHR(context->instance, surface->surface, NULL);
+
+	free(surface->image_views);
+	free(surface->images);
+
+	// the error stays, for whoever looks after a failed creation
+	struct RenderError error = surface->error;
+
+	*surface = (struct RenderSurface) {
+		.window = surface->window,
+		.error = error,
+	};
+}
+
+struct SurfaceFrame *current_surface_frame(struct RenderSurface *surface)
+{
+	return &surface->frames[surface->frame_index % RENDER_SURFACE_FRAMES];
+}
+
+// after a failed submit the acquire's signal is never waited on, and a signaled semaphore cannot be
+// acquired with again; the slot gets a fresh one, and a slot left without one makes it again here
+static VkResult replace_image_available(struct SurfaceFrame *frame, struct RenderContext *context)
+{
+	if (frame->image_available != VK_NULL_HANDLE) {
+		vkDeviceWaitIdle(context->device);
+
+		untrack_resource(RESOURCE_SEMAPHORE, frame->image_available);
+		vkDestroySemaphore(context->device, frame->image_available, NULL);
+	}
+
+	VkSemaphoreCreateInfo semaphore_info = {
+		.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+		.pNext = NULL,
+		.flags = 0,
+	};
+
+	VkResult result = vkCreateSemaphore(context->device, &semaphore_info, NULL, &frame->image_available);
+
+	if (result != VK_SUCCESS) {
+		frame->image_available = VK_NULL_HANDLE;
+		return result;
+	}
+
+	track_resource(RESOURCE_SEMAPHORE, frame->image_available, 0);
+
+	return VK_SUCCESS;
+}
+
+VkResult begin_surface_frame(struct RenderSurface *surface, struct RenderContext *context)
+{
+	surface->frame_index++;
+	surface->acquired = false;
+
+	struct SurfaceFrame *frame = current_surface_frame(surface);
+
+	// a slot whose last submit failed has an unsignaled fence nothing is going to signal, only
+	// wait on one that was submitted
+	if (frame->submitted) {
+		VkResult result = vkWaitForFences(context->device, 1, &frame->in_flight, VK_TRUE, UINT64_MAX);
+		if (result != VK_SUCCESS) return result;
+
+		render_frame_finished(context);
+		frame->submitted = false;
+	}
+
+	if (frame->image_available == VK_NULL_HANDLE) {
+		VkResult result = replace_image_available(frame, context);
+		if (result != VK_SUCCESS) return result;
+	}
+
+	VkResult result = vkAcquireNextImageKHR(context->device, surface->swapchain, UINT64_MAX, frame->image_available, VK_NULL_HANDLE, &surface->image_index);
+
+	// a fixed size window never has to be resized, the image is still good to present
+	if (result == VK_SUBOPTIMAL_KHR) result = VK_SUCCESS;
+	if (result != VK_SUCCESS) return result;
+
+	surface->acquired = true;
+
+	vkResetCommandBuffer(frame->command_buffer, 0);
+
+	return VK_SUCCESS;
+}
+
+VkResult submit_surface_frame(struct RenderSurface *surface, struct RenderContext *context)
+{
+	struct SurfaceFrame *frame = current_surface_frame(surface);
+
+	// the submit signals it again; if the submit fails, frame->submitted stays false and
+	// begin_surface_frame does not wait on it. The acquired image stays held until the swapchain
+	// is made again, which recovery does for everything a submit can fail with
+	VkResult result = vkResetFences(context->device, 1, &frame->in_flight);
+	if (result != VK_SUCCESS) {
+		surface->acquired = false;
+		replace_image_available(frame, context);
+		return result;
+	}
+
+	VkSubmitInfo submit_info = {
+		.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+		.pNext = NULL,
+		.waitSemaphoreCount = 1,
+		.pWaitSemaphores = &frame->image_available,
+		.pWaitDstStageMask = &(VkPipelineStageFlags) {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT},
+		.commandBufferCount = 1,
+		.pCommandBuffers = &frame->command_buffer,
+		.signalSemaphoreCount = 1,
+		.pSignalSemaphores = &frame->render_finished,
+	};
+
+	result = vkQueueSubmit(context->graphics_queue, 1, &submit_info, frame->in_flight);
+
+	if (result != VK_SUCCESS) {
+		surface->acquired = false;
+		replace_image_available(frame, context);
+		return result;
+	}
+
+	frame->submitted = true;
+
+	return VK_SUCCESS;
+}
+
+// what decides the result of a batch: losses first, then memory, then everything else
+static uint32_t result_severity(VkResult result)
+{
+	if (result == VK_ERROR_DEVICE_LOST) return 5;
+	if (result == VK_ERROR_SURFACE_LOST_KHR) return 4;
+	if (result == VK_ERROR_OUT_OF_HOST_MEMORY || result == VK_ERROR_OUT_OF_DEVICE_MEMORY) return 3;
+	if (result < 0) return 2;
+	if (result != VK_SUCCESS) return 1;
+
+	return 0;
+}
+
+VkResult present_surfaces(struct RenderContext *context, struct RenderSurface *surfaces, uint32_t surface_count)
+{
+	VkSwapchainKHR swapchains[RENDER_MAX_SURFACES];
+	uint32_t image_indices[RENDER_MAX_SURFACES];
+	VkSemaphore wait_semaphores[RENDER_MAX_SURFACES];
+	VkResult results[RENDER_MAX_SURFACES];
+	struct RenderSurface *presented[RENDER_MAX_SURFACES];
+	uint32_t present_count = 0;
+
+	for (uint32_t i = 0; i < surface_count; i++)
+	{
+		struct RenderSurface *surface = &surfaces[i];
+		struct SurfaceFrame *frame = current_surface_frame(surface);
+
+		surface->present_result = VK_SUCCESS;
+
+		if (!surface->acquired || !frame->submitted) continue;
+
+		if (present_count == RENDER_MAX_SURFACES) {
+			printf("failed to present more than %u surfaces together\n", RENDER_MAX_SURFACES);
+			break;
+		}
+
+		swapchains[present_count] = surface->swapchain;
+		image_indices[present_count] = surface->image_index;
+		wait_semaphores[present_count] = frame->render_finished;
+		results[present_count] = VK_SUCCESS;
+		presented[present_count] = surface;
+		present_count++;
+	}
+
+	if (present_count == 0) return VK_SUCCESS;
+
+	VkPresentInfoKHR present_info = {
+		.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
+		.pNext = NULL,
+		.waitSemaphoreCount = present_count,
+		.pWaitSemaphores = wait_semaphores,
+		.swapchainCount = present_count,
+		.pSwapchains = swapchains,
+		.pImageIndices = image_indices,
+		.pResults = results,
+	};
+
+	VkResult result = vkQueuePresentKHR(context->present_queue, &present_info);
+
+	// the call's result is the worst of them, but a lost device may leave the rest unwritten
+	for (uint32_t i = 0; i < present_count; i++)
+	{
+		presented[i]->present_result = result_severity(result) > result_severity(results[i]) ? result : results[i];
+		presented[i]->acquired = false;
+
+		if (result_severity(presented[i]->present_result) > result_severity(result)) result = presented[i]->present_result;
+	}
+
+	return result;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "render.h"
+#include "context.h"
+
+// A window drawn to through a shared RenderContext: its surface, swapchain
+// and RENDER_SURFACE_FRAMES frame slots, each with its own command buffer,
+// semaphores and fence. Any number of surfaces share the context's device
+// and queues. There is a single slot for now, not a ring: the scene's
+// uniform, instance and readback buffers are sized for one frame in flight,
+// so each frame waits for the one before it.
+//
+// A frame goes through begin_surface_frame, which waits for the slot and
+// acquires an image, then submit_surface_frame once its command buffer is
+// recorded. present_surfaces then hands every submitted image of every
+// surface to the present queue in one vkQueuePresentKHR, so windows on
+// different displays flip together and the driver sees one present per
+// frame instead of one per window.
+//
+// A swapchain that runs out of memory is made again with fewer images.
+
+#define RENDER_SURFACE_FRAMES 1 // frames in flight per surface, raise it together with the scene's buffers
+#define RENDER_MAX_SURFACES 16  // presented together
+
+struct SurfaceFrame {
+	VkCommandBuffer command_buffer;
+	VkSemaphore image_available;
+	VkSemaphore render_finished;
+	VkFence in_flight;
+	bool submitted; // since its fence was last waited for, the fence is only waited on while set
+};
+
+struct RenderSurface {
+	GLFWwindow *window;
+	VkSurfaceKHR surface;
+	VkSurfaceFormatKHR format;
+	VkPresentModeKHR present_mode;
+	VkSurfaceCapabilitiesKHR capabilities;
+	VkExtent2D extent;
+	VkSwapchainKHR swapchain;
+	uint32_t image_count;
+	VkImage *images;
+	VkImageView *image_views;
+
+	VkCommandPool command_pool; // also lent out for uploads to what draws into the surface
+	struct SurfaceFrame frames[RENDER_SURFACE_FRAMES];
+	uint64_t frame_index; // frames begun
+	uint32_t image_index; // acquired by begin_surface_frame
+	bool acquired;        // an image is waiting to be submitted and presented
+	VkResult present_result;
+
+	struct RenderError error; // the first failure creating it
+	uint32_t fallbacks;
+};
+
+// on failure nothing is left to destroy and surface->error says what failed
+VkResult create_render_surface(struct RenderSurface *surface, struct RenderContext *context, GLFWwindow *window);
+void destroy_render_surface(struct RenderSurface *surface, struct RenderContext *context);
+
+// the frame begun last
+struct SurfaceFrame *current_surface_frame(struct RenderSurface *surface);
+
+// waits for the next frame slot and acquires an image, then resets the slot's command buffer;
+// without an image acquired the surface sits this frame out
+VkResult begin_surface_frame(struct RenderSurface *surface, struct RenderContext *context);
+
+// submits the recorded command buffer, after the acquire and before the present
+VkResult submit_surface_frame(struct RenderSurface *surface, struct RenderContext *context);
+
+// presents the submitted image of every surface that has one with a single vkQueuePresentKHR,
+// RENDER_MAX_SURFACES at most; returns the worst result, each surface's own is in present_result
+VkResult present_surfaces(struct RenderContext *context, struct RenderSurface *surfaces, uint32_t surface_count);
@@ -0,0 +1,78 @@
+#include <vulkan/vulkan.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "render.h"
+#include "timer.h"
+#include "track.h"
+
+struct GpuTimer create_gpu_timer(VkPhysicalDevice physical_device, VkDevice device, uint32_t query_count)
+{
+	struct GpuTimer timer = {0};
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physical_device, &properties);
+
+	timer.query_count = query_count;
+	timer.period = properties.limits.timestampPeriod;
+	timer.supported = properties.limits.timestampComputeAndGraphics && properties.limits.timestampPeriod > 0.0f;
+
+	if (!timer.supported) {
+		printf("gpu timestamps are not supported, gpu times will not be reported\n");
+		return timer;
+	}
+
+	VkQueryPoolCreateInfo pool_info = {
+		.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+		.pNext = NULL,
+		.flags = 0,
+		.queryType = VK_QUERY_TYPE_TIMESTAMP,
+		.queryCount = query_count,
+		.pipelineStatistics = 0,
+	};
+
+	VkResult result = vkCreateQueryPool(device, &pool_info, NULL, &timer.pool);
+	if (result != VK_SUCCESS) {
+		printf("failed to create timestamp query pool\n");
+		timer.supported = false;
+	}
+
+	if (result == VK_SUCCESS) track_resource(RESOURCE_QUERY_POOL, timer.pool, 0);
+
+	return timer;
+}
+
+void destroy_gpu_timer(VkDevice device, struct GpuTimer *timer)
+{
+	untrack_resource(RESOURCE_QUERY_POOL, timer->pool);
+	if (timer->supported) vkDestroyQueryPool(device, timer->pool, NULL);
+}
+
+void reset_gpu_timer(VkCommandBuffer command_buffer, struct GpuTimer *timer, uint32_t first, uint32_t count)
+{
+	if (timer->supported) vkCmdResetQueryPool(command_buffer, timer->pool, first, count);
+}
+
+void write_gpu_timestamp(VkCommandBuffer command_buffer, struct GpuTimer *timer, VkPipelineStageFlagBits stage, uint32_t query)
+{
+	if (timer->supported) vkCmdWriteTimestamp(command_buffer, stage, timer->pool, query);
+}
+
+double read_gpu_elapsed(VkDevice device, struct GpuTimer *timer, uint32_t begin)
+{
+	if (!timer->supported) return -1.0;
+
+	uint64_t ticks[2];
+
+	VkResult result = vkGetQueryPoolResults(device, timer->pool, begin, 2, sizeof(ticks), ticks, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+	if (result != VK_SUCCESS) {
+		printf("failed to read timestamps\n");
+		return -1.0;
+	}
+
+	return (double) (ticks[1] - ticks[0]) * timer->period / 1e6;
+}
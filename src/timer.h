@@ -0,0 +1,23 @@
+#pragma once
+
+#include "render.h"
+
+// GPU timestamps. Queries are written in pairs around the work being timed
+// and read back once the submission has finished.
+
+struct GpuTimer {
+	VkQueryPool pool;
+	uint32_t query_count;
+	double period; // nanoseconds per tick
+	bool supported;
+};
+
+struct GpuTimer create_gpu_timer(VkPhysicalDevice physical_device, VkDevice device, uint32_t query_count);
+void destroy_gpu_timer(VkDevice device, struct GpuTimer *timer);
+
+// queries have to be reset before they are written again, outside a render pass
+void reset_gpu_timer(VkCommandBuffer command_buffer, struct GpuTimer *timer, uint32_t first, uint32_t count);
+void write_gpu_timestamp(VkCommandBuffer command_buffer, struct GpuTimer *timer, VkPipelineStageFlagBits stage, uint32_t query);
+
+// milliseconds between queries begin and begin + 1, waits for both; negative when unsupported
+double read_gpu_elapsed(VkDevice device, struct GpuTimer *timer, uint32_t begin);
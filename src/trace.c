@@ -0,0 +1,369 @@
+#define _POSIX_C_SOURCE 200809L // mmap, posix_madvise
+
+#include <vulkan/vulkan.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "render.h"
+#include "trace.h"
+
+static uint64_t align8(uint64_t value)
+{
+	return (value + 7) & ~(uint64_t) 7;
+}
+
+static void write_bytes(struct TraceWriter *writer, const void *data, size_t size)
+{
+	static const uint8_t zeros[8] = {0};
+
+	fwrite(data, 1, size, writer->file);
+	writer->offset += size;
+
+	size_t padding = align8(writer->offset) - writer->offset;
+	fwrite(zeros, 1, padding, writer->file);
+	writer->offset += padding;
+}
+
+static void write_record(struct TraceWriter *writer, enum TraceOp op, const void *payload, uint32_t size)
+{
+	struct TraceRecord record = {
+		.op = op,
+		.size = size,
+	};
+
+	write_bytes(writer, &record, sizeof(record));
+	write_bytes(writer, payload, size);
+}
+
+struct TraceWriter *open_trace_writer(const char *path, VkExtent2D extent, const struct SceneSetup *setup)
+{
+	FILE *file = fopen(path, "wb");
+	if (file == NULL) {
+		printf("failed to open trace %s\n", path);
+		return NULL;
+	}
+
+	struct TraceWriter *writer = calloc(1, sizeof(struct TraceWriter));
+
+	writer->file = file;
+	writer->frame_capacity = 1024;
+	writer->frame_offsets = malloc(writer->frame_capacity * sizeof(uint64_t));
+
+	writer->header = (struct TraceHeader) {
+		.magic = TRACE_MAGIC,
+		.version = TRACE_VERSION,
+		.width = extent.width,
+		.height = extent.height,
+	};
+
+	// zeroed until close, an unfinished trace has no magic
+	struct TraceHeader placeholder = {0};
+	write_bytes(writer, &placeholder, sizeof(placeholder));
+
+	writer->header.setup_offset = writer->offset;
+
+	struct TraceSetup trace_setup = {
+		.sprite_count = setup->sprite_count,
+		.clip_count = setup->clip_count,
+		.panel_size = {setup->panel_size[0], setup->panel_size[1]},
+		.shadow_radius = setup->shadow_radius,
+		.line_point_count = setup->line_point_count,
+	};
+
+	if (setup->panel_image != NULL) {
+		snprintf(trace_setup.panel_image, sizeof(trace_setup.panel_image), "%s", setup->panel_image);
+	}
+
+	write_bytes(writer, &trace_setup, sizeof(trace_setup));
+	write_bytes(writer, setup->sprites, setup->sprite_count * sizeof(struct SpriteInstance));
+	write_bytes(writer, setup->clips, setup->clip_count * sizeof(struct ClipRect));
+	write_bytes(writer, setup->line_points, (size_t) setup->line_point_count * 2 * sizeof(float));
+
+	return writer;
+}
+
+void write_trace_frame(struct TraceWriter *writer, const struct SceneFrame *frame)
+{
+	if (writer->frame_count == writer->frame_capacity) {
+		writer->frame_capacity *= 2;
+		writer->frame_offsets = realloc(writer->frame_offsets, writer->frame_capacity * sizeof(uint64_t));
+	}
+
+	writer->frame_offsets[writer->frame_count++] = writer->offset;
+
+	struct TraceFrame trace_frame = {
+		.time = frame->time,
+		.view = frame->view,
+	};
+
+	write_record(writer, TRACE_OP_FRAME, &trace_frame, sizeof(trace_frame));
+
+	for (uint32_t i = 0; i < frame->triangle_count; i++)
+	{
+		write_record(writer, TRACE_OP_TRIANGLE, &frame->triangles[i], sizeof(struct SceneTriangle));
+	}
+
+	struct TracePanel panel = {
+		.position = {frame->panel_position[0], frame->panel_position[1]},
+		.color = {frame->panel_color[0], frame->panel_color[1], frame->panel_color[2], frame->panel_color[3]},
+	};
+
+	write_record(writer, TRACE_OP_PANEL, &panel, sizeof(panel));
+
+	// shapes go as one record each way, thousands of them are common
+	uint32_t gradient_count = frame->gradient_count < SCENE_MAX_GRADIENTS ? frame->gradient_count : SCENE_MAX_GRADIENTS;
+	uint32_t shape_count = frame->shape_count < SCENE_MAX_SHAPES ? frame->shape_count : SCENE_MAX_SHAPES;
+	uint32_t clip_count = frame->clip_count < SCENE_MAX_CLIPS ? frame->clip_count : SCENE_MAX_CLIPS;
+	uint32_t line_count = frame->line_count < SCENE_MAX_LINES ? frame->line_count : SCENE_MAX_LINES;
+	uint32_t point_count = frame->line_point_count < SCENE_MAX_FRAME_POINTS ? frame->line_point_count : SCENE_MAX_FRAME_POINTS;
+
+	if (clip_count > 0) write_record(writer, TRACE_OP_CLIPS, frame->clips, clip_count * sizeof(struct SceneClip));
+	if (gradient_count > 0) write_record(writer, TRACE_OP_GRADIENTS, frame->gradients, gradient_count * sizeof(struct Gradient));
+	if (shape_count > 0) write_record(writer, TRACE_OP_SHAPES, frame->shapes, shape_count * sizeof(struct SceneShape));
+	if (line_count > 0) write_record(writer, TRACE_OP_LINES, frame->lines, line_count * sizeof(struct SceneLine));
+	if (point_count > 0) write_record(writer, TRACE_OP_POINTS, frame->line_points, point_count * 2 * sizeof(float));
+
+	// the tile moves every frame, the vertices follow it in the same record
+	uint32_t stream_count = frame->stream_count < SCENE_MAX_STREAM_VERTICES ? frame->stream_count : SCENE_MAX_STREAM_VERTICES;
+
+	struct TraceStream stream = {
+		.tile = {frame->stream_tile[0], frame->stream_tile[1], frame->stream_tile[2], frame->stream_tile[3]},
+	};
+
+	struct TraceRecord stream_record = {
+		.op = TRACE_OP_STREAM,
+		.size = sizeof(stream) + stream_count * sizeof(struct Vertex),
+	};
+
+	write_bytes(writer, &stream_record, sizeof(stream_record));
+	write_bytes(writer, &stream, sizeof(stream));
+	write_bytes(writer, frame->stream_vertices, stream_count * sizeof(struct Vertex));
+}
+
+void close_trace_writer(struct TraceWriter *writer)
+{
+	writer->header.frame_count = writer->frame_count;
+	writer->header.index_offset = writer->offset;
+
+	write_bytes(writer, writer->frame_offsets, writer->frame_count * sizeof(uint64_t));
+
+	fseek(writer->file, 0, SEEK_SET);
+	fwrite(&writer->header, 1, sizeof(writer->header), writer->file);
+	fclose(writer->file);
+
+	printf("trace: %u frames, %.1f KB\n", writer->frame_count, writer->offset / 1024.0);
+
+	free(writer->frame_offsets);
+	free(writer);
+}
+
+bool open_trace_reader(const char *path, struct TraceReader *reader)
+{
+	*reader = (struct TraceReader) {
+		.fd = -1,
+	};
+
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		printf("failed to open trace %s\n", path);
+		return false;
+	}
+
+	struct stat info;
+	if (fstat(fd, &info) != 0 || (size_t) info.st_size < sizeof(struct TraceHeader)) {
+		printf("failed to read trace %s\n", path);
+		close(fd);
+		return false;
+	}
+
+	void *data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (data == MAP_FAILED) {
+		printf("failed to map trace %s\n", path);
+		close(fd);
+		return false;
+	}
+
+	reader->fd = fd;
+	reader->data = data;
+	reader->size = info.st_size;
+	reader->header = data;
+
+	const struct TraceHeader *header = reader->header;
+
+	bool valid = header->magic == TRACE_MAGIC &&
+		header->version == TRACE_VERSION &&
+		header->setup_offset + sizeof(struct TraceSetup) <= reader->size &&
+		header->index_offset + header->frame_count * sizeof(uint64_t) <= reader->size;
+
+	if (!valid) {
+		printf("failed to load trace %s, not a finished version %u trace\n", path, TRACE_VERSION);
+		close_trace_reader(reader);
+		return false;
+	}
+
+	const struct TraceSetup *setup = (const struct TraceSetup *) (reader->data + header->setup_offset);
+	uint64_t setup_end = header->setup_offset + align8(sizeof(struct TraceSetup)) + align8((uint64_t) setup->sprite_count * sizeof(struct SpriteInstance)) + align8((uint64_t) setup->clip_count * sizeof(struct ClipRect)) + (uint64_t) setup->line_point_count * 2 * sizeof(float);
+
+	if (setup_end > header->index_offset || memchr(setup->panel_image, 0, sizeof(setup->panel_image)) == NULL) {
+		printf("failed to load trace %s, bad setup\n", path);
+		close_trace_reader(reader);
+		return false;
+	}
+
+	reader->index = (const uint64_t *) (reader->data + header->index_offset);
+
+	// frames are read in order, the kernel can read ahead
+	posix_madvise((void *) reader->data, reader->size, POSIX_MADV_SEQUENTIAL);
+
+	return true;
+}
+
+void close_trace_reader(struct TraceReader *reader)
+{
+	if (reader->data != NULL) munmap((void *) reader->data, reader->size);
+	if (reader->fd >= 0) close(reader->fd);
+
+	*reader = (struct TraceReader) {
+		.fd = -1,
+	};
+}
+
+struct SceneSetup trace_setup(const struct TraceReader *reader)
+{
+	const uint8_t *data = reader->data + reader->header->setup_offset;
+	const struct TraceSetup *setup = (const struct TraceSetup *) data;
+
+	uint64_t sprites_offset = align8(sizeof(struct TraceSetup));
+	uint64_t clips_offset = sprites_offset + align8(setup->sprite_count * sizeof(struct SpriteInstance));
+	uint64_t points_offset = clips_offset + align8(setup->clip_count * sizeof(struct ClipRect));
+
+	struct SceneSetup scene_setup = {
+		.sprites = (const struct SpriteInstance *) (data + sprites_offset),
+		.sprite_count = setup->sprite_count,
+		.clips = (const struct ClipRect *) (data + clips_offset),
+		.clip_count = setup->clip_count,
+		.line_points = (const float *) (data + points_offset),
+		.line_point_count = setup->line_point_count,
+		.panel_size = {setup->panel_size[0], setup->panel_size[1]},
+		.shadow_radius = setup->shadow_radius,
+		.panel_image = setup->panel_image[0] != '\0' ? setup->panel_image : NULL,
+		.vertex_layout = VERTEX_LAYOUT_COMPACT,
+	};
+
+	return scene_setup;
+}
+
+bool read_trace_frame(const struct TraceReader *reader, uint32_t index, struct SceneFrame *frame)
+{
+	if (index >= reader->header->frame_count) return false;
+
+	uint64_t offset = reader->index[index];
+	uint64_t end = index + 1 < reader->header->frame_count ? reader->index[index + 1] : reader->header->index_offset;
+
+	// records are read in place through struct pointers, they have to start 8 byte aligned
+	if (offset > end || end > reader->header->index_offset || offset % 8 != 0) {
+		printf("failed to read trace frame %u, bad index\n", index);
+		return false;
+	}
+
+	// a frame without a record for something has none of it, nothing is left from the frame before
+	frame->time = 0.0f;
+	frame->view = (struct ClipRect) {0.0f, 0.0f, 0.0f, 0.0f};
+	memset(frame->panel_position, 0, sizeof(frame->panel_position));
+	memset(frame->panel_color, 0, sizeof(frame->panel_color));
+	frame->triangle_count = 0;
+	frame->gradient_count = 0;
+	frame->shape_count = 0;
+	frame->clip_count = 0;
+	frame->line_count = 0;
+	frame->line_point_count = 0;
+	frame->stream_count = 0;
+	memset(frame->stream_tile, 0, sizeof(frame->stream_tile));
+
+	while (offset + sizeof(struct TraceRecord) <= end)
+	{
+		const struct TraceRecord *record = (const struct TraceRecord *) (reader->data + offset);
+		const uint8_t *payload = reader->data + offset + sizeof(struct TraceRecord);
+
+		if (offset + sizeof(struct TraceRecord) + record->size > end) {
+			printf("failed to read trace frame %u, record runs past the frame\n", index);
+			return false;
+		}
+
+		// records this version does not know are skipped
+		switch (record->op)
+		{
+			case TRACE_OP_FRAME: {
+				if (record->size < sizeof(struct TraceFrame)) break;
+				const struct TraceFrame *trace_frame = (const struct TraceFrame *) payload;
+				frame->time = trace_frame->time;
+				frame->view = trace_frame->view;
+				break;
+			}
+			case TRACE_OP_TRIANGLE:
+				if (record->size >= sizeof(struct SceneTriangle) && frame->triangle_count < SCENE_MAX_TRIANGLES) {
+					memcpy(&frame->triangles[frame->triangle_count++], payload, sizeof(struct SceneTriangle));
+				}
+				break;
+			case TRACE_OP_PANEL: {
+				if (record->size < sizeof(struct TracePanel)) break;
+				const struct TracePanel *panel = (const struct TracePanel *) payload;
+				memcpy(frame->panel_position, panel->position, sizeof(frame->panel_position));
+				memcpy(frame->panel_color, panel->color, sizeof(frame->panel_color));
+				break;
+			}
+			case TRACE_OP_GRADIENTS: {
+				uint32_t count = record->size / sizeof(struct Gradient);
+				frame->gradient_count = count < SCENE_MAX_GRADIENTS ? count : SCENE_MAX_GRADIENTS;
+				memcpy(frame->gradients, payload, frame->gradient_count * sizeof(struct Gradient));
+				break;
+			}
+			case TRACE_OP_SHAPES: {
+				uint32_t count = record->size / sizeof(struct SceneShape);
+				frame->shape_count = count < SCENE_MAX_SHAPES ? count : SCENE_MAX_SHAPES;
+				memcpy(frame->shapes, payload, frame->shape_count * sizeof(struct SceneShape));
+				break;
+			}
+			case TRACE_OP_CLIPS: {
+				uint32_t count = record->size / sizeof(struct SceneClip);
+				frame->clip_count = count < SCENE_MAX_CLIPS ? count : SCENE_MAX_CLIPS;
+				memcpy(frame->clips, payload, frame->clip_count * sizeof(struct SceneClip));
+				break;
+			}
+			case TRACE_OP_LINES: {
+				uint32_t count = record->size / sizeof(struct SceneLine);
+				frame->line_count = count < SCENE_MAX_LINES ? count : SCENE_MAX_LINES;
+				memcpy(frame->lines, payload, frame->line_count * sizeof(struct SceneLine));
+				break;
+			}
+			case TRACE_OP_POINTS: {
+				uint32_t count = record->size / (2 * sizeof(float));
+				frame->line_point_count = count < SCENE_MAX_FRAME_POINTS ? count : SCENE_MAX_FRAME_POINTS;
+				memcpy(frame->line_points, payload, frame->line_point_count * 2 * sizeof(float));
+				break;
+			}
+			case TRACE_OP_STREAM: {
+				if (record->size < sizeof(struct TraceStream)) break;
+				const struct TraceStream *stream = (const struct TraceStream *) payload;
+				memcpy(frame->stream_tile, stream->tile, sizeof(frame->stream_tile));
+
+				uint32_t count = (record->size - sizeof(struct TraceStream)) / sizeof(struct Vertex);
+				frame->stream_count = count < SCENE_MAX_STREAM_VERTICES ? count : SCENE_MAX_STREAM_VERTICES;
+				memcpy(frame->stream_vertices, payload + sizeof(struct TraceStream), frame->stream_count * sizeof(struct Vertex));
+				break;
+			}
+		}
+
+		offset += sizeof(struct TraceRecord) + align8(record->size);
+	}
+
+	return true;
+}
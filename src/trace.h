@@ -0,0 +1,103 @@
+#pragma once
+
+#include "scene.h"
+
+// Binary trace of scene frames, for reproducing performance problems away
+// from the application that produced them. All values are little endian and
+// every record starts 8 byte aligned, so a trace is read straight out of an
+// mmap without copying:
+//
+//   TraceHeader
+//   setup:  TraceSetup, sprites[sprite_count], clips[clip_count],
+//           line points[line_point_count]
+//   frames: TRACE_OP_FRAME record followed by that frame's draw records
+//   index:  uint64_t offset of every frame's first record
+//
+// The header is written last, so a trace cut short by a crash has no index
+// and is rejected rather than half replayed.
+
+#define TRACE_MAGIC 0x52544756 // "VGTR"
+#define TRACE_VERSION 2
+
+enum TraceOp {
+	TRACE_OP_FRAME,     // struct TraceFrame
+	TRACE_OP_TRIANGLE,  // struct SceneTriangle
+	TRACE_OP_PANEL,     // struct TracePanel
+	TRACE_OP_GRADIENTS, // struct Gradient, as many as fit the record
+	TRACE_OP_SHAPES,    // struct SceneShape, as many as fit the record
+	TRACE_OP_CLIPS,     // struct SceneClip, as many as fit the record
+	TRACE_OP_LINES,     // struct SceneLine, as many as fit the record
+	TRACE_OP_POINTS,    // x, y pairs of the frame's line points, as many as fit the record
+	TRACE_OP_STREAM,    // struct TraceStream, then struct Vertex, as many as fit the record
+};
+
+struct TraceHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t width;
+	uint32_t height;
+	uint32_t frame_count;
+	uint32_t pad;
+	uint64_t setup_offset;
+	uint64_t index_offset;
+};
+
+struct TraceSetup {
+	uint32_t sprite_count;
+	uint32_t clip_count;
+	float panel_size[2];
+	float shadow_radius;
+	uint32_t line_point_count; // x, y pairs
+	char panel_image[256]; // empty for none
+};
+
+struct TraceRecord {
+	uint32_t op;
+	uint32_t size; // payload bytes, the next record follows 8 byte aligned
+};
+
+struct TraceFrame {
+	float time;
+	struct ClipRect view;
+};
+
+struct TraceStream {
+	float tile[4];
+};
+
+struct TracePanel {
+	float position[2];
+	float color[4];
+};
+
+struct TraceWriter {
+	FILE *file;
+	uint64_t offset;
+
+	uint64_t *frame_offsets;
+	uint32_t frame_count;
+	uint32_t frame_capacity;
+
+	struct TraceHeader header;
+};
+
+struct TraceReader {
+	int fd;
+	const uint8_t *data;
+	size_t size;
+
+	const struct TraceHeader *header;
+	const uint64_t *index;
+};
+
+// returns NULL when path cannot be created
+struct TraceWriter *open_trace_writer(const char *path, VkExtent2D extent, const struct SceneSetup *setup);
+void write_trace_frame(struct TraceWriter *writer, const struct SceneFrame *frame);
+void close_trace_writer(struct TraceWriter *writer);
+
+bool open_trace_reader(const char *path, struct TraceReader *reader);
+void close_trace_reader(struct TraceReader *reader);
+
+// the returned setup points into the mapping, it lives as long as the reader
+struct SceneSetup trace_setup(const struct TraceReader *reader);
+bool read_trace_frame(const struct TraceReader *reader, uint32_t index, struct SceneFrame *frame);
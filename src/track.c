@@ -0,0 +1,315 @@
+#define _POSIX_C_SOURCE 200809L // rename
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "track.h"
+
+#define TRACK_INITIAL_CAPACITY 1024 // power of two
+#define TRACK_EMPTY UINT32_MAX
+#define TRACK_DELETED (UINT32_MAX - 1)
+
+struct TrackedResource {
+	uint64_t handle;
+	uint64_t bytes;
+	const char *file;
+	uint32_t line;
+	uint32_t type; // TRACK_EMPTY or TRACK_DELETED for free slots
+};
+
+// open addressing, linear probing; deleted slots are reclaimed when the table is rebuilt
+static struct {
+	pthread_mutex_t lock;
+	struct TrackedResource *slots;
+	uint32_t capacity;
+	uint32_t used; // live and deleted slots
+
+	_Atomic int64_t live[RESOURCE_TYPE_COUNT];
+	_Atomic int64_t bytes[RESOURCE_TYPE_COUNT];
+	_Atomic uint64_t created[RESOURCE_TYPE_COUNT];
+	_Atomic uint64_t unknown_destroys;
+} registry = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+static const char *type_names[RESOURCE_TYPE_COUNT] = {
+	[RESOURCE_BUFFER] = "buffer",
+	[RESOURCE_MEMORY] = "memory",
+	[RESOURCE_IMAGE] = "image",
+	[RESOURCE_IMAGE_VIEW] = "image_view",
+	[RESOURCE_SAMPLER] = "sampler",
+	[RESOURCE_PIPELINE] = "pipeline",
+	[RESOURCE_PIPELINE_LAYOUT] = "pipeline_layout",
+	[RESOURCE_PIPELINE_CACHE] = "pipeline_cache",
+	[RESOURCE_RENDER_PASS] = "render_pass",
+	[RESOURCE_FRAMEBUFFER] = "framebuffer",
+	[RESOURCE_DESCRIPTOR_SET_LAYOUT] = "descriptor_set_layout",
+	[RESOURCE_DESCRIPTOR_POOL] = "descriptor_pool",
+	[RESOURCE_COMMAND_POOL] = "command_pool",
+	[RESOURCE_SEMAPHORE] = "semaphore",
+	[RESOURCE_FENCE] = "fence",
+	[RESOURCE_EVENT] = "event",
+	[RESOURCE_QUERY_POOL] = "query_pool",
+};
+
+static uint32_t hash_resource(uint32_t type, uint64_t handle)
+{
+	uint64_t hash = (handle ^ ((uint64_t) type << 56)) * 0x9e3779b97f4a7c15ull;
+
+	return (uint32_t) (hash >> 32);
+}
+
+// under the lock
+static struct TrackedResource *find_slot(uint32_t type, uint64_t handle)
+{
+	uint32_t mask = registry.capacity - 1;
+
+	for (uint32_t i = hash_resource(type, handle) & mask;; i = (i + 1) & mask)
+	{
+		struct TrackedResource *slot = &registry.slots[i];
+
+		if (slot->type == TRACK_EMPTY) return NULL;
+		if (slot->type == type && slot->handle == handle) return slot;
+	}
+}
+
+// under the lock; doubles when live slots take more than a quarter, otherwise only sweeps deleted ones
+static bool rebuild_table(void)
+{
+	uint32_t live = 0;
+	for (uint32_t i = 0; i < registry.capacity; i++) live += registry.slots[i].type < TRACK_DELETED;
+
+	uint32_t capacity = registry.capacity > 0 ? registry.capacity : TRACK_INITIAL_CAPACITY;
+	while (live * 4 >= capacity) capacity *= 2;
+
+	struct TrackedResource *slots = malloc(capacity * sizeof(struct TrackedResource));
+	if (slots == NULL) return false;
+
+	for (uint32_t i = 0; i < capacity; i++) slots[i].type = TRACK_EMPTY;
+
+	struct TrackedResource *old_slots = registry.slots;
+	uint32_t old_capacity = registry.capacity;
+
+	registry.slots = slots;
+	registry.capacity = capacity;
+	registry.used = 0;
+
+	for (uint32_t i = 0; i < old_capacity; i++)
+	{
+		if (old_slots[i].type >= TRACK_DELETED) continue;
+
+		uint32_t mask = capacity - 1;
+		uint32_t j = hash_resource(old_slots[i].type, old_slots[i].handle) & mask;
+		while (slots[j].type != TRACK_EMPTY) j = (j + 1) & mask;
+
+		slots[j] = old_slots[i];
+		registry.used++;
+	}
+
+	free(old_slots);
+
+	return true;
+}
+
+void track_resource_at(enum ResourceType type, uint64_t handle, uint64_t bytes, const char *file, int line)
+{
+	if (handle == 0 || type >= RESOURCE_TYPE_COUNT) return;
+
+	atomic_fetch_add_explicit(&registry.live[type], 1, memory_order_relaxed);
+	atomic_fetch_add_explicit(&registry.bytes[type], (int64_t) bytes, memory_order_relaxed);
+	atomic_fetch_add_explicit(&registry.created[type], 1, memory_order_relaxed);
+
+	pthread_mutex_lock(&registry.lock);
+
+	// at most half full, counting deleted slots, so probes stay short and always end
+	if ((registry.used + 1) * 2 > registry.capacity && !rebuild_table()) {
+		pthread_mutex_unlock(&registry.lock);
+		printf("failed to grow the resource registry, %s from %s:%d is counted but not listed\n", type_names[type], file, line);
+		return;
+	}
+
+	uint32_t mask = registry.capacity - 1;
+	uint32_t i = hash_resource(type, handle) & mask;
+	while (registry.slots[i].type < TRACK_DELETED) i = (i + 1) & mask;
+
+	if (registry.slots[i].type == TRACK_EMPTY) registry.used++;
+
+	registry.slots[i] = (struct TrackedResource) {
+		.handle = handle,
+		.bytes = bytes,
+		.file = file,
+		.line = (uint32_t) line,
+		.type = type,
+	};
+
+	pthread_mutex_unlock(&registry.lock);
+}
+
+void untrack_resource_at(enum ResourceType type, uint64_t handle)
+{
+	if (handle == 0 || type >= RESOURCE_TYPE_COUNT) return;
+
+	pthread_mutex_lock(&registry.lock);
+
+	struct TrackedResource *slot = registry.capacity > 0 ? find_slot(type, handle) : NULL;
+	uint64_t bytes = 0;
+
+	if (slot != NULL) {
+		bytes = slot->bytes;
+		slot->type = TRACK_DELETED;
+	}
+
+	pthread_mutex_unlock(&registry.lock);
+
+	if (slot == NULL) {
+		atomic_fetch_add_explicit(&registry.unknown_destroys, 1, memory_order_relaxed);
+		return;
+	}
+
+	atomic_fetch_sub_explicit(&registry.live[type], 1, memory_order_relaxed);
+	atomic_fetch_sub_explicit(&registry.bytes[type], (int64_t) bytes, memory_order_relaxed);
+}
+
+const char *resource_type_name(enum ResourceType type)
+{
+	return type < RESOURCE_TYPE_COUNT ? type_names[type] : "unknown";
+}
+
+void read_resource_metrics(struct ResourceMetrics *metrics)
+{
+	for (uint32_t i = 0; i < RESOURCE_TYPE_COUNT; i++)
+	{
+		metrics->live[i] = atomic_load_explicit(&registry.live[i], memory_order_relaxed);
+		metrics->bytes[i] = atomic_load_explicit(&registry.bytes[i], memory_order_relaxed);
+		metrics->created[i] = atomic_load_explicit(&registry.created[i], memory_order_relaxed);
+	}
+
+	metrics->unknown_destroys = atomic_load_explicit(&registry.unknown_destroys, memory_order_relaxed);
+}
+
+void write_resource_metrics(FILE *file)
+{
+	struct ResourceMetrics metrics;
+	read_resource_metrics(&metrics);
+
+	fprintf(file, "# HELP vg_resources_live Vulkan objects alive.\n# TYPE vg_resources_live gauge\n");
+	for (uint32_t i = 0; i < RESOURCE_TYPE_COUNT; i++) fprintf(file, "vg_resources_live{type=\"%s\"} %lld\n", type_names[i], (long long) metrics.live[i]);
+
+	fprintf(file, "# HELP vg_resources_bytes Bytes held by live Vulkan objects.\n# TYPE vg_resources_bytes gauge\n");
+	for (uint32_t i = 0; i < RESOURCE_TYPE_COUNT; i++) fprintf(file, "vg_resources_bytes{type=\"%s\"} %lld\n", type_names[i], (long long) metrics.bytes[i]);
+
+	fprintf(file, "# HELP vg_resources_created_total Vulkan objects created since startup.\n# TYPE vg_resources_created_total counter\n");
+	for (uint32_t i = 0; i < RESOURCE_TYPE_COUNT; i++) fprintf(file, "vg_resources_created_total{type=\"%s\"} %llu\n", type_names[i], (unsigned long long) metrics.created[i]);
+
+	fprintf(file, "# HELP vg_resources_unknown_destroys_total Destroyed objects that were never tracked.\n# TYPE vg_resources_unknown_destroys_total counter\n");
+	fprintf(file, "vg_resources_unknown_destroys_total %llu\n", (unsigned long long) metrics.unknown_destroys);
+}
+
+bool write_resource_metrics_file(const char *path)
+{
+	char temporary[1024];
+	snprintf(temporary, sizeof(temporary), "%s.tmp", path);
+
+	FILE *file = fopen(temporary, "w");
+	if (file == NULL) {
+		printf("failed to open %s for metrics\n", temporary);
+		return false;
+	}
+
+	write_resource_metrics(file);
+
+	if (fclose(file) != 0 || rename(temporary, path) != 0) {
+		printf("failed to write metrics to %s\n", path);
+		return false;
+	}
+
+	return true;
+}
+
+struct LeakGroup {
+	uint32_t type;
+	const char *file;
+	uint32_t line;
+	uint32_t count;
+	uint64_t bytes;
+};
+
+static int compare_leak_groups(const void *a, const void *b)
+{
+	const struct LeakGroup *x = a;
+	const struct LeakGroup *y = b;
+
+	if (x->type != y->type) return x->type < y->type ? -1 : 1;
+	if (x->count != y->count) return x->count > y->count ? -1 : 1;
+
+	int file = strcmp(x->file, y->file);
+	if (file != 0) return file;
+
+	return (x->line > y->line) - (x->line < y->line);
+}
+
+uint32_t report_resource_leaks(void)
+{
+	pthread_mutex_lock(&registry.lock);
+
+	uint32_t leaked = 0;
+	for (uint32_t i = 0; i < registry.capacity; i++) leaked += registry.slots[i].type < TRACK_DELETED;
+
+	struct LeakGroup *groups = malloc((leaked > 0 ? leaked : 1) * sizeof(struct LeakGroup));
+	uint32_t group_count = 0;
+	uint64_t leaked_bytes = 0;
+
+	// call sites are few, a scan over the groups found so far is plenty
+	for (uint32_t i = 0; i < registry.capacity && groups != NULL; i++)
+	{
+		const struct TrackedResource *slot = &registry.slots[i];
+		if (slot->type >= TRACK_DELETED) continue;
+
+		uint32_t g = 0;
+		while (g < group_count && !(groups[g].type == slot->type && groups[g].line == slot->line && strcmp(groups[g].file, slot->file) == 0)) g++;
+
+		if (g == group_count) {
+			groups[group_count++] = (struct LeakGroup) {
+				.type = slot->type,
+				.file = slot->file,
+				.line = slot->line,
+				.count = 0,
+				.bytes = 0,
+			};
+		}
+
+		groups[g].count++;
+		groups[g].bytes += slot->bytes;
+		leaked_bytes += slot->bytes;
+	}
+
+	pthread_mutex_unlock(&registry.lock);
+
+	if (leaked == 0) {
+		printf("resource leaks: none\n");
+		free(groups);
+		return 0;
+	}
+
+	printf("resource leaks: %u objects, %.1f KiB\n", leaked, leaked_bytes / 1024.0);
+
+	if (groups != NULL) {
+		qsort(groups, group_count, sizeof(struct LeakGroup), compare_leak_groups);
+
+		for (uint32_t g = 0; g < group_count; g++)
+		{
+			printf("\t%u %s", groups[g].count, type_names[groups[g].type]);
+			if (groups[g].bytes > 0) printf(" (%.1f KiB)", groups[g].bytes / 1024.0);
+			printf(" from %s:%u\n", groups[g].file, groups[g].line);
+		}
+	}
+
+	free(groups);
+
+	return leaked;
+}
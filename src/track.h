@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Registry of live Vulkan objects, for finding leaks in long running
+// processes. Every object the renderer creates is tracked by the code that
+// creates it, tagged with the file and line of the call, and untracked right
+// before it is destroyed. report_resource_leaks lists what is still alive,
+// grouped by where it was created; call it once everything has been torn
+// down.
+//
+// Objects are created and destroyed at startup, on resize and when assets
+// stream in, never per draw, so the cost is a hash insert under a mutex next
+// to a driver call that costs far more. Live counts and byte totals per type
+// are kept in atomics on the side and can be read from any thread without
+// the lock, for a metrics scraper.
+
+enum ResourceType {
+	RESOURCE_BUFFER,
+	RESOURCE_MEMORY, // bytes are the allocation sizes
+	RESOURCE_IMAGE,
+	RESOURCE_IMAGE_VIEW,
+	RESOURCE_SAMPLER,
+	RESOURCE_PIPELINE,
+	RESOURCE_PIPELINE_LAYOUT,
+	RESOURCE_PIPELINE_CACHE,
+	RESOURCE_RENDER_PASS,
+	RESOURCE_FRAMEBUFFER,
+	RESOURCE_DESCRIPTOR_SET_LAYOUT,
+	RESOURCE_DESCRIPTOR_POOL,
+	RESOURCE_COMMAND_POOL,
+	RESOURCE_SEMAPHORE,
+	RESOURCE_FENCE,
+	RESOURCE_EVENT,
+	RESOURCE_QUERY_POOL,
+	RESOURCE_TYPE_COUNT,
+};
+
+struct ResourceMetrics {
+	int64_t live[RESOURCE_TYPE_COUNT];
+	int64_t bytes[RESOURCE_TYPE_COUNT];
+	uint64_t created[RESOURCE_TYPE_COUNT]; // since startup
+	uint64_t unknown_destroys;             // untracked handles, created elsewhere or destroyed twice
+};
+
+// handles are pointers or 64 bit integers depending on the platform, both fit a uint64_t
+#define track_resource(type, handle, bytes) track_resource_at((type), (uint64_t) (handle), (bytes), __FILE__, __LINE__)
+#define untrack_resource(type, handle) untrack_resource_at((type), (uint64_t) (handle))
+
+// VK_NULL_HANDLE is ignored by both, so failed creations need no special case
+void track_resource_at(enum ResourceType type, uint64_t handle, uint64_t bytes, const char *file, int line);
+void untrack_resource_at(enum ResourceType type, uint64_t handle);
+
+const char *resource_type_name(enum ResourceType type);
+
+// without taking the lock, counts of different types may be a few operations apart
+void read_resource_metrics(struct ResourceMetrics *metrics);
+
+// Prometheus text format; the file variant writes next to path and renames it over, so a scraper
+// never reads half a file. False when the file could not be written
+void write_resource_metrics(FILE *file);
+bool write_resource_metrics_file(const char *path);
+
+// prints every object still alive grouped by type and call site, returns how many there are
+uint32_t report_resource_leaks(void);